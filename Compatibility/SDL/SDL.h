@@ -45,6 +45,8 @@ void SDL_Quit(void);
 
 void SDL_Delay(Uint32 ms);
 
+int SDL_GetCPUCount(void);
+
 void SDL_PumpEvents(void);
 
 void SDL_GL_SwapBuffers(void);
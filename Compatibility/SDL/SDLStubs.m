@@ -27,6 +27,7 @@
 #include "SDL.h"
 #include "SDL_thread.h"
 #import <OpenEmuBase/OETimingUtils.h>
+#include <errno.h>
 #include <pthread.h>
 #include <semaphore.h>
 #include <sys/time.h>
@@ -57,7 +58,7 @@ void SDL_DestroyMutex(SDL_mutex *m)
 
 Uint32 SDL_GetTicks(void)
 {
-    return OEMonotonicTime();
+    return (Uint32)(OEMonotonicTime() * 1000.0);
 }
 
 void SDL_Quit(void)
@@ -69,6 +70,13 @@ void SDL_Delay(Uint32 ms)
     usleep(ms * 1000);
 }
 
+int SDL_GetCPUCount(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (count > 0) ? (int)count : 1;
+}
+
 void SDL_PumpEvents(void)
 {
 }
@@ -91,6 +99,18 @@ int SDL_CondWait(SDL_cond *cond, SDL_mutex *mut)
     return pthread_cond_wait((pthread_cond_t*)cond, (pthread_mutex_t*)mut);
 }
 
+int SDL_CondWaitTimeout(SDL_cond *cond, SDL_mutex *mut, Uint32 ms)
+{
+    struct timespec delay;
+    int retval;
+
+    delay.tv_sec = ms / 1000;
+    delay.tv_nsec = (long)(ms % 1000) * 1000000;
+    retval = pthread_cond_timedwait_relative_np((pthread_cond_t*)cond, (pthread_mutex_t*)mut, &delay);
+
+    return (retval == ETIMEDOUT) ? SDL_MUTEX_TIMEDOUT : retval;
+}
+
 int SDL_CondSignal(SDL_cond *cond)
 {
     return pthread_cond_signal((pthread_cond_t*)cond);
@@ -102,25 +122,36 @@ void SDL_DestroyCond(SDL_cond *cond)
     free(cond);
 }
 
-static struct {
+struct fake_sdl_thread_context {
+    int (*fn)(void *);
     const char *thread_name;
     void *thread_context;
-} sContext;
+};
 
 void *Fake_SDL_New_Thread(void *p)
 {
-    pthread_setname_np(sContext.thread_name);
-    int (*fn)(void *) = p;
-    return (void*)fn(sContext.thread_context);
+    struct fake_sdl_thread_context context = *(struct fake_sdl_thread_context *)p;
+
+    free(p);
+    pthread_setname_np(context.thread_name);
+    return (void*)(intptr_t)context.fn(context.thread_context);
 }
 
 SDL_Thread *SDL_CreateThread(int (*fn)(void *), const char *name, void *context)
 {
     pthread_t *thread = malloc(sizeof(pthread_t));
-    
-    sContext.thread_name = name;
-    sContext.thread_context = context;
-    pthread_create(thread, NULL, Fake_SDL_New_Thread, fn);
+    struct fake_sdl_thread_context *ctx = malloc(sizeof(*ctx));
+
+    /* Each thread gets its own context: several threads may be created
+     * before the first one had a chance to start running. */
+    ctx->fn = fn;
+    ctx->thread_name = name;
+    ctx->thread_context = context;
+    if (pthread_create(thread, NULL, Fake_SDL_New_Thread, ctx) != 0) {
+        free(ctx);
+        free(thread);
+        return NULL;
+    }
     return (SDL_Thread*)thread;
 }
 
@@ -27,6 +27,8 @@
 #ifndef SDL_THREAD_H
 #define SDL_THREAD_H
 
+#include <stdint.h>
+
 #define SDL_VERSION_ATLEAST(x,y,z) 1
 
 typedef void SDL_mutex;
@@ -34,6 +36,8 @@ typedef void SDL_cond;
 typedef void SDL_Thread;
 typedef void SDL_sem;
 
+#define SDL_MUTEX_TIMEDOUT 1
+
 __BEGIN_DECLS
 
 SDL_mutex *SDL_CreateMutex(void);
@@ -43,6 +47,7 @@ void SDL_DestroyMutex(SDL_mutex *m);
 
 SDL_cond *SDL_CreateCond(void);
 int SDL_CondWait(SDL_cond *cond, SDL_mutex *mut);
+int SDL_CondWaitTimeout(SDL_cond *cond, SDL_mutex *mut, uint32_t ms);
 int SDL_CondSignal(SDL_cond *cond);
 void SDL_DestroyCond(SDL_cond *cond);
 
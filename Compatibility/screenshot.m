@@ -27,10 +27,26 @@
 #include "osd.h"
 #include "../mupen64plus-core/src/main/screenshot.h"
 
+void ScreenshotInit(void)
+{
+}
+
+void ScreenshotDeinit(void)
+{
+}
+
 void ScreenshotRomOpen(void)
 {
 }
 
+void ScreenshotRomClose(void)
+{
+}
+
 void TakeScreenshot(int iFrameNumber)
 {
 }
+
+void DumpFrame(int iFrameNumber)
+{
+}
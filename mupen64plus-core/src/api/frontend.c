@@ -25,6 +25,7 @@
  */
 
 #include <SDL.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -38,6 +39,8 @@
 #include "m64p_types.h"
 #include "main/cheat.h"
 #include "main/eventloop.h"
+#include "main/frame_ring.h"
+#include "main/headless.h"
 #include "main/main.h"
 #include "main/rom.h"
 #include "main/savestates.h"
@@ -46,6 +49,9 @@
 #include "main/workqueue.h"
 #include "main/screenshot.h"
 #include "main/netplay.h"
+#include "main/observe.h"
+#include "main/profile.h"
+#include "device/r4300/new_dynarec/new_dynarec.h"
 #include "plugin/plugin.h"
 #include "vidext.h"
 
@@ -86,6 +92,9 @@ EXPORT m64p_error CALL CoreStartup(int APIVersion, const char *ConfigPath, const
     plugin_connect(M64PLUGIN_CORE, NULL);
 
     savestates_init();
+    ScreenshotInit();
+    observe_init();
+    frame_ring_init();
 
     /* next, start up the configuration handling code by loading and parsing the config file */
     if (ConfigInit(ConfigPath, DataPath) != M64ERR_SUCCESS)
@@ -119,10 +128,13 @@ EXPORT m64p_error CALL CoreShutdown(void)
         return M64ERR_NOT_INIT;
 
     /* close down some core sub-systems */
+    ScreenshotDeinit();
     romdatabase_close();
     ConfigShutdown();
     workqueue_shutdown();
     savestates_deinit();
+    observe_deinit();
+    frame_ring_deinit();
 
     /* if the calling code is using SDL, don't shut it down */
     if (!l_CallerUsingSDL)
@@ -348,6 +360,10 @@ EXPORT m64p_error CALL CoreDoCommand(m64p_command Command, int ParamInt, void *P
                 return M64ERR_INPUT_INVALID;
             g_media_loader = *(m64p_media_loader*)ParamPtr;
             return M64ERR_SUCCESS;
+        case M64CMD_SET_HEADLESS:
+            if (g_EmulatorRunning)
+                return M64ERR_INVALID_STATE;
+            return headless_set_params((const m64p_headless*)ParamPtr, ParamInt);
         case M64CMD_NETPLAY_INIT:
             if (ParamInt < 1 || ParamPtr == NULL)
                 return M64ERR_INPUT_INVALID;
@@ -372,6 +388,61 @@ EXPORT m64p_error CALL CoreDoCommand(m64p_command Command, int ParamInt, void *P
                 return M64ERR_INCOMPATIBLE;
         case M64CMD_NETPLAY_CLOSE:
             return netplay_stop();
+        case M64CMD_DYNAREC_GET_STATS:
+#ifdef NEW_DYNAREC
+        {
+            m64p_dynarec_stats stats;
+            if (ParamPtr == NULL)
+                return M64ERR_INPUT_ASSERT;
+            if (ParamInt < 0)
+                return M64ERR_INPUT_INVALID;
+            if ((int)sizeof(m64p_dynarec_stats) < ParamInt)
+                ParamInt = sizeof(m64p_dynarec_stats);
+            new_dynarec_get_stats(&stats);
+            memcpy(ParamPtr, &stats, ParamInt);
+            return M64ERR_SUCCESS;
+        }
+#else
+            return M64ERR_UNSUPPORTED;
+#endif
+        case M64CMD_DYNAREC_DUMP_BLOCKS:
+#ifdef NEW_DYNAREC
+            /* the block lists are only stable while the emulation thread is paused */
+            if (!g_EmulatorRunning || !g_rom_pause)
+                return M64ERR_INVALID_STATE;
+            if (ParamPtr == NULL)
+                return M64ERR_INPUT_ASSERT;
+            return new_dynarec_dump_blocks((const char *) ParamPtr);
+#else
+            return M64ERR_UNSUPPORTED;
+#endif
+        case M64CMD_PROFILE_SET_MODE:
+            return profile_set_mode(ParamInt);
+        case M64CMD_PROFILE_GET_SECTIONS:
+            if (ParamPtr == NULL)
+                return M64ERR_INPUT_ASSERT;
+            return profile_get_sections((m64p_profile_section*) ParamPtr, ParamInt);
+        case M64CMD_PROFILE_DUMP_TRACE:
+            /* the trace ring is only stable while the emulation thread is paused */
+            if (g_EmulatorRunning && !g_rom_pause)
+                return M64ERR_INVALID_STATE;
+            if (ParamPtr == NULL)
+                return M64ERR_INPUT_ASSERT;
+            return profile_dump_trace((const char *) ParamPtr);
+        case M64CMD_FRAME_RING_GET_FD:
+            if (!g_EmulatorRunning)
+                return M64ERR_INVALID_STATE;
+            if (ParamPtr == NULL)
+                return M64ERR_INPUT_ASSERT;
+            return frame_ring_get_fd((int *) ParamPtr);
+        case M64CMD_OBSERVE_GET:
+            if (!g_EmulatorRunning)
+                return M64ERR_INVALID_STATE;
+            if (ParamPtr == NULL)
+                return M64ERR_INPUT_ASSERT;
+            return observe_get(&g_dev, (m64p_observation *) ParamPtr);
+        case M64CMD_OBSERVE_WATCH:
+            return observe_watch((const m64p_observe_range *) ParamPtr, ParamInt);
         default:
             return M64ERR_INPUT_INVALID;
     }
@@ -428,7 +499,8 @@ EXPORT m64p_error CALL CoreGetRomSettings(m64p_rom_settings *RomSettings, int Ro
         return M64ERR_NOT_INIT;
     if (RomSettings == NULL)
         return M64ERR_INPUT_ASSERT;
-    if (RomSettingsLength < (int)sizeof(m64p_rom_settings))
+    /* rsplle was appended to the structure, older front-ends don't know about it */
+    if (RomSettingsLength < (int)offsetof(m64p_rom_settings, rsplle))
         return M64ERR_INPUT_INVALID;
 
     /* Look up this ROM in the .ini file and fill in goodname, etc */
@@ -452,6 +524,14 @@ EXPORT m64p_error CALL CoreGetRomSettings(m64p_rom_settings *RomSettings, int Ro
     RomSettings->savetype = entry->savetype;
     RomSettings->sidmaduration = entry->sidmaduration;
     RomSettings->aidmamodifier = entry->aidmamodifier;
+    if (RomSettingsLength >= (int)offsetof(m64p_rom_settings, XXH3))
+    {
+        strncpy(RomSettings->rsplle, entry->rsplle != NULL ? entry->rsplle : "", sizeof(RomSettings->rsplle) - 1);
+        RomSettings->rsplle[sizeof(RomSettings->rsplle) - 1] = '\0';
+    }
+    /* the database only has MD5 hashes */
+    if (RomSettingsLength >= (int)sizeof(m64p_rom_settings))
+        RomSettings->XXH3[0] = '\0';
 
     return M64ERR_SUCCESS;
 }
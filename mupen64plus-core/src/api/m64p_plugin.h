@@ -288,9 +288,14 @@ EXPORT void CALL SetVRUWordMask(uint8_t length, uint8_t *mask);
 /* RSP plugin function pointers */
 typedef unsigned int (*ptr_DoRspCycles)(unsigned int Cycles);
 typedef void (*ptr_InitiateRSP)(RSP_INFO Rsp_Info, unsigned int *CycleCount);
+/* Optional: wait until every task started by DoRspCycles is done with RDRAM.
+ * Called before the completion of a task is reported to the game, before
+ * AI DMAs and around savestates. */
+typedef void (*ptr_SyncRspTasks)(void);
 #if defined(M64P_PLUGIN_PROTOTYPES)
 EXPORT unsigned int CALL DoRspCycles(unsigned int Cycles);
 EXPORT void CALL InitiateRSP(RSP_INFO Rsp_Info, unsigned int *CycleCount);
+EXPORT void CALL SyncRspTasks(void);
 #endif
 
 #ifdef __cplusplus
@@ -139,6 +139,7 @@ typedef enum {
   M64CORE_STATE_LOADCOMPLETE,
   M64CORE_STATE_SAVECOMPLETE,
   M64CORE_SCREENSHOT_CAPTURED,
+  M64CORE_AUDIO_BUFFER_LEVEL,
 } m64p_core_param;
 
 typedef enum {
@@ -171,7 +172,16 @@ typedef enum {
   M64CMD_PIF_OPEN,
   M64CMD_ROM_SET_SETTINGS,
   M64CMD_DISK_OPEN,
-  M64CMD_DISK_CLOSE
+  M64CMD_DISK_CLOSE,
+  M64CMD_DYNAREC_GET_STATS,
+  M64CMD_DYNAREC_DUMP_BLOCKS,
+  M64CMD_SET_HEADLESS,
+  M64CMD_PROFILE_SET_MODE,
+  M64CMD_PROFILE_GET_SECTIONS,
+  M64CMD_PROFILE_DUMP_TRACE,
+  M64CMD_FRAME_RING_GET_FD,
+  M64CMD_OBSERVE_GET,
+  M64CMD_OBSERVE_WATCH
 } m64p_command;
 
 typedef struct {
@@ -179,6 +189,107 @@ typedef struct {
   int      value;
 } m64p_cheat_code;
 
+typedef struct {
+  uint64_t blocks_compiled;       /* Blocks translated by the dynamic recompiler */
+  uint64_t bytes_emitted;         /* Host code bytes generated for those blocks */
+  uint64_t compile_time_ns;       /* Time spent translating blocks */
+  uint64_t invalidations;         /* Code pages invalidated by writes (self-modifying code, DMA) */
+  uint64_t blocks_restored;       /* Invalidated blocks found unmodified and made valid again */
+  uint64_t verify_dirty_failures; /* Invalidated blocks whose code had really changed */
+  uint64_t cache_wraps;           /* Times the translation cache was filled and reused from the start */
+  uint32_t cache_size;            /* Translation cache size in bytes */
+  uint32_t cache_kept_regions;    /* Cache regions currently kept across wraps because they are hot */
+} m64p_dynarec_stats;
+
+typedef enum {
+  M64P_PROFILE_OFF = 0,
+  M64P_PROFILE_COUNTERS,  /* Accumulate per-section counters and histograms */
+  M64P_PROFILE_TRACE,     /* Also keep the last events for M64CMD_PROFILE_DUMP_TRACE */
+  M64P_PROFILE_CPU_EVENTS = 0x100 /* Flag to combine with the above: also count CPU events (Linux only) */
+} m64p_profile_mode;
+
+typedef enum {
+  M64P_PROFILE_CYCLES = 0,
+  M64P_PROFILE_INSTRUCTIONS,
+  M64P_PROFILE_L1D_MISSES,        /* L1 data cache read misses */
+  M64P_PROFILE_LLC_MISSES,        /* Last level cache read misses */
+  M64P_PROFILE_BRANCH_MISSES,
+  M64P_PROFILE_EVENTS
+} m64p_profile_event;
+
+#define M64P_PROFILE_HISTOGRAM_BUCKETS 32
+
+typedef struct {
+  char     name[32];              /* Section name, empty for unused entries */
+  char     category[16];          /* Subsystem the section belongs to (core, dynarec, rsp, ...) */
+  uint64_t count;                 /* Times the section was recorded */
+  uint64_t total_ns;              /* Time spent in the section */
+  uint64_t min_ns;
+  uint64_t max_ns;
+  uint64_t value;                 /* Section specific amount, eg bytes transferred by DMA sections */
+  uint64_t histogram[M64P_PROFILE_HISTOGRAM_BUCKETS]; /* Bucket i counts durations in [2^i, 2^(i+1)) ns, the last one everything above */
+  uint64_t events[M64P_PROFILE_EVENTS]; /* CPU events counted in the section, indexed by m64p_profile_event */
+  uint32_t events_mask;           /* Bit n is set if event n was counted */
+} m64p_profile_section;
+
+/* Shared memory frame ring (see the FrameRingMode parameter). The ring starts
+ * with a m64p_frame_ring_header, followed at slot_offset by slot_count slots
+ * of slot_size bytes. Each slot is a m64p_frame_ring_slot, followed at
+ * M64P_FRAME_RING_SLOT_HEADER by the pixels, in the M64CMD_READ_SCREEN format.
+ *
+ * Frame n is written to slot n % slot_count. A reader takes the sequence of
+ * the header, reads the frame from its slot if the slot has the same sequence,
+ * and checks again the sequence of the slot afterwards: if it changed, the
+ * frame was overwritten while being read. */
+#define M64P_FRAME_RING_MAGIC       0x4652364d  /* "M6RF" */
+#define M64P_FRAME_RING_VERSION     1
+#define M64P_FRAME_RING_SLOT_HEADER 64
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slot_count;
+  uint32_t slot_offset;           /* Offset of the first slot from the start of the ring */
+  uint64_t slot_size;             /* Bytes between two slots */
+  uint64_t pixels_size;           /* Pixel bytes available in each slot */
+  volatile uint64_t sequence;     /* Sequence number of the last complete frame, 0 before the first one */
+} m64p_frame_ring_header;
+
+typedef struct {
+  volatile uint64_t sequence;     /* Sequence number of the frame in the slot, 0 while it is written */
+  int64_t  timestamp_ns;          /* Monotonic time at which the frame was captured */
+  uint32_t frame;                 /* Core frame counter */
+  uint32_t width;
+  uint32_t height;
+  uint32_t pitch;                 /* Bytes per row, rows are stored bottom row first */
+} m64p_frame_ring_slot;
+
+typedef struct {
+  uint32_t address;               /* RDRAM address of the first byte, 4 bytes aligned */
+  uint32_t length;                /* Bytes to watch, multiple of 4 */
+} m64p_observe_range;
+
+/* Returned by M64CMD_OBSERVE_GET. The pointers stay valid until the emulation
+ * stops, and the memory they point to is only stable while the emulation
+ * thread is in the frame callback or paused. Memories are arrays of 32-bit
+ * words in host byte order, as with DebugMemGetPointer. */
+typedef struct {
+  unsigned int    frame;          /* Frame counter, as passed to the frame callback */
+  const uint32_t* rdram;
+  uint32_t        rdram_size;     /* Bytes */
+  const uint32_t* sp_mem;         /* RSP DMEM (0x1000 bytes) followed by IMEM (0x1000 bytes) */
+  const uint32_t* vi_regs;
+  uint32_t        fb_address;     /* RDRAM address of the framebuffer scanned out by the VI */
+  uint32_t        fb_width;       /* Pixels per line of that framebuffer */
+  uint32_t        fb_bpp;         /* 16 or 32, 0 if the VI is blanked */
+  const void*     screen;         /* Last frame published in the frame ring, NULL if there is none */
+  int             screen_width;
+  int             screen_height;
+  const uint32_t* watch_data;     /* Watched ranges, packed in the order they were given, copied before each frame callback.
+                                     After M64CMD_OBSERVE_WATCH, it is no longer updated and stays valid until the next M64CMD_OBSERVE_GET */
+  uint32_t        watch_size;     /* Bytes */
+} m64p_observation;
+
 typedef struct {
   /* Frontend-defined callback data. */
   void* cb_data;
@@ -220,6 +331,44 @@ typedef struct {
   char* (*get_dd_disk)(void* cb_data);
 } m64p_media_loader;
 
+typedef struct {
+  /* Frontend-defined callback data. */
+  void* cb_data;
+
+  /* Stop emulation at the vertical interrupt which completes this many frames,
+   * 0 for no limit. */
+  uint32_t frame_limit;
+
+  /* Stop emulation at the first vertical interrupt at which the CP0 Count register
+   * has advanced by at least this many ticks since emulation started, 0 for no limit. */
+  uint64_t count_limit;
+
+  /* Have the video plugin render every frame_interval-th frame, 0 to never render. */
+  uint32_t frame_interval;
+
+  /* Buffer receiving the rendered frames in the format of M64CMD_READ_SCREEN
+   * (24-bit RGB), and its size in bytes. May be NULL to render without reading back. */
+  void* frame_buffer;
+  uint32_t frame_buffer_size;
+
+  /* Called on the emulation thread once frame_buffer holds a new frame (may be NULL)
+   * cb_data: points to frontend-defined callback data.
+   * frame: number of the frame, starting from 1
+   * width, height: dimensions of the frame
+   */
+  void (*frame_ready)(void* cb_data, uint32_t frame, int width, int height);
+
+  /* Called on the emulation thread with the samples played by the AI (may be NULL,
+   * in which case audio is discarded)
+   * cb_data: points to frontend-defined callback data.
+   * samples: 16-bit stereo samples, as 32-bit words holding the left sample in their
+   * upper half, in host byte order
+   * size: size of the samples in bytes
+   * frequency: sample rate in Hz
+   */
+  void (*audio_samples)(void* cb_data, const void* samples, uint32_t size, uint32_t frequency);
+} m64p_headless;
+
 /* ----------------------------------------- */
 /* Structures to hold ROM image information  */
 /* ----------------------------------------- */
@@ -287,6 +436,8 @@ typedef struct
    unsigned int countperop; /* Number of CPU cycles per instruction. */
    unsigned int sidmaduration; /* Default SI DMA duration */
    unsigned int aidmamodifier; /* Percentage modifier for AI DMA duration */
+   char rsplle[256]; /* Names of the RSP ucodes to run on the LLE fallback instead of HLE */
+   char XXH3[17]; /* 64-bit XXH3 hash of the image, faster to compute than MD5 */
 } m64p_rom_settings;
 
 /* ----------------------------------------- */
@@ -21,14 +21,45 @@
 
 #include "file_storage.h"
 
+#include <SDL.h>
+#include <SDL_thread.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "api/callbacks.h"
 #include "api/m64p_types.h"
 #include "backends/api/storage_backend.h"
 #include "device/dd/dd_controller.h"
+#include "main/list.h"
 #include "main/util.h"
 #include "main/netplay.h"
+#include "main/workqueue.h"
+
+/* Writes are delayed until the storage has been left alone for that long,
+ * so that bursts of small saves (EEPROM blocks, flashram pages)
+ * end up in a single file write. */
+enum { FILE_STORAGE_FLUSH_DELAY_MS = 250 };
+
+/* Storages up to that size are rewritten as a whole through a temporary file.
+ * Larger ones (64DD disks) only get their dirty range written in place. */
+enum { FILE_STORAGE_ATOMIC_MAX_SIZE = 0x100000 };
+
+struct file_storage_writer
+{
+    struct file_storage* fstorage;
+    SDL_mutex* lock;
+    struct work_fence* fence;
+
+    /* coalesced range waiting to be written */
+    size_t dirty_start;
+    size_t dirty_end;
+    int full;
+
+    int queued;
+    int flushing;
+    unsigned int last_save;
+    struct work_struct work;
+};
 
 int open_file_storage(struct file_storage* fstorage, size_t size, const char* filename)
 {
@@ -36,6 +67,7 @@ int open_file_storage(struct file_storage* fstorage, size_t size, const char* fi
     fstorage->filename = filename;
     fstorage->size = size;
     fstorage->first_access = 1;
+    fstorage->writer = NULL;
 
     /* allocate memory for holding data */
     fstorage->data = malloc(fstorage->size);
@@ -60,6 +92,7 @@ int open_rom_file_storage(struct file_storage* fstorage, const char* filename)
     fstorage->size = 0;
     fstorage->filename = NULL;
     fstorage->first_access = 1;
+    fstorage->writer = NULL;
 
     file_status_t err = load_file(filename, (void**)&fstorage->data, &fstorage->size);
 
@@ -71,8 +104,143 @@ int open_rom_file_storage(struct file_storage* fstorage, const char* filename)
     return err;
 }
 
+static void file_storage_report(const struct file_storage* fstorage, file_status_t err)
+{
+    switch(err)
+    {
+    case file_open_error:
+        DebugMessage(M64MSG_WARNING, "couldn't open storage file '%s' for writing", fstorage->filename);
+        break;
+    case file_write_error:
+        DebugMessage(M64MSG_WARNING, "failed to write storage file '%s'", fstorage->filename);
+        break;
+    default:
+        break;
+    }
+}
+
+static void file_storage_flush_work(struct work_struct* work)
+{
+    struct file_storage_writer* writer = container_of(work, struct file_storage_writer, work);
+    struct file_storage* fstorage = writer->fstorage;
+    uint8_t* snapshot;
+    size_t start, size;
+    unsigned int elapsed;
+    int whole_file;
+    file_status_t err;
+
+    SDL_LockMutex(writer->lock);
+    for (;;) {
+        /* debounce: come back once the game has stopped writing, without
+         * holding a worker thread meanwhile */
+        elapsed = SDL_GetTicks() - writer->last_save;
+        if (!writer->flushing && elapsed < FILE_STORAGE_FLUSH_DELAY_MS) {
+            work_fence_add(writer->fence, &writer->work);
+            SDL_UnlockMutex(writer->lock);
+            queue_delayed_work(&writer->work, FILE_STORAGE_FLUSH_DELAY_MS - elapsed);
+            return;
+        }
+
+        if (!writer->full && writer->dirty_start >= writer->dirty_end) {
+            break;
+        }
+
+        whole_file = writer->full || fstorage->size <= FILE_STORAGE_ATOMIC_MAX_SIZE;
+        start = whole_file ? 0 : writer->dirty_start;
+        size = whole_file ? fstorage->size : writer->dirty_end - writer->dirty_start;
+
+        writer->full = 0;
+        writer->dirty_start = SIZE_MAX;
+        writer->dirty_end = 0;
+
+        /* write from a snapshot, so emulation can keep on modifying the storage */
+        snapshot = malloc(size);
+        if (snapshot != NULL) {
+            memcpy(snapshot, fstorage->data + start, size);
+        }
+        SDL_UnlockMutex(writer->lock);
+
+        if (!whole_file) {
+            err = write_chunk_to_file(fstorage->filename, (snapshot != NULL) ? snapshot : fstorage->data + start, size, start);
+        }
+        else if (size <= FILE_STORAGE_ATOMIC_MAX_SIZE) {
+            err = write_to_file_atomic(fstorage->filename, (snapshot != NULL) ? snapshot : fstorage->data, size);
+        }
+        else {
+            err = write_to_file(fstorage->filename, (snapshot != NULL) ? snapshot : fstorage->data, size);
+        }
+        file_storage_report(fstorage, err);
+        free(snapshot);
+
+        SDL_LockMutex(writer->lock);
+    }
+
+    writer->queued = 0;
+    SDL_UnlockMutex(writer->lock);
+}
+
+static struct file_storage_writer* file_storage_get_writer(struct file_storage* fstorage)
+{
+    struct file_storage_writer* writer;
+
+    if (fstorage->writer != NULL) {
+        return fstorage->writer;
+    }
+
+    /* debouncing would stall emulation if the flush ran synchronously */
+    if (workqueue_thread_count() == 0) {
+        return NULL;
+    }
+
+    writer = malloc(sizeof(*writer));
+    if (writer == NULL) {
+        return NULL;
+    }
+
+    memset(writer, 0, sizeof(*writer));
+    writer->fstorage = fstorage;
+    writer->dirty_start = SIZE_MAX;
+    writer->lock = SDL_CreateMutex();
+    writer->fence = work_fence_create(NULL);
+    if (writer->lock == NULL || writer->fence == NULL) {
+        DebugMessage(M64MSG_WARNING, "couldn't create background writer for storage file '%s'", fstorage->filename);
+        work_fence_destroy(writer->fence);
+        if (writer->lock != NULL) { SDL_DestroyMutex(writer->lock); }
+        free(writer);
+        return NULL;
+    }
+    init_work(&writer->work, file_storage_flush_work);
+    writer->work.priority = WORK_PRIORITY_LOW;
+
+    fstorage->writer = writer;
+    return writer;
+}
+
+/* Waits for pending writes and releases the background writer */
+void flush_file_storage(struct file_storage* fstorage)
+{
+    struct file_storage_writer* writer = fstorage->writer;
+
+    if (writer == NULL) {
+        return;
+    }
+
+    SDL_LockMutex(writer->lock);
+    writer->flushing = 1;
+    SDL_UnlockMutex(writer->lock);
+
+    work_fence_wait(writer->fence);
+
+    work_fence_destroy(writer->fence);
+    SDL_DestroyMutex(writer->lock);
+    free(writer);
+    fstorage->writer = NULL;
+}
+
 void close_file_storage(struct file_storage* fstorage)
 {
+    flush_file_storage(fstorage);
+
     free((void*)fstorage->data);
     free((void*)fstorage->filename);
 }
@@ -99,7 +267,39 @@ static void file_storage_save(void* storage, size_t start, size_t size)
 
     file_status_t err;
 
-    /* On first save access ignore start/size and write full storage content,
+    /* Hand the write over to the workqueue, coalescing it with pending ones */
+    struct file_storage_writer* writer = file_storage_get_writer(fstorage);
+    if (writer != NULL) {
+        int queue;
+
+        SDL_LockMutex(writer->lock);
+        if (fstorage->first_access) {
+            fstorage->first_access = 0;
+            writer->full = 1;
+        }
+        if (start < writer->dirty_start) {
+            writer->dirty_start = start;
+        }
+        if (start + size > writer->dirty_end) {
+            writer->dirty_end = start + size;
+        }
+        writer->last_save = SDL_GetTicks();
+
+        queue = !writer->queued;
+        writer->queued = 1;
+        if (queue) {
+            work_fence_add(writer->fence, &writer->work);
+        }
+        SDL_UnlockMutex(writer->lock);
+
+        if (queue) {
+            queue_delayed_work(&writer->work, FILE_STORAGE_FLUSH_DELAY_MS);
+        }
+        return;
+    }
+
+    /* Fallback when the writer couldn't be created.
+     * On first save access ignore start/size and write full storage content,
      * otherwise write only updated chunk */
     if (fstorage->first_access) {
         fstorage->first_access = 0;
@@ -109,23 +309,16 @@ static void file_storage_save(void* storage, size_t start, size_t size)
         err = write_chunk_to_file(fstorage->filename, fstorage->data + start, size, start);
     }
 
-    switch(err)
-    {
-    case file_open_error:
-        DebugMessage(M64MSG_WARNING, "couldn't open storage file '%s' for writing", fstorage->filename);
-        break;
-    case file_write_error:
-        DebugMessage(M64MSG_WARNING, "failed to write storage file '%s'", fstorage->filename);
-        break;
-    default:
-        break;
-    }
+    file_storage_report(fstorage, err);
 }
 
 static void file_storage_parent_save(void* storage, size_t start, size_t size)
 {
-    struct file_storage* fstorage = (struct file_storage*)((struct file_storage*)storage)->filename;
-    file_storage_save(fstorage, start, size);
+    struct file_storage* fstorage = (struct file_storage*)storage;
+    struct file_storage* parent = (struct file_storage*)fstorage->filename;
+
+    /* start is relative to the subfile */
+    file_storage_save(parent, (size_t)(fstorage->data - parent->data) + start, size);
 }
 
 static void dummy_save(void* storage, size_t start, size_t size)
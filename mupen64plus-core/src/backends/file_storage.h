@@ -25,17 +25,22 @@
 #include <stddef.h>
 #include <stdint.h>
 
+struct file_storage_writer;
+
 struct file_storage
 {
     uint8_t* data;
     size_t size;
     const char* filename;
     int first_access;
+    /* background writer, created on first save */
+    struct file_storage_writer* writer;
 };
 
 
 int open_file_storage(struct file_storage* storage, size_t size, const char* filename);
 int open_rom_file_storage(struct file_storage* storage, const char* filename);
+void flush_file_storage(struct file_storage* storage);
 void close_file_storage(struct file_storage* storage);
 
 extern const struct storage_backend_interface g_ifile_storage;
@@ -26,9 +26,12 @@
 #include "device/rcp/ri/ri_controller.h"
 #include "device/rcp/vi/vi_controller.h"
 #include "device/rdram/rdram.h"
+#include "main/profile.h"
 #include "main/rom.h"
 #include "plugin/plugin.h"
 
+PROFILE_SECTION(profile_ai_len_changed, "aiLenChanged", "audio");
+
 static void audio_plugin_set_frequency(void* aout, unsigned int frequency)
 {
     struct ai_controller* ai = (struct ai_controller*)aout;
@@ -52,7 +55,10 @@ static void audio_plugin_push_samples(void* aout, const void* buffer, size_t siz
     ai->regs[AI_DRAM_ADDR_REG] = (uint32_t)((uint8_t*)buffer - (uint8_t*)ai->ri->rdram->dram);
     ai->regs[AI_LEN_REG] = (uint32_t)size;
 
+    struct profile_mark mark;
+    profile_start(&mark);
     audio.aiLenChanged();
+    profile_end_value(&profile_ai_len_changed, &mark, size);
 
     ai->regs[AI_LEN_REG] = saved_ai_length;
     ai->regs[AI_DRAM_ADDR_REG] = saved_ai_dram;
@@ -28,6 +28,7 @@
 
 #include "main/main.h"
 #include "main/netplay.h"
+#include "main/profile.h"
 
 #include <stdint.h>
 #include <string.h>
@@ -47,6 +48,8 @@ enum {
 enum { PAK_SWITCH_DELAY = 20 };
 enum { GB_CART_SWITCH_DELAY = 20 };
 
+PROFILE_SECTION(profile_get_keys, "getKeys", "input");
+
 static int is_button_released(uint32_t input, uint32_t last_input, uint32_t mask)
 {
     return ((input & mask) == 0)
@@ -59,6 +62,8 @@ static m64p_error input_plugin_get_input(void* opaque, uint32_t* input_)
     BUTTONS keys = { 0 };
 
     int pak_change_requested = 0;
+    struct profile_mark mark;
+    profile_start(&mark);
 
     /* first poll controller */
     if (!netplay_is_init())
@@ -85,6 +90,8 @@ static m64p_error input_plugin_get_input(void* opaque, uint32_t* input_)
         cin_compat->last_pak_type = Controls[cin_compat->control_id].Plugin; //disable pak switching for netplay
     }
 
+    profile_end(&profile_get_keys, &mark);
+
     /* return an error if controller is not plugged */
     if (!Controls[cin_compat->control_id].Present) {
         return M64ERR_SYSTEM_FAIL;
@@ -41,7 +41,10 @@
 // Note: FP is set to &dynarec_local when executing generated code.
 // Thus the local variables are actually global and not on the stack.
 
-#define TARGET_SIZE_2 25 // 2^25 = 32 megabytes
+#define TARGET_SIZE_2 NEW_DYNAREC_CACHE_SIZE_2 // 2^25 = 32 megabytes, 2^26 = 64 megabytes
+#if TARGET_SIZE_2 > 27
+#error "ARM64 branches cannot span a translation cache larger than 128MB"
+#endif
 #define JUMP_TABLE_SIZE (sizeof(jump_table_symbols)*2)
 
 #endif /* M64P_DEVICE_R4300_NEW_DYNAREC_ARM_ASSEM_ARM64_H */
@@ -33,6 +33,7 @@
 #include "api/m64p_types.h"
 #include "api/callbacks.h"
 #include "main/main.h"
+#include "main/profile.h"
 #include "main/rom.h"
 #include "device/memory/memory.h"
 #include "device/r4300/cached_interp.h"
@@ -43,6 +44,7 @@
 #include "device/r4300/fpu.h"
 #include "device/rcp/mi/mi_controller.h"
 #include "device/rcp/rsp/rsp_core.h"
+#include "osal/files.h"
 
 #if !defined(WIN32)
 #include <sys/mman.h>
@@ -67,6 +69,27 @@ void recomp_dbg_block(int addr);
 #error Unsupported dynarec architecture
 #endif
 
+#if defined(WIN32)
+static long long int get_time_ns(void)
+{
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER counter;
+  if(freq.QuadPart==0) QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&counter);
+  return (long long int)(counter.QuadPart*1000000000.0/freq.QuadPart);
+}
+#else
+#include <time.h>
+static long long int get_time_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (long long int)ts.tv_sec*1000000000+ts.tv_nsec;
+}
+#endif
+
+PROFILE_SECTION(profile_compile, "new_recompile_block", "dynarec");
+
 /* debug */
 #define ASSEM_DEBUG 0
 #define INV_DEBUG 0
@@ -212,6 +235,8 @@ struct ll_entry
   u_int reg32;
   u_int start;
   u_int length;
+  u_int host_length;
+  u_int hits;
 };
 
 /* linkage */
@@ -295,6 +320,21 @@ static struct ll_entry *jump_in[4096];
 static struct ll_entry *jump_dirty[4096];
 static struct ll_entry *jump_out[4096];
 static unsigned char restore_candidate[512];
+// The cache is expired in 8 regions, round robin behind the output pointer.
+// Regions which are dispatched to much more often than the others are kept
+// for another pass instead of being overwritten.
+#define CACHE_REGIONS 8
+#define CACHE_REGION_SHIFT (TARGET_SIZE_2-3)
+#define CACHE_MAX_KEPT_REGIONS 2
+#define CACHE_KEEP_MIN_HITS 1024
+static u_int region_hits[CACHE_REGIONS];
+static u_char region_kept[CACHE_REGIONS];
+static int kept_regions;
+
+// Compilation statistics, see new_dynarec_get_stats
+static m64p_dynarec_stats stats;
+static struct ll_entry *new_entries[MAXBLOCK*2];
+static int new_entry_count;
 
 #if COUNT_NOTCOMPILEDS
 static int notcompiledCount = 0;
@@ -2347,20 +2387,26 @@ u_int verify_dirty(struct ll_entry * head)
     unsigned int page=head->start>>12;
     uintptr_t map_value=g_dev.r4300.new_dynarec_hot_state.memory_map[page];
 
-    if((intptr_t)map_value<(intptr_t)0)
+    if((intptr_t)map_value<(intptr_t)0) {
+      stats.verify_dirty_failures++;
       return head->vaddr;
+    }
 
     while(page<((head->start+head->length-1)>>12)) {
-      if((g_dev.r4300.new_dynarec_hot_state.memory_map[++page]<<2)!=(map_value<<2))
+      if((g_dev.r4300.new_dynarec_hot_state.memory_map[++page]<<2)!=(map_value<<2)) {
+        stats.verify_dirty_failures++;
         return head->vaddr;
+      }
     }
     source=(void*)(head->start+(map_value<<2));
   }
   else
     assert(0);
 
-  if(memcmp(source,head->copy,head->length))
+  if(memcmp(source,head->copy,head->length)) {
+    stats.verify_dirty_failures++;
     return head->vaddr;
+  }
   else
     return 0;
 }
@@ -2378,6 +2424,8 @@ static struct ll_entry *ll_add_32(struct ll_entry **head,int vaddr,u_int reg32,v
   new_entry->start=start;
   new_entry->copy=copy;
   new_entry->length=length;
+  new_entry->host_length=0;
+  new_entry->hits=0;
   new_entry->next=*head;
   *head=new_entry;
   return new_entry;
@@ -2389,13 +2437,30 @@ static struct ll_entry *ll_add(struct ll_entry **head,int vaddr,void *addr,void
   return ll_add_32(head,vaddr,0,addr,clean_addr,start,copy,length);
 }
 
+static u_int cache_region(void *addr)
+{
+  return (((uintptr_t)addr-(uintptr_t)base_addr)>>CACHE_REGION_SHIFT)&(CACHE_REGIONS-1);
+}
+
+// Check if ptr belongs to the block of the cache starting at addr. Code may
+// extend up to MAX_OUTPUT_BLOCK_SIZE past the start of the following block,
+// and code at the end of a kept region may spill into the block being
+// expired, so both are matched as well.
+static int expires_with_block(uintptr_t ptr,intptr_t addr,int shift)
+{
+  uintptr_t block=(addr-(uintptr_t)base_addr)>>shift;
+  if(((ptr-(uintptr_t)base_addr)>>shift)==block) return 1;
+  if(((ptr-(uintptr_t)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==block) return 1;
+  return region_kept[cache_region((void *)ptr)]&&
+         ((ptr-(uintptr_t)base_addr+MAX_OUTPUT_BLOCK_SIZE)>>shift)==block;
+}
+
 static void ll_remove_matching_addrs(struct ll_entry **head,intptr_t addr,int shift)
 {
   struct ll_entry **cur=head;
   struct ll_entry *next;
   while(*cur) {
-    if((((uintptr_t)((*cur)->addr)-(uintptr_t)base_addr)>>shift)==((addr-(uintptr_t)base_addr)>>shift) ||
-       (((uintptr_t)((*cur)->addr)-(uintptr_t)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((addr-(uintptr_t)base_addr)>>shift))
+    if(expires_with_block((uintptr_t)(*cur)->addr,addr,shift))
     {
       if((*cur)->addr!=(*cur)->clean_addr){ //jump_dirty
         assert(head>=jump_dirty&&head<(jump_dirty+4096));
@@ -2451,8 +2516,7 @@ static void ll_kill_pointers(struct ll_entry *head,intptr_t addr,int shift)
   while(head) {
     uintptr_t ptr=get_pointer(head->addr);
     inv_debug("EXP: Lookup pointer to %x at %x (%x)\n",(intptr_t)ptr,(intptr_t)head->addr,head->vaddr);
-    if((((ptr-(uintptr_t)base_addr)>>shift)==((addr-(uintptr_t)base_addr)>>shift)) ||
-       (((ptr-(uintptr_t)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((addr-(uintptr_t)base_addr)>>shift)))
+    if(expires_with_block(ptr,addr,shift))
     {
       inv_debug("EXP: Kill pointer at %x (%x)\n",(intptr_t)head->addr,head->vaddr);
       uintptr_t host_addr=(intptr_t)kill_pointer(head->addr);
@@ -2479,6 +2543,16 @@ static void add_link(u_int vaddr,void *src)
   //inv_debug("add_link: Pointer is to %x\n",(intptr_t)ptr);
 }
 
+// Blocks just ahead of the output pointer are about to be overwritten,
+// unless they live in a region which is kept for another pass (and don't
+// spill over into the next one)
+static int doesnt_expire_soon(void *addr)
+{
+  if(region_kept[cache_region(addr)]&&
+     cache_region(addr)==cache_region((char *)addr+MAX_OUTPUT_BLOCK_SIZE)) return 1;
+  return (((uintptr_t)addr-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2));
+}
+
 static struct ll_entry *get_clean(struct r4300_core* r4300,u_int vaddr,u_int flags)
 {
   u_int page=(vaddr^0x80000000)>>12;
@@ -2508,7 +2582,7 @@ static struct ll_entry *get_dirty(struct r4300_core* r4300,u_int vaddr,u_int fla
   while(head!=NULL) {
     if(head->vaddr==vaddr&&(head->reg32&flags)==0) {
       // Don't restore blocks which are about to expire from the cache
-      if((((uintptr_t)head->addr-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
+      if(doesnt_expire_soon(head->addr)) {
         if(verify_dirty(head)==0) {
           r4300->cached_interp.invalid_code[vaddr>>12]=0;
           r4300->new_dynarec_hot_state.memory_map[vaddr>>12]|=WRITE_PROTECT;
@@ -2658,6 +2732,8 @@ void *get_addr(u_int vaddr)
   if(head!=NULL){
     ht_bin[1]=ht_bin[0];
     ht_bin[0]=head;
+    head->hits++;
+    region_hits[cache_region(head->addr)]++;
     return (void*)(((intptr_t)head->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
   }
 
@@ -2688,8 +2764,16 @@ void *get_addr(u_int vaddr)
 void *get_addr_ht(u_int vaddr)
 {
   struct ll_entry **ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
-  if(ht_bin[0]&&ht_bin[0]->vaddr==vaddr) return (void *)(((intptr_t)ht_bin[0]->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
-  if(ht_bin[1]&&ht_bin[1]->vaddr==vaddr) return (void *)(((intptr_t)ht_bin[1]->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
+  if(ht_bin[0]&&ht_bin[0]->vaddr==vaddr) {
+    ht_bin[0]->hits++;
+    region_hits[cache_region(ht_bin[0]->addr)]++;
+    return (void *)(((intptr_t)ht_bin[0]->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
+  }
+  if(ht_bin[1]&&ht_bin[1]->vaddr==vaddr) {
+    ht_bin[1]->hits++;
+    region_hits[cache_region(ht_bin[1]->addr)]++;
+    return (void *)(((intptr_t)ht_bin[1]->addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
+  }
   return get_addr(vaddr);
 }
 
@@ -2742,11 +2826,11 @@ static void *check_addr(u_int vaddr)
   struct ll_entry **ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
 
   if(ht_bin[0]&&ht_bin[0]->vaddr==vaddr) {
-    if((((uintptr_t)ht_bin[0]->addr-MAX_OUTPUT_BLOCK_SIZE-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2)))
+    if(doesnt_expire_soon((char *)ht_bin[0]->addr-MAX_OUTPUT_BLOCK_SIZE))
       if(ht_bin[0]->addr==ht_bin[0]->clean_addr) return ht_bin[0]->addr; //jump_in
   }
   if(ht_bin[1]&&ht_bin[1]->vaddr==vaddr) {
-    if((((uintptr_t)ht_bin[1]->addr-MAX_OUTPUT_BLOCK_SIZE-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2)))
+    if(doesnt_expire_soon((char *)ht_bin[1]->addr-MAX_OUTPUT_BLOCK_SIZE))
       if(ht_bin[1]->addr==ht_bin[1]->clean_addr) return ht_bin[1]->addr; //jump_in
   }
 
@@ -2754,7 +2838,7 @@ static void *check_addr(u_int vaddr)
   struct ll_entry *head;
   head=get_clean(r4300,vaddr,~0);
   if(head!=NULL){
-    if((((uintptr_t)head->addr-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
+    if(doesnt_expire_soon(head->addr)) {
       // Update existing entry with current address
       if(ht_bin[0]&&ht_bin[0]->vaddr==vaddr) {
         ht_bin[0]=head;
@@ -2816,6 +2900,7 @@ void invalidate_block(u_int block)
   if(page>262143&&g_dev.r4300.cp0.tlb.LUT_r[block]) page=(g_dev.r4300.cp0.tlb.LUT_r[block]^0x80000000)>>12;
   if(page>2048) page=2048+(page&2047);
   inv_debug("INVALIDATE: %x (%d)\n",block<<12,page);
+  stats.invalidations++;
   u_int first,last;
   first=last=page;
   struct ll_entry *head;
@@ -2952,7 +3037,7 @@ void clean_blocks(u_int page)
   while(head!=NULL) {
     if(!g_dev.r4300.cached_interp.invalid_code[head->vaddr>>12]) {
       // Don't restore blocks which are about to expire from the cache
-      if((((uintptr_t)head->addr-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
+      if(doesnt_expire_soon(head->addr)) {
         if(verify_dirty(head)==0) {
           //DebugMessage(M64MSG_VERBOSE, "Possibly Restore %x (%x)",head->vaddr, (intptr_t)head->addr);
           u_int i,j;
@@ -2981,13 +3066,15 @@ void clean_blocks(u_int page)
             inv=1;
           }
           if(!inv) {
-            if((((uintptr_t)head->clean_addr-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
+            if(doesnt_expire_soon(head->clean_addr)) {
               u_int ppage=page;
               if(page<2048&&g_dev.r4300.cp0.tlb.LUT_r[head->vaddr>>12]) ppage=(g_dev.r4300.cp0.tlb.LUT_r[head->vaddr>>12]^0x80000000)>>12;
               inv_debug("INV: Restored %x (%x/%x)\n",head->vaddr, (intptr_t)head->addr, (intptr_t)head->clean_addr);
               //DebugMessage(M64MSG_VERBOSE, "page=%x, addr=%x",page,head->vaddr);
               //assert(head->vaddr>>12==(page|0x80000));
               struct ll_entry *clean_head=ll_add_32(jump_in+ppage,head->vaddr,head->reg32,head->clean_addr,head->clean_addr,head->start,head->copy,head->length);
+              clean_head->host_length=head->host_length;
+              stats.blocks_restored++;
               struct ll_entry **ht_bin=hash_table[((head->vaddr>>16)^head->vaddr)&0xFFFF];
               if(!head->reg32) {
                 if(ht_bin[0]&&ht_bin[0]->vaddr==head->vaddr) {
@@ -8681,7 +8768,7 @@ void new_dynarec_init(void)
 #else
 #if defined(WIN32)
   DWORD dummy;
-  BOOL res=VirtualProtect((void*)g_dev.r4300.extra_memory, 33554432, PAGE_EXECUTE_READWRITE, &dummy);
+  BOOL res=VirtualProtect((void*)g_dev.r4300.extra_memory, 1<<TARGET_SIZE_2, PAGE_EXECUTE_READWRITE, &dummy);
   assert(res!=0);
   base_addr = base_addr_rx = (void*)g_dev.r4300.extra_memory;
 #else
@@ -8711,6 +8798,10 @@ void new_dynarec_init(void)
   memset(restore_candidate,0,sizeof(restore_candidate));
   copy_size=0;
   expirep=16384; // Expiry pointer, +2 blocks
+  memset(region_hits,0,sizeof(region_hits));
+  memset(region_kept,0,sizeof(region_kept));
+  kept_regions=0;
+  memset(&stats,0,sizeof(stats));
   g_dev.r4300.new_dynarec_hot_state.pending_exception=0;
   literalcount=0;
 #if defined(HOST_IMM8) || defined(NEED_INVC_PTR)
@@ -8756,7 +8847,84 @@ void new_dynarec_cleanup(void)
 #endif
 }
 
-int new_recompile_block(int addr)
+void new_dynarec_get_stats(m64p_dynarec_stats *dst)
+{
+  *dst=stats;
+  dst->cache_size=1<<TARGET_SIZE_2;
+  dst->cache_kept_regions=kept_regions;
+}
+
+static int compare_hits(const void *a,const void *b)
+{
+  const struct ll_entry *ea=*(const struct ll_entry * const *)a;
+  const struct ll_entry *eb=*(const struct ll_entry * const *)b;
+  if(ea->hits!=eb->hits) return ea->hits<eb->hits?1:-1;
+  return ea->vaddr<eb->vaddr?-1:(ea->vaddr>eb->vaddr);
+}
+
+// Write every clean entry point as a CSV line, most dispatched first.
+// Dispatches are counted when a block is reached through the hash table
+// or get_addr; jumps through direct links between blocks are not counted.
+int new_dynarec_dump_blocks(const char *filename)
+{
+  struct ll_entry *head;
+  struct ll_entry **entries;
+  size_t count=0,n;
+  FILE *f;
+  int page;
+
+  for(page=0;page<4096;page++)
+    for(head=jump_in[page];head!=NULL;head=head->next) count++;
+
+  entries=(struct ll_entry **)malloc((count?count:1)*sizeof(*entries));
+  if(entries==NULL) return M64ERR_NO_MEMORY;
+  count=0;
+  for(page=0;page<4096;page++)
+    for(head=jump_in[page];head!=NULL;head=head->next) entries[count++]=head;
+  qsort(entries,count,sizeof(*entries),compare_hits);
+
+  f=osal_file_open(filename,"w");
+  if(f==NULL) {
+    DebugMessage(M64MSG_ERROR, "Couldn't open dynarec block dump file: %s", filename);
+    free(entries);
+    return M64ERR_FILES;
+  }
+  fprintf(f,"vaddr,block_start,mips_bytes,host_offset,host_bytes,dispatches\n");
+  for(n=0;n<count;n++) {
+    head=entries[n];
+    fprintf(f,"%08x,%08x,%u,%u,%u,%u\n",head->vaddr,head->start,head->length,
+            (u_int)((uintptr_t)head->addr-(uintptr_t)base_addr),head->host_length,head->hits);
+  }
+  free(entries);
+  if(fclose(f)!=0) return M64ERR_FILES;
+  return M64ERR_SUCCESS;
+}
+
+// Called when the expiry pointer reaches a region. Hit counts decay by half
+// on every call, so they favour regions which were used recently. A region
+// which got at least twice its share of the hits is kept for another pass,
+// everything else is expired as usual.
+static void age_cache_region(int region)
+{
+  u_int total=0;
+  int n;
+  if(region_kept[region]) {
+    region_kept[region]=0;
+    kept_regions--;
+  }
+  for(n=0;n<CACHE_REGIONS;n++) total+=region_hits[n];
+  if(kept_regions<CACHE_MAX_KEPT_REGIONS&&
+     region!=(int)cache_region(out)&&
+     region_hits[region]>=CACHE_KEEP_MIN_HITS&&
+     (uint64_t)region_hits[region]*CACHE_REGIONS>=(uint64_t)total*2) {
+    inv_debug("EXP: Keep region %d (%d/%d hits)\n",region,region_hits[region],total);
+    region_kept[region]=1;
+    kept_regions++;
+  }
+  for(n=0;n<CACHE_REGIONS;n++) region_hits[n]>>=1;
+}
+
+static int recompile_block(int addr)
 {
 #if defined(RECOMPILER_DEBUG) && !defined(RECOMP_DBG)
   recomp_dbg_block(addr);
@@ -11485,6 +11653,7 @@ int new_recompile_block(int addr)
   u_int dirty_pre=0;
   #endif
 
+  new_entry_count=0;
   copy=NULL;
   copy=(char*)malloc((slen*4)+4);
   assert(copy);
@@ -11758,7 +11927,9 @@ int new_recompile_block(int addr)
           dirty_entry_count++;
           intptr_t entry_point=do_dirty_stub(i,head);
           head->clean_addr=(void*)entry_point;
+          new_entries[new_entry_count++]=head;
           head=ll_add(jump_in+page,vaddr,(void *)entry_point,(void *)entry_point,start,copy,slen*4);
+          new_entries[new_entry_count++]=head;
           // If there was an existing entry in the hash table,
           // replace it with the new address.
           // Don't add new entries.  We'll insert the
@@ -11788,7 +11959,8 @@ int new_recompile_block(int addr)
           dirty_entry_count++;
           intptr_t entry_point=do_dirty_stub(i,head);
           head->clean_addr=(void*)entry_point;
-          (void)ll_add_32(jump_in+page,vaddr,r,(void *)entry_point,(void *)entry_point,start,copy,slen*4);
+          new_entries[new_entry_count++]=head;
+          new_entries[new_entry_count++]=ll_add_32(jump_in+page,vaddr,r,(void *)entry_point,(void *)entry_point,start,copy,slen*4);
         }
       }
     }
@@ -11800,6 +11972,10 @@ int new_recompile_block(int addr)
   if(((uintptr_t)out)&7) emit_addnop(13);
   #endif
   assert((uintptr_t)out-beginning<MAX_OUTPUT_BLOCK_SIZE);
+  for(i=0;i<new_entry_count;i++)
+    new_entries[i]->host_length=(uintptr_t)out-beginning;
+  stats.blocks_compiled++;
+  stats.bytes_emitted+=(uintptr_t)out-beginning;
   memcpy(copy,(char*)source,slen*4);
   u_int *ptr=(u_int*)copy;
   ptr[slen]=dirty_entry_count;
@@ -11812,8 +11988,17 @@ int new_recompile_block(int addr)
 
   // If we're within 256K of the end of the buffer,
   // start over from the beginning. (Is 256K enough?)
-  if(out > (u_char *)((u_char *)base_addr+(1<<TARGET_SIZE_2)-MAX_OUTPUT_BLOCK_SIZE-JUMP_TABLE_SIZE))
+  if(out > (u_char *)((u_char *)base_addr+(1<<TARGET_SIZE_2)-MAX_OUTPUT_BLOCK_SIZE-JUMP_TABLE_SIZE)) {
     out=(u_char *)base_addr;
+    stats.cache_wraps++;
+  }
+
+  // Don't let the next block spill into a region which is kept
+  while(region_kept[cache_region(out)]||region_kept[cache_region(out+MAX_OUTPUT_BLOCK_SIZE)]) {
+    out=(u_char *)base_addr+((uintptr_t)(cache_region(out)+1)<<CACHE_REGION_SHIFT);
+    if(out > (u_char *)((u_char *)base_addr+(1<<TARGET_SIZE_2)-MAX_OUTPUT_BLOCK_SIZE-JUMP_TABLE_SIZE))
+      out=(u_char *)base_addr;
+  }
 
   // Trap writes to any of the pages we compiled
   for(i=start>>12;i<=(int)((start+slen*4-4)>>12);i++) {
@@ -11837,6 +12022,12 @@ int new_recompile_block(int addr)
     int shift=TARGET_SIZE_2-3; // Divide into 8 blocks
     intptr_t base=(intptr_t)base_addr+((expirep>>13)<<shift); // Base address of this block
     inv_debug("EXP: Phase %d\n",expirep);
+    if((expirep&8191)==0) age_cache_region(expirep>>13);
+    if(region_kept[expirep>>13]) {
+      // Skip the whole block, it stays valid for another pass
+      expirep=(expirep+1)&65535;
+      continue;
+    }
     switch((expirep>>11)&3)
     {
       case 0:
@@ -11855,13 +12046,11 @@ int new_recompile_block(int addr)
         // Clear hash table
         for(i=0;i<32;i++) {
           struct ll_entry **ht_bin=hash_table[((expirep&2047)<<5)+i];
-          if(ht_bin[1]&&((((uintptr_t)ht_bin[1]->addr-(uintptr_t)base_addr)>>shift)==((base-(uintptr_t)base_addr)>>shift) ||
-             (((uintptr_t)ht_bin[1]->addr-(uintptr_t)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((base-(uintptr_t)base_addr)>>shift))) {
+          if(ht_bin[1]&&expires_with_block((uintptr_t)ht_bin[1]->addr,base,shift)) {
             inv_debug("EXP: Remove hash %x -> %x\n",ht_bin[1]->vaddr,ht_bin[1]->addr);
             ht_bin[1]=NULL;
           }
-          if(ht_bin[0]&&((((uintptr_t)ht_bin[0]->addr-(uintptr_t)base_addr)>>shift)==((base-(uintptr_t)base_addr)>>shift) ||
-             (((uintptr_t)ht_bin[0]->addr-(uintptr_t)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((base-(uintptr_t)base_addr)>>shift))) {
+          if(ht_bin[0]&&expires_with_block((uintptr_t)ht_bin[0]->addr,base,shift)) {
             inv_debug("EXP: Remove hash %x -> %x\n",ht_bin[0]->vaddr,ht_bin[0]->addr);
             ht_bin[0]=ht_bin[1];
             ht_bin[1]=NULL;
@@ -11882,3 +12071,16 @@ int new_recompile_block(int addr)
   }
   return 0;
 }
+
+// Single exit, so that every return gets accounted for
+int new_recompile_block(int addr)
+{
+  long long int compile_start=get_time_ns();
+  struct profile_mark profile_compile_mark;
+  int ret;
+  profile_start(&profile_compile_mark);
+  ret=recompile_block(addr);
+  stats.compile_time_ns+=get_time_ns()-compile_start;
+  profile_end(&profile_compile,&profile_compile_mark);
+  return ret;
+}
@@ -22,6 +22,7 @@
 #ifndef M64P_DEVICE_R4300_NEW_DYNAREC_H
 #define M64P_DEVICE_R4300_NEW_DYNAREC_H
 
+#include "api/m64p_types.h"
 #include "device/r4300/recomp_types.h" /* for precomp_instr */
 
 #include <stddef.h>
@@ -34,6 +35,17 @@
 
 #define WRITE_PROTECT ((uintptr_t)1<<((sizeof(uintptr_t)<<3)-2))
 
+/* log2 of the translation cache size. 32-bit ARM branches only reach +/-32MB,
+ * so the cache stays at 32MB there and on x86; 64-bit hosts default to 64MB.
+ * Can be overridden at build time (e.g. -DNEW_DYNAREC_CACHE_SIZE_2=27). */
+#ifndef NEW_DYNAREC_CACHE_SIZE_2
+#if (NEW_DYNAREC == NEW_DYNAREC_ARM64) || (NEW_DYNAREC == NEW_DYNAREC_X64)
+#define NEW_DYNAREC_CACHE_SIZE_2 26
+#else
+#define NEW_DYNAREC_CACHE_SIZE_2 25
+#endif
+#endif
+
 struct r4300_core;
 
 /* This struct contains "hot" variables used by the new_dynarec
@@ -93,5 +105,7 @@ void invalidate_cached_code_new_dynarec(struct r4300_core* r4300, uint32_t addre
 void new_dynarec_init(void);
 void new_dyna_start(void);
 void new_dynarec_cleanup(void);
+void new_dynarec_get_stats(m64p_dynarec_stats *stats);
+int new_dynarec_dump_blocks(const char *filename);
 
 #endif /* M64P_DEVICE_R4300_NEW_DYNAREC_H */
@@ -41,7 +41,7 @@
 #define DESTRUCTIVE_SHIFT 1
 #define USE_MINI_HT 1
 
-#define TARGET_SIZE_2 25 // 2^25 = 32 megabytes
+#define TARGET_SIZE_2 NEW_DYNAREC_CACHE_SIZE_2 // 2^25 = 32 megabytes, 2^26 = 64 megabytes
 #define JUMP_TABLE_SIZE 0 // Not needed for x86
 
 #ifdef _WIN32
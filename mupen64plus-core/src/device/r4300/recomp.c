@@ -43,9 +43,7 @@
 #include "device/r4300/recomp_types.h"
 #include "device/r4300/tlb.h"
 #include "main/main.h"
-#if defined(PROFILE)
 #include "main/profile.h"
-#endif
 
 #if defined(__x86_64__)
   #include "x86_64/regcache.h"
@@ -56,6 +54,9 @@
 static void *malloc_exec(size_t size);
 static void free_exec(void *ptr, size_t length);
 
+PROFILE_SECTION(profile_init_block, "init_block", "dynarec");
+PROFILE_SECTION(profile_recompile_block, "recompile_block", "dynarec");
+
 /* defined in <arch>/assemble.c */
 void init_assembler(struct r4300_core* r4300, void *block_jumps_table, int block_jumps_number, void *block_riprel_table, int block_riprel_number);
 void free_assembler(struct r4300_core* r4300, void **block_jumps_table, int *block_jumps_number, void **block_riprel_table, int *block_riprel_number);
@@ -455,9 +456,8 @@ static void (*const recomp_funcs[R4300_OPCODES_COUNT])(struct r4300_core* r4300)
 void dynarec_init_block(struct r4300_core* r4300, uint32_t address)
 {
     int i, length, already_exist = 1;
-#if defined(PROFILE)
-    timed_section_start(TIMED_SECTION_COMPILER);
-#endif
+    struct profile_mark mark;
+    profile_start(&mark);
 
     struct precomp_block** block = &r4300->cached_interp.blocks[address >> 12];
 
@@ -600,9 +600,8 @@ void dynarec_init_block(struct r4300_core* r4300, uint32_t address)
             dynarec_init_block(r4300, alt_addr);
         }
     }
-#if defined(PROFILE)
-    timed_section_end(TIMED_SECTION_COMPILER);
-#endif
+
+    profile_end(&profile_init_block, &mark);
 }
 
 void dynarec_free_block(struct precomp_block* block)
@@ -627,9 +626,8 @@ void dynarec_recompile_block(struct r4300_core* r4300, const uint32_t* iw, struc
     int block_start_in_tlb = ((block->start & UINT32_C(0xc0000000)) != UINT32_C(0x80000000));
     int block_not_in_tlb = (block->start >= UINT32_C(0xc0000000) || block->end < UINT32_C(0x80000000));
 
-#if defined(PROFILE)
-    timed_section_start(TIMED_SECTION_COMPILER);
-#endif
+    struct profile_mark mark;
+    profile_start(&mark);
 
     length = get_block_length(block);
     length2 = length - 2 + (length >> 2);
@@ -757,9 +755,7 @@ void dynarec_recompile_block(struct r4300_core* r4300, const uint32_t* iw, struc
     r4300->recomp.pfProfile = NULL;
 #endif
 
-#if defined(PROFILE)
-    timed_section_end(TIMED_SECTION_COMPILER);
-#endif
+    profile_end(&profile_recompile_block, &mark);
 }
 
 /**********************************************************************
@@ -30,6 +30,7 @@
 #include "device/rcp/ri/ri_controller.h"
 #include "device/rcp/vi/vi_controller.h"
 #include "device/rdram/rdram.h"
+#include "plugin/plugin.h"
 
 
 #define AI_STATUS_BUSY UINT32_C(0x40000000)
@@ -196,6 +197,8 @@ void write_ai_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mask
     case AI_LEN_REG:
         masked_write(&ai->regs[AI_LEN_REG], value, mask);
         if (ai->regs[AI_LEN_REG] != 0) {
+            /* the samples may still be produced by an asynchronous audio task */
+            rsp.syncRspTasks();
             fifo_push(ai);
         }
         else {
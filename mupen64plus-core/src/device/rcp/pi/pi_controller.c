@@ -34,10 +34,14 @@
 #include "device/rcp/mi/mi_controller.h"
 #include "device/rcp/rdp/rdp_core.h"
 #include "device/rcp/ri/ri_controller.h"
+#include "main/profile.h"
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
+PROFILE_SECTION(profile_dma_read, "dma_read", "pi");
+PROFILE_SECTION(profile_dma_write, "dma_write", "pi");
+
 int validate_pi_request(struct pi_controller* pi)
 {
     if (pi->regs[PI_STATUS_REG] & (PI_STATUS_DMA_BUSY | PI_STATUS_IO_BUSY)) {
@@ -73,7 +77,10 @@ static void dma_pi_read(struct pi_controller* pi)
     /* PI seems to treat the first 128 bytes differently, see https://n64brew.dev/wiki/Peripheral_Interface#Unaligned_DMA_transfer */
     if (length >= 0x7f && (length & 1))
         length += 1;
+    struct profile_mark mark;
+    profile_start(&mark);
     unsigned int cycles = handler->dma_read(opaque, dram, dram_addr, cart_addr, length);
+    profile_end_value(&profile_dma_read, &mark, length);
 
     /* Mark DMA as busy */
     pi->regs[PI_STATUS_REG] |= PI_STATUS_DMA_BUSY;
@@ -111,7 +118,10 @@ static void dma_pi_write(struct pi_controller* pi)
         length += 1;
     if (length <= 0x80)
         length -= dram_addr & 0x7;
+    struct profile_mark mark;
+    profile_start(&mark);
     unsigned int cycles = handler->dma_write(opaque, dram, dram_addr, cart_addr, length);
+    profile_end_value(&profile_dma_write, &mark, length);
 
     post_framebuffer_write(&pi->dp->fb, dram_addr, length);
 
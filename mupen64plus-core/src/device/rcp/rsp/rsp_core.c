@@ -30,12 +30,15 @@
 #include "device/rcp/ri/ri_controller.h"
 #include "device/rdram/rdram.h"
 #include "main/main.h"
-#if defined(PROFILE)
 #include "main/profile.h"
-#endif
 #include "plugin/plugin.h"
 #include "api/callbacks.h"
 
+PROFILE_SECTION(profile_sp_dma, "sp_dma", "rsp");
+PROFILE_SECTION(profile_gfx_task, "gfx_task", "rsp");
+PROFILE_SECTION(profile_audio_task, "audio_task", "rsp");
+PROFILE_SECTION(profile_other_task, "other_task", "rsp");
+
 static void do_sp_dma(struct rsp_core* sp, const struct sp_dma* dma)
 {
     unsigned int i,j;
@@ -52,6 +55,9 @@ static void do_sp_dma(struct rsp_core* sp, const struct sp_dma* dma)
     unsigned char *spmem = (unsigned char*)sp->mem + (dma->memaddr & 0x1000);
     unsigned char *dram = (unsigned char*)sp->ri->rdram->dram;
 
+    struct profile_mark mark;
+    profile_start(&mark);
+
     if (dma->dir == SP_DMA_READ)
     {
         for(j=0; j<count; j++) {
@@ -79,6 +85,8 @@ static void do_sp_dma(struct rsp_core* sp, const struct sp_dma* dma)
         }
     }
 
+    profile_end_value(&profile_sp_dma, &mark, count * length);
+
     /* schedule end of dma event */
     cp0_update_count(sp->mi->r4300);
     add_interrupt_event(&sp->mi->r4300->cp0, RSP_DMA_EVT, (count * length) / 8);
@@ -309,6 +317,7 @@ void do_SP_Task(struct rsp_core* sp)
     uint32_t save_pc = sp->regs2[SP_PC_REG] & ~0xfff;
 
     uint32_t sp_delay_time;
+    struct profile_mark mark;
 
     if (sp->mem[0xfc0/4] == 1)
     {
@@ -316,13 +325,9 @@ void do_SP_Task(struct rsp_core* sp)
 
         //gfx.processDList();
         sp->regs2[SP_PC_REG] &= 0xfff;
-#if defined(PROFILE)
-        timed_section_start(TIMED_SECTION_GFX);
-#endif
+        profile_start(&mark);
         rsp.doRspCycles(0xffffffff);
-#if defined(PROFILE)
-        timed_section_end(TIMED_SECTION_GFX);
-#endif
+        profile_end(&profile_gfx_task, &mark);
         sp->regs2[SP_PC_REG] |= save_pc;
         new_frame();
 
@@ -344,13 +349,9 @@ void do_SP_Task(struct rsp_core* sp)
     {
         //audio.processAList();
         sp->regs2[SP_PC_REG] &= 0xfff;
-#if defined(PROFILE)
-        timed_section_start(TIMED_SECTION_AUDIO);
-#endif
+        profile_start(&mark);
         rsp.doRspCycles(0xffffffff);
-#if defined(PROFILE)
-        timed_section_end(TIMED_SECTION_AUDIO);
-#endif
+        profile_end(&profile_audio_task, &mark);
         sp->regs2[SP_PC_REG] |= save_pc;
 
         sp_delay_time = 4000;
@@ -358,7 +359,9 @@ void do_SP_Task(struct rsp_core* sp)
     else
     {
         sp->regs2[SP_PC_REG] &= 0xfff;
+        profile_start(&mark);
         rsp.doRspCycles(0xffffffff);
+        profile_end(&profile_other_task, &mark);
         sp->regs2[SP_PC_REG] |= save_pc;
 
         sp_delay_time = 0;
@@ -387,6 +390,10 @@ void rsp_interrupt_event(void* opaque)
 {
     struct rsp_core* sp = (struct rsp_core*)opaque;
 
+    /* This is where the game learns that the task is done. Tasks still
+     * running asynchronously must be done with RDRAM by then. */
+    rsp.syncRspTasks();
+
     if (!sp->rsp_task_locked)
     {
         sp->regs[SP_STATUS_REG] |=
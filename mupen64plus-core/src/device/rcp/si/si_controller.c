@@ -31,6 +31,7 @@
 #include "device/rcp/mi/mi_controller.h"
 #include "device/rcp/ri/ri_controller.h"
 #include "device/rdram/rdram.h"
+#include "main/profile.h"
 #include "osal/preproc.h"
 
 static int validate_dma(struct si_controller* si, uint32_t reg)
@@ -50,6 +51,9 @@ static int validate_dma(struct si_controller* si, uint32_t reg)
     return 1;
 }
 
+PROFILE_SECTION(profile_dma_read, "dma_read", "si");
+PROFILE_SECTION(profile_dma_write, "dma_write", "si");
+
 static void copy_pif_rdram(struct si_controller* si)
 {
     size_t i;
@@ -78,7 +82,10 @@ static void dma_si_write(struct si_controller* si)
 
     si->dma_dir = SI_DMA_WRITE;
 
+    struct profile_mark mark;
+    profile_start(&mark);
     copy_pif_rdram(si);
+    profile_end_value(&profile_dma_write, &mark, PIF_RAM_SIZE);
 
     cp0_update_count(si->mi->r4300);
     si->regs[SI_STATUS_REG] |= SI_STATUS_DMA_BUSY;
@@ -92,7 +99,11 @@ static void dma_si_read(struct si_controller* si)
 
     si->dma_dir = SI_DMA_READ;
 
+    /* includes the joybus processing, and so the controller reads */
+    struct profile_mark mark;
+    profile_start(&mark);
     update_pif_ram(si->pif);
+    profile_end_value(&profile_dma_read, &mark, PIF_RAM_SIZE);
 
     cp0_update_count(si->mi->r4300);
     si->regs[SI_STATUS_REG] |= SI_STATUS_DMA_BUSY;
@@ -27,9 +27,13 @@
 #include "device/memory/memory.h"
 #include "device/r4300/r4300_core.h"
 #include "device/rcp/mi/mi_controller.h"
+#include "main/headless.h"
 #include "main/main.h"
+#include "main/profile.h"
 #include "plugin/plugin.h"
 
+PROFILE_SECTION(profile_update_screen, "updateScreen", "gfx");
+
 unsigned int vi_clock_from_tv_standard(m64p_system_type tv_standard)
 {
     switch(tv_standard)
@@ -159,8 +163,12 @@ void vi_vertical_interrupt_event(void* opaque)
     struct vi_controller* vi = (struct vi_controller*)opaque;
     if (vi->dp->do_on_unfreeze & DELAY_DP_INT)
         vi->dp->do_on_unfreeze |= DELAY_UPDATESCREEN;
-    else
+    else if (!headless_enabled() || headless_wants_frame()) {
+        struct profile_mark mark;
+        profile_start(&mark);
         gfx.updateScreen();
+        profile_end(&profile_update_screen, &mark);
+    }
 
     /* allow main module to do things on VI event */
     new_vi();
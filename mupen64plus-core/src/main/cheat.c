@@ -39,6 +39,7 @@
 
 #include "api/callbacks.h"
 #include "api/m64p_types.h"
+#include "device/memory/memory.h"
 #include "device/r4300/r4300_core.h"
 #include "device/rdram/rdram.h"
 #include "osal/preproc.h"
@@ -61,49 +62,202 @@ typedef struct cheat {
     struct list_head list;
 } cheat_t;
 
+enum cheat_op_type
+{
+    CHEAT_OP_WRITE8,
+    CHEAT_OP_WRITE16,
+    /* tests skip the following "skip" ops when they fail */
+    CHEAT_OP_EQUAL8,
+    CHEAT_OP_EQUAL16,
+    CHEAT_OP_NOT_EQUAL8,
+    CHEAT_OP_NOT_EQUAL16,
+    CHEAT_OP_GS_BUTTON,
+    /* write back the old value and forget it */
+    CHEAT_OP_RESTORE8,
+    CHEAT_OP_RESTORE16
+};
+
+/* Writes and tests go straight to their host byte in RDRAM, with the
+ * address only kept for the invalidation of the recompiled code. */
+struct cheat_op
+{
+    uint8_t type;
+    uint16_t value;
+    uint32_t skip;
+    uint32_t address;
+    void* host;
+    uint32_t* old_value;    /* saved before the first write, or NULL */
+};
+
 /* private functions */
-static uint16_t read_address_16bit(struct r4300_core* r4300, uint32_t address)
+static int is_rdram(uint32_t address, unsigned int size)
+{
+    return (address & 0xFFFFFF) + size <= RDRAM_MAX_SIZE;
+}
+
+/* size of the memory written or tested by a code, 0 if there is none */
+static unsigned int code_size(uint32_t address)
+{
+    switch (address & 0xFF000000)
+    {
+    case 0x80000000:
+    case 0x88000000:
+    case 0xA0000000:
+    case 0xA8000000:
+    case 0xF0000000:
+    case 0xD0000000:
+    case 0xD8000000:
+    case 0xD2000000:
+    case 0xDB000000:
+        return 1;
+    case 0x81000000:
+    case 0x89000000:
+    case 0xA1000000:
+    case 0xA9000000:
+    case 0xF1000000:
+    case 0xD1000000:
+    case 0xD9000000:
+    case 0xD3000000:
+    case 0xDA000000:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+static void* host_address(struct r4300_core* r4300, uint32_t address, unsigned int size)
 {
-    return *(uint16_t*)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S16)));
+    /* only RDRAM is patched */
+    if (!is_rdram(address, size))
+        return NULL;
+
+    return (unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF) ^ ((size == 2) ? S16 : S8));
 }
 
-static uint8_t read_address_8bit(struct r4300_core* r4300, uint32_t address)
+static void write_8bit(struct r4300_core* r4300, uint8_t* host, uint32_t address, uint8_t new_value)
 {
-    return *(uint8_t*)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S8)));
+    /* cheats rewrite the same values every VI, leave the recompiled code
+     * alone if memory didn't change */
+    if (*host == new_value)
+        return;
+
+    *host = new_value;
+    invalidate_r4300_cached_code(r4300, address, 1);
 }
 
-static void update_address_16bit(struct r4300_core* r4300, uint32_t address, uint16_t new_value)
+static void write_16bit(struct r4300_core* r4300, uint16_t* host, uint32_t address, uint16_t new_value)
 {
-    *(uint16_t*)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S16))) = new_value;
+    if (*host == new_value)
+        return;
+
+    *host = new_value;
     /* mask out bit 24 which is used by GS codes to specify 8/16 bits */
     address &= 0xfeffffff;
     invalidate_r4300_cached_code(r4300, address, 2);
 }
 
-static void update_address_8bit(struct r4300_core* r4300, uint32_t address, uint8_t new_value)
+static void run_program(struct r4300_core* r4300, const struct cheat_program* program)
 {
-    *(uint8_t*)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S8))) = new_value;
-    invalidate_r4300_cached_code(r4300, address, 1);
+    const struct cheat_op* op = program->ops;
+    const struct cheat_op* end = program->ops + program->count;
+    int passed;
+
+    while (op < end)
+    {
+        switch (op->type)
+        {
+        case CHEAT_OP_WRITE8:
+            if (op->old_value && (*op->old_value == CHEAT_CODE_MAGIC_VALUE)) {
+                *op->old_value = *(uint8_t*)op->host;
+            }
+            write_8bit(r4300, (uint8_t*)op->host, op->address, (uint8_t)op->value);
+            passed = 1;
+            break;
+        case CHEAT_OP_WRITE16:
+            if (op->old_value && (*op->old_value == CHEAT_CODE_MAGIC_VALUE)) {
+                *op->old_value = *(uint16_t*)op->host;
+            }
+            write_16bit(r4300, (uint16_t*)op->host, op->address, op->value);
+            passed = 1;
+            break;
+        case CHEAT_OP_EQUAL8:
+            passed = (*(uint8_t*)op->host == (uint8_t)op->value);
+            break;
+        case CHEAT_OP_EQUAL16:
+            passed = (*(uint16_t*)op->host == op->value);
+            break;
+        case CHEAT_OP_NOT_EQUAL8:
+            passed = (*(uint8_t*)op->host != (uint8_t)op->value);
+            break;
+        case CHEAT_OP_NOT_EQUAL16:
+            passed = (*(uint16_t*)op->host != op->value);
+            break;
+        case CHEAT_OP_GS_BUTTON:
+            passed = event_gameshark_active();
+            break;
+        case CHEAT_OP_RESTORE8:
+            write_8bit(r4300, (uint8_t*)op->host, op->address, (uint8_t)op->value);
+            *op->old_value = CHEAT_CODE_MAGIC_VALUE;
+            passed = 1;
+            break;
+        case CHEAT_OP_RESTORE16:
+            write_16bit(r4300, (uint16_t*)op->host, op->address, op->value);
+            *op->old_value = CHEAT_CODE_MAGIC_VALUE;
+            passed = 1;
+            break;
+        default:
+            passed = 1;
+            break;
+        }
+
+        op += passed ? 1 : 1 + op->skip;
+    }
 }
 
-static int address_equal_to_8bit(struct r4300_core* r4300, uint32_t address, uint8_t value)
+static struct cheat_op* emit_op(struct cheat_program* program, uint8_t type)
 {
-    uint8_t value_read;
-    value_read = *(uint8_t*)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S8)));
-    return value_read == value;
+    struct cheat_op* op;
+
+    if (program->count == program->capacity)
+    {
+        size_t capacity = (program->capacity == 0) ? 64 : 2 * program->capacity;
+        struct cheat_op* ops = realloc(program->ops, capacity * sizeof(*ops));
+        if (ops == NULL)
+            return NULL;
+
+        program->ops = ops;
+        program->capacity = capacity;
+    }
+
+    op = &program->ops[program->count++];
+    memset(op, 0, sizeof(*op));
+    op->type = type;
+    return op;
 }
 
-static int address_equal_to_16bit(struct r4300_core* r4300, uint32_t address, uint16_t value)
+static int emit_access(struct cheat_program* program, struct r4300_core* r4300, uint8_t type,
+                       unsigned int size, uint32_t address, uint32_t value, uint32_t* old_value)
 {
-    uint16_t value_read;
-    value_read = *(unsigned short *)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S16)));
-    return value_read == value;
+    struct cheat_op* op;
+    void* host = host_address(r4300, address, size);
+
+    /* cheat_add_new warned about it */
+    if (host == NULL)
+        return 1;
+
+    op = emit_op(program, type);
+    if (op == NULL)
+        return 0;
+
+    op->value = (uint16_t)value;
+    op->address = address;
+    op->host = host;
+    op->old_value = old_value;
+    return 1;
 }
 
-/* individual application - returns 0 if we are supposed to skip the next cheat
- * (only really used on conditional codes)
- */
-static int execute_cheat(struct r4300_core* r4300, uint32_t address, uint32_t value, uint32_t* old_value)
+/* emit the ops of a code which isn't a test, returns 0 on allocation failure */
+static int emit_code(struct cheat_program* program, struct r4300_core* r4300, uint32_t address, uint32_t value, uint32_t* old_value)
 {
     switch (address & 0xFF000000)
     {
@@ -112,45 +266,246 @@ static int execute_cheat(struct r4300_core* r4300, uint32_t address, uint32_t va
     case 0xA0000000:
     case 0xA8000000:
     case 0xF0000000:
-        /* if pointer to old value is valid and uninitialized, write current value to it */
-        if (old_value && (*old_value == CHEAT_CODE_MAGIC_VALUE)) {
-            *old_value = read_address_8bit(r4300, address);
-        }
-        update_address_8bit(r4300, address, (uint8_t)value);
-        return 1;
+        return emit_access(program, r4300, CHEAT_OP_WRITE8, 1, address, value, old_value);
     case 0x81000000:
     case 0x89000000:
     case 0xA1000000:
     case 0xA9000000:
     case 0xF1000000:
-        /* if pointer to old value is valid and uninitialized, write current value to it */
-        if (old_value && (*old_value == CHEAT_CODE_MAGIC_VALUE)) {
-            *old_value = read_address_16bit(r4300, address);
-        }
-        update_address_16bit(r4300, address, (uint16_t)value);
+        return emit_access(program, r4300, CHEAT_OP_WRITE16, 2, address, value, old_value);
+    case 0xEE000000:
+        /* most likely, this doesnt do anything. */
+        return emit_access(program, r4300, CHEAT_OP_WRITE16, 2, 0xF1000318, 0x0040, NULL)
+            && emit_access(program, r4300, CHEAT_OP_WRITE16, 2, 0xF100031A, 0x0000, NULL);
+    default:
         return 1;
+    }
+}
+
+/* emit a test code, returns 0 on allocation failure */
+static int emit_test(struct cheat_program* program, struct r4300_core* r4300, uint32_t address, uint32_t value)
+{
+    switch (address & 0xFF000000)
+    {
     case 0xD0000000:
     case 0xD8000000:
-        return address_equal_to_8bit(r4300, address, (uint8_t)value);
+        return emit_access(program, r4300, CHEAT_OP_EQUAL8, 1, address, value, NULL);
     case 0xD1000000:
     case 0xD9000000:
-        return address_equal_to_16bit(r4300, address, (uint16_t)value);
+        return emit_access(program, r4300, CHEAT_OP_EQUAL16, 2, address, value, NULL);
     case 0xD2000000:
     case 0xDB000000:
-        return !(address_equal_to_8bit(r4300, address, (uint8_t)value));
+        return emit_access(program, r4300, CHEAT_OP_NOT_EQUAL8, 1, address, value, NULL);
     case 0xD3000000:
     case 0xDA000000:
-        return !(address_equal_to_16bit(r4300, address, (uint16_t)value));
-    case 0xEE000000:
-        /* most likely, this doesnt do anything. */
-        execute_cheat(r4300, 0xF1000318, 0x0040, NULL);
-        execute_cheat(r4300, 0xF100031A, 0x0000, NULL);
-        return 1;
+        return emit_access(program, r4300, CHEAT_OP_NOT_EQUAL16, 2, address, value, NULL);
     default:
         return 1;
     }
 }
 
+/* A failed test skips the next code which isn't a test, so the tests in
+ * [first, last) jump to the end of the ops emitted so far. */
+static void resolve_tests(struct cheat_program* program, size_t first, size_t last)
+{
+    size_t i;
+
+    for (i = first; i < last; ++i) {
+        program->ops[i].skip = (uint32_t)(program->count - i - 1);
+    }
+}
+
+static int compile_boot_cheat(struct cheat_program* program, struct r4300_core* r4300, cheat_t* cheat)
+{
+    cheat_code_t *code;
+
+    list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
+        /* code should only be written once at boot time */
+        if ((code->address & 0xF0000000) == 0xF0000000) {
+            if (!emit_code(program, r4300, code->address, code->value, &code->old_value))
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int compile_vi_cheat(struct cheat_program* program, struct r4300_core* r4300, cheat_t* cheat)
+{
+    cheat_code_t *code;
+    /* pending tests, a cheat starts without any */
+    size_t tests = program->count;
+    size_t tests_end;
+    size_t gs_button;
+
+    list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
+        /* conditional cheat codes */
+        if ((code->address & 0xF0000000) == 0xD0000000)
+        {
+            switch (code->address & 0xFF000000) {
+            /* if code needs GS button pressed and it's not, skip it */
+            case 0xD8000000:
+            case 0xD9000000:
+            case 0xDA000000:
+            case 0xDB000000:
+                if (emit_op(program, CHEAT_OP_GS_BUTTON) == NULL)
+                    return 0;
+                break;
+            default:
+                break;
+            }
+
+            if (!emit_test(program, r4300, code->address, code->value))
+                return 0;
+        }
+        else
+        {
+            tests_end = program->count;
+
+            switch (code->address & 0xFF000000) {
+            /* GS button triggers cheat code */
+            case 0x88000000:
+            case 0x89000000:
+            case 0xA8000000:
+            case 0xA9000000:
+                gs_button = program->count;
+                if (emit_op(program, CHEAT_OP_GS_BUTTON) == NULL
+                 || !emit_code(program, r4300, code->address, code->value, NULL))
+                    return 0;
+                /* skip whatever the code emitted, if anything */
+                if (program->count == gs_button + 1)
+                    program->count = gs_button;
+                else
+                    program->ops[gs_button].skip = (uint32_t)(program->count - gs_button - 1);
+                break;
+                /* normal cheat code */
+            default:
+                /* exclude boot-time cheat codes */
+                if ((code->address & 0xF0000000) != 0xF0000000) {
+                    if (!emit_code(program, r4300, code->address, code->value, &code->old_value))
+                        return 0;
+                }
+                break;
+            }
+
+            resolve_tests(program, tests, tests_end);
+            tests = program->count;
+        }
+    }
+
+    /* tests at the end of the cheat have nothing left to skip */
+    resolve_tests(program, tests, program->count);
+    return 1;
+}
+
+/* Put back the memory of a cheat which was disabled. The restore ops run
+ * once, in the order of the cheats, and the next application rebuilds the
+ * program without them. */
+static int compile_restore_cheat(struct cheat_program* program, struct r4300_core* r4300, cheat_t* cheat)
+{
+    cheat_code_t *code;
+    uint8_t type;
+    unsigned int size;
+
+    list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
+        if (code->old_value == CHEAT_CODE_MAGIC_VALUE)
+            continue;
+
+        switch (code->address & 0xFF000000)
+        {
+        case 0x80000000:
+        case 0x88000000:
+        case 0xA0000000:
+        case 0xA8000000:
+        case 0xF0000000:
+            type = CHEAT_OP_RESTORE8;
+            size = 1;
+            break;
+        case 0x81000000:
+        case 0x89000000:
+        case 0xA1000000:
+        case 0xA9000000:
+        case 0xF1000000:
+            type = CHEAT_OP_RESTORE16;
+            size = 2;
+            break;
+        default:
+            code->old_value = CHEAT_CODE_MAGIC_VALUE;
+            continue;
+        }
+
+        /* the restore op clears the saved copy of the old value */
+        if (!emit_access(program, r4300, type, size, code->address, code->old_value, &code->old_value))
+            return 0;
+    }
+
+    return 1;
+}
+
+static void free_retired_codes(struct cheat_ctx* ctx)
+{
+    cheat_code_t *code, *safe;
+
+    list_for_each_entry_safe_t(code, safe, &ctx->retired_codes, cheat_code_t, list) {
+        list_del(&code->list);
+        free(code);
+    }
+}
+
+/* Rebuild the programs from the active cheats, with the mutex held. */
+static void compile_cheats(struct cheat_ctx* ctx, struct r4300_core* r4300, int entry)
+{
+    cheat_t *cheat;
+
+    ctx->boot_program.count = 0;
+    ctx->vi_program.count = 0;
+    ctx->dram = r4300->rdram->dram;
+
+    /* the programs were the last users of the removed codes */
+    free_retired_codes(ctx);
+
+    list_for_each_entry_t(cheat, &ctx->active_cheats, cheat_t, list) {
+        if (cheat->enabled)
+        {
+            cheat->was_enabled = 1;
+            if (!compile_boot_cheat(&ctx->boot_program, r4300, cheat) ||
+                !compile_vi_cheat(&ctx->vi_program, r4300, cheat))
+            {
+                DebugMessage(M64MSG_ERROR, "Couldn't allocate memory for the cheat programs");
+                ctx->boot_program.count = 0;
+                ctx->vi_program.count = 0;
+                return;
+            }
+        }
+        /* if cheat was enabled, but is now disabled, restore old memory values */
+        else if (cheat->was_enabled)
+        {
+            cheat->was_enabled = 0;
+            if (entry == ENTRY_VI)
+            {
+                if (!compile_restore_cheat(&ctx->vi_program, r4300, cheat))
+                {
+                    DebugMessage(M64MSG_ERROR, "Couldn't allocate memory for the cheat programs");
+                    ctx->boot_program.count = 0;
+                    ctx->vi_program.count = 0;
+                    return;
+                }
+                ctx->dirty = 1;
+            }
+        }
+    }
+}
+
+static void retire_codes(struct cheat_ctx* ctx, cheat_t *cheat)
+{
+    cheat_code_t *code, *safe;
+
+    list_for_each_entry_safe_t(code, safe, &cheat->cheat_codes, cheat_code_t, list) {
+        list_del(&code->list);
+        list_add_tail(&code->list, &ctx->retired_codes);
+    }
+}
+
 static cheat_t *find_or_create_cheat(struct cheat_ctx* ctx, const char *name)
 {
     cheat_t *cheat;
@@ -166,12 +521,7 @@ static cheat_t *find_or_create_cheat(struct cheat_ctx* ctx, const char *name)
     if (found)
     {
         /* delete any pre-existing cheat codes */
-        cheat_code_t *code, *safe;
-
-        list_for_each_entry_safe_t(code, safe, &cheat->cheat_codes, cheat_code_t, list) {
-            list_del(&code->list);
-            free(code);
-        }
+        retire_codes(ctx, cheat);
 
         cheat->enabled = 0;
         cheat->was_enabled = 0;
@@ -195,6 +545,11 @@ void cheat_init(struct cheat_ctx* ctx)
 {
     ctx->mutex = SDL_CreateMutex();
     INIT_LIST_HEAD(&ctx->active_cheats);
+    INIT_LIST_HEAD(&ctx->retired_codes);
+    memset(&ctx->boot_program, 0, sizeof(ctx->boot_program));
+    memset(&ctx->vi_program, 0, sizeof(ctx->vi_program));
+    ctx->dram = NULL;
+    ctx->dirty = 1;
 }
 
 void cheat_uninit(struct cheat_ctx* ctx)
@@ -203,124 +558,48 @@ void cheat_uninit(struct cheat_ctx* ctx)
         SDL_DestroyMutex(ctx->mutex);
     }
     ctx->mutex = NULL;
+
+    free(ctx->boot_program.ops);
+    free(ctx->vi_program.ops);
+    memset(&ctx->boot_program, 0, sizeof(ctx->boot_program));
+    memset(&ctx->vi_program, 0, sizeof(ctx->vi_program));
+    free_retired_codes(ctx);
 }
 
 void cheat_apply_cheats(struct cheat_ctx* ctx, struct r4300_core* r4300, int entry)
 {
-    cheat_t *cheat;
-    cheat_code_t *code;
-    int cond_failed;
-
-    if (list_empty(&ctx->active_cheats))
-        return;
-
-    if (ctx->mutex == NULL || SDL_LockMutex(ctx->mutex) != 0)
+    /* the mutex is only needed to rebuild the programs */
+    if (ctx->dirty || ctx->dram != r4300->rdram->dram)
     {
-        DebugMessage(M64MSG_ERROR, "Internal error: failed to lock mutex in cheat_apply_cheats()");
-        return;
-    }
-
-    list_for_each_entry_t(cheat, &ctx->active_cheats, cheat_t, list) {
-        if (cheat->enabled)
-        {
-            cheat->was_enabled = 1;
-            switch(entry)
-            {
-            case ENTRY_BOOT:
-                list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
-                    /* code should only be written once at boot time */
-                    if ((code->address & 0xF0000000) == 0xF0000000) {
-                        execute_cheat(r4300, code->address, code->value, &code->old_value);
-                    }
-                }
-                break;
-            case ENTRY_VI:
-                /* a cheat starts without failed preconditions */
-                cond_failed = 0;
-
-                list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
-                    /* conditional cheat codes */
-                    if ((code->address & 0xF0000000) == 0xD0000000)
-                    {
-                        /* if code needs GS button pressed and it's not, skip it */
-                        if (((code->address & 0xFF000000) == 0xD8000000 ||
-                                    (code->address & 0xFF000000) == 0xD9000000 ||
-                                    (code->address & 0xFF000000) == 0xDA000000 ||
-                                    (code->address & 0xFF000000) == 0xDB000000) &&
-                                !event_gameshark_active()) {
-                            /* if condition false, skip next code non-test code */
-                            cond_failed = 1;
-                        }
-
-                        /* if condition false, skip next code non-test code */
-                        if (!execute_cheat(r4300, code->address, code->value, NULL)) {
-                            cond_failed = 1;
-                        }
-                    }
-                    else {
-                        /* preconditions were false for this non-test code
-                         * reset the condition state and skip the cheat
-                         */
-                        if (cond_failed) {
-                            cond_failed = 0;
-                            continue;
-                        }
-
-                        switch (code->address & 0xFF000000) {
-                        /* GS button triggers cheat code */
-                        case 0x88000000:
-                        case 0x89000000:
-                        case 0xA8000000:
-                        case 0xA9000000:
-                            if (event_gameshark_active()) {
-                                execute_cheat(r4300, code->address, code->value, NULL);
-                            }
-                            break;
-                            /* normal cheat code */
-                        default:
-                            /* exclude boot-time cheat codes */
-                            if ((code->address & 0xF0000000) != 0xF0000000) {
-                                execute_cheat(r4300, code->address, code->value, &code->old_value);
-                            }
-                            break;
-                        }
-                    }
-                }
-                break;
-            default:
-                break;
-            }
-        }
-        /* if cheat was enabled, but is now disabled, restore old memory values */
-        else if (cheat->was_enabled)
+        if (ctx->mutex == NULL || SDL_LockMutex(ctx->mutex) != 0)
         {
-            cheat->was_enabled = 0;
-            switch(entry)
-            {
-            case ENTRY_VI:
-                list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
-                    /* set memory back to old value and clear saved copy of old value */
-                    if(code->old_value != CHEAT_CODE_MAGIC_VALUE)
-                    {
-                        execute_cheat(r4300, code->address, code->old_value, NULL);
-                        code->old_value = CHEAT_CODE_MAGIC_VALUE;
-                    }
-                }
-                break;
-            default:
-                break;
-            }
+            DebugMessage(M64MSG_ERROR, "Internal error: failed to lock mutex in cheat_apply_cheats()");
+            return;
         }
+
+        ctx->dirty = 0;
+        compile_cheats(ctx, r4300, entry);
+
+        SDL_UnlockMutex(ctx->mutex);
     }
 
-    SDL_UnlockMutex(ctx->mutex);
+    switch(entry)
+    {
+    case ENTRY_BOOT:
+        run_program(r4300, &ctx->boot_program);
+        break;
+    case ENTRY_VI:
+        run_program(r4300, &ctx->vi_program);
+        break;
+    default:
+        break;
+    }
 }
 
 
 void cheat_delete_all(struct cheat_ctx* ctx)
 {
     cheat_t *cheat, *safe_cheat;
-    cheat_code_t *code, *safe_code;
 
     if (list_empty(&ctx->active_cheats))
         return;
@@ -333,15 +612,12 @@ void cheat_delete_all(struct cheat_ctx* ctx)
 
     list_for_each_entry_safe_t(cheat, safe_cheat, &ctx->active_cheats, cheat_t, list) {
         free(cheat->name);
-
-        list_for_each_entry_safe_t(code, safe_code, &cheat->cheat_codes, cheat_code_t, list) {
-            list_del(&code->list);
-            free(code);
-        }
+        retire_codes(ctx, cheat);
         list_del(&cheat->list);
         free(cheat);
     }
 
+    ctx->dirty = 1;
     SDL_UnlockMutex(ctx->mutex);
 }
 
@@ -362,6 +638,7 @@ int cheat_set_enabled(struct cheat_ctx* ctx, const char* name, int enabled)
         if (strcmp(name, cheat->name) == 0)
         {
             cheat->enabled = enabled;
+            ctx->dirty = 1;
             SDL_UnlockMutex(ctx->mutex);
             return 1;
         }
@@ -371,6 +648,22 @@ int cheat_set_enabled(struct cheat_ctx* ctx, const char* name, int enabled)
     return 0;
 }
 
+static void add_code(cheat_t* cheat, uint32_t address, uint32_t value)
+{
+    cheat_code_t *code;
+    unsigned int size = code_size(address);
+
+    /* the code is left out of the cheat programs, warn only once */
+    if (size != 0 && !is_rdram(address, size))
+        DebugMessage(M64MSG_WARNING, "Cheat code %08" PRIX32 " doesn't target RDRAM, ignored", address);
+
+    code = malloc(sizeof(*code));
+    code->address = address;
+    code->value = value;
+    code->old_value = CHEAT_CODE_MAGIC_VALUE;
+    list_add_tail(&code->list, &cheat->cheat_codes);
+}
+
 int cheat_add_new(struct cheat_ctx* ctx, const char* name, m64p_cheat_code* code_list, int num_codes)
 {
     cheat_t *cheat;
@@ -406,11 +699,7 @@ int cheat_add_new(struct cheat_ctx* ctx, const char* name, m64p_cheat_code* code
             i += 1;
             for (j = 0; j < code_count; j++)
             {
-                cheat_code_t *code = malloc(sizeof(*code));
-                code->address = cur_addr;
-                code->value = cur_value;
-                code->old_value = CHEAT_CODE_MAGIC_VALUE;
-                list_add_tail(&code->list, &cheat->cheat_codes);
+                add_code(cheat, cur_addr, cur_value);
                 cur_addr += incr_addr;
                 cur_value += incr_value;
             }
@@ -418,14 +707,11 @@ int cheat_add_new(struct cheat_ctx* ctx, const char* name, m64p_cheat_code* code
         else
         {
             /* just a normal code */
-            cheat_code_t *code = malloc(sizeof(*code));
-            code->address = code_list[i].address;
-            code->value = code_list[i].value;
-            code->old_value = CHEAT_CODE_MAGIC_VALUE;
-            list_add_tail(&code->list, &cheat->cheat_codes);
+            add_code(cheat, code_list[i].address, code_list[i].value);
         }
     }
 
+    ctx->dirty = 1;
     SDL_UnlockMutex(ctx->mutex);
     return 1;
 }
@@ -26,6 +26,7 @@
 
 #include "list.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define ENTRY_BOOT 0
@@ -33,11 +34,28 @@
 
 struct SDL_mutex;
 struct r4300_core;
+struct cheat_op;
+
+struct cheat_program
+{
+    struct cheat_op* ops;
+    size_t count;
+    size_t capacity;
+};
 
 struct cheat_ctx
 {
     struct SDL_mutex* mutex;
     struct list_head active_cheats;
+    struct list_head retired_codes;     /* removed codes the programs may still point to */
+
+    /* The enabled cheats are compiled by the emulation thread into flat
+     * programs, which it runs without taking the mutex. Changing the cheats
+     * sets dirty, and the programs are rebuilt at the next application. */
+    volatile int dirty;
+    void* dram;                         /* RDRAM the programs write to */
+    struct cheat_program boot_program;
+    struct cheat_program vi_program;
 };
 
 void cheat_apply_cheats(struct cheat_ctx* ctx, struct r4300_core* r4300, int entry);
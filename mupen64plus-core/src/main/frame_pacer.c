@@ -0,0 +1,222 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - frame_pacer.c                                           *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "frame_pacer.h"
+
+#include <string.h>
+
+#if defined(WIN32)
+  #include <windows.h>
+#else
+  #include <errno.h>
+  #include <time.h>
+#endif
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+  #include <emmintrin.h>
+  #define cpu_relax() _mm_pause()
+#else
+  #define cpu_relax()
+#endif
+
+#define NSEC_PER_SEC 1000000000LL
+#define NSEC_PER_MSEC 1000000LL
+#define NSEC_PER_USEC 1000LL
+
+/* bounds of the spin before each deadline */
+#define MIN_SPIN (50 * NSEC_PER_USEC)
+#define MAX_SPIN (2 * NSEC_PER_MSEC)
+
+/* a late frame is made up on the following ones, but no more than this
+ * many periods are caught up after a stall */
+#define MAX_DEBT_FRAMES 2
+
+/* audio levels are ignored if none was reported for this many frames */
+#define AUDIO_STALE_FRAMES 60
+
+#if defined(WIN32)
+
+int64_t frame_pacer_now(void)
+{
+    static LARGE_INTEGER freq = { 0 };
+    LARGE_INTEGER counter;
+
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+
+    return (int64_t)(counter.QuadPart / freq.QuadPart) * NSEC_PER_SEC
+         + (int64_t)(counter.QuadPart % freq.QuadPart) * NSEC_PER_SEC / freq.QuadPart;
+}
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+static void sleep_until(int64_t target)
+{
+    static HANDLE timer = NULL;
+    static int timer_checked = 0;
+    LARGE_INTEGER due;
+    int64_t delay = target - frame_pacer_now();
+
+    if (delay <= 0)
+        return;
+
+    /* high resolution timers are only available since Windows 10 1803 */
+    if (!timer_checked) {
+        timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        timer_checked = 1;
+    }
+
+    if (timer != NULL) {
+        due.QuadPart = -(delay / 100);  /* relative, in 100 ns units */
+        if (SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE)) {
+            WaitForSingleObject(timer, INFINITE);
+            return;
+        }
+    }
+
+    Sleep((DWORD)(delay / NSEC_PER_MSEC));
+}
+
+#else
+
+int64_t frame_pacer_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void sleep_until(int64_t target)
+{
+    struct timespec ts;
+
+#if defined(__APPLE__)
+    /* no clock_nanosleep, sleep for the remaining time instead */
+    int64_t delay = target - frame_pacer_now();
+    if (delay <= 0)
+        return;
+
+    ts.tv_sec = (time_t)(delay / NSEC_PER_SEC);
+    ts.tv_nsec = (long)(delay % NSEC_PER_SEC);
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR);
+#else
+    ts.tv_sec = (time_t)(target / NSEC_PER_SEC);
+    ts.tv_nsec = (long)(target % NSEC_PER_SEC);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+#endif
+}
+
+#endif
+
+void frame_pacer_init(struct frame_pacer* fp, unsigned int audio_target_ms)
+{
+    memset(fp, 0, sizeof(*fp));
+    fp->spin = 4 * MIN_SPIN;
+    fp->audio_target = (int64_t)audio_target_ms * NSEC_PER_MSEC;
+    fp->audio_stale_frames = AUDIO_STALE_FRAMES;
+}
+
+void frame_pacer_reset(struct frame_pacer* fp)
+{
+    fp->period = 0;
+}
+
+void frame_pacer_set_audio_level(struct frame_pacer* fp, unsigned int level_us)
+{
+    fp->audio_level = level_us;
+    fp->audio_reports++;
+}
+
+static int64_t audio_paced_period(struct frame_pacer* fp, int64_t period)
+{
+    unsigned int reports = fp->audio_reports;
+    int64_t error;
+
+    if (fp->audio_target == 0)
+        return period;
+
+    if (reports != fp->audio_reports_seen) {
+        fp->audio_reports_seen = reports;
+        fp->audio_stale_frames = 0;
+    }
+    else if (fp->audio_stale_frames < AUDIO_STALE_FRAMES) {
+        fp->audio_stale_frames++;
+    }
+
+    if (fp->audio_stale_frames >= AUDIO_STALE_FRAMES)
+        return period;
+
+    /* more audio queued than wanted means frames come too fast: stretch
+     * the period, proportionally to the error, by up to 0.5% */
+    error = (int64_t)fp->audio_level * NSEC_PER_USEC - fp->audio_target;
+    if (error > fp->audio_target)
+        error = fp->audio_target;
+    else if (error < -fp->audio_target)
+        error = -fp->audio_target;
+
+    return period + period * error / fp->audio_target / 200;
+}
+
+void frame_pacer_wait(struct frame_pacer* fp, int64_t period_ns, int limit)
+{
+    int64_t now = frame_pacer_now();
+    int64_t wake, late;
+
+    /* first frame, resumed from a reset, or the speed changed */
+    if (fp->period != period_ns || !limit) {
+        fp->period = period_ns;
+        fp->deadline = now + period_ns;
+        return;
+    }
+
+    /* bound the catch up after a stall, and recover from a deadline which
+     * is unreasonably far away */
+    if (now - fp->deadline > MAX_DEBT_FRAMES * period_ns)
+        fp->deadline = now - MAX_DEBT_FRAMES * period_ns;
+    else if (fp->deadline - now > 2 * period_ns)
+        fp->deadline = now;
+
+    if (fp->deadline > now) {
+        wake = fp->deadline - fp->spin;
+        if (wake > now) {
+            sleep_until(wake);
+
+            /* keep the spin slightly above the average oversleep */
+            late = frame_pacer_now() - wake;
+            if (late < 0)
+                late = 0;
+            fp->oversleep += (late - fp->oversleep) / 8;
+            fp->spin = fp->oversleep + fp->oversleep / 2;
+            if (fp->spin < MIN_SPIN)
+                fp->spin = MIN_SPIN;
+            else if (fp->spin > MAX_SPIN)
+                fp->spin = MAX_SPIN;
+        }
+
+        while (frame_pacer_now() < fp->deadline)
+            cpu_relax();
+    }
+
+    fp->deadline += audio_paced_period(fp, period_ns);
+}
@@ -0,0 +1,62 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - frame_pacer.h                                           *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_MAIN_FRAME_PACER_H
+#define M64P_MAIN_FRAME_PACER_H
+
+#include <stdint.h>
+
+/* Frames are scheduled on an absolute monotonic timeline: each deadline is
+ * the previous one plus the frame period, so a late wake up is made up on
+ * the following frames instead of drifting. The pacer sleeps until shortly
+ * before the deadline and spins for the rest, the spin time following the
+ * oversleep measured on the host.
+ *
+ * When the front-end reports how much audio is queued for playback, the
+ * period is stretched or shortened by up to 0.5% to keep that amount near
+ * audio_target, so frames follow the audio device clock. */
+struct frame_pacer
+{
+    int64_t period;         /* ns per frame at the current speed, 0 after reset */
+    int64_t deadline;       /* monotonic time at which the next frame is due */
+    int64_t spin;           /* ns before the deadline at which sleeping stops */
+    int64_t oversleep;      /* average oversleep of the host sleep, in ns */
+
+    int64_t audio_target;   /* ns of queued audio to aim for, 0 to disable */
+    volatile unsigned int audio_level;      /* last reported queued audio, in us */
+    volatile unsigned int audio_reports;    /* bumped by each report */
+    unsigned int audio_reports_seen;
+    unsigned int audio_stale_frames;        /* frames since the last report */
+};
+
+int64_t frame_pacer_now(void);
+
+void frame_pacer_init(struct frame_pacer* fp, unsigned int audio_target_ms);
+void frame_pacer_reset(struct frame_pacer* fp);
+
+/* may be called from any thread */
+void frame_pacer_set_audio_level(struct frame_pacer* fp, unsigned int level_us);
+
+/* Wait for the next frame, which is due period_ns after the previous one.
+ * Without limit, only the schedule is updated. */
+void frame_pacer_wait(struct frame_pacer* fp, int64_t period_ns, int limit);
+
+#endif
@@ -0,0 +1,423 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - frame_ring.c                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "frame_ring.h"
+
+#include <SDL.h>
+
+#define M64P_CORE_PROTOTYPES 1
+#include "api/callbacks.h"
+#include "main/frame_pacer.h"
+#include "plugin/plugin.h"
+
+#include <string.h>
+
+#if !defined(WIN32)
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+  #include <sys/syscall.h>
+#endif
+
+/* Slots are large enough for any sensible window, the pages of the shared
+ * memory are only allocated once they are written to. */
+#define MAX_WIDTH  3840
+#define MAX_HEIGHT 2160
+#define MAX_SLOTS  64
+
+#define PAGE_ALIGN(x) (((x) + 4095) & ~(uint64_t)4095)
+
+/* orders the accesses to the ring, for readers in other processes */
+#define ring_barrier() __sync_synchronize()
+
+/* held by the readers of other threads while they use the ring, so that
+ * it isn't unmapped under them */
+static SDL_mutex* l_lock = NULL;
+
+static m64p_frame_ring_header* l_ring = NULL;
+static size_t l_ring_size = 0;
+static int l_fd = -1;
+static char* l_name = NULL;
+
+static int l_read_width = 0;
+static int l_read_height = 0;
+static int l_too_large = 0;
+
+static m64p_frame_ring_slot* get_slot(uint64_t sequence)
+{
+    return (m64p_frame_ring_slot*) ((unsigned char*) l_ring + l_ring->slot_offset
+                                    + (sequence % l_ring->slot_count) * l_ring->slot_size);
+}
+
+static unsigned char* slot_pixels(m64p_frame_ring_slot* slot)
+{
+    return (unsigned char*) slot + M64P_FRAME_RING_SLOT_HEADER;
+}
+
+void frame_ring_init(void)
+{
+    l_lock = SDL_CreateMutex();
+    if (l_lock == NULL)
+        DebugMessage(M64MSG_ERROR, "Could not create frame ring mutex");
+}
+
+void frame_ring_deinit(void)
+{
+    frame_ring_close();
+
+    if (l_lock != NULL)
+    {
+        SDL_DestroyMutex(l_lock);
+        l_lock = NULL;
+    }
+}
+
+m64p_error frame_ring_open(int mode, const char* name, int slot_count)
+{
+    m64p_frame_ring_header* header;
+    uint64_t slot_size, pixels_size;
+    void* ring;
+
+    frame_ring_close();
+
+    if (mode == FRAME_RING_DISABLED)
+        return M64ERR_SUCCESS;
+
+    if (l_lock == NULL)
+        return M64ERR_NOT_INIT;
+
+    if (slot_count < 2 || slot_count > MAX_SLOTS)
+    {
+        DebugMessage(M64MSG_WARNING, "Invalid frame ring slot count %d, using 4", slot_count);
+        slot_count = 4;
+    }
+
+    if (mode == FRAME_RING_SHM)
+    {
+        if (name == NULL || name[0] != '/' || strchr(name + 1, '/') != NULL)
+        {
+            DebugMessage(M64MSG_ERROR, "Invalid frame ring name '%s', it must be of the form /name", name ? name : "");
+            return M64ERR_INPUT_INVALID;
+        }
+        l_fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (l_fd >= 0)
+            l_name = strdup(name);
+    }
+    else if (mode == FRAME_RING_MEMFD)
+    {
+#if defined(__linux__) && defined(SYS_memfd_create)
+        l_fd = (int) syscall(SYS_memfd_create, "mupen64plus-frames", 0);
+#else
+        DebugMessage(M64MSG_ERROR, "memfd frame ring is only supported on Linux");
+        return M64ERR_UNSUPPORTED;
+#endif
+    }
+    else
+    {
+        DebugMessage(M64MSG_ERROR, "Unknown frame ring mode %d", mode);
+        return M64ERR_INPUT_INVALID;
+    }
+
+    if (l_fd < 0)
+    {
+        DebugMessage(M64MSG_ERROR, "Could not create frame ring memory");
+        frame_ring_close();
+        return M64ERR_SYSTEM_FAIL;
+    }
+
+    pixels_size = (uint64_t) MAX_WIDTH * MAX_HEIGHT * 3;
+    slot_size = PAGE_ALIGN(M64P_FRAME_RING_SLOT_HEADER + pixels_size);
+    l_ring_size = (size_t) (PAGE_ALIGN(sizeof(m64p_frame_ring_header)) + slot_count * slot_size);
+
+    if (ftruncate(l_fd, (off_t) l_ring_size) != 0)
+    {
+        DebugMessage(M64MSG_ERROR, "Could not allocate %zu bytes of frame ring memory", l_ring_size);
+        frame_ring_close();
+        return M64ERR_SYSTEM_FAIL;
+    }
+
+    ring = mmap(NULL, l_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, l_fd, 0);
+    if (ring == MAP_FAILED)
+    {
+        DebugMessage(M64MSG_ERROR, "Could not map frame ring memory");
+        frame_ring_close();
+        return M64ERR_SYSTEM_FAIL;
+    }
+
+    header = (m64p_frame_ring_header*) ring;
+    header->version = M64P_FRAME_RING_VERSION;
+    header->slot_count = (uint32_t) slot_count;
+    header->slot_offset = (uint32_t) PAGE_ALIGN(sizeof(m64p_frame_ring_header));
+    header->slot_size = slot_size;
+    header->pixels_size = pixels_size;
+    header->sequence = 0;
+    /* the magic tells readers the header is complete */
+    ring_barrier();
+    header->magic = M64P_FRAME_RING_MAGIC;
+
+    SDL_LockMutex(l_lock);
+    l_ring = header;
+    l_too_large = 0;
+    l_read_width = l_read_height = 0;
+    SDL_UnlockMutex(l_lock);
+
+    DebugMessage(M64MSG_INFO, "Frame ring of %d slots created%s%s", slot_count,
+                 l_name ? " as " : "", l_name ? l_name : "");
+    return M64ERR_SUCCESS;
+}
+
+void frame_ring_close(void)
+{
+    /* wait for the readers to be done with the ring */
+    if (l_lock != NULL)
+        SDL_LockMutex(l_lock);
+
+    if (l_ring != NULL)
+    {
+        munmap(l_ring, l_ring_size);
+        l_ring = NULL;
+    }
+    if (l_fd >= 0)
+    {
+        close(l_fd);
+        l_fd = -1;
+    }
+    if (l_name != NULL)
+    {
+        shm_unlink(l_name);
+        free(l_name);
+        l_name = NULL;
+    }
+
+    if (l_lock != NULL)
+        SDL_UnlockMutex(l_lock);
+}
+
+int frame_ring_active(void)
+{
+    return l_ring != NULL;
+}
+
+m64p_error frame_ring_get_fd(int* fd)
+{
+    m64p_error rval = M64ERR_INVALID_STATE;
+
+    if (l_lock == NULL)
+        return rval;
+
+    SDL_LockMutex(l_lock);
+    if (l_ring != NULL)
+    {
+        *fd = l_fd;
+        rval = M64ERR_SUCCESS;
+    }
+    SDL_UnlockMutex(l_lock);
+
+    return rval;
+}
+
+void frame_ring_write(unsigned int frame)
+{
+    uint64_t sequence;
+    m64p_frame_ring_slot* slot;
+    int width = 640, height = 480;
+
+    if (l_ring == NULL)
+        return;
+
+    gfx.readScreen(NULL, &width, &height, 0);
+    if (width <= 0 || height <= 0 || (uint64_t) width * height * 3 > l_ring->pixels_size)
+    {
+        if (!l_too_large)
+            DebugMessage(M64MSG_WARNING, "Screen size %dx%d does not fit in the frame ring, frames are dropped", width, height);
+        l_too_large = 1;
+        return;
+    }
+
+    sequence = l_ring->sequence + 1;
+    slot = get_slot(sequence);
+
+    /* invalidate the slot while it is being written */
+    slot->sequence = 0;
+    ring_barrier();
+
+    gfx.readScreen(slot_pixels(slot), &width, &height, 0);
+    slot->timestamp_ns = frame_pacer_now();
+    slot->frame = frame;
+    slot->width = (uint32_t) width;
+    slot->height = (uint32_t) height;
+    slot->pitch = (uint32_t) width * 3;
+
+    ring_barrier();
+    slot->sequence = sequence;
+    ring_barrier();
+    l_ring->sequence = sequence;
+}
+
+int frame_ring_screen_size(int* width, int* height)
+{
+    uint64_t sequence;
+    m64p_frame_ring_slot* slot;
+    int found = 0;
+
+    if (l_lock == NULL)
+        return 0;
+
+    SDL_LockMutex(l_lock);
+    if (l_ring != NULL && (sequence = l_ring->sequence) != 0)
+    {
+        slot = get_slot(sequence);
+        ring_barrier();
+        *width = (int) slot->width;
+        *height = (int) slot->height;
+        ring_barrier();
+        if (slot->sequence == sequence)
+        {
+            l_read_width = *width;
+            l_read_height = *height;
+            found = 1;
+        }
+    }
+    SDL_UnlockMutex(l_lock);
+
+    return found;
+}
+
+int frame_ring_read_screen(void* pixels)
+{
+    uint64_t sequence;
+    m64p_frame_ring_slot* slot;
+    int tries;
+    int copied = 0;
+
+    if (l_lock == NULL)
+        return 0;
+
+    SDL_LockMutex(l_lock);
+
+    /* the writer may overwrite a slot while it is copied, retry a few times */
+    for (tries = 0; l_ring != NULL && tries < 4; ++tries)
+    {
+        sequence = l_ring->sequence;
+        if (sequence == 0)
+            break;
+
+        slot = get_slot(sequence);
+        ring_barrier();
+        if (slot->sequence != sequence)
+            continue;
+        if ((int) slot->width != l_read_width || (int) slot->height != l_read_height)
+            break;
+
+        memcpy(pixels, slot_pixels(slot), (size_t) l_read_width * l_read_height * 3);
+
+        ring_barrier();
+        if (slot->sequence == sequence)
+        {
+            copied = 1;
+            break;
+        }
+    }
+
+    SDL_UnlockMutex(l_lock);
+    return copied;
+}
+
+int frame_ring_last_frame(const void** pixels, int* width, int* height)
+{
+    uint64_t sequence;
+    m64p_frame_ring_slot* slot;
+    int found = 0;
+
+    if (l_lock == NULL)
+        return 0;
+
+    SDL_LockMutex(l_lock);
+    if (l_ring != NULL && (sequence = l_ring->sequence) != 0)
+    {
+        slot = get_slot(sequence);
+        *pixels = slot_pixels(slot);
+        *width = (int) slot->width;
+        *height = (int) slot->height;
+        found = 1;
+    }
+    SDL_UnlockMutex(l_lock);
+
+    return found;
+}
+
+#else
+
+void frame_ring_init(void)
+{
+}
+
+void frame_ring_deinit(void)
+{
+}
+
+m64p_error frame_ring_open(int mode, const char* name, int slot_count)
+{
+    if (mode == FRAME_RING_DISABLED)
+        return M64ERR_SUCCESS;
+
+    DebugMessage(M64MSG_ERROR, "Frame ring is not supported on this platform");
+    return M64ERR_UNSUPPORTED;
+}
+
+void frame_ring_close(void)
+{
+}
+
+int frame_ring_active(void)
+{
+    return 0;
+}
+
+m64p_error frame_ring_get_fd(int* fd)
+{
+    return M64ERR_UNSUPPORTED;
+}
+
+void frame_ring_write(unsigned int frame)
+{
+}
+
+int frame_ring_screen_size(int* width, int* height)
+{
+    return 0;
+}
+
+int frame_ring_read_screen(void* pixels)
+{
+    return 0;
+}
+
+int frame_ring_last_frame(const void** pixels, int* width, int* height)
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,70 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - frame_ring.h                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_MAIN_FRAME_RING_H
+#define M64P_MAIN_FRAME_RING_H
+
+#include "api/m64p_types.h"
+
+/* Publishes every rendered frame in a ring of frames in shared memory, with
+ * the layout of m64p_frame_ring_header, so that other processes can consume
+ * them as they are produced. The video plugin reads the screen directly into
+ * the slots, and readers use the frames in place.
+ *
+ * The memory is either a named POSIX shared memory object, or an anonymous
+ * memfd (Linux only) which the front-end passes to the consumer. It exists
+ * while the emulation runs. */
+
+enum frame_ring_mode
+{
+    FRAME_RING_DISABLED,
+    FRAME_RING_SHM,
+    FRAME_RING_MEMFD
+};
+
+void frame_ring_init(void);
+void frame_ring_deinit(void);
+
+m64p_error frame_ring_open(int mode, const char* name, int slot_count);
+void frame_ring_close(void);
+
+int frame_ring_active(void);
+
+/* file descriptor of the ring memory, owned by the core */
+m64p_error frame_ring_get_fd(int* fd);
+
+/* Read the screen from the video plugin into the next slot, and publish it.
+ * Called from the rendering callback. */
+void frame_ring_write(unsigned int frame);
+
+/* Fast path of M64CMD_GET_SCREEN_SIZE and M64CMD_READ_SCREEN for the front
+ * buffer, which may be called from any thread: the last published frame is
+ * copied instead of calling the video plugin. They return 0 if no frame can
+ * be used, the frame being read having the size returned by the last size
+ * query. frame_ring_close waits for them to finish. */
+int frame_ring_screen_size(int* width, int* height);
+int frame_ring_read_screen(void* pixels);
+
+/* Pixels of the last published frame, in place. They are overwritten once
+ * the ring wraps, so they are only stable on the emulation thread. */
+int frame_ring_last_frame(const void** pixels, int* width, int* height);
+
+#endif
@@ -0,0 +1,130 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - headless.c                                              *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "headless.h"
+
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "osal/preproc.h"
+#include "plugin/plugin.h"
+
+static int l_HeadlessEnabled = 0;
+static m64p_headless l_Headless;
+
+static uint32_t l_Frames;
+static uint64_t l_Count;
+static uint32_t l_LastCount;
+static unsigned int l_AudioFrequency = 44100;
+static int l_FrameBufferWarned;
+
+m64p_error headless_set_params(const m64p_headless* params, int size)
+{
+    if (params == NULL) {
+        l_HeadlessEnabled = 0;
+        return M64ERR_SUCCESS;
+    }
+
+    if (size != sizeof(m64p_headless))
+        return M64ERR_INPUT_INVALID;
+
+    l_Headless = *params;
+    l_HeadlessEnabled = 1;
+    return M64ERR_SUCCESS;
+}
+
+int headless_enabled(void)
+{
+    return l_HeadlessEnabled;
+}
+
+void headless_start(void)
+{
+    l_Frames = 0;
+    l_Count = 0;
+    l_LastCount = 0;
+    l_FrameBufferWarned = 0;
+}
+
+int headless_wants_frame(void)
+{
+    return l_Headless.frame_interval != 0
+        && (l_Frames + 1) % l_Headless.frame_interval == 0;
+}
+
+static void read_frame(void)
+{
+    int width = 0, height = 0;
+
+    if (l_Headless.frame_buffer != NULL) {
+        gfx.readScreen(NULL, &width, &height, 0);
+        if (width <= 0 || height <= 0)
+            return;
+
+        if ((uint64_t)width * height * 3 > l_Headless.frame_buffer_size) {
+            if (!l_FrameBufferWarned)
+                DebugMessage(M64MSG_WARNING, "Headless frame buffer too small for %dx%d frames", width, height);
+            l_FrameBufferWarned = 1;
+            return;
+        }
+
+        gfx.readScreen(l_Headless.frame_buffer, &width, &height, 0);
+    }
+
+    if (l_Headless.frame_ready != NULL)
+        l_Headless.frame_ready(l_Headless.cb_data, l_Frames, width, height);
+}
+
+int headless_new_vi(uint32_t cp0_count)
+{
+    int frame_rendered = headless_wants_frame();
+
+    ++l_Frames;
+    l_Count += (uint32_t)(cp0_count - l_LastCount);
+    l_LastCount = cp0_count;
+
+    if (frame_rendered)
+        read_frame();
+
+    return (l_Headless.frame_limit != 0 && l_Frames >= l_Headless.frame_limit)
+        || (l_Headless.count_limit != 0 && l_Count >= l_Headless.count_limit);
+}
+
+static void headless_set_frequency(void* aout, unsigned int frequency)
+{
+    UNUSED(aout);
+
+    l_AudioFrequency = frequency;
+}
+
+static void headless_push_samples(void* aout, const void* buffer, size_t size)
+{
+    UNUSED(aout);
+
+    if (l_Headless.audio_samples != NULL)
+        l_Headless.audio_samples(l_Headless.cb_data, buffer, (uint32_t)size, l_AudioFrequency);
+}
+
+const struct audio_out_backend_interface g_iaudio_out_backend_headless =
+{
+    headless_set_frequency,
+    headless_push_samples
+};
@@ -0,0 +1,50 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - headless.h                                              *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_MAIN_HEADLESS_H
+#define M64P_MAIN_HEADLESS_H
+
+#include <stdint.h>
+
+#include "api/m64p_types.h"
+#include "backends/api/audio_out_backend.h"
+
+/* In headless mode, set with M64CMD_SET_HEADLESS, the core runs as fast as
+ * it can: the speed limiter, SDL event polling, OSD and pause handling are
+ * skipped, the video plugin only renders the frames which were asked for,
+ * and audio bypasses the audio plugin. Emulation stops by itself once the
+ * frame or CP0 Count limit is reached, always at a vertical interrupt so
+ * that runs are reproducible. */
+
+extern const struct audio_out_backend_interface g_iaudio_out_backend_headless;
+
+m64p_error headless_set_params(const m64p_headless* params, int size);
+int headless_enabled(void);
+
+void headless_start(void);
+
+/* whether the video plugin has to render the upcoming frame */
+int headless_wants_frame(void);
+
+/* returns nonzero once the stop condition is reached */
+int headless_new_vi(uint32_t cp0_count);
+
+#endif
@@ -65,14 +65,16 @@
 #include "device/gb/gb_cart.h"
 #include "device/pif/bootrom_hle.h"
 #include "eventloop.h"
+#include "frame_pacer.h"
+#include "frame_ring.h"
+#include "headless.h"
 #include "main.h"
+#include "observe.h"
 #include "osal/files.h"
 #include "osal/preproc.h"
 #include "osd/osd.h"
 #include "plugin/plugin.h"
-#if defined(PROFILE)
 #include "profile.h"
-#endif
 #include "rom.h"
 #include "savestates.h"
 #include "screenshot.h"
@@ -120,9 +122,16 @@ int g_gs_vi_counter = 0;
 /** static (local) variables **/
 static int   l_CurrentFrame = 0;         // frame counter
 static int   l_TakeScreenshot = 0;       // Tell OSD Rendering callback to take a screenshot just before drawing the OSD
+static int   l_FrameDumpInterval = 0;    // dump every Nth frame, 0 when disabled
+static int   l_NextFrameDump = 0;        // frame number at which the next frame dump is due
 static int   l_SpeedFactor = 100;        // percentage of nominal game speed at which emulator is running
 static int   l_FrameAdvance = 0;         // variable to check if we pause on next frame
 static int   l_MainSpeedLimit = 1;       // insert delay during vi_interrupt to keep speed at real-time
+static struct frame_pacer l_FramePacer;  // schedules the vi_interrupts when the speed limiter is enabled
+static struct profile_mark l_FrameMark;  // profiling start of the current frame
+
+PROFILE_SECTION(l_ProfileFrame, "frame", "core");
+PROFILE_SECTION(l_ProfileSpeedLimiter, "speed_limiter", "core");
 
 static osd_message_t *l_msgVol = NULL;
 static osd_message_t *l_msgFF = NULL;
@@ -429,13 +438,22 @@ int main_set_core_defaults(void)
     ConfigSetDefaultInt(g_CoreConfig, "CountPerOpDenomPot", 0, "Reduce number of cycles per update by power of two when set greater than 0 (overclock)");
     ConfigSetDefaultBool(g_CoreConfig, "AutoStateSlotIncrement", 0, "Increment the save state slot after each save operation");
     ConfigSetDefaultInt(g_CoreConfig, "CurrentStateSlot", 0, "Save state slot (0-9) to use when saving/loading the emulator state");
+    ConfigSetDefaultInt(g_CoreConfig, "SaveStateCompressionLevel", 1, "Compression level of Mupen64Plus save states (0: none, 1: fastest - 9: smallest, -1: zlib default)");
     ConfigSetDefaultBool(g_CoreConfig, "EnableDebugger", 0, "Activate the R4300 debugger when ROM execution begins, if core was built with Debugger support");
     ConfigSetDefaultString(g_CoreConfig, "ScreenshotPath", "", "Path to directory where screenshots are saved. If this is blank, the default value of ${UserDataPath}/screenshot will be used");
+    ConfigSetDefaultInt(g_CoreConfig, "ScreenshotFormat", 0, "File format of screenshots and frame dumps (0: PNG, 1: QOI, 2: PPM)");
+    ConfigSetDefaultInt(g_CoreConfig, "ScreenshotCompressionLevel", -1, "Compression level of PNG screenshots and frame dumps (0: none, 1: fastest - 9: smallest, -1: zlib default)");
+    ConfigSetDefaultInt(g_CoreConfig, "FrameDumpInterval", 0, "Save every Nth frame to the frame dump directory (0: disabled)");
+    ConfigSetDefaultString(g_CoreConfig, "FrameDumpPath", "", "Path to directory where frame dumps are saved. If this is blank, the default value of ${UserDataPath}/framedump will be used");
+    ConfigSetDefaultInt(g_CoreConfig, "FrameRingMode", 0, "Publish every rendered frame in a ring of frames in shared memory, for other processes (0: disabled, 1: POSIX shared memory named FrameRingName, 2: anonymous memfd, see M64CMD_FRAME_RING_GET_FD)");
+    ConfigSetDefaultString(g_CoreConfig, "FrameRingName", "/mupen64plus-frames", "Name of the POSIX shared memory object of the frame ring");
+    ConfigSetDefaultInt(g_CoreConfig, "FrameRingSlots", 4, "Number of frames kept in the frame ring");
     ConfigSetDefaultString(g_CoreConfig, "SaveStatePath", "", "Path to directory where emulator save states (snapshots) are saved. If this is blank, the default value of ${UserDataPath}/save will be used");
     ConfigSetDefaultString(g_CoreConfig, "SaveSRAMPath", "", "Path to directory where SRAM/EEPROM data (in-game saves) are stored. If this is blank, the default value of ${UserDataPath}/save will be used");
     ConfigSetDefaultString(g_CoreConfig, "SharedDataPath", "", "Path to a directory to search when looking for shared data files");
     ConfigSetDefaultBool(g_CoreConfig, "RandomizeInterrupt", 1, "Randomize PI/SI Interrupt Timing");
     ConfigSetDefaultInt(g_CoreConfig, "SiDmaDuration", -1, "Duration of SI DMA (-1: use per game settings)");
+    ConfigSetDefaultInt(g_CoreConfig, "AudioPacingLatency", 0, "Amount of queued audio in milliseconds to keep when the front-end reports the audio buffer level (M64CORE_AUDIO_BUFFER_LEVEL), frames then follow the audio clock (0: pace frames on the system clock only)");
     ConfigSetDefaultString(g_CoreConfig, "GbCameraVideoCaptureBackend1", DEFAULT_VIDEO_CAPTURE_BACKEND, "Gameboy Camera Video Capture backend");
     ConfigSetDefaultInt(g_CoreConfig, "SaveDiskFormat", 1, "Disk Save Format (0: Full Disk Copy (*.ndr/*.d6r), 1: RAM Area Only (*.ram))");
     ConfigSetDefaultInt(g_CoreConfig, "SaveFilenameFormat", 1, "Save (SRAM/State) Filename Format (0: ROM Header Name, 1: Automatic (including partial MD5 hash))");
@@ -734,6 +752,9 @@ m64p_error main_core_state_query(m64p_core_param param, int *rval)
         case M64CORE_STATE_LOADCOMPLETE:
         case M64CORE_STATE_SAVECOMPLETE:
             return M64ERR_INPUT_INVALID;
+        // this one can only be set
+        case M64CORE_AUDIO_BUFFER_LEVEL:
+            return M64ERR_INPUT_INVALID;
         default:
             return M64ERR_INPUT_INVALID;
     }
@@ -825,6 +846,11 @@ m64p_error main_core_state_set(m64p_core_param param, int val)
                 return M64ERR_INVALID_STATE;
             event_set_gameshark(val);
             return M64ERR_SUCCESS;
+        case M64CORE_AUDIO_BUFFER_LEVEL:
+            if (val < 0)
+                return M64ERR_INPUT_INVALID;
+            frame_pacer_set_audio_level(&l_FramePacer, (unsigned int) val);
+            return M64ERR_SUCCESS;
         // these are only used for callbacks; they cannot be queried or set
         case M64CORE_STATE_LOADCOMPLETE:
         case M64CORE_STATE_SAVECOMPLETE:
@@ -836,6 +862,9 @@ m64p_error main_core_state_set(m64p_core_param param, int val)
 
 m64p_error main_get_screen_size(int *width, int *height)
 {
+    if (frame_ring_screen_size(width, height))
+        return M64ERR_SUCCESS;
+
     gfx.readScreen(NULL, width, height, 0);
     return M64ERR_SUCCESS;
 }
@@ -843,6 +872,12 @@ m64p_error main_get_screen_size(int *width, int *height)
 m64p_error main_read_screen(void *pixels, int bFront)
 {
     int width_trash, height_trash;
+
+    // copy the last frame of the frame ring, without calling into the video plugin;
+    // the ring only holds presented frames, the back buffer comes from the plugin
+    if (bFront && frame_ring_read_screen(pixels))
+        return M64ERR_SUCCESS;
+
     gfx.readScreen(pixels, &width_trash, &height_trash, bFront);
     return M64ERR_SUCCESS;
 }
@@ -911,6 +946,10 @@ m64p_error main_reset(int do_hard_reset)
 * global functions, callbacks from the r4300 core or from other plugins
 */
 
+static void headless_render_callback(int bScreenRedrawn)
+{
+}
+
 static void video_plugin_render_callback(int bScreenRedrawn)
 {
 #ifdef M64P_OSD
@@ -931,6 +970,29 @@ static void video_plugin_render_callback(int bScreenRedrawn)
         }
     }
 
+    // dump the frame if one is due, with the same restriction regarding the OSD
+    if (l_FrameDumpInterval > 0 && l_CurrentFrame >= l_NextFrameDump)
+    {
+#ifdef M64P_OSD
+        if (!bOSD || bScreenRedrawn)
+#endif /* M64P_OSD */
+        {
+            DumpFrame(l_CurrentFrame);
+            l_NextFrameDump = l_CurrentFrame + l_FrameDumpInterval;
+        }
+    }
+
+    // publish the frame to the frame ring
+    if (frame_ring_active())
+    {
+#ifdef M64P_OSD
+        if (!bOSD || bScreenRedrawn)
+#endif /* M64P_OSD */
+        {
+            frame_ring_write(l_CurrentFrame);
+        }
+    }
+
 #ifdef M64P_OSD
     // if the OSD is enabled, then draw it now
     if (bOSD)
@@ -948,6 +1010,8 @@ static void video_plugin_render_callback(int bScreenRedrawn)
 
 void new_frame(void)
 {
+    observe_new_frame(&g_dev, l_CurrentFrame);
+
     if (g_FrameCallback != NULL)
         (*g_FrameCallback)(l_CurrentFrame);
 
@@ -963,71 +1027,18 @@ void new_frame(void)
 
 static void apply_speed_limiter(void)
 {
-    static unsigned long totalVIs = 0;
-    static int resetOnce = 0;
-    static int lastSpeedFactor = 100;
-    static unsigned int StartFPSTime = 0;
-    static const double defaultSpeedFactor = 100.0;
-    unsigned int CurrentFPSTime = SDL_GetTicks();
-
     // calculate frame duration based upon ROM setting (50/60hz) and mupen64plus speed adjustment
-    const double VILimitMilliseconds = 1000.0 / g_dev.vi.expected_refresh_rate;
-    const double SpeedFactorMultiple = defaultSpeedFactor/l_SpeedFactor;
-    const double AdjustedLimit = VILimitMilliseconds * SpeedFactorMultiple;
-
-    //if this is the first time or we are resuming from pause
-    if(StartFPSTime == 0 || !resetOnce || lastSpeedFactor != l_SpeedFactor)
-    {
-       StartFPSTime = CurrentFPSTime;
-       totalVIs = 0;
-       resetOnce = 1;
-    }
-    else
-    {
-        ++totalVIs;
-    }
-
-    lastSpeedFactor = l_SpeedFactor;
-
-#if defined(PROFILE)
-    timed_section_start(TIMED_SECTION_IDLE);
-#endif
+    const int64_t FramePeriod = (int64_t)(1000000000.0 / g_dev.vi.expected_refresh_rate * 100.0 / l_SpeedFactor);
+    struct profile_mark mark;
+    profile_start(&mark);
 
 #ifdef DBG
     if(g_DebuggerActive) DebuggerCallback(DEBUG_UI_VI, 0);
 #endif
 
-    double totalElapsedGameTime = AdjustedLimit*totalVIs;
-    double elapsedRealTime = CurrentFPSTime - StartFPSTime;
-    double sleepTime = totalElapsedGameTime - elapsedRealTime;
-
-    //Reset if the sleep needed is an unreasonable value
-    static const double minSleepNeeded = -50;
-    static const double maxSleepNeeded = 50;
-    if(sleepTime < minSleepNeeded || sleepTime > (maxSleepNeeded*SpeedFactorMultiple))
-    {
-       resetOnce = 0;
-    }
-
-    if (sleepTime < minSleepNeeded) {
-        totalVIs += (unsigned long)(minSleepNeeded/AdjustedLimit);
-    }
+    frame_pacer_wait(&l_FramePacer, FramePeriod, l_MainSpeedLimit);
 
-    if(l_MainSpeedLimit && sleepTime > 0 && sleepTime < maxSleepNeeded*SpeedFactorMultiple)
-    {
-        while(sleepTime >= 0) {
-            SDL_Delay((unsigned int) sleepTime);
-
-            CurrentFPSTime = SDL_GetTicks();
-            elapsedRealTime = CurrentFPSTime - StartFPSTime;
-            sleepTime = totalElapsedGameTime - elapsedRealTime;
-        }
-    }
-
-
-#if defined(PROFILE)
-    timed_section_end(TIMED_SECTION_IDLE);
-#endif
+    profile_end(&l_ProfileSpeedLimiter, &mark);
 }
 
 /* TODO: make a GameShark module and move that there */
@@ -1058,6 +1069,10 @@ static void pause_loop(void)
             SDL_Delay(10);
             main_check_inputs();
         }
+
+        frame_pacer_reset(&l_FramePacer);
+        /* don't account the pause in the frame time */
+        profile_start(&l_FrameMark);
     }
 }
 
@@ -1065,12 +1080,18 @@ static void pause_loop(void)
  * Allow the core to perform various things */
 void new_vi(void)
 {
-#if defined(PROFILE)
-    timed_sections_refresh();
-#endif
+    profile_end(&l_ProfileFrame, &l_FrameMark);
+    profile_start(&l_FrameMark);
 
     gs_apply_cheats(&g_cheat_ctx);
 
+    if (headless_enabled())
+    {
+        if (headless_new_vi(r4300_cp0_regs(&g_dev.r4300.cp0)[CP0_COUNT_REG]))
+            main_stop();
+        return;
+    }
+
     apply_speed_limiter();
     main_check_inputs();
 
@@ -1352,6 +1373,7 @@ static int load_dd_disk(struct dd_disk* dd_disk, const struct storage_backend_in
         fstorage_save->data = fstorage->data;
         fstorage_save->size = fstorage->size;
         fstorage_save->first_access = 1;
+        fstorage_save->writer = NULL;
         break;
     case 1: /* RAM only */
         *dd_idisk = &g_istorage_disk_ram_only;
@@ -1359,6 +1381,7 @@ static int load_dd_disk(struct dd_disk* dd_disk, const struct storage_backend_in
         fstorage_save->data = &fstorage->data[offset_ram];
         fstorage_save->size = size_ram;
         fstorage_save->first_access = 1;
+        fstorage_save->writer = NULL;
         break;
     default: /* read only */
         *dd_idisk = &g_istorage_disk_read_only;
@@ -1424,7 +1447,9 @@ no_disk:
 static void close_dd_disk(struct dd_disk* disk)
 {
     if (disk->save_storage != NULL) {
-        /* no need to close save_storage as it is a child of disk->storage */
+        /* no need to close save_storage as it is a child of disk->storage,
+         * but its pending writes must land before the data is released */
+        flush_file_storage(disk->save_storage);
         free(disk->save_storage);
         disk->save_storage = NULL;
     }
@@ -1587,6 +1612,7 @@ m64p_error main_run(void)
     int32_t si_dma_duration;
     int32_t no_compiled_jump;
     int32_t randomize_interrupt;
+    int audio_pacing_latency;
     struct file_storage eep;
     struct file_storage fla;
     struct file_storage sra;
@@ -1625,6 +1651,7 @@ m64p_error main_run(void)
 
     /* set some other core parameters based on the config file values */
     savestates_set_autoinc_slot(ConfigGetParamBool(g_CoreConfig, "AutoStateSlotIncrement"));
+    savestates_set_compression_level(ConfigGetParamInt(g_CoreConfig, "SaveStateCompressionLevel"));
     savestates_select_slot(ConfigGetParamInt(g_CoreConfig, "CurrentStateSlot"));
     no_compiled_jump = ConfigGetParamBool(g_CoreConfig, "NoCompiledJump");
     //We disable any randomness for netplay
@@ -1647,6 +1674,10 @@ m64p_error main_run(void)
     if (si_dma_duration < 0)
         si_dma_duration = ROM_SETTINGS.sidmaduration;
 
+    audio_pacing_latency = ConfigGetParamInt(g_CoreConfig, "AudioPacingLatency");
+    frame_pacer_init(&l_FramePacer, (audio_pacing_latency > 0) ? audio_pacing_latency : 0);
+    l_FrameMark.time = 0;  // no frame in progress
+
     //During netplay, player 1 is the source of truth for these settings
     netplay_sync_settings(&count_per_op, &count_per_op_denom_pot, &disable_extra_mem, &si_dma_duration, &emumode, &no_compiled_jump);
 
@@ -1904,7 +1935,8 @@ m64p_error main_run(void)
                 no_compiled_jump,
                 randomize_interrupt,
                 g_start_address,
-                &g_dev.ai, &g_iaudio_out_backend_plugin_compat, ((float)ROM_SETTINGS.aidmamodifier / 100.0),
+                &g_dev.ai, headless_enabled() ? &g_iaudio_out_backend_headless : &g_iaudio_out_backend_plugin_compat,
+                ((float)ROM_SETTINGS.aidmamodifier / 100.0),
                 si_dma_duration,
                 rdram_size,
                 joybus_devices, ijoybus_devices,
@@ -1936,13 +1968,22 @@ m64p_error main_run(void)
     }
 
     /* set up the SDL key repeat and event filter to catch keyboard/joystick commands for the core */
-    event_initialize();
+    if (!headless_enabled())
+        event_initialize();
 
     /* initialize frame counter */
     l_CurrentFrame = 0;
+    l_FrameDumpInterval = ConfigGetParamInt(g_CoreConfig, "FrameDumpInterval");
+    l_NextFrameDump = 0;
+    headless_start();
+
+    if (!headless_enabled())
+        frame_ring_open(ConfigGetParamInt(g_CoreConfig, "FrameRingMode"),
+                        ConfigGetParamString(g_CoreConfig, "FrameRingName"),
+                        ConfigGetParamInt(g_CoreConfig, "FrameRingSlots"));
 
     /* initialize the on-screen display */
-    if (ConfigGetParamBool(g_CoreConfig, "OnScreenDisplay"))
+    if (!headless_enabled() && ConfigGetParamBool(g_CoreConfig, "OnScreenDisplay"))
     {
         // init on-screen display
         int width = 640, height = 480;
@@ -1951,7 +1992,7 @@ m64p_error main_run(void)
     }
 
     // setup rendering callback from video plugin to the core, for screenshots and On-Screen-Display
-    gfx.setRenderingCallback(video_plugin_render_callback);
+    gfx.setRenderingCallback(headless_enabled() ? headless_render_callback : video_plugin_render_callback);
 
 #ifdef WITH_LIRC
     lircStart();
@@ -1972,6 +2013,9 @@ m64p_error main_run(void)
     pif_bootrom_hle_execute(&g_dev.r4300);
     run_device(&g_dev);
 
+    /* the CPU counters belong to this thread */
+    profile_hw_close();
+
     /* now begin to shut down */
 #ifdef WITH_LIRC
     lircStop();
@@ -1998,7 +2042,9 @@ m64p_error main_run(void)
     close_file_storage(&mpk);
     close_dd_disk(&dd_disk);
 
-    if (ConfigGetParamBool(g_CoreConfig, "OnScreenDisplay"))
+    ScreenshotRomClose();
+
+    if (!headless_enabled() && ConfigGetParamBool(g_CoreConfig, "OnScreenDisplay"))
     {
         osd_exit();
     }
@@ -2010,6 +2056,7 @@ m64p_error main_run(void)
 
     // clean up
     g_EmulatorRunning = 0;
+    frame_ring_close();
     StateChanged(M64CORE_EMU_STATE, M64EMU_STOPPED);
 
     return M64ERR_SUCCESS;
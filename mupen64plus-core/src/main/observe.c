@@ -0,0 +1,215 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - observe.c                                               *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "observe.h"
+
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define M64P_CORE_PROTOTYPES 1
+#include "api/callbacks.h"
+#include "device/device.h"
+#include "main/frame_ring.h"
+
+#define MAX_WATCH_RANGES 4096
+#define MAX_RDRAM_SIZE   0x800000
+
+static SDL_mutex* l_lock = NULL;
+
+static m64p_observe_range* l_ranges = NULL;
+static int l_range_count = 0;
+
+static uint32_t* l_watch_data = NULL;
+static uint32_t l_watch_size = 0;
+
+/* observe_watch keeps the buffer last returned by observe_get until the
+ * next observe_get, so that a held observation doesn't point to freed
+ * memory */
+static uint32_t* l_retired_data = NULL;
+static int l_watch_data_returned = 0;
+
+static unsigned int l_frame = 0;
+
+void observe_init(void)
+{
+    l_lock = SDL_CreateMutex();
+    if (l_lock == NULL)
+        DebugMessage(M64MSG_ERROR, "Could not create observation mutex");
+}
+
+void observe_deinit(void)
+{
+    observe_watch(NULL, 0);
+    free(l_retired_data);
+    l_retired_data = NULL;
+
+    if (l_lock != NULL)
+    {
+        SDL_DestroyMutex(l_lock);
+        l_lock = NULL;
+    }
+}
+
+void observe_new_frame(const struct device* dev, unsigned int frame)
+{
+    const uint32_t* dram = dev->rdram.dram;
+    uint32_t* dst;
+    int i;
+
+    l_frame = frame;
+
+    if (l_lock == NULL)
+        return;
+
+    SDL_LockMutex(l_lock);
+    dst = l_watch_data;
+    for (i = 0; i < l_range_count; ++i)
+    {
+        uint32_t address = l_ranges[i].address;
+        uint32_t length = l_ranges[i].length;
+
+        /* ranges past the end of a 4MB RDRAM read as zero */
+        if (address + length <= dev->rdram.dram_size)
+            memcpy(dst, dram + address / 4, length);
+        else
+            memset(dst, 0, length);
+        dst += length / 4;
+    }
+    SDL_UnlockMutex(l_lock);
+}
+
+m64p_error observe_get(const struct device* dev, m64p_observation* obs)
+{
+    const uint32_t* vi_regs = dev->vi.regs;
+    const void* screen;
+    int width, height;
+
+    memset(obs, 0, sizeof(*obs));
+
+    obs->frame = l_frame;
+    obs->rdram = dev->rdram.dram;
+    obs->rdram_size = (uint32_t) dev->rdram.dram_size;
+    obs->sp_mem = dev->sp.mem;
+    obs->vi_regs = vi_regs;
+
+    obs->fb_address = vi_regs[VI_ORIGIN_REG] & 0xffffff;
+    obs->fb_width = vi_regs[VI_WIDTH_REG] & 0xfff;
+    switch (vi_regs[VI_STATUS_REG] & 3)
+    {
+        case 2: obs->fb_bpp = 16; break;
+        case 3: obs->fb_bpp = 32; break;
+        default: obs->fb_bpp = 0; break;
+    }
+
+    if (frame_ring_last_frame(&screen, &width, &height))
+    {
+        obs->screen = screen;
+        obs->screen_width = width;
+        obs->screen_height = height;
+    }
+
+    if (l_lock != NULL)
+        SDL_LockMutex(l_lock);
+    free(l_retired_data);
+    l_retired_data = NULL;
+    l_watch_data_returned = 1;
+    obs->watch_data = l_watch_data;
+    obs->watch_size = l_watch_size;
+    if (l_lock != NULL)
+        SDL_UnlockMutex(l_lock);
+
+    return M64ERR_SUCCESS;
+}
+
+m64p_error observe_watch(const m64p_observe_range* ranges, int count)
+{
+    m64p_observe_range* new_ranges = NULL;
+    uint32_t* new_data = NULL;
+    uint64_t size = 0;
+    int i;
+
+    if (count < 0 || count > MAX_WATCH_RANGES || (count > 0 && ranges == NULL))
+        return M64ERR_INPUT_INVALID;
+
+    if (count > 0)
+    {
+        new_ranges = malloc(count * sizeof(*new_ranges));
+        if (new_ranges == NULL)
+            return M64ERR_NO_MEMORY;
+
+        for (i = 0; i < count; ++i)
+        {
+            /* accept KSEG0/KSEG1 addresses as well */
+            uint32_t address = ranges[i].address & 0x1fffffff;
+            uint32_t length = ranges[i].length;
+
+            if ((address & 3) != 0 || (length & 3) != 0 || length == 0
+             || address >= MAX_RDRAM_SIZE || length > MAX_RDRAM_SIZE - address)
+            {
+                DebugMessage(M64MSG_ERROR, "Invalid watched range %08x, %u bytes: it must be word aligned and within RDRAM",
+                             ranges[i].address, length);
+                free(new_ranges);
+                return M64ERR_INPUT_INVALID;
+            }
+
+            new_ranges[i].address = address;
+            new_ranges[i].length = length;
+            size += length;
+        }
+
+        if (size > MAX_RDRAM_SIZE)
+        {
+            free(new_ranges);
+            return M64ERR_INPUT_INVALID;
+        }
+
+        /* zeroed until the next frame fills it */
+        new_data = calloc(1, (size_t) size);
+        if (new_data == NULL)
+        {
+            free(new_ranges);
+            return M64ERR_NO_MEMORY;
+        }
+    }
+
+    if (l_lock != NULL)
+        SDL_LockMutex(l_lock);
+    free(l_ranges);
+    if (l_watch_data_returned)
+    {
+        /* observe_get freed the one retired before */
+        l_retired_data = l_watch_data;
+    }
+    else
+    {
+        free(l_watch_data);
+    }
+    l_watch_data_returned = 0;
+    l_ranges = new_ranges;
+    l_watch_data = new_data;
+    l_watch_size = (uint32_t) size;
+    l_range_count = count;
+    if (l_lock != NULL)
+        SDL_UnlockMutex(l_lock);
+
+    return M64ERR_SUCCESS;
+}
@@ -0,0 +1,46 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - observe.h                                               *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_MAIN_OBSERVE_H
+#define M64P_MAIN_OBSERVE_H
+
+#include "api/m64p_types.h"
+
+struct device;
+
+/* Gives the front-end read-only pointers to the emulated memories, and
+ * copies a list of watched RDRAM ranges into a packed buffer before each
+ * frame callback, so that an agent can observe the game state once per
+ * frame without going through the debugger API. */
+
+void observe_init(void);
+void observe_deinit(void);
+
+/* Called on the emulation thread before the frame callback */
+void observe_new_frame(const struct device* dev, unsigned int frame);
+
+m64p_error observe_get(const struct device* dev, m64p_observation* obs);
+
+/* Replace the watched ranges, count 0 clears them. May be called from any
+ * thread, including from the frame callback. */
+m64p_error observe_watch(const m64p_observe_range* ranges, int count);
+
+#endif
@@ -23,77 +23,241 @@
 
 #include "profile.h"
 
-#include "api/callbacks.h"
-#include "api/m64p_types.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-static long long int time_in_section[NUM_TIMED_SECTIONS];
-static long long int last_start[NUM_TIMED_SECTIONS];
+#include "api/callbacks.h"
+#include "osal/files.h"
 
-#if defined(WIN32) && !defined(__MINGW32__)
-  // timing
+#if defined(WIN32)
   #include <windows.h>
-
-  static long long int get_time(void)
-  {
-      LARGE_INTEGER counter;
-      QueryPerformanceCounter(&counter);
-      return counter.QuadPart;
-  }
-  static long long int time_to_nsec(long long int time)
-  {
-      static LARGE_INTEGER freq = { 0 };
-      if (freq.QuadPart == 0)
-          QueryPerformanceFrequency(&freq);
-      return time * 1000000000 / freq.QuadPart;
-  }
-
-#else  /* Not WIN32 */
-  // timing
+#else
   #include <time.h>
+#endif
+
+#define MAX_SECTIONS 64
+#define MAX_TRACE_EVENTS 65536
+
+struct trace_event
+{
+    const struct profile_section* section;
+    int64_t start;
+    int64_t duration;
+    uint64_t cycles;        /* UINT64_MAX if not counted */
+    uint64_t instructions;
+};
+
+volatile int g_profile_mode = M64P_PROFILE_OFF;
+volatile int g_profile_events = 0;
+
+static struct profile_section* l_sections[MAX_SECTIONS];
+static volatile int l_section_count = 0;
+
+/* ring of the last MAX_TRACE_EVENTS events, allocated when tracing starts */
+static struct trace_event* l_trace = NULL;
+static size_t l_trace_next = 0;
+static int l_trace_wrapped = 0;
+
+#if defined(WIN32)
+int64_t profile_now(void)
+{
+    static LARGE_INTEGER freq = { 0 };
+    LARGE_INTEGER counter;
+
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
 
-  static long long int get_time(void)
-  {
-     struct timespec ts;
-     clock_gettime(CLOCK_MONOTONIC, &ts);
-     return (long long int)ts.tv_sec * 1000000000 + ts.tv_nsec;
-  }
-  static long long int time_to_nsec(long long int time)
-  {
-      return time;
-  }
+    return (int64_t)(counter.QuadPart / freq.QuadPart) * 1000000000
+         + (int64_t)(counter.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart;
+}
+#else
+int64_t profile_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
 #endif
 
-void timed_section_start(enum timed_section section)
+static unsigned int histogram_bucket(uint64_t duration)
 {
-   last_start[section] = get_time();
+    unsigned int bucket = 0;
+
+    while ((duration >>= 1) != 0 && bucket < M64P_PROFILE_HISTOGRAM_BUCKETS - 1)
+        ++bucket;
+
+    return bucket;
 }
 
-void timed_section_end(enum timed_section section)
+static void clear_section(struct profile_section* section)
 {
-   long long int end = get_time();
-   time_in_section[section] += end - last_start[section];
+    section->count = 0;
+    section->total_ns = 0;
+    section->min_ns = 0;
+    section->max_ns = 0;
+    section->value = 0;
+    memset(section->histogram, 0, sizeof(section->histogram));
+    memset(section->events, 0, sizeof(section->events));
+    section->events_mask = 0;
 }
 
-void timed_sections_refresh()
+static int register_section(struct profile_section* section)
 {
-   long long int curr_time = get_time();
-   if(time_to_nsec(curr_time - last_start[TIMED_SECTION_ALL]) >= 2000000000)
-   {
-      time_in_section[TIMED_SECTION_ALL] = curr_time - last_start[TIMED_SECTION_ALL];
-      DebugMessage(M64MSG_INFO, "gfx=%f%% - audio=%f%% - compiler=%f%%, idle=%f%%",
-         100.0 * (double)time_in_section[TIMED_SECTION_GFX] / time_in_section[TIMED_SECTION_ALL],
-         100.0 * (double)time_in_section[TIMED_SECTION_AUDIO] / time_in_section[TIMED_SECTION_ALL],
-         100.0 * (double)time_in_section[TIMED_SECTION_COMPILER] / time_in_section[TIMED_SECTION_ALL],
-         100.0 * (double)time_in_section[TIMED_SECTION_IDLE] / time_in_section[TIMED_SECTION_ALL]);
-      DebugMessage(M64MSG_INFO, "gfx=%llins - audio=%llins - compiler %llins - idle=%llins",
-         time_to_nsec(time_in_section[TIMED_SECTION_GFX]),
-         time_to_nsec(time_in_section[TIMED_SECTION_AUDIO]),
-         time_to_nsec(time_in_section[TIMED_SECTION_COMPILER]),
-         time_to_nsec(time_in_section[TIMED_SECTION_IDLE]));
-      time_in_section[TIMED_SECTION_GFX] = 0;
-      time_in_section[TIMED_SECTION_AUDIO] = 0;
-      time_in_section[TIMED_SECTION_COMPILER] = 0;
-      time_in_section[TIMED_SECTION_IDLE] = 0;
-      last_start[TIMED_SECTION_ALL] = curr_time;
-   }
+    if (l_section_count >= MAX_SECTIONS) {
+        DebugMessage(M64MSG_WARNING, "Too many profiling sections, %s.%s is not recorded", section->category, section->name);
+        section->id = -1;
+        return 0;
+    }
+
+    l_sections[l_section_count] = section;
+    section->id = ++l_section_count;
+    return 1;
+}
+
+void profile_record(struct profile_section* section, const struct profile_mark* mark, uint64_t value)
+{
+    int64_t end = profile_now();
+    uint64_t duration = (end > mark->time) ? (uint64_t)(end - mark->time) : 0;
+    uint64_t counters[M64P_PROFILE_EVENTS];
+    int counted = mark->counted && profile_hw_read(counters);
+    unsigned int i;
+
+    if (section->id <= 0 && (section->id < 0 || !register_section(section)))
+        return;
+
+    if (counted) {
+        for (i = 0; i < M64P_PROFILE_EVENTS; ++i)
+            section->events[i] += counters[i] - mark->counters[i];
+        section->events_mask |= profile_hw_mask();
+    }
+
+    if (section->count == 0 || duration < section->min_ns)
+        section->min_ns = duration;
+    if (duration > section->max_ns)
+        section->max_ns = duration;
+    section->count++;
+    section->total_ns += duration;
+    section->value += value;
+    section->histogram[histogram_bucket(duration)]++;
+
+    if (g_profile_mode == M64P_PROFILE_TRACE && l_trace != NULL) {
+        struct trace_event* event = &l_trace[l_trace_next];
+        event->section = section;
+        event->start = mark->time;
+        event->duration = (int64_t)duration;
+        event->cycles = counted ? counters[M64P_PROFILE_CYCLES] - mark->counters[M64P_PROFILE_CYCLES] : UINT64_MAX;
+        event->instructions = counted ? counters[M64P_PROFILE_INSTRUCTIONS] - mark->counters[M64P_PROFILE_INSTRUCTIONS] : 0;
+        if (++l_trace_next == MAX_TRACE_EVENTS) {
+            l_trace_next = 0;
+            l_trace_wrapped = 1;
+        }
+    }
+}
+
+m64p_error profile_set_mode(int mode)
+{
+    int base = mode & ~M64P_PROFILE_CPU_EVENTS;
+    m64p_error rval = M64ERR_SUCCESS;
+    unsigned int events = 0;
+    int i;
+
+    if (base != M64P_PROFILE_OFF && base != M64P_PROFILE_COUNTERS && base != M64P_PROFILE_TRACE)
+        return M64ERR_INPUT_INVALID;
+
+    /* stop recording before touching the collected data */
+    g_profile_mode = M64P_PROFILE_OFF;
+    g_profile_events = 0;
+
+    /* the counters are opened later on the emulation thread, only check
+     * here that the host lets us use them */
+    if (base != M64P_PROFILE_OFF && (mode & M64P_PROFILE_CPU_EVENTS)) {
+        events = profile_hw_probe();
+        if (events == 0) {
+            DebugMessage(M64MSG_WARNING, "CPU performance counters are not available, profiling without them");
+            rval = M64ERR_UNSUPPORTED;
+        }
+    }
+
+    if (base == M64P_PROFILE_TRACE && l_trace == NULL) {
+        l_trace = (struct trace_event*)malloc(MAX_TRACE_EVENTS * sizeof(*l_trace));
+        if (l_trace == NULL)
+            return M64ERR_NO_MEMORY;
+    }
+
+    for (i = 0; i < l_section_count; ++i)
+        clear_section(l_sections[i]);
+    l_trace_next = 0;
+    l_trace_wrapped = 0;
+
+    g_profile_events = (events != 0);
+    g_profile_mode = base;
+    return rval;
+}
+
+m64p_error profile_get_sections(m64p_profile_section* sections, int count)
+{
+    int i, n = l_section_count;
+
+    if (sections == NULL || count < 1)
+        return M64ERR_INPUT_INVALID;
+
+    memset(sections, 0, count * sizeof(*sections));
+
+    for (i = 0; i < n && i < count; ++i) {
+        const struct profile_section* section = l_sections[i];
+        strncpy(sections[i].name, section->name, sizeof(sections[i].name) - 1);
+        strncpy(sections[i].category, section->category, sizeof(sections[i].category) - 1);
+        sections[i].count = section->count;
+        sections[i].total_ns = section->total_ns;
+        sections[i].min_ns = section->min_ns;
+        sections[i].max_ns = section->max_ns;
+        sections[i].value = section->value;
+        memcpy(sections[i].histogram, section->histogram, sizeof(sections[i].histogram));
+        memcpy(sections[i].events, section->events, sizeof(sections[i].events));
+        sections[i].events_mask = section->events_mask;
+    }
+
+    return M64ERR_SUCCESS;
+}
+
+m64p_error profile_dump_trace(const char* filename)
+{
+    FILE* f;
+    size_t i, first, n;
+    int64_t origin;
+
+    if (l_trace == NULL || (l_trace_next == 0 && !l_trace_wrapped))
+        return M64ERR_INVALID_STATE;
+
+    f = osal_file_open(filename, "w");
+    if (f == NULL) {
+        DebugMessage(M64MSG_ERROR, "Couldn't open profiling trace file: %s", filename);
+        return M64ERR_FILES;
+    }
+
+    first = l_trace_wrapped ? l_trace_next : 0;
+    n = l_trace_wrapped ? MAX_TRACE_EVENTS : l_trace_next;
+    origin = l_trace[first].start;
+
+    /* Chrome trace event format, complete events with timestamps in us */
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (i = 0; i < n; ++i) {
+        const struct trace_event* event = &l_trace[(first + i) % MAX_TRACE_EVENTS];
+        fprintf(f, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f",
+                event->section->name, event->section->category,
+                (double)(event->start - origin) / 1000.0, (double)event->duration / 1000.0);
+        if (event->cycles != UINT64_MAX)
+            fprintf(f, ",\"args\":{\"cycles\":%" PRIu64 ",\"instructions\":%" PRIu64 "}",
+                    event->cycles, event->instructions);
+        fprintf(f, "}%s\n", (i + 1 < n) ? "," : "");
+    }
+    fprintf(f, "]}\n");
+
+    if (fclose(f) != 0)
+        return M64ERR_FILES;
+
+    return M64ERR_SUCCESS;
 }
@@ -24,18 +24,78 @@
 #ifndef PROFILE_H
 #define PROFILE_H
 
-enum timed_section
+#include <stdint.h>
+
+#include "api/m64p_types.h"
+#include "osal/preproc.h"
+#include "profile_hw.h"
+
+/* Timed sections are declared statically by each subsystem with
+ * PROFILE_SECTION and register themselves the first time they are recorded.
+ * While profiling is off, profile_start only clears the mark and nothing is
+ * recorded, so sections can stay in release builds.
+ *
+ * Sections are expected to be recorded from the emulation thread only. */
+struct profile_section
+{
+    const char* name;
+    const char* category;
+    int id;                 /* index in the registry plus one, 0 if unregistered */
+
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t value;
+    uint64_t histogram[M64P_PROFILE_HISTOGRAM_BUCKETS];
+    uint64_t events[M64P_PROFILE_EVENTS];
+    unsigned int events_mask;   /* events which were counted */
+};
+
+/* start of a section, kept by the caller until profile_end */
+struct profile_mark
 {
-    TIMED_SECTION_ALL,
-    TIMED_SECTION_GFX,
-    TIMED_SECTION_AUDIO,
-    TIMED_SECTION_COMPILER,
-    TIMED_SECTION_IDLE,
-    NUM_TIMED_SECTIONS
+    int64_t time;           /* 0 if profiling was off at the start */
+    int counted;            /* counters were read */
+    uint64_t counters[M64P_PROFILE_EVENTS];
 };
 
-void timed_section_start(enum timed_section section);
-void timed_section_end(enum timed_section section);
-void timed_sections_refresh(void);
+#define PROFILE_SECTION(var, name, category) \
+    static struct profile_section var = { name, category, 0 }
+
+extern volatile int g_profile_mode;
+extern volatile int g_profile_events;   /* CPU counters requested */
+
+int64_t profile_now(void);
+void profile_record(struct profile_section* section, const struct profile_mark* mark, uint64_t value);
+
+m64p_error profile_set_mode(int mode);
+m64p_error profile_get_sections(m64p_profile_section* sections, int count);
+m64p_error profile_dump_trace(const char* filename);
+
+static osal_inline void profile_start(struct profile_mark* mark)
+{
+    if (g_profile_mode == M64P_PROFILE_OFF) {
+        mark->time = 0;
+        return;
+    }
+
+    mark->counted = g_profile_events && profile_hw_read(mark->counters);
+    mark->time = profile_now();
+}
+
+/* a section started while profiling was off is dropped */
+static osal_inline void profile_end(struct profile_section* section, const struct profile_mark* mark)
+{
+    if (mark->time != 0)
+        profile_record(section, mark, 0);
+}
+
+/* same as profile_end, also adding value (bytes transferred, ...) to the section */
+static osal_inline void profile_end_value(struct profile_section* section, const struct profile_mark* mark, uint64_t value)
+{
+    if (mark->time != 0)
+        profile_record(section, mark, value);
+}
 
 #endif
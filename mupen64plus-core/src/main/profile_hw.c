@@ -0,0 +1,237 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - profile_hw.c                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "profile_hw.h"
+
+#include "api/m64p_types.h"
+
+#if defined(__linux__)
+
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct hw_counter
+{
+    int fd;
+    struct perf_event_mmap_page* page;  /* for rdpmc, NULL if not mapped */
+};
+
+static const struct
+{
+    uint32_t type;
+    uint64_t config;
+} l_events[M64P_PROFILE_EVENTS] =
+{
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+                        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL
+                        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+static struct hw_counter l_counters[M64P_PROFILE_EVENTS];
+static unsigned int l_mask = 0;
+static int l_opened = 0;
+
+static int open_event(unsigned int event, int group_fd)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = l_events[event].type;
+    attr.config = l_events[event].config;
+    /* user space only, which perf_event_paranoid allows by default */
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static void close_counters(struct hw_counter* counters)
+{
+    unsigned int i;
+
+    for (i = 0; i < M64P_PROFILE_EVENTS; ++i) {
+        if (counters[i].page != NULL)
+            munmap(counters[i].page, sysconf(_SC_PAGESIZE));
+        if (counters[i].fd >= 0)
+            close(counters[i].fd);
+        counters[i].page = NULL;
+        counters[i].fd = -1;
+    }
+}
+
+/* The counters form a group led by the cycles counter, so that they are
+ * scheduled on the PMU together. Events the host doesn't support are left
+ * out, and without a cycles counter each event is opened on its own. */
+static unsigned int open_counters(struct hw_counter* counters)
+{
+    unsigned int i, mask = 0;
+    int leader;
+
+    for (i = 0; i < M64P_PROFILE_EVENTS; ++i) {
+        counters[i].fd = -1;
+        counters[i].page = NULL;
+    }
+
+    leader = open_event(M64P_PROFILE_CYCLES, -1);
+
+    for (i = 0; i < M64P_PROFILE_EVENTS; ++i) {
+        void* page;
+
+        counters[i].fd = (i == M64P_PROFILE_CYCLES) ? leader : open_event(i, leader);
+        if (counters[i].fd < 0)
+            continue;
+
+        mask |= 1u << i;
+
+        page = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, counters[i].fd, 0);
+        if (page != MAP_FAILED)
+            counters[i].page = (struct perf_event_mmap_page*)page;
+    }
+
+    return mask;
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+static uint64_t rdpmc(uint32_t counter)
+{
+    uint32_t low, high;
+    __asm__ __volatile__("rdpmc" : "=a" (low), "=d" (high) : "c" (counter));
+    return low | ((uint64_t)high << 32);
+}
+
+/* Self-monitoring read from the mapped page, see linux/perf_event.h.
+ * Returns 0 if the counter isn't currently on the PMU or if user space
+ * reads are not allowed. */
+static int read_counter_rdpmc(const struct hw_counter* counter, uint64_t* value)
+{
+    volatile struct perf_event_mmap_page* page = counter->page;
+    uint32_t seq, index;
+    uint64_t count, pmc;
+    int ok;
+
+    do {
+        seq = page->lock;
+        __asm__ __volatile__("" ::: "memory");
+
+        index = page->index;
+        count = page->offset;
+        ok = page->cap_user_rdpmc && index != 0;
+        if (ok) {
+            unsigned int shift = 64 - page->pmc_width;
+            pmc = rdpmc(index - 1);
+            count += (uint64_t)((int64_t)(pmc << shift) >> shift);
+        }
+
+        __asm__ __volatile__("" ::: "memory");
+    } while (page->lock != seq);
+
+    *value = count;
+    return ok;
+}
+#endif
+
+static uint64_t read_counter(const struct hw_counter* counter)
+{
+    uint64_t value;
+
+#if defined(__i386__) || defined(__x86_64__)
+    if (counter->page != NULL && read_counter_rdpmc(counter, &value))
+        return value;
+#endif
+
+    if (read(counter->fd, &value, sizeof(value)) != sizeof(value))
+        return 0;
+
+    return value;
+}
+
+unsigned int profile_hw_probe(void)
+{
+    struct hw_counter counters[M64P_PROFILE_EVENTS];
+    unsigned int mask = open_counters(counters);
+
+    close_counters(counters);
+    return mask;
+}
+
+unsigned int profile_hw_mask(void)
+{
+    return l_mask;
+}
+
+int profile_hw_read(uint64_t* counters)
+{
+    unsigned int i;
+
+    if (!l_opened) {
+        l_mask = open_counters(l_counters);
+        l_opened = 1;
+    }
+
+    if (l_mask == 0)
+        return 0;
+
+    for (i = 0; i < M64P_PROFILE_EVENTS; ++i)
+        counters[i] = (l_mask & (1u << i)) ? read_counter(&l_counters[i]) : 0;
+
+    return 1;
+}
+
+void profile_hw_close(void)
+{
+    if (l_opened)
+        close_counters(l_counters);
+    l_mask = 0;
+    l_opened = 0;
+}
+
+#else
+
+unsigned int profile_hw_probe(void)
+{
+    return 0;
+}
+
+unsigned int profile_hw_mask(void)
+{
+    return 0;
+}
+
+int profile_hw_read(uint64_t* counters)
+{
+    return 0;
+}
+
+void profile_hw_close(void)
+{
+}
+
+#endif
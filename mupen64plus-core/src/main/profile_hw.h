@@ -0,0 +1,49 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - profile_hw.h                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_MAIN_PROFILE_HW_H
+#define M64P_MAIN_PROFILE_HW_H
+
+#include <stdint.h>
+
+/* CPU performance counters for the profiler, counting the events of
+ * m64p_profile_event in user space for the calling thread. They are only
+ * implemented on Linux, with perf_event_open. On x86 they are read with
+ * rdpmc when the kernel allows it, which costs a few tens of cycles per
+ * counter instead of a system call.
+ *
+ * The counters are opened by the first profile_hw_read on the emulation
+ * thread and must be closed on that same thread. */
+
+/* Open the counters on the calling thread, to check which ones the host
+ * supports and allows, and close them. Returns the mask of usable events. */
+unsigned int profile_hw_probe(void);
+
+/* mask of the events counted by the counters opened on the emulation thread */
+unsigned int profile_hw_mask(void);
+
+/* Read the counters into counters[M64P_PROFILE_EVENTS], opening them first
+ * if needed. Returns 0 if none could be opened. */
+int profile_hw_read(uint64_t* counters);
+
+void profile_hw_close(void);
+
+#endif
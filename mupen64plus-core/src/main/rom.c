@@ -26,6 +26,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#if !defined(WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
@@ -46,7 +53,11 @@
 #include "rom.h"
 #include "util.h"
 
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
 #define CHUNKSIZE 1024*128 /* Read files 128KB at a time. */
+#define HASHCHUNKSIZE 1024*64 /* Swap and hash ROMs 64KB at a time. */
 
 /* Number of cpu cycles per instruction */
 enum { DEFAULT_COUNT_PER_OP = 2 };
@@ -57,6 +68,14 @@ enum { DEFAULT_SI_DMA_DURATION = 0x900 };
 /* Default AI DMA modifier */
 enum { DEFAULT_AI_DMA_MODIFIER = 100 };
 
+/* The INI file as parsed, before being compiled */
+struct romdatabase_ini
+{
+    romdatabase_search* md5_lists[256];
+    romdatabase_search* list;
+    uint32_t entry_count;
+};
+
 static romdatabase_entry* ini_search_by_md5(md5_byte_t* md5);
 
 static _romdatabase g_romdatabase;
@@ -72,6 +91,8 @@ static m64p_system_type rom_country_code_to_system_type(uint16_t country_code);
 
 static unsigned char rom_homebrew_savetype_to_savetype(uint8_t save_type);
 
+static void rom_settings_set_rsplle(const char* rsplle);
+
 static const uint8_t Z64_SIGNATURE[4] = { 0x80, 0x37, 0x12, 0x40 };
 static const uint8_t V64_SIGNATURE[4] = { 0x37, 0x80, 0x40, 0x12 };
 static const uint8_t N64_SIGNATURE[4] = { 0x40, 0x12, 0x37, 0x80 };
@@ -89,8 +110,11 @@ static int is_valid_rom(const unsigned char *buffer)
 
 /* Copies the source block of memory to the destination block of memory while
  * switching the endianness of .v64 and .n64 images to the .z64 format, which
- * is native to the Nintendo 64. The data extraction routines and MD5 hashing
- * function may only act on the .z64 big-endian format.
+ * is native to the Nintendo 64. The data extraction routines and hashing
+ * functions may only act on the .z64 big-endian format.
+ *
+ * The image is processed by chunks small enough to stay in the cache, each
+ * one being hashed right after being copied.
  *
  * IN: src: The source block of memory. This must be a valid Nintendo 64 ROM
  *          image of 'len' bytes.
@@ -101,45 +125,111 @@ static int is_valid_rom(const unsigned char *buffer)
  *                 V64IMAGE, N64IMAGE or Z64IMAGE according to the format of
  *                 the source block. The value is undefined if 'src' does not
  *                 represent a valid Nintendo 64 ROM image.
+ *      xxh3: The hash of the .z64 image, which must have been reset.
  */
-static void swap_copy_rom(void* dst, const void* src, size_t len, unsigned char* imagetype)
+static void swap_copy_rom(void* dst, const void* src, size_t len, unsigned char* imagetype, XXH3_state_t* xxh3)
 {
+    size_t element, offset, chunk;
+
     if (memcmp(src, V64_SIGNATURE, sizeof(V64_SIGNATURE)) == 0)
     {
-        size_t i;
-        const uint16_t* src16 = (const uint16_t*) src;
-        uint16_t* dst16 = (uint16_t*) dst;
-
-        *imagetype = V64IMAGE;
         /* .v64 images have byte-swapped half-words (16-bit). */
-        for (i = 0; i < len; i += 2)
-        {
-            *dst16++ = m64p_swap16(*src16++);
-        }
+        *imagetype = V64IMAGE;
+        element = 2;
     }
     else if (memcmp(src, N64_SIGNATURE, sizeof(N64_SIGNATURE)) == 0)
     {
-        size_t i;
-        const uint32_t* src32 = (const uint32_t*) src;
-        uint32_t* dst32 = (uint32_t*) dst;
-
-        *imagetype = N64IMAGE;
         /* .n64 images have byte-swapped words (32-bit). */
-        for (i = 0; i < len; i += 4)
-        {
-            *dst32++ = m64p_swap32(*src32++);
-        }
+        *imagetype = N64IMAGE;
+        element = 4;
     }
     else {
         *imagetype = Z64IMAGE;
-        memcpy(dst, src, len);
+        element = 1;
+    }
+
+    for (offset = 0; offset < len; offset += chunk)
+    {
+        uint8_t* d = (uint8_t*)dst + offset;
+        const uint8_t* s = (const uint8_t*)src + offset;
+
+        chunk = (len - offset < HASHCHUNKSIZE) ? len - offset : HASHCHUNKSIZE;
+
+        /* a truncated element at the end of the image is copied as is */
+        swap_copy_buffer(d, s, element, chunk / element);
+        memcpy(d + chunk / element * element, s + chunk / element * element, chunk % element);
+
+        XXH3_64bits_update(xxh3, d, chunk);
+    }
+}
+
+/* MD5 identifies ROMs in the database, but hashing a large image takes a
+ * lot longer than copying it. The MD5 of the images already seen are kept
+ * in the user cache directory, indexed by their XXH3 hash and size, one
+ * "<XXH3> <size> <MD5>" line per image. */
+static char* rom_hash_cache_path(void)
+{
+    const char* cache_dir = ConfigGetUserCachePath();
+    if (cache_dir == NULL)
+        return NULL;
+
+    osal_mkdirp(cache_dir, 0700);
+    return combinepath(cache_dir, "romhashes.txt");
+}
+
+static int rom_hash_cache_lookup(uint64_t xxh3, unsigned int size, md5_byte_t* md5)
+{
+    char line[128];
+    char md5_string[33];
+    unsigned long long line_xxh3;
+    unsigned int line_size;
+    int found = 0;
+    FILE* f;
+    char* path = rom_hash_cache_path();
+
+    if (path == NULL)
+        return 0;
+
+    f = osal_file_open(path, "r");
+    free(path);
+    if (f == NULL)
+        return 0;
+
+    while (!found && fgets(line, sizeof(line), f) != NULL)
+    {
+        if (sscanf(line, "%llx %u %32s", &line_xxh3, &line_size, md5_string) == 3
+         && line_xxh3 == xxh3 && line_size == size)
+            found = parse_hex(md5_string, md5, 16);
     }
+
+    fclose(f);
+    return found;
+}
+
+static void rom_hash_cache_store(uint64_t xxh3, unsigned int size, const char* md5_string)
+{
+    FILE* f;
+    char* path = rom_hash_cache_path();
+
+    if (path == NULL)
+        return;
+
+    f = osal_file_open(path, "a");
+    free(path);
+    if (f == NULL)
+        return;
+
+    fprintf(f, "%016" PRIX64 " %u %s\n", xxh3, size, md5_string);
+    fclose(f);
 }
 
 m64p_error open_rom(const unsigned char* romimage, unsigned int size)
 {
     md5_state_t state;
     md5_byte_t digest[16];
+    XXH3_state_t xxh3;
+    uint64_t hash;
+    int cached;
     romdatabase_entry* entry;
     char buffer[256];
     unsigned char imagetype;
@@ -156,19 +246,31 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
     g_RomWordsLittleEndian = 0;
     /* allocate new buffer for ROM and copy into this buffer */
     g_rom_size = size;
-    swap_copy_rom((uint8_t*)mem_base_u32(g_mem_base, MM_CART_ROM), romimage, size, &imagetype);
+    /* Calculate the XXH3 hash while copying */
+    XXH3_INITSTATE(&xxh3);
+    XXH3_64bits_reset(&xxh3);
+    swap_copy_rom((uint8_t*)mem_base_u32(g_mem_base, MM_CART_ROM), romimage, size, &imagetype, &xxh3);
     /* ROM is now in N64 native (big endian) byte order */
 
     memcpy(&ROM_HEADER, (uint8_t*)mem_base_u32(g_mem_base, MM_CART_ROM), sizeof(m64p_rom_header));
 
-    /* Calculate MD5 hash  */
-    md5_init(&state);
-    md5_append(&state, (const md5_byte_t*)((uint8_t*)mem_base_u32(g_mem_base, MM_CART_ROM)), g_rom_size);
-    md5_finish(&state, digest);
+    hash = XXH3_64bits_digest(&xxh3);
+    sprintf(ROM_SETTINGS.XXH3, "%016" PRIX64, hash);
+
+    /* Calculate MD5 hash, unless it is known for this image */
+    cached = rom_hash_cache_lookup(hash, size, digest);
+    if (!cached)
+    {
+        md5_init(&state);
+        md5_append(&state, (const md5_byte_t*)((uint8_t*)mem_base_u32(g_mem_base, MM_CART_ROM)), g_rom_size);
+        md5_finish(&state, digest);
+    }
     for ( i = 0; i < 16; ++i )
         sprintf(buffer+i*2, "%02X", digest[i]);
     buffer[32] = '\0';
     strcpy(ROM_SETTINGS.MD5, buffer);
+    if (!cached)
+        rom_hash_cache_store(hash, size, ROM_SETTINGS.MD5);
 
     /* add some useful properties to ROM_PARAMS */
     ROM_PARAMS.systemtype = rom_country_code_to_system_type(ROM_HEADER.Country_code);
@@ -195,6 +297,7 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
         ROM_SETTINGS.disableextramem = entry->disableextramem;
         ROM_SETTINGS.sidmaduration = entry->sidmaduration;
         ROM_SETTINGS.aidmamodifier = entry->aidmamodifier;
+        rom_settings_set_rsplle(entry->rsplle);
         ROM_PARAMS.cheats = entry->cheats;
     }
     else
@@ -211,6 +314,7 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
         ROM_SETTINGS.disableextramem = DEFAULT_DISABLE_EXTRA_MEM;
         ROM_SETTINGS.sidmaduration = DEFAULT_SI_DMA_DURATION;
         ROM_SETTINGS.aidmamodifier = DEFAULT_AI_DMA_MODIFIER;
+        rom_settings_set_rsplle(NULL);
         ROM_PARAMS.cheats = NULL;
 
         /* check if ROM has the Advanced Homebrew ROM Header (see https://n64brew.dev/wiki/ROM_Header) */
@@ -231,6 +335,7 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
     DebugMessage(M64MSG_INFO, "Name: %s", ROM_HEADER.Name);
     imagestring(imagetype, buffer);
     DebugMessage(M64MSG_INFO, "MD5: %s", ROM_SETTINGS.MD5);
+    DebugMessage(M64MSG_INFO, "XXH3: %s", ROM_SETTINGS.XXH3);
     DebugMessage(M64MSG_INFO, "CRC: %08" PRIX32 " %08" PRIX32, tohl(ROM_HEADER.CRC1), tohl(ROM_HEADER.CRC2));
     DebugMessage(M64MSG_INFO, "Imagetype: %s", buffer);
     DebugMessage(M64MSG_INFO, "Rom size: %d bytes (or %d Mb or %d Megabits)", g_rom_size, g_rom_size/1024/1024, g_rom_size/1024/1024*8);
@@ -315,6 +420,7 @@ m64p_error open_disk(void)
         sprintf(buffer+i*2, "%02X", digest[i]);
     buffer[32] = '\0';
     strcpy(ROM_SETTINGS.MD5, buffer);
+    sprintf(ROM_SETTINGS.XXH3, "%016" PRIX64, (uint64_t)XXH3_64bits(fstorage->data, fstorage->size));
 
     /* Look up this disk in the .ini file and fill in goodname, etc */
     if ((entry=ini_search_by_md5(digest)) != NULL)
@@ -332,6 +438,7 @@ m64p_error open_disk(void)
         ROM_SETTINGS.disableextramem = entry->disableextramem;
         ROM_SETTINGS.sidmaduration = entry->sidmaduration;
         ROM_SETTINGS.aidmamodifier = entry->aidmamodifier;
+        rom_settings_set_rsplle(entry->rsplle);
         ROM_PARAMS.cheats = entry->cheats;
     }
     else
@@ -349,6 +456,7 @@ m64p_error open_disk(void)
         ROM_SETTINGS.disableextramem = DEFAULT_DISABLE_EXTRA_MEM;
         ROM_SETTINGS.sidmaduration = DEFAULT_SI_DMA_DURATION;
         ROM_SETTINGS.aidmamodifier = DEFAULT_AI_DMA_MODIFIER;
+        rom_settings_set_rsplle(NULL);
         ROM_PARAMS.cheats = NULL;
     }
 
@@ -443,18 +551,41 @@ static unsigned char rom_homebrew_savetype_to_savetype(uint8_t save_type)
     return m64p_save_type;
 }
 
-static size_t romdatabase_resolve_round(void)
+// Copies the RSP ucodes to run on the LLE fallback (RspLle) into ROM_SETTINGS
+static void rom_settings_set_rsplle(const char* rsplle)
+{
+    if (rsplle == NULL)
+        rsplle = "";
+
+    strncpy(ROM_SETTINGS.rsplle, rsplle, sizeof(ROM_SETTINGS.rsplle) - 1);
+    ROM_SETTINGS.rsplle[sizeof(ROM_SETTINGS.rsplle) - 1] = '\0';
+}
+
+static romdatabase_entry* ini_list_search_by_md5(struct romdatabase_ini* ini, md5_byte_t* md5)
+{
+    romdatabase_search* search = ini->md5_lists[md5[0]];
+
+    while (search != NULL && memcmp(search->entry.md5, md5, 16) != 0)
+        search = search->next_md5;
+
+    if(search==NULL)
+        return NULL;
+
+    return &(search->entry);
+}
+
+static size_t romdatabase_resolve_round(struct romdatabase_ini* ini)
 {
     romdatabase_search *entry;
     romdatabase_entry *ref;
     size_t skipped = 0;
 
     /* Resolve RefMD5 references */
-    for (entry = g_romdatabase.list; entry; entry = entry->next_entry) {
+    for (entry = ini->list; entry; entry = entry->next_entry) {
         if (!entry->entry.refmd5)
             continue;
 
-        ref = ini_search_by_md5(entry->entry.refmd5);
+        ref = ini_list_search_by_md5(ini, entry->entry.refmd5);
         if (!ref) {
             DebugMessage(M64MSG_WARNING, "ROM Database: Error solving RefMD5s");
             continue;
@@ -553,6 +684,12 @@ static size_t romdatabase_resolve_round(void)
             entry->entry.set_flags |= ROMDATABASE_ENTRY_AIDMAMODIFIER;
         }
 
+        if (!isset_bitmask(entry->entry.set_flags, ROMDATABASE_ENTRY_RSPLLE) &&
+            isset_bitmask(ref->set_flags, ROMDATABASE_ENTRY_RSPLLE)) {
+            entry->entry.rsplle = strdup(ref->rsplle);
+            entry->entry.set_flags |= ROMDATABASE_ENTRY_RSPLLE;
+        }
+
         free(entry->entry.refmd5);
         entry->entry.refmd5 = NULL;
     }
@@ -560,13 +697,13 @@ static size_t romdatabase_resolve_round(void)
     return skipped;
 }
 
-static void romdatabase_resolve(void)
+static void romdatabase_resolve(struct romdatabase_ini* ini)
 {
     size_t last_skipped = (size_t)~0ULL;
     size_t skipped;
 
     do {
-        skipped = romdatabase_resolve_round();
+        skipped = romdatabase_resolve_round(ini);
         if (skipped == last_skipped) {
             DebugMessage(M64MSG_ERROR, "Unable to resolve rom database entries (loop)");
             break;
@@ -578,37 +715,17 @@ static void romdatabase_resolve(void)
 /********************************************************************************************/
 /* INI Rom database functions */
 
-void romdatabase_open(void)
+static void romdatabase_parse_ini(FILE* fPtr, struct romdatabase_ini* ini)
 {
-    FILE *fPtr;
     char buffer[256];
     romdatabase_search* search = NULL;
     romdatabase_search** next_search;
 
-    int counter, value, lineno;
+    int value, lineno;
     unsigned char index;
-    const char *pathname = ConfigGetSharedDataFilepath("mupen64plus.ini");
 
-    if(g_romdatabase.have_database)
-        return;
-
-    /* Open romdatabase. */
-    if (pathname == NULL || (fPtr = osal_file_open(pathname, "rb")) == NULL)
-    {
-        DebugMessage(M64MSG_ERROR, "Unable to open rom database file '%s'.", pathname);
-        return;
-    }
-
-    g_romdatabase.have_database = 1;
-
-    /* Clear premade indices. */
-    for(counter = 0; counter < 255; ++counter)
-        g_romdatabase.crc_lists[counter] = NULL;
-    for(counter = 0; counter < 255; ++counter)
-        g_romdatabase.md5_lists[counter] = NULL;
-    g_romdatabase.list = NULL;
-
-    next_search = &g_romdatabase.list;
+    memset(ini, 0, sizeof(*ini));
+    next_search = &ini->list;
 
     /* Parse ROM database file */
     for (lineno = 1; fgets(buffer, 255, fPtr) != NULL; lineno++)
@@ -630,6 +747,7 @@ void romdatabase_open(void)
             *next_search = (romdatabase_search*) malloc(sizeof(romdatabase_search));
             search = *next_search;
             next_search = &search->next_entry;
+            ini->entry_count++;
 
             memset(search, 0, sizeof(romdatabase_search));
 
@@ -650,14 +768,14 @@ void romdatabase_open(void)
             search->entry.biopak = 0;
             search->entry.sidmaduration = DEFAULT_SI_DMA_DURATION;
             search->entry.aidmamodifier = DEFAULT_AI_DMA_MODIFIER;
+            search->entry.rsplle = NULL;
             search->entry.set_flags = ROMDATABASE_ENTRY_NONE;
 
             search->next_entry = NULL;
-            search->next_crc = NULL;
             /* Index MD5s by first 8 bits. */
             index = search->entry.md5[0];
-            search->next_md5 = g_romdatabase.md5_lists[index];
-            g_romdatabase.md5_lists[index] = search;
+            search->next_md5 = ini->md5_lists[index];
+            ini->md5_lists[index] = search;
 
             break;
         }
@@ -680,11 +798,8 @@ void romdatabase_open(void)
                 if (sscanf(l.value, "%X %X%c", &search->entry.crc1,
                     &search->entry.crc2, &garbage_sweeper) == 2)
                 {
-                    /* Index CRCs by first 8 bits. */
-                    index = search->entry.crc1 >> 24;
-                    search->next_crc = g_romdatabase.crc_lists[index];
-                    g_romdatabase.crc_lists[index] = search;
                     search->entry.set_flags |= ROMDATABASE_ENTRY_CRC;
+                    search->crc_indexed = 1;
                 }
                 else
                 {
@@ -855,6 +970,16 @@ void romdatabase_open(void)
                     DebugMessage(M64MSG_WARNING, "ROM Database: Invalid AiDmaModifier on line %i", lineno);
                 }
             }
+            else if(!strcmp(l.name, "RspLle"))
+            {
+                if (strlen(l.value) < sizeof(ROM_SETTINGS.rsplle)) {
+                    free(search->entry.rsplle);
+                    search->entry.rsplle = strdup(l.value);
+                    search->entry.set_flags |= ROMDATABASE_ENTRY_RSPLLE;
+                } else {
+                    DebugMessage(M64MSG_WARNING, "ROM Database: RspLle list too long on line %i", lineno);
+                }
+            }
             else
             {
                 DebugMessage(M64MSG_WARNING, "ROM Database: Unknown property on line %i", lineno);
@@ -865,8 +990,429 @@ void romdatabase_open(void)
         }
     }
 
+    romdatabase_resolve(ini);
+}
+
+static void romdatabase_free_ini(struct romdatabase_ini* ini)
+{
+    while (ini->list != NULL)
+        {
+        romdatabase_search* search = ini->list->next_entry;
+        if(ini->list->entry.goodname)
+            free(ini->list->entry.goodname);
+        if(ini->list->entry.refmd5)
+            free(ini->list->entry.refmd5);
+        free(ini->list->entry.cheats);
+        free(ini->list->entry.rsplle);
+        free(ini->list);
+        ini->list = search;
+        }
+}
+
+/********************************************************************************************/
+/* Compiled Rom database functions */
+
+/* The resolved database is compiled into a single block, which is cached in
+ * the user cache directory and mapped as is on the following starts:
+ *   struct romdatabase_cache_header
+ *   struct romdatabase_cache_entry [entry_count]
+ *   uint32_t md5_index[index_size]
+ *   uint32_t crc_index[index_size]
+ *   string table (NUL terminated strings)
+ * Both indices are open addressing hash tables holding entry index + 1, 0
+ * for empty slots, and are at most half full. The cache is in host byte
+ * order, and is compiled again whenever the INI file changes. */
+#define ROMDATABASE_CACHE_MAGIC   "M64PRDB1"
+#define ROMDATABASE_CACHE_VERSION 1
+#define ROMDATABASE_NO_STRING     0xffffffff
+
+struct romdatabase_cache_header
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t ini_path_hash;
+    uint64_t ini_size;
+    int64_t  ini_mtime;     /* in ns, where the host has it */
+    uint32_t entry_count;
+    uint32_t index_size;
+    uint32_t md5_index_offset;
+    uint32_t crc_index_offset;
+    uint32_t strings_offset;
+    uint32_t strings_size;
+};
+
+struct romdatabase_cache_entry
+{
+    uint8_t  md5[16];
+    uint32_t crc1;
+    uint32_t crc2;
+    uint32_t goodname;  /* offsets in the string table */
+    uint32_t cheats;
+    uint32_t rsplle;
+    uint32_t sidmaduration;
+    uint32_t aidmamodifier;
+    uint32_t set_flags;
+    uint8_t  status;
+    uint8_t  savetype;
+    uint8_t  players;
+    uint8_t  rumble;
+    uint8_t  countperop;
+    uint8_t  disableextramem;
+    uint8_t  transferpak;
+    uint8_t  mempak;
+    uint8_t  biopak;
+    uint8_t  crc_indexed;
+    uint8_t  reserved[2];
+};
+
+static uint32_t romdatabase_md5_hash(const md5_byte_t* md5)
+{
+    /* MD5s are uniformly distributed already */
+    return (uint32_t)md5[0] | ((uint32_t)md5[1] << 8) | ((uint32_t)md5[2] << 16) | ((uint32_t)md5[3] << 24);
+}
+
+static uint32_t romdatabase_crc_hash(uint32_t crc1, uint32_t crc2)
+{
+    uint32_t hash = crc1 ^ (crc2 * 0x9e3779b1);
+    return hash ^ (hash >> 16);
+}
+
+static uint32_t romdatabase_add_string(char* strings, uint32_t* strings_size, const char* string)
+{
+    uint32_t offset = *strings_size;
+    size_t length;
+
+    if (string == NULL)
+        return ROMDATABASE_NO_STRING;
+
+    length = strlen(string) + 1;
+    memcpy(strings + offset, string, length);
+    *strings_size += (uint32_t)length;
+    return offset;
+}
+
+static void* romdatabase_compile(struct romdatabase_ini* ini, const struct romdatabase_cache_header* source, size_t* size)
+{
+    struct romdatabase_cache_header* header;
+    struct romdatabase_cache_entry* entries;
+    uint32_t* md5_index;
+    uint32_t* crc_index;
+    char* strings;
+    romdatabase_search* search;
+    unsigned char* data;
+    uint32_t index_size = 16;
+    uint32_t strings_size = 0;
+    uint32_t mask, slot, i;
+    size_t total;
+
+    while (index_size < 2 * ini->entry_count)
+        index_size *= 2;
+    mask = index_size - 1;
+
+    for (search = ini->list; search != NULL; search = search->next_entry)
+    {
+        if (search->entry.goodname)
+            strings_size += (uint32_t)strlen(search->entry.goodname) + 1;
+        if (search->entry.cheats)
+            strings_size += (uint32_t)strlen(search->entry.cheats) + 1;
+        if (search->entry.rsplle)
+            strings_size += (uint32_t)strlen(search->entry.rsplle) + 1;
+    }
+
+    total = sizeof(*header)
+          + ini->entry_count * sizeof(*entries)
+          + 2 * index_size * sizeof(uint32_t)
+          + strings_size;
+
+    data = calloc(1, total);
+    if (data == NULL)
+        return NULL;
+
+    header = (struct romdatabase_cache_header*)data;
+    *header = *source;
+    memcpy(header->magic, ROMDATABASE_CACHE_MAGIC, sizeof(header->magic));
+    header->version = ROMDATABASE_CACHE_VERSION;
+    header->entry_size = sizeof(*entries);
+    header->entry_count = ini->entry_count;
+    header->index_size = index_size;
+    header->md5_index_offset = (uint32_t)(sizeof(*header) + ini->entry_count * sizeof(*entries));
+    header->crc_index_offset = header->md5_index_offset + index_size * sizeof(uint32_t);
+    header->strings_offset = header->crc_index_offset + index_size * sizeof(uint32_t);
+    header->strings_size = strings_size;
+
+    entries = (struct romdatabase_cache_entry*)(data + sizeof(*header));
+    md5_index = (uint32_t*)(data + header->md5_index_offset);
+    crc_index = (uint32_t*)(data + header->crc_index_offset);
+    strings = (char*)(data + header->strings_offset);
+    strings_size = 0;
+
+    for (search = ini->list, i = 0; search != NULL; search = search->next_entry, ++i)
+    {
+        struct romdatabase_cache_entry* entry = &entries[i];
+
+        memcpy(entry->md5, search->entry.md5, 16);
+        entry->crc1 = search->entry.crc1;
+        entry->crc2 = search->entry.crc2;
+        entry->goodname = romdatabase_add_string(strings, &strings_size, search->entry.goodname);
+        entry->cheats = romdatabase_add_string(strings, &strings_size, search->entry.cheats);
+        entry->rsplle = romdatabase_add_string(strings, &strings_size, search->entry.rsplle);
+        entry->sidmaduration = search->entry.sidmaduration;
+        entry->aidmamodifier = search->entry.aidmamodifier;
+        entry->set_flags = search->entry.set_flags;
+        entry->status = search->entry.status;
+        entry->savetype = search->entry.savetype;
+        entry->players = search->entry.players;
+        entry->rumble = search->entry.rumble;
+        entry->countperop = search->entry.countperop;
+        entry->disableextramem = search->entry.disableextramem;
+        entry->transferpak = search->entry.transferpak;
+        entry->mempak = search->entry.mempak;
+        entry->biopak = search->entry.biopak;
+        entry->crc_indexed = search->crc_indexed;
+
+        /* as with the parsed lists, a later entry hides an earlier one
+         * with the same MD5 */
+        for (slot = romdatabase_md5_hash(entry->md5) & mask; md5_index[slot] != 0; slot = (slot + 1) & mask)
+        {
+            if (memcmp(entries[md5_index[slot] - 1].md5, entry->md5, 16) == 0)
+                break;
+        }
+        md5_index[slot] = i + 1;
+
+        /* CRCs can be ambiguous, all of them are indexed */
+        if (entry->crc_indexed)
+        {
+            for (slot = romdatabase_crc_hash(entry->crc1, entry->crc2) & mask; crc_index[slot] != 0; slot = (slot + 1) & mask);
+            crc_index[slot] = i + 1;
+        }
+    }
+
+    *size = total;
+    return data;
+}
+
+static char* romdatabase_string(const char* strings, uint32_t offset)
+{
+    return (offset == ROMDATABASE_NO_STRING) ? NULL : (char*)(strings + offset);
+}
+
+/* Checks a compiled database against the INI file it should come from, and
+ * sets it up for lookups. The strings of the entries point into data. */
+static int romdatabase_load(void* data, size_t size, const struct romdatabase_cache_header* source)
+{
+    const struct romdatabase_cache_header* header = (const struct romdatabase_cache_header*)data;
+    const struct romdatabase_cache_entry* entries;
+    const uint32_t* md5_index;
+    const uint32_t* crc_index;
+    const char* strings;
+    romdatabase_entry* loaded;
+    uint64_t md5_index_offset;
+    uint32_t md5_used = 0, crc_used = 0;
+    uint32_t i;
+
+    if (size < sizeof(*header)
+     || memcmp(header->magic, ROMDATABASE_CACHE_MAGIC, sizeof(header->magic)) != 0
+     || header->version != ROMDATABASE_CACHE_VERSION
+     || header->entry_size != sizeof(*entries)
+     || header->ini_path_hash != source->ini_path_hash
+     || header->ini_size != source->ini_size
+     || header->ini_mtime != source->ini_mtime)
+        return 0;
+
+    md5_index_offset = sizeof(*header) + (uint64_t)header->entry_count * sizeof(*entries);
+    if (header->index_size == 0
+     || (header->index_size & (header->index_size - 1)) != 0
+     || header->entry_count >= header->index_size
+     || header->md5_index_offset != md5_index_offset
+     || header->crc_index_offset != md5_index_offset + (uint64_t)header->index_size * sizeof(uint32_t)
+     || header->strings_offset != header->crc_index_offset + (uint64_t)header->index_size * sizeof(uint32_t)
+     || (uint64_t)header->strings_offset + header->strings_size != size
+     || (header->strings_size > 0 && ((const char*)data)[size - 1] != '\0'))
+        return 0;
+
+    entries = (const struct romdatabase_cache_entry*)((const unsigned char*)data + sizeof(*header));
+    md5_index = (const uint32_t*)((const unsigned char*)data + header->md5_index_offset);
+    crc_index = (const uint32_t*)((const unsigned char*)data + header->crc_index_offset);
+    strings = (const char*)data + header->strings_offset;
+
+    for (i = 0; i < header->index_size; ++i)
+    {
+        if (md5_index[i] > header->entry_count || crc_index[i] > header->entry_count)
+            return 0;
+        md5_used += (md5_index[i] != 0);
+        crc_used += (crc_index[i] != 0);
+    }
+
+    /* lookups probe until an empty slot */
+    if (md5_used == header->index_size || crc_used == header->index_size)
+        return 0;
+
+    loaded = malloc((header->entry_count + 1) * sizeof(*loaded));
+    if (loaded == NULL)
+        return 0;
+
+    for (i = 0; i < header->entry_count; ++i)
+    {
+        const struct romdatabase_cache_entry* entry = &entries[i];
+
+        if ((entry->goodname != ROMDATABASE_NO_STRING && entry->goodname >= header->strings_size)
+         || (entry->cheats != ROMDATABASE_NO_STRING && entry->cheats >= header->strings_size)
+         || (entry->rsplle != ROMDATABASE_NO_STRING && entry->rsplle >= header->strings_size))
+        {
+            free(loaded);
+            return 0;
+        }
+
+        loaded[i].goodname = romdatabase_string(strings, entry->goodname);
+        memcpy(loaded[i].md5, entry->md5, 16);
+        loaded[i].refmd5 = NULL;
+        loaded[i].cheats = romdatabase_string(strings, entry->cheats);
+        loaded[i].crc1 = entry->crc1;
+        loaded[i].crc2 = entry->crc2;
+        loaded[i].status = entry->status;
+        loaded[i].savetype = entry->savetype;
+        loaded[i].players = entry->players;
+        loaded[i].rumble = entry->rumble;
+        loaded[i].countperop = entry->countperop;
+        loaded[i].disableextramem = entry->disableextramem;
+        loaded[i].transferpak = entry->transferpak;
+        loaded[i].mempak = entry->mempak;
+        loaded[i].biopak = entry->biopak;
+        loaded[i].sidmaduration = entry->sidmaduration;
+        loaded[i].aidmamodifier = entry->aidmamodifier;
+        loaded[i].rsplle = romdatabase_string(strings, entry->rsplle);
+        loaded[i].set_flags = entry->set_flags;
+    }
+
+    g_romdatabase.entries = loaded;
+    g_romdatabase.entry_count = header->entry_count;
+    g_romdatabase.md5_index = md5_index;
+    g_romdatabase.crc_index = crc_index;
+    g_romdatabase.index_mask = header->index_size - 1;
+    g_romdatabase.data = data;
+    g_romdatabase.data_size = size;
+    return 1;
+}
+
+static char* romdatabase_cache_path(void)
+{
+    const char* cache_dir = ConfigGetUserCachePath();
+    if (cache_dir == NULL)
+        return NULL;
+
+    osal_mkdirp(cache_dir, 0700);
+    return combinepath(cache_dir, "mupen64plus.ini.db");
+}
+
+static int romdatabase_load_cache(const char* path, const struct romdatabase_cache_header* source)
+{
+    void* data;
+    size_t size;
+#if !defined(WIN32)
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return 0;
+
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(*source))
+    {
+        close(fd);
+        return 0;
+    }
+
+    size = (size_t)st.st_size;
+    data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return 0;
+
+    if (!romdatabase_load(data, size, source))
+    {
+        munmap(data, size);
+        return 0;
+    }
+
+    g_romdatabase.data_mapped = 1;
+#else
+    if (load_file(path, &data, &size) != file_ok)
+        return 0;
+
+    if (!romdatabase_load(data, size, source))
+    {
+        free(data);
+        return 0;
+    }
+#endif
+
+    return 1;
+}
+
+void romdatabase_open(void)
+{
+    FILE *fPtr;
+    struct romdatabase_cache_header source;
+    struct romdatabase_ini ini;
+    char* cache_path = NULL;
+    void* data;
+    size_t size;
+    const char *pathname = ConfigGetSharedDataFilepath("mupen64plus.ini");
+
+    if(g_romdatabase.have_database)
+        return;
+
+    if (pathname == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "Unable to open rom database file '%s'.", pathname);
+        return;
+    }
+
+    memset(&source, 0, sizeof(source));
+    source.ini_path_hash = XXH3_64bits(pathname, strlen(pathname));
+
+    /* Use the compiled database if the INI file hasn't changed. When its
+     * size and time can't be read, the INI file is parsed every time. */
+    if (osal_file_info(pathname, &source.ini_size, &source.ini_mtime) == 0)
+    {
+        cache_path = romdatabase_cache_path();
+        if (cache_path != NULL && romdatabase_load_cache(cache_path, &source))
+        {
+            free(cache_path);
+            g_romdatabase.have_database = 1;
+            return;
+        }
+    }
+
+    /* Open romdatabase. */
+    if ((fPtr = osal_file_open(pathname, "rb")) == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "Unable to open rom database file '%s'.", pathname);
+        free(cache_path);
+        return;
+    }
+
+    romdatabase_parse_ini(fPtr, &ini);
     fclose(fPtr);
-    romdatabase_resolve();
+
+    data = romdatabase_compile(&ini, &source, &size);
+    romdatabase_free_ini(&ini);
+
+    if (data == NULL || !romdatabase_load(data, size, &source))
+    {
+        DebugMessage(M64MSG_ERROR, "Unable to compile rom database file '%s'.", pathname);
+        free(data);
+        free(cache_path);
+        return;
+    }
+
+    /* Compiling the same INI file always gives the same result, so
+     * concurrent instances writing the cache can't corrupt it. */
+    if (cache_path != NULL && write_to_file_atomic(cache_path, data, size) != file_ok)
+        DebugMessage(M64MSG_WARNING, "Unable to write rom database cache '%s'.", cache_path);
+    free(cache_path);
+
+    g_romdatabase.have_database = 1;
 }
 
 void romdatabase_close(void)
@@ -874,64 +1420,58 @@ void romdatabase_close(void)
     if (!g_romdatabase.have_database)
         return;
 
-    while (g_romdatabase.list != NULL)
-        {
-        romdatabase_search* search = g_romdatabase.list->next_entry;
-        if(g_romdatabase.list->entry.goodname)
-            free(g_romdatabase.list->entry.goodname);
-        if(g_romdatabase.list->entry.refmd5)
-            free(g_romdatabase.list->entry.refmd5);
-        free(g_romdatabase.list->entry.cheats);
-        free(g_romdatabase.list);
-        g_romdatabase.list = search;
-        }
+    free(g_romdatabase.entries);
+#if !defined(WIN32)
+    if (g_romdatabase.data_mapped)
+        munmap(g_romdatabase.data, g_romdatabase.data_size);
+    else
+#endif
+        free(g_romdatabase.data);
 
-    g_romdatabase.have_database = 0;
+    memset(&g_romdatabase, 0, sizeof(g_romdatabase));
 }
 
 static romdatabase_entry* ini_search_by_md5(md5_byte_t* md5)
 {
-    romdatabase_search* search;
+    uint32_t slot, index;
 
     if(!g_romdatabase.have_database)
         return NULL;
 
-    search = g_romdatabase.md5_lists[md5[0]];
-
-    while (search != NULL && memcmp(search->entry.md5, md5, 16) != 0)
-        search = search->next_md5;
-
-    if(search==NULL)
-        return NULL;
+    for (slot = romdatabase_md5_hash(md5) & g_romdatabase.index_mask;
+         (index = g_romdatabase.md5_index[slot]) != 0;
+         slot = (slot + 1) & g_romdatabase.index_mask)
+    {
+        if (memcmp(g_romdatabase.entries[index - 1].md5, md5, 16) == 0)
+            return &g_romdatabase.entries[index - 1];
+    }
 
-    return &(search->entry);
+    return NULL;
 }
 
 romdatabase_entry* ini_search_by_crc(unsigned int crc1, unsigned int crc2)
 {
-    romdatabase_search* search;
     romdatabase_entry* found_entry = NULL;
+    uint32_t slot, index;
 
     if(!g_romdatabase.have_database) 
         return NULL;
 
-    search = g_romdatabase.crc_lists[((crc1 >> 24) & 0xff)];
-
     // because CRCs can be ambiguous (there can be multiple database entries with the same CRC),
     // we will prefer MD5 hashes instead. If the given CRC matches more than one entry in the
     // database, we will return no match.
-    while (search != NULL)
+    for (slot = romdatabase_crc_hash(crc1, crc2) & g_romdatabase.index_mask;
+         (index = g_romdatabase.crc_index[slot]) != 0;
+         slot = (slot + 1) & g_romdatabase.index_mask)
     {
-        if (search->entry.crc1 == crc1 && search->entry.crc2 == crc2)
+        romdatabase_entry* entry = &g_romdatabase.entries[index - 1];
+        if (entry->crc1 == crc1 && entry->crc2 == crc2)
         {
             if (found_entry != NULL)
                 return NULL;
-            found_entry = &search->entry;
+            found_entry = entry;
         }
-        search = search->next_crc;
     }
 
     return found_entry;
 }
-
-
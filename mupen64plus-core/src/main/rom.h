@@ -117,6 +117,7 @@ typedef struct
    unsigned char biopak; /* 0 - No, 1 - Yes boolean for biopak support. */
    unsigned int sidmaduration;
    unsigned int aidmamodifier;
+   char *rsplle;
    uint32_t set_flags;
 } romdatabase_entry;
 
@@ -135,21 +136,31 @@ typedef struct
 #define ROMDATABASE_ENTRY_BIOPAK        BIT(11)
 #define ROMDATABASE_ENTRY_SIDMADURATION BIT(12)
 #define ROMDATABASE_ENTRY_AIDMAMODIFIER BIT(13)
+#define ROMDATABASE_ENTRY_RSPLLE        BIT(14)
 
+/* Entries as parsed from the INI file, before being compiled */
 typedef struct _romdatabase_search
 {
     romdatabase_entry entry;
     struct _romdatabase_search* next_entry;
-    struct _romdatabase_search* next_crc;
     struct _romdatabase_search* next_md5;
+    int crc_indexed; /* CRC given in the entry itself, not by its RefMD5 */
 } romdatabase_search;
 
+/* The compiled database is a single block of memory, mapped from a cache
+ * file when the INI file hasn't changed since it was compiled. Lookups go
+ * through open addressing hash tables on the MD5 and on the CRCs. */
 typedef struct
 {
     int have_database;
-    romdatabase_search* crc_lists[256];
-    romdatabase_search* md5_lists[256];
-    romdatabase_search* list;
+    romdatabase_entry* entries;
+    uint32_t entry_count;
+    const uint32_t* md5_index;  /* entry index + 1 of each slot, 0 if empty */
+    const uint32_t* crc_index;
+    uint32_t index_mask;
+    void* data;
+    size_t data_size;
+    int data_mapped;
 } _romdatabase;
 
 void romdatabase_open(void);
@@ -22,8 +22,6 @@
  *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-#include <SDL.h>
-#include <SDL_thread.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -47,6 +45,7 @@
 #include "osal/preproc.h"
 #include "osd/osd.h"
 #include "plugin/plugin.h"
+#include "profile.h"
 #include "rom.h"
 #include "savestates.h"
 #include "util.h"
@@ -67,13 +66,63 @@ static char *fname = NULL;
 
 static unsigned int slot = 0;
 static int autoinc_save_slot = 0;
+static int compression_level = 1;
+
+/* Tracks the Mupen64Plus savestates still being written */
+static struct work_fence *savestates_fence;
+
+PROFILE_SECTION(profile_load, "load", "savestate");
+PROFILE_SECTION(profile_save, "save", "savestate");
+
+/* Mupen64Plus savestates are written as a sequence of independent gzip
+ * members, one per chunk of state data. Each member carries an 'MP' extra
+ * subfield holding its total size, so chunks can be located without
+ * inflating the previous ones and can be (de)compressed in parallel.
+ * The result is still a valid multi-member gzip stream. */
+enum { SAVESTATE_CHUNK_SIZE = 256 * 1024 };
+enum { SAVESTATE_CHUNK_HEADER_SIZE = 20 };
+enum { SAVESTATE_CHUNK_TRAILER_SIZE = 8 };
+enum { SAVESTATE_M64P_MAX_SIZE = 16788288 + 1024 + 4 + 4096 };
+
+static const unsigned char savestate_chunk_header[SAVESTATE_CHUNK_HEADER_SIZE - 4] = {
+    0x1f, 0x8b, 0x08, 0x04,     /* gzip magic, deflate, FEXTRA */
+    0x00, 0x00, 0x00, 0x00,     /* no mtime */
+    0x00, 0xff,                 /* no extra flags, unknown OS */
+    0x08, 0x00,                 /* XLEN */
+    'M', 'P', 0x04, 0x00        /* subfield id and length, followed by the member size */
+};
+
+struct savestate_work;
 
-static SDL_mutex *savestates_lock;
+struct savestate_chunk {
+    struct savestate_work *save;
+    const unsigned char *src;
+    size_t src_size;
+    unsigned char *dst;
+    size_t dst_size;
+    int failed;
+    struct work_struct work;
+};
 
 struct savestate_work {
     char *filepath;
     char *data;
     size_t size;
+    int level;
+    size_t chunk_count;
+    struct savestate_chunk *chunks;
+    /* the file is written once all chunks are compressed */
+    struct work_fence *fence;
+    struct work_struct work;
+};
+
+struct savestate_inflate_chunk {
+    const unsigned char *src;
+    size_t src_size;
+    unsigned char *dst;
+    size_t dst_size;
+    uint32_t crc;
+    int failed;
     struct work_struct work;
 };
 
@@ -138,6 +187,14 @@ void savestates_set_autoinc_slot(int b)
     autoinc_save_slot = b;
 }
 
+/* Sets the zlib compression level (-1 to 9) used for Mupen64Plus savestates. */
+void savestates_set_compression_level(int level)
+{
+    if (level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION)
+        level = Z_DEFAULT_COMPRESSION;
+    compression_level = level;
+}
+
 void savestates_inc_slot(void)
 {
     if(++slot>9)
@@ -185,47 +242,249 @@ static void savestates_clear_job(void)
 #define PUTDATA(buff, type, value) \
     do { type x = value; PUTARRAY(&x, buff, type, 1); } while(0)
 
+static void savestates_inflate_chunk_work(struct work_struct *work)
+{
+    struct savestate_inflate_chunk *chunk = container_of(work, struct savestate_inflate_chunk, work);
+    z_stream strm;
+    int ok = 0;
+
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, -MAX_WBITS) == Z_OK)
+    {
+        strm.next_in = (Bytef *)chunk->src;
+        strm.avail_in = (uInt)chunk->src_size;
+        strm.next_out = chunk->dst;
+        strm.avail_out = (uInt)chunk->dst_size;
+
+        ok = inflate(&strm, Z_FINISH) == Z_STREAM_END
+          && strm.total_out == chunk->dst_size
+          && crc32(0L, chunk->dst, (uInt)chunk->dst_size) == chunk->crc;
+
+        inflateEnd(&strm);
+    }
+
+    chunk->failed = !ok;
+}
+
+/* Walks the chunk members of a savestate file.
+ * Returns the number of chunks, or 0 if the data isn't a well-formed chunked savestate.
+ * If chunks is not NULL, it is filled with the location of each chunk. */
+static size_t savestates_scan_chunks(const unsigned char *src, size_t src_size,
+                                     struct savestate_inflate_chunk *chunks, size_t *total_size)
+{
+    size_t count = 0;
+    size_t offset = 0;
+    size_t total = 0;
+    size_t member_size, isize;
+
+    while (offset < src_size)
+    {
+        if (src_size - offset < SAVESTATE_CHUNK_HEADER_SIZE + SAVESTATE_CHUNK_TRAILER_SIZE
+         || memcmp(src + offset, savestate_chunk_header, sizeof(savestate_chunk_header)) != 0)
+            return 0;
+
+        member_size = load_leu32(src + offset + sizeof(savestate_chunk_header));
+        if (member_size < SAVESTATE_CHUNK_HEADER_SIZE + SAVESTATE_CHUNK_TRAILER_SIZE
+         || member_size > src_size - offset)
+            return 0;
+
+        isize = load_leu32(src + offset + member_size - 4);
+        if (isize > SAVESTATE_M64P_MAX_SIZE - total)
+            return 0;
+
+        if (chunks != NULL)
+        {
+            chunks[count].src = src + offset + SAVESTATE_CHUNK_HEADER_SIZE;
+            chunks[count].src_size = member_size - SAVESTATE_CHUNK_HEADER_SIZE - SAVESTATE_CHUNK_TRAILER_SIZE;
+            chunks[count].dst_size = isize;
+            chunks[count].crc = load_leu32(src + offset + member_size - 8);
+        }
+
+        total += isize;
+        offset += member_size;
+        ++count;
+    }
+
+    *total_size = total;
+    return count;
+}
+
+/* Inflates a chunked savestate, distributing the chunks over the workqueue. */
+static unsigned char *savestates_inflate_chunked(const unsigned char *src, size_t src_size, size_t count, size_t *size)
+{
+    struct work_fence *fence;
+    struct savestate_inflate_chunk *chunks;
+    unsigned char *data;
+    size_t i, offset;
+
+    chunks = malloc(count * sizeof(*chunks));
+    data = malloc(SAVESTATE_M64P_MAX_SIZE);
+    fence = work_fence_create(NULL);
+    if (chunks == NULL || data == NULL || fence == NULL)
+    {
+        free(chunks);
+        free(data);
+        work_fence_destroy(fence);
+        return NULL;
+    }
+
+    savestates_scan_chunks(src, src_size, chunks, size);
+
+    for (i = 0, offset = 0; i < count; ++i)
+    {
+        chunks[i].dst = data + offset;
+        chunks[i].failed = 0;
+        offset += chunks[i].dst_size;
+        init_work(&chunks[i].work, savestates_inflate_chunk_work);
+        /* the emulation thread is waiting for these */
+        chunks[i].work.priority = WORK_PRIORITY_HIGH;
+        work_fence_add(fence, &chunks[i].work);
+    }
+
+    for (i = 0; i < count; ++i)
+        queue_work(&chunks[i].work);
+
+    work_fence_wait(fence);
+    work_fence_destroy(fence);
+
+    for (i = 0; i < count; ++i)
+    {
+        if (chunks[i].failed)
+        {
+            free(data);
+            data = NULL;
+            break;
+        }
+    }
+
+    free(chunks);
+    return data;
+}
+
+/* Inflates a plain (possibly multi-member) gzip savestate, as written by older versions. */
+static unsigned char *savestates_inflate_gzip(const unsigned char *src, size_t src_size, size_t *size)
+{
+    z_stream strm;
+    unsigned char *data;
+    int ret;
+
+    data = malloc(SAVESTATE_M64P_MAX_SIZE);
+    if (data == NULL)
+        return NULL;
+
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, MAX_WBITS + 16) != Z_OK)
+    {
+        free(data);
+        return NULL;
+    }
+
+    strm.next_in = (Bytef *)src;
+    strm.avail_in = (uInt)src_size;
+    strm.next_out = data;
+    strm.avail_out = SAVESTATE_M64P_MAX_SIZE;
+
+    do
+    {
+        ret = inflate(&strm, Z_NO_FLUSH);
+        /* Like gzread, continue with the next member and ignore trailing garbage */
+        if (ret == Z_STREAM_END && strm.avail_out > 0
+         && strm.avail_in >= 2 && strm.next_in[0] == 0x1f && strm.next_in[1] == 0x8b)
+            ret = inflateReset(&strm);
+        else
+            break;
+    } while (ret == Z_OK);
+
+    inflateEnd(&strm);
+
+    /* A truncated stream is reported by the size checks of the caller */
+    if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+    {
+        free(data);
+        return NULL;
+    }
+
+    *size = SAVESTATE_M64P_MAX_SIZE - strm.avail_out;
+    return data;
+}
+
+/* Reads and inflates a Mupen64Plus savestate file into a newly allocated buffer. */
+static file_status_t savestates_read_m64p(const char *filepath, unsigned char **data, size_t *size)
+{
+    void *src;
+    size_t src_size, total_size, count;
+    file_status_t status;
+
+    /* Make sure no savestate is still being written */
+    if (savestates_fence != NULL)
+        work_fence_wait(savestates_fence);
+
+    status = load_file(filepath, &src, &src_size);
+
+    if (status != file_ok)
+        return status;
+
+    count = savestates_scan_chunks(src, src_size, NULL, &total_size);
+    *data = (count > 0)
+        ? savestates_inflate_chunked(src, src_size, count, size)
+        : savestates_inflate_gzip(src, src_size, size);
+
+    free(src);
+    return (*data != NULL) ? file_ok : file_read_error;
+}
+
+/* Returns the next 'length' bytes of state data, or NULL if there isn't enough data left. */
+static unsigned char *savestates_take(unsigned char **curr, const unsigned char *end, size_t length)
+{
+    unsigned char *ptr = *curr;
+
+    if ((size_t)(end - ptr) < length)
+        return NULL;
+
+    *curr += length;
+    return ptr;
+}
+
 static int savestates_load_m64p(struct device* dev, char *filepath)
 {
-    unsigned char header[44];
-    gzFile f;
     unsigned int version;
     int i;
     uint32_t FCR31;
 
-    size_t savestateSize;
-    unsigned char *savestateData, *curr;
+    size_t savestateSize, size, queueSize;
+    unsigned char *data, *end, *savestateData, *curr;
     char queue[1024];
     unsigned char using_tlb_data[4];
     unsigned char data_0001_0200[4096]; // 4k for extra state from v1.2
 
     uint32_t* cp0_regs = r4300_cp0_regs(&dev->r4300.cp0);
 
-    SDL_LockMutex(savestates_lock);
-
-    f = osal_gzopen(filepath, "rb");
-    if(f==NULL)
+    switch (savestates_read_m64p(filepath, &data, &size))
     {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not open state file: %s", filepath);
-        SDL_UnlockMutex(savestates_lock);
-        return 0;
+        case file_ok:
+            break;
+        case file_open_error:
+            main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not open state file: %s", filepath);
+            return 0;
+        default:
+            main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not decompress state file: %s", filepath);
+            return 0;
     }
+    curr = data;
+    end = data + size;
 
     /* Read and check Mupen64Plus magic number. */
-    if (gzread(f, header, 44) != 44)
+    if (size < 44)
     {
         main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read header from state file %s", filepath);
-        gzclose(f);
-        SDL_UnlockMutex(savestates_lock);
+        free(data);
         return 0;
     }
-    curr = header;
 
     if(strncmp((char *)curr, savestate_magic, 8)!=0)
     {
         main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State file: %s is not a valid Mupen64plus savestate.", filepath);
-        gzclose(f);
-        SDL_UnlockMutex(savestates_lock);
+        free(data);
         return 0;
     }
     curr += 8;
@@ -237,72 +496,59 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
     if((version >> 16) != (savestate_latest_version >> 16))
     {
         main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State version (%08x) isn't compatible. Please update Mupen64Plus.", version);
-        gzclose(f);
-        SDL_UnlockMutex(savestates_lock);
+        free(data);
         return 0;
     }
 
     if(memcmp((char *)curr, ROM_SETTINGS.MD5, 32))
     {
         main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State ROM MD5 does not match current ROM.");
-        gzclose(f);
-        SDL_UnlockMutex(savestates_lock);
+        free(data);
         return 0;
     }
-    curr += 32;
 
-    /* Read the rest of the savestate */
+    /* The rest of the savestate is parsed in place */
+    curr = data + 44;
     savestateSize = 16788244;
-    savestateData = curr = (unsigned char *)malloc(savestateSize);
-    if (savestateData == NULL)
-    {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Insufficient memory to load state.");
-        gzclose(f);
-        SDL_UnlockMutex(savestates_lock);
-        return 0;
-    }
+    savestateData = savestates_take(&curr, end, savestateSize);
     if (version == 0x00010000) /* original savestate version */
     {
-        if (gzread(f, savestateData, savestateSize) != (int)savestateSize ||
-            (gzread(f, queue, sizeof(queue)) % 4) != 0)
+        queueSize = (size_t)(end - curr);
+        if (queueSize > sizeof(queue))
+            queueSize = sizeof(queue);
+        if (savestateData == NULL || (queueSize % 4) != 0)
         {
             main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read Mupen64Plus savestate 1.0 data from %s", filepath);
-            free(savestateData);
-            gzclose(f);
-            SDL_UnlockMutex(savestates_lock);
+            free(data);
             return 0;
         }
+        memcpy(queue, curr, queueSize);
     }
     else if (version == 0x00010100) // saves entire eventqueue plus 4-byte using_tlb flags
     {
-        if (gzread(f, savestateData, savestateSize) != (int)savestateSize ||
-            gzread(f, queue, sizeof(queue)) != sizeof(queue) ||
-            gzread(f, using_tlb_data, sizeof(using_tlb_data)) != sizeof(using_tlb_data))
+        if (savestateData == NULL || (size_t)(end - curr) < sizeof(queue) + sizeof(using_tlb_data))
         {
             main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read Mupen64Plus savestate 1.1 data from %s", filepath);
-            free(savestateData);
-            gzclose(f);
-            SDL_UnlockMutex(savestates_lock);
+            free(data);
             return 0;
         }
+        memcpy(queue, savestates_take(&curr, end, sizeof(queue)), sizeof(queue));
+        memcpy(using_tlb_data, savestates_take(&curr, end, sizeof(using_tlb_data)), sizeof(using_tlb_data));
     }
     else // version >= 0x00010200  saves entire eventqueue, 4-byte using_tlb flags and extra state
     {
-        if (gzread(f, savestateData, savestateSize) != (int)savestateSize ||
-            gzread(f, queue, sizeof(queue)) != sizeof(queue) ||
-            gzread(f, using_tlb_data, sizeof(using_tlb_data)) != sizeof(using_tlb_data) ||
-            gzread(f, data_0001_0200, sizeof(data_0001_0200)) != sizeof(data_0001_0200))
+        if (savestateData == NULL || (size_t)(end - curr) < sizeof(queue) + sizeof(using_tlb_data) + sizeof(data_0001_0200))
         {
             main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read Mupen64Plus savestate 1.2+ data from %s", filepath);
-            free(savestateData);
-            gzclose(f);
-            SDL_UnlockMutex(savestates_lock);
+            free(data);
             return 0;
         }
+        memcpy(queue, savestates_take(&curr, end, sizeof(queue)), sizeof(queue));
+        memcpy(using_tlb_data, savestates_take(&curr, end, sizeof(using_tlb_data)), sizeof(using_tlb_data));
+        memcpy(data_0001_0200, savestates_take(&curr, end, sizeof(data_0001_0200)), sizeof(data_0001_0200));
     }
 
-    gzclose(f);
-    SDL_UnlockMutex(savestates_lock);
+    curr = savestateData;
 
     // Parse savestate
     dev->rdram.regs[0][RDRAM_CONFIG_REG]       = GETDATA(curr, uint32_t);
@@ -954,7 +1200,7 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
 
     *r4300_cp0_last_addr(&dev->r4300.cp0) = *r4300_pc(&dev->r4300);
 
-    free(savestateData);
+    free(data);
     main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State loaded from: %s", namefrompath(filepath));
     return 1;
 }
@@ -1404,6 +1650,9 @@ int savestates_load(void)
     char *filepath = NULL;
     int ret = 0;
 
+    /* don't let a pending RSP task write over the loaded RDRAM */
+    rsp.syncRspTasks();
+
     if (fname == NULL) // For slots, autodetect the savestate type
     {
         // try M64P type first
@@ -1458,6 +1707,8 @@ int savestates_load(void)
     if (filepath != NULL)
     {
         struct device* dev = &g_dev;
+        struct profile_mark mark;
+        profile_start(&mark);
 
         switch (type)
         {
@@ -1466,6 +1717,7 @@ int savestates_load(void)
             case savestates_type_pj64_unc: ret = savestates_load_pj64_unc(dev, filepath); break;
             default: ret = 0; break;
         }
+        profile_end(&profile_load, &mark);
         free(filepath);
         filepath = NULL;
     }
@@ -1478,40 +1730,149 @@ int savestates_load(void)
     return ret;
 }
 
+static int savestates_deflate_chunk(struct savestate_chunk *chunk, int level)
+{
+    z_stream strm;
+    uLong bound;
+    unsigned char *trailer;
+    int ret;
+
+    memset(&strm, 0, sizeof(strm));
+    if (deflateInit2(&strm, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return 0;
+
+    bound = deflateBound(&strm, (uLong)chunk->src_size);
+    chunk->dst = malloc(SAVESTATE_CHUNK_HEADER_SIZE + bound + SAVESTATE_CHUNK_TRAILER_SIZE);
+    if (chunk->dst == NULL)
+    {
+        deflateEnd(&strm);
+        return 0;
+    }
+
+    strm.next_in = (Bytef *)chunk->src;
+    strm.avail_in = (uInt)chunk->src_size;
+    strm.next_out = chunk->dst + SAVESTATE_CHUNK_HEADER_SIZE;
+    strm.avail_out = (uInt)bound;
+
+    ret = deflate(&strm, Z_FINISH);
+    deflateEnd(&strm);
+    if (ret != Z_STREAM_END)
+        return 0;
+
+    chunk->dst_size = SAVESTATE_CHUNK_HEADER_SIZE + strm.total_out + SAVESTATE_CHUNK_TRAILER_SIZE;
+
+    memcpy(chunk->dst, savestate_chunk_header, sizeof(savestate_chunk_header));
+    store_leu32((uint32_t)chunk->dst_size, chunk->dst + sizeof(savestate_chunk_header));
+
+    trailer = chunk->dst + chunk->dst_size - SAVESTATE_CHUNK_TRAILER_SIZE;
+    store_leu32((uint32_t)crc32(0L, chunk->src, (uInt)chunk->src_size), trailer);
+    store_leu32((uint32_t)chunk->src_size, trailer + 4);
+
+    return 1;
+}
+
+static void savestates_deflate_chunk_work(struct work_struct *work)
+{
+    struct savestate_chunk *chunk = container_of(work, struct savestate_chunk, work);
+
+    chunk->failed = !savestates_deflate_chunk(chunk, chunk->save->level);
+}
+
+/* Writes the compressed chunks to the state file and releases the save job.
+ * Queued once all the chunks are compressed. */
 static void savestates_save_m64p_work(struct work_struct *work)
 {
-    gzFile f;
-    int gzres;
     struct savestate_work *save = container_of(work, struct savestate_work, work);
+    FILE *f = NULL;
+    size_t i;
 
-    SDL_LockMutex(savestates_lock);
-
-    // Write the state to a GZIP file
-    f = osal_gzopen(save->filepath, "wb");
+    for (i = 0; i < save->chunk_count; ++i)
+    {
+        if (save->chunks[i].failed)
+        {
+            main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not compress state data for: %s", save->filepath);
+            goto cleanup;
+        }
+    }
 
-    if (f==NULL)
+    f = osal_file_open(save->filepath, "wb");
+    if (f == NULL)
     {
         main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not open state file: %s", save->filepath);
-        free(save->data);
-        return;
+        goto cleanup;
+    }
+
+    for (i = 0; i < save->chunk_count; ++i)
+    {
+        if (fwrite(save->chunks[i].dst, 1, save->chunks[i].dst_size, f) != save->chunks[i].dst_size)
+        {
+            main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not write data to state file: %s", save->filepath);
+            goto cleanup;
+        }
     }
 
-    gzres = gzwrite(f, save->data, save->size);
-    if ((gzres < 0) || ((size_t)gzres != save->size))
+    if (fclose(f) != 0)
     {
+        f = NULL;
         main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not write data to state file: %s", save->filepath);
-        gzclose(f);
-        free(save->data);
-        return;
+        goto cleanup;
     }
+    f = NULL;
 
-    gzclose(f);
     main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Saved state to: %s", namefrompath(save->filepath));
+
+cleanup:
+    if (f != NULL)
+        fclose(f);
+    for (i = 0; i < save->chunk_count; ++i)
+        free(save->chunks[i].dst);
+    free(save->chunks);
+    work_fence_destroy(save->fence);
     free(save->data);
     free(save->filepath);
     free(save);
+}
 
-    SDL_UnlockMutex(savestates_lock);
+/* Splits the state data into chunks and compresses them on the workqueue. */
+static int savestates_queue_m64p(struct savestate_work *save)
+{
+    struct savestate_chunk *chunks;
+    size_t i, count;
+
+    count = (save->size + SAVESTATE_CHUNK_SIZE - 1) / SAVESTATE_CHUNK_SIZE;
+    chunks = malloc(count * sizeof(*chunks));
+    save->fence = work_fence_create(&save->work);
+    if (chunks == NULL || save->fence == NULL)
+    {
+        free(chunks);
+        work_fence_destroy(save->fence);
+        return 0;
+    }
+
+    save->level = compression_level;
+    save->chunk_count = count;
+    save->chunks = chunks;
+    init_work(&save->work, savestates_save_m64p_work);
+    if (savestates_fence != NULL)
+        work_fence_add(savestates_fence, &save->work);
+
+    for (i = 0; i < count; ++i)
+    {
+        chunks[i].save = save;
+        chunks[i].src = (const unsigned char *)save->data + i * SAVESTATE_CHUNK_SIZE;
+        chunks[i].src_size = (i + 1 < count) ? SAVESTATE_CHUNK_SIZE : save->size - i * SAVESTATE_CHUNK_SIZE;
+        chunks[i].dst = NULL;
+        chunks[i].dst_size = 0;
+        chunks[i].failed = 0;
+        init_work(&chunks[i].work, savestates_deflate_chunk_work);
+        work_fence_add(save->fence, &chunks[i].work);
+    }
+
+    /* save may be released as soon as the last chunk is queued */
+    for (i = 0; i < count; ++i)
+        queue_work(&chunks[i].work);
+
+    return 1;
 }
 
 static int savestates_save_m64p(const struct device* dev, char *filepath)
@@ -1910,8 +2271,14 @@ static int savestates_save_m64p(const struct device* dev, char *filepath)
     PUTDATA(curr, uint64_t, *r4300_cp0_latch((struct cp0*)&dev->r4300.cp0));
     PUTDATA(curr, uint64_t, *r4300_cp2_latch((struct cp2*)&dev->r4300.cp2));
 
-    init_work(&save->work, savestates_save_m64p_work);
-    queue_work(&save->work);
+    if (!savestates_queue_m64p(save))
+    {
+        free(save->data);
+        free(save->filepath);
+        free(save);
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Insufficient memory to save state.");
+        return 0;
+    }
 
     return 1;
 }
@@ -2164,6 +2531,8 @@ int savestates_save(void)
         get_next_event_type(&dev->r4300.cp0.q) > COMPARE_INT)
         return 0;
 
+    rsp.syncRspTasks();
+
     if (fname != NULL && type == savestates_type_unknown)
         type = savestates_type_m64p;
     else if (fname == NULL) // Always save slots in M64P format
@@ -2172,6 +2541,9 @@ int savestates_save(void)
     filepath = savestates_generate_path(type);
     if (filepath != NULL)
     {
+        struct profile_mark mark;
+        profile_start(&mark);
+
         switch (type)
         {
             case savestates_type_m64p: ret = savestates_save_m64p(dev, filepath); break;
@@ -2179,6 +2551,7 @@ int savestates_save(void)
             case savestates_type_pj64_unc: ret = savestates_save_pj64_unc(dev, filepath); break;
             default: ret = 0; break;
         }
+        profile_end(&profile_save, &mark);
         free(filepath);
     }
 
@@ -2191,15 +2564,19 @@ int savestates_save(void)
 
 void savestates_init(void)
 {
-    savestates_lock = SDL_CreateMutex();
-    if (!savestates_lock) {
-        DebugMessage(M64MSG_ERROR, "Could not create savestates list lock");
+    savestates_fence = work_fence_create(NULL);
+    if (!savestates_fence) {
+        DebugMessage(M64MSG_ERROR, "Could not create savestates fence");
         return;
     }
 }
 
 void savestates_deinit(void)
 {
-    SDL_DestroyMutex(savestates_lock);
+    if (savestates_fence) {
+        work_fence_wait(savestates_fence);
+        work_fence_destroy(savestates_fence);
+        savestates_fence = NULL;
+    }
     savestates_clear_job();
 }
@@ -51,6 +51,7 @@ int savestates_save(void);
 void savestates_select_slot(unsigned int s);
 unsigned int savestates_get_slot(void);
 void savestates_set_autoinc_slot(int b);
+void savestates_set_compression_level(int level);
 void savestates_inc_slot(void);
 
 #endif /* __SAVESTAVES_H__ */
@@ -34,12 +34,52 @@
 #include "api/m64p_types.h"
 #include "main/main.h"
 #include "main/rom.h"
+#include "main/screenshot.h"
 #include "main/util.h"
+#include "main/workqueue.h"
 #include "osal/files.h"
 #include "osal/preproc.h"
 #include "osd/osd.h"
 #include "plugin/plugin.h"
 
+/* number of pixel buffers which may be waiting for the encoder at once */
+#define CAPTURE_POOL_SIZE 4
+
+enum capture_format
+{
+    CAPTURE_FORMAT_PNG,
+    CAPTURE_FORMAT_QOI,
+    CAPTURE_FORMAT_PPM,
+    CAPTURE_FORMAT_COUNT
+};
+
+static const char* const capture_extensions[CAPTURE_FORMAT_COUNT] = { "png", "qoi", "ppm" };
+
+/* A frame read from the video plugin, waiting to be encoded on the workqueue.
+ * Buffers are taken from a small pool and kept allocated across captures. */
+struct capture
+{
+    struct work_struct work;
+    struct capture *next_free;
+    unsigned char *pixels;      /* 24-bit RGB, bottom row first */
+    size_t capacity;
+    int width;
+    int height;
+    int format;
+    int level;                  /* PNG compression level, -1 for the zlib default */
+    int frame;
+    int screenshot;             /* report the result to the front-end */
+    char *filename;
+};
+
+static struct capture l_Captures[CAPTURE_POOL_SIZE];
+static struct capture *l_FreeCaptures;
+static SDL_mutex *l_CaptureLock;
+static struct work_fence *l_CaptureFence;
+
+static unsigned int l_DroppedFrames;
+static char *l_FrameDumpBase;
+
 /*********************************************************************************************************
 * PNG support functions for writing screenshot files
 */
@@ -71,7 +111,7 @@ static void user_flush_data(png_structp png_write)
 * Other Local (static) functions
 */
 
-static int SaveRGBBufferToFile(const char *filename, const unsigned char *buf, int width, int height, int pitch)
+static int SaveRGBBufferToFile(const char *filename, const unsigned char *buf, int width, int height, int pitch, int level)
 {
     int i;
 
@@ -105,6 +145,8 @@ static int SaveRGBBufferToFile(const char *filename, const unsigned char *buf, i
     }
     // set function pointers in the PNG library, for write callbacks
     png_set_write_fn(png_write, (png_voidp) savefile, user_write_data, user_flush_data);
+    if (level >= 0)
+        png_set_compression_level(png_write, level > 9 ? 9 : level);
     // set the info
     png_set_IHDR(png_write, png_info, width, height, 8, PNG_COLOR_TYPE_RGB,
                  PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
@@ -128,12 +170,155 @@ static int SaveRGBBufferToFile(const char *filename, const unsigned char *buf, i
     return 0;
 }
 
-static int CurrentShotIndex;
+static int WriteBufferToFile(const char *filename, const unsigned char *data, size_t size)
+{
+    FILE *savefile = osal_file_open(filename, "wb");
+    if (savefile == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "Error opening '%s' to save screenshot.", filename);
+        return 4;
+    }
+    if (fwrite(data, 1, size, savefile) != size)
+    {
+        DebugMessage(M64MSG_ERROR, "Failed to write %zi bytes to screenshot file.", size);
+        fclose(savefile);
+        return 5;
+    }
+    if (fclose(savefile) != 0)
+        return 5;
+    return 0;
+}
 
-static char *GetNextScreenshotPath(void)
+/* Encodes the buffer as a QOI image (https://qoiformat.org/), which is
+ * lossless like PNG but several times faster to write. */
+static int SaveRGBBufferToQOI(const char *filename, const unsigned char *buf, int width, int height, int pitch)
+{
+    /* RGBA, so that the empty slots (alpha 0) never match a pixel */
+    unsigned char index[64][4];
+    unsigned char prev[3] = { 0, 0, 0 };
+    unsigned char *out, *p;
+    int x, y, run = 0, rval;
+
+    /* worst case is 4 bytes per pixel, plus the header and end marker */
+    out = (unsigned char *) malloc((size_t) width * height * 4 + 14 + 8);
+    if (out == NULL)
+        return 6;
+
+    memset(index, 0, sizeof(index));
+    p = out;
+    memcpy(p, "qoif", 4);
+    p[4] = (unsigned char) (width >> 24); p[5] = (unsigned char) (width >> 16);
+    p[6] = (unsigned char) (width >> 8);  p[7] = (unsigned char) width;
+    p[8] = (unsigned char) (height >> 24); p[9] = (unsigned char) (height >> 16);
+    p[10] = (unsigned char) (height >> 8); p[11] = (unsigned char) height;
+    p[12] = 3;  /* RGB */
+    p[13] = 0;  /* sRGB with linear alpha */
+    p += 14;
+
+    for (y = height - 1; y >= 0; --y)
+    {
+        const unsigned char *px = buf + y * pitch;
+        for (x = 0; x < width; ++x, px += 3)
+        {
+            if (px[0] == prev[0] && px[1] == prev[1] && px[2] == prev[2])
+            {
+                if (++run == 62)
+                {
+                    *p++ = 0xc0 | (run - 1);    /* QOI_OP_RUN */
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0)
+            {
+                *p++ = 0xc0 | (run - 1);
+                run = 0;
+            }
+
+            /* alpha is always 255 */
+            unsigned int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + 255 * 11) % 64;
+            if (index[hash][0] == px[0] && index[hash][1] == px[1] && index[hash][2] == px[2] && index[hash][3] == 255)
+            {
+                *p++ = hash;                    /* QOI_OP_INDEX */
+            }
+            else
+            {
+                signed char dr = (signed char) (px[0] - prev[0]);
+                signed char dg = (signed char) (px[1] - prev[1]);
+                signed char db = (signed char) (px[2] - prev[2]);
+                signed char dr_dg = (signed char) (dr - dg);
+                signed char db_dg = (signed char) (db - dg);
+
+                memcpy(index[hash], px, 3);
+                index[hash][3] = 255;
+                if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2)
+                {
+                    *p++ = 0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);    /* QOI_OP_DIFF */
+                }
+                else if (dr_dg > -9 && dr_dg < 8 && dg > -33 && dg < 32 && db_dg > -9 && db_dg < 8)
+                {
+                    *p++ = 0x80 | (dg + 32);                                    /* QOI_OP_LUMA */
+                    *p++ = (dr_dg + 8) << 4 | (db_dg + 8);
+                }
+                else
+                {
+                    *p++ = 0xfe;                                                /* QOI_OP_RGB */
+                    *p++ = px[0];
+                    *p++ = px[1];
+                    *p++ = px[2];
+                }
+            }
+            memcpy(prev, px, 3);
+        }
+    }
+    if (run > 0)
+        *p++ = 0xc0 | (run - 1);
+
+    memcpy(p, "\0\0\0\0\0\0\0\1", 8);
+    p += 8;
+
+    rval = WriteBufferToFile(filename, out, p - out);
+    free(out);
+    return rval;
+}
+
+/* Writes the buffer as a binary PPM, which costs no more than copying the rows. */
+static int SaveRGBBufferToPPM(const char *filename, const unsigned char *buf, int width, int height, int pitch)
+{
+    char header[32];
+    int header_size, y;
+    size_t row_size = (size_t) width * 3;
+    unsigned char *out;
+    int rval;
+
+    header_size = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+    out = (unsigned char *) malloc(header_size + row_size * height);
+    if (out == NULL)
+        return 6;
+
+    memcpy(out, header, header_size);
+    for (y = 0; y < height; ++y)
+        memcpy(out + header_size + y * row_size, buf + (height - 1 - y) * pitch, row_size);
+
+    rval = WriteBufferToFile(filename, out, header_size + row_size * height);
+    free(out);
+    return rval;
+}
+
+static int GetCaptureFormat(void)
+{
+    int format = ConfigGetParamInt(g_CoreConfig, "ScreenshotFormat");
+    if (format < 0 || format >= CAPTURE_FORMAT_COUNT)
+    {
+        DebugMessage(M64MSG_WARNING, "Unknown screenshot format %d, using PNG", format);
+        format = CAPTURE_FORMAT_PNG;
+    }
+    return format;
+}
+
+static void GetRomBaseName(char *name, size_t size)
 {
-    char *ScreenshotPath;
-    char ScreenshotFileName[60 + 8 + 1];
     char *pch;
 
     // if there are any characters in the ROM header name with the highest bit set,
@@ -147,48 +332,70 @@ static char *GetNextScreenshotPath(void)
     }
     if (*pccNameChar == 0)
     {
-        // generate the base name of the screenshot
         // add the ROM name, convert to lowercase, convert spaces to underscores
-        strcpy(ScreenshotFileName, ROM_PARAMS.headername);
-        for (pch = ScreenshotFileName; *pch != '\0'; pch++)
+        strncpy(name, ROM_PARAMS.headername, size - 1);
+        name[size - 1] = '\0';
+        for (pch = name; *pch != '\0'; pch++)
             *pch = ((*pch == ' ') || (*pch == ':')) ? '_' : tolower(*pch);
     }
     else
     {
-        ShiftJis2UTF8((unsigned char *) ROM_PARAMS.headername, (unsigned char *) ScreenshotFileName, sizeof(ScreenshotFileName));
-        for (pch = ScreenshotFileName; *pch != '\0'; pch++)
+        ShiftJis2UTF8((unsigned char *) ROM_PARAMS.headername, (unsigned char *) name, size);
+        for (pch = name; *pch != '\0'; pch++)
         {
             if (*pch == ' ' || *pch == ':')
                 *pch = '_';
         }
     }
+}
 
-    strcat(ScreenshotFileName, "-###.png");
-    
-    // add the base path to the screenshot file name
-    const char *SshotDir = ConfigGetParamString(g_CoreConfig, "ScreenshotPath");
-    if (SshotDir == NULL || *SshotDir == '\0')
+/* Returns the path of fileName in the directory given by the ConfigParam
+ * setting, or in DefaultDir under the user data path if it is blank. */
+static char *GetCapturePath(const char *ConfigParam, const char *DefaultDir, const char *FileName)
+{
+    char *CapturePath;
+
+    const char *CaptureDir = ConfigGetParamString(g_CoreConfig, ConfigParam);
+    if (CaptureDir == NULL || *CaptureDir == '\0')
     {
         // note the trick to avoid an allocation. we add a NUL character
         // instead of the separator, call mkdir, then add the separator
-        ScreenshotPath = formatstr("%sscreenshot%c%s", ConfigGetUserDataPath(), '\0', ScreenshotFileName);
-        if (ScreenshotPath == NULL)
+        CapturePath = formatstr("%s%s%c%s", ConfigGetUserDataPath(), DefaultDir, '\0', FileName);
+        if (CapturePath == NULL)
             return NULL;
-        osal_mkdirp(ScreenshotPath, 0700);
-        ScreenshotPath[strlen(ScreenshotPath)] = OSAL_DIR_SEPARATORS[0];
+        osal_mkdirp(CapturePath, 0700);
+        CapturePath[strlen(CapturePath)] = OSAL_DIR_SEPARATORS[0];
     }
     else
     {
-        ScreenshotPath = combinepath(SshotDir, ScreenshotFileName);
-        if (ScreenshotPath == NULL)
-            return NULL;
+        osal_mkdirp(CaptureDir, 0700);
+        CapturePath = combinepath(CaptureDir, FileName);
     }
 
+    return CapturePath;
+}
+
+static int CurrentShotIndex;
+
+static char *GetNextScreenshotPath(int format)
+{
+    char *ScreenshotPath;
+    char ScreenshotFileName[60 + 8 + 1];
+
+    // generate the base name of the screenshot
+    GetRomBaseName(ScreenshotFileName, 60 + 1);
+    strcat(ScreenshotFileName, "-###.png");
+
+    // add the base path to the screenshot file name
+    ScreenshotPath = GetCapturePath("ScreenshotPath", "screenshot", ScreenshotFileName);
+    if (ScreenshotPath == NULL)
+        return NULL;
+
     // patch the number part of the name (the '###' part) until we find a free spot
     char *NumberPtr = ScreenshotPath + strlen(ScreenshotPath) - 7;
     for (; CurrentShotIndex < 1000; CurrentShotIndex++)
     {
-        sprintf(NumberPtr, "%03i.png", CurrentShotIndex);
+        sprintf(NumberPtr, "%03i.%s", CurrentShotIndex, capture_extensions[format]);
         FILE *pFile = osal_file_open(ScreenshotPath, "r");
         if (pFile == NULL)
             break;
@@ -206,58 +413,261 @@ static char *GetNextScreenshotPath(void)
     return ScreenshotPath;
 }
 
+static char *GetFrameDumpPath(int format, int iFrameNumber)
+{
+    char FileName[60 + 1 + 1];
+
+    // the directory is created once per ROM
+    if (l_FrameDumpBase == NULL)
+    {
+        GetRomBaseName(FileName, 60 + 1);
+        strcat(FileName, "-");
+        l_FrameDumpBase = GetCapturePath("FrameDumpPath", "framedump", FileName);
+        if (l_FrameDumpBase == NULL)
+            return NULL;
+    }
+
+    return formatstr("%s%08d.%s", l_FrameDumpBase, iFrameNumber, capture_extensions[format]);
+}
+
+/*********************************************************************************************************
+* Capture buffer pool and background encoding
+*/
+
+static struct capture *GetCapture(int wait)
+{
+    struct capture *capture;
+
+    for (;;)
+    {
+        SDL_LockMutex(l_CaptureLock);
+        capture = l_FreeCaptures;
+        if (capture != NULL)
+            l_FreeCaptures = capture->next_free;
+        SDL_UnlockMutex(l_CaptureLock);
+
+        if (capture != NULL || !wait)
+            return capture;
+
+        // every buffer is being encoded, wait for them
+        work_fence_wait(l_CaptureFence);
+    }
+}
+
+static void PutCapture(struct capture *capture)
+{
+    SDL_LockMutex(l_CaptureLock);
+    capture->next_free = l_FreeCaptures;
+    l_FreeCaptures = capture;
+    SDL_UnlockMutex(l_CaptureLock);
+}
+
+/* Grabs the back image from the video plugin into the capture buffer */
+static int ReadScreen(struct capture *capture)
+{
+    size_t size;
+
+    // get the width and height
+    int width = 640;
+    int height = 480;
+    gfx.readScreen(NULL, &width, &height, 0);
+
+    size = (size_t) width * height * 3;
+    if (size > capture->capacity)
+    {
+        unsigned char *pixels = (unsigned char *) realloc(capture->pixels, size);
+        if (pixels == NULL)
+            return 0;
+        capture->pixels = pixels;
+        capture->capacity = size;
+    }
+
+    gfx.readScreen(capture->pixels, &width, &height, 0);
+    capture->width = width;
+    capture->height = height;
+    return 1;
+}
+
+static void EncodeCaptureWork(struct work_struct *work)
+{
+    struct capture *capture = container_of(work, struct capture, work);
+    int pitch = capture->width * 3;
+    int rval;
+
+    switch (capture->format)
+    {
+        case CAPTURE_FORMAT_QOI:
+            rval = SaveRGBBufferToQOI(capture->filename, capture->pixels, capture->width, capture->height, pitch);
+            break;
+        case CAPTURE_FORMAT_PPM:
+            rval = SaveRGBBufferToPPM(capture->filename, capture->pixels, capture->width, capture->height, pitch);
+            break;
+        default:
+            rval = SaveRGBBufferToFile(capture->filename, capture->pixels, capture->width, capture->height, pitch, capture->level);
+            break;
+    }
+
+    // print message -- this allows developers to capture frames and use them in the regression test
+    if (capture->screenshot)
+    {
+        if (rval != 0)
+        {
+            StateChanged(M64CORE_SCREENSHOT_CAPTURED, 0);
+        }
+        else
+        {
+            main_message(M64MSG_INFO, OSD_BOTTOM_LEFT, "Captured screenshot for frame %i.", capture->frame);
+            StateChanged(M64CORE_SCREENSHOT_CAPTURED, 1);
+        }
+    }
+
+    free(capture->filename);
+    capture->filename = NULL;
+    PutCapture(capture);
+}
+
+static void QueueCapture(struct capture *capture, char *filename, int format, int iFrameNumber, int screenshot)
+{
+    capture->filename = filename;
+    capture->format = format;
+    capture->level = ConfigGetParamInt(g_CoreConfig, "ScreenshotCompressionLevel");
+    capture->frame = iFrameNumber;
+    capture->screenshot = screenshot;
+
+    init_work(&capture->work, EncodeCaptureWork);
+    capture->work.priority = WORK_PRIORITY_LOW;
+    work_fence_add(l_CaptureFence, &capture->work);
+    queue_work(&capture->work);
+}
+
 /*********************************************************************************************************
 * Global screenshot functions
 */
 
+void ScreenshotInit(void)
+{
+    int i;
+
+    l_CaptureLock = SDL_CreateMutex();
+    l_CaptureFence = work_fence_create(NULL);
+    if (l_CaptureLock == NULL || l_CaptureFence == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "Could not initialize screenshot buffers");
+        ScreenshotDeinit();
+        return;
+    }
+
+    l_FreeCaptures = NULL;
+    for (i = 0; i < CAPTURE_POOL_SIZE; i++)
+        PutCapture(&l_Captures[i]);
+}
+
+void ScreenshotDeinit(void)
+{
+    int i;
+
+    if (l_CaptureFence != NULL)
+    {
+        work_fence_wait(l_CaptureFence);
+        work_fence_destroy(l_CaptureFence);
+        l_CaptureFence = NULL;
+    }
+    if (l_CaptureLock != NULL)
+    {
+        SDL_DestroyMutex(l_CaptureLock);
+        l_CaptureLock = NULL;
+    }
+
+    l_FreeCaptures = NULL;
+    for (i = 0; i < CAPTURE_POOL_SIZE; i++)
+    {
+        free(l_Captures[i].pixels);
+        l_Captures[i].pixels = NULL;
+        l_Captures[i].capacity = 0;
+    }
+
+    free(l_FrameDumpBase);
+    l_FrameDumpBase = NULL;
+}
+
 void ScreenshotRomOpen(void)
 {
     CurrentShotIndex = 0;
+    l_DroppedFrames = 0;
+
+    free(l_FrameDumpBase);
+    l_FrameDumpBase = NULL;
+}
+
+void ScreenshotRomClose(void)
+{
+    /* the captures report to the front-end and the OSD, which go away
+     * with the emulation */
+    if (l_CaptureFence != NULL)
+        work_fence_wait(l_CaptureFence);
 }
 
 void TakeScreenshot(int iFrameNumber)
 {
+    struct capture *capture;
     char *filename;
+    int format;
+
+    if (l_CaptureFence == NULL)
+    {
+        StateChanged(M64CORE_SCREENSHOT_CAPTURED, 0);
+        return;
+    }
 
     // look for an unused screenshot filename
-    filename = GetNextScreenshotPath();
+    format = GetCaptureFormat();
+    filename = GetNextScreenshotPath(format);
     if (filename == NULL)
     {
         StateChanged(M64CORE_SCREENSHOT_CAPTURED, 0);
         return;
     }
 
-    // get the width and height
-    int width = 640;
-    int height = 480;
-    gfx.readScreen(NULL, &width, &height, 0);
-
-    // allocate memory for the image
-    unsigned char *pucFrame = (unsigned char *) malloc(width * height * 3);
-    if (pucFrame == NULL)
+    // a screenshot was asked for, so wait for a buffer if all are in use
+    capture = GetCapture(1);
+    if (!ReadScreen(capture))
     {
+        PutCapture(capture);
         StateChanged(M64CORE_SCREENSHOT_CAPTURED, 0);
         free(filename);
         return;
     }
 
-    // grab the back image from OpenGL by calling the video plugin
-    gfx.readScreen(pucFrame, &width, &height, 0);
+    // the image is written to disk in the background
+    QueueCapture(capture, filename, format, iFrameNumber, 1);
+}
 
-    // write the image to a PNG
-    int rval = SaveRGBBufferToFile(filename, pucFrame, width, height, width * 3);
-    // free the memory
-    free(pucFrame);
-    free(filename);
-    // print message -- this allows developers to capture frames and use them in the regression test
-    if (rval != 0)
+void DumpFrame(int iFrameNumber)
+{
+    struct capture *capture;
+    char *filename;
+    int format;
+
+    if (l_CaptureFence == NULL)
+        return;
+
+    // don't hold up the emulation when the encoder can't keep up
+    capture = GetCapture(0);
+    if (capture == NULL)
     {
-        StateChanged(M64CORE_SCREENSHOT_CAPTURED, 0);
+        if (l_DroppedFrames++ == 0)
+            DebugMessage(M64MSG_WARNING, "Frame dump encoder is too slow, frame %i dropped", iFrameNumber);
+        return;
     }
-    else
+
+    format = GetCaptureFormat();
+    filename = GetFrameDumpPath(format, iFrameNumber);
+    if (filename == NULL || !ReadScreen(capture))
     {
-        main_message(M64MSG_INFO, OSD_BOTTOM_LEFT, "Captured screenshot for frame %i.", iFrameNumber);
-        StateChanged(M64CORE_SCREENSHOT_CAPTURED, 1);
+        PutCapture(capture);
+        free(filename);
+        return;
     }
-}
 
+    QueueCapture(capture, filename, format, iFrameNumber, 0);
+}
@@ -22,7 +22,16 @@
 #ifndef M64P_MAIN_SCREENSHOT_H
 #define M64P_MAIN_SCREENSHOT_H
 
+void ScreenshotInit(void);
+void ScreenshotDeinit(void);
+
 void ScreenshotRomOpen(void);
+/* waits for the captures still being encoded */
+void ScreenshotRomClose(void);
+
+/* Both read the screen synchronously and encode it on the workqueue. Frame
+ * dumps are dropped, rather than waited for, when the encoder falls behind. */
 void TakeScreenshot(int iFrameNumber);
+void DumpFrame(int iFrameNumber);
 
 #endif
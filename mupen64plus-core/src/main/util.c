@@ -43,6 +43,12 @@
 #include "rom.h"
 #include "util.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 /**********************
      File utilities
  **********************/
@@ -83,6 +89,30 @@ file_status_t write_to_file(const char *filename, const void *data, size_t size)
     return file_ok;
 }
 
+file_status_t write_to_file_atomic(const char *filename, const void *data, size_t size)
+{
+    file_status_t ret;
+    char *tmpname = formatstr("%s.tmp", filename);
+    if (tmpname == NULL)
+    {
+        return file_open_error;
+    }
+
+    ret = write_to_file(tmpname, data, size);
+    if (ret == file_ok && osal_rename_file(tmpname, filename) != 0)
+    {
+        ret = file_write_error;
+    }
+
+    if (ret != file_ok)
+    {
+        osal_delete_file(tmpname);
+    }
+
+    free(tmpname);
+    return ret;
+}
+
 
 file_status_t write_chunk_to_file(const char *filename, const void *data, size_t size, size_t offset)
 {
@@ -220,29 +250,114 @@ close_file:
 /**********************
    Byte swap utilities
  **********************/
-void swap_buffer(void *buffer, size_t length, size_t count)
+/* Byte swaps the 16 byte blocks of src into dst, returning the number of
+ * bytes done. The remaining elements are left to the scalar loops. */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+static size_t swap_copy_simd(void *dst, const void *src, size_t length, size_t size)
 {
+    const unsigned char *s = (const unsigned char *) src;
+    unsigned char *d = (unsigned char *) dst;
     size_t i;
+
+    for (i = 0; i + 16 <= size; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) (s + i));
+
+        /* reverse the half-words within each element, then the bytes */
+        if (length == 4)
+        {
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        else if (length == 8)
+        {
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        }
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+
+        _mm_storeu_si128((__m128i *) (d + i), v);
+    }
+
+    return i;
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+static size_t swap_copy_simd(void *dst, const void *src, size_t length, size_t size)
+{
+    const uint8_t *s = (const uint8_t *) src;
+    uint8_t *d = (uint8_t *) dst;
+    size_t i;
+
+    for (i = 0; i + 16 <= size; i += 16)
+    {
+        uint8x16_t v = vld1q_u8(s + i);
+
+        if (length == 2)
+            v = vrev16q_u8(v);
+        else if (length == 4)
+            v = vrev32q_u8(v);
+        else
+            v = vrev64q_u8(v);
+
+        vst1q_u8(d + i, v);
+    }
+
+    return i;
+}
+
+#else
+
+static size_t swap_copy_simd(void *dst, const void *src, size_t length, size_t size)
+{
+    return 0;
+}
+
+#endif
+
+void swap_copy_buffer(void *dst, const void *src, size_t length, size_t count)
+{
+    size_t i;
+
+    if (length != 2 && length != 4 && length != 8)
+    {
+        if (dst != src)
+            memcpy(dst, src, length * count);
+        return;
+    }
+
+    i = swap_copy_simd(dst, src, length, length * count) / length;
+
     if (length == 2)
     {
-        uint16_t *pun = (uint16_t *) buffer;
-        for (i = 0; i < count; i++)
-            pun[i] = m64p_swap16(pun[i]);
+        const uint16_t *s = (const uint16_t *) src;
+        uint16_t *d = (uint16_t *) dst;
+        for (; i < count; i++)
+            d[i] = m64p_swap16(s[i]);
     }
     else if (length == 4)
     {
-        uint32_t *pun = (uint32_t *) buffer;
-        for (i = 0; i < count; i++)
-            pun[i] = m64p_swap32(pun[i]);
+        const uint32_t *s = (const uint32_t *) src;
+        uint32_t *d = (uint32_t *) dst;
+        for (; i < count; i++)
+            d[i] = m64p_swap32(s[i]);
     }
-    else if (length == 8)
+    else
     {
-        uint64_t *pun = (uint64_t *) buffer;
-        for (i = 0; i < count; i++)
-            pun[i] = m64p_swap64(pun[i]);
+        const uint64_t *s = (const uint64_t *) src;
+        uint64_t *d = (uint64_t *) dst;
+        for (; i < count; i++)
+            d[i] = m64p_swap64(s[i]);
     }
 }
 
+void swap_buffer(void *buffer, size_t length, size_t count)
+{
+    swap_copy_buffer(buffer, buffer, length, count);
+}
+
 void to_little_endian_buffer(void *buffer, size_t length, size_t count)
 {
 #if defined(M64P_BIG_ENDIAN)
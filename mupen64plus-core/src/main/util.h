@@ -61,6 +61,13 @@ file_status_t read_from_file(const char *filename, void *data, size_t size);
  */
 file_status_t write_to_file(const char *filename, const void *data, size_t size);
 
+/** write_to_file_atomic
+ *    writes the specified number of bytes to a temporary file,
+ *    then renames it over the destination file.
+ *    returns zero on success, nonzero on failure
+ */
+file_status_t write_to_file_atomic(const char *filename, const void *data, size_t size);
+
 /** write_chunk_to_file
  *    opens a file, seek to offset and writes the specified number of bytes.
  *    returns zero on success, nonzero on failure
@@ -147,6 +154,10 @@ static osal_inline unsigned long long int m64p_swap64(unsigned long long int x)
 /* Byte swaps, converts to little endian or converts to big endian a buffer,
  * containing 'count' elements, each of size 'length'. */
 void swap_buffer(void *buffer, size_t length, size_t count);
+
+/* Copies 'count' elements of size 'length' from src to dst, byte swapping
+ * them. dst may be the same as src, but the buffers may not overlap otherwise. */
+void swap_copy_buffer(void *dst, const void *src, size_t length, size_t count);
 void to_little_endian_buffer(void *buffer, size_t length, size_t count);
 void to_big_endian_buffer(void *buffer, size_t length, size_t count);
 
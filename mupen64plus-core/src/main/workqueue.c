@@ -31,12 +31,23 @@
 #include "api/m64p_types.h"
 #include "main/list.h"
 
-#define WORKQUEUE_THREADS 1
+#define WORKQUEUE_MAX_THREADS 8
+#define WORKQUEUE_MAX_PENDING 256
+
+struct work_fence {
+    SDL_cond *done;
+    size_t pending;
+    struct work_struct *on_done;
+};
 
 struct workqueue_mgmt_globals {
-    struct list_head work_queue;
+    struct list_head work_queue[WORK_PRIORITY_COUNT];
+    size_t pending[WORK_PRIORITY_COUNT];
+    struct list_head delayed_queue;
     struct list_head thread_queue;
     struct list_head thread_list;
+    size_t thread_count;
+    int shutdown;
     SDL_mutex *lock;
 };
 
@@ -49,31 +60,114 @@ struct workqueue_thread {
 
 static struct workqueue_mgmt_globals workqueue_mgmt;
 
-static void workqueue_dismiss(struct work_struct *work)
+/* The lock doesn't exist when the workqueue isn't running,
+ * everything then happens on the calling thread. */
+static void workqueue_lock(void)
+{
+    if (workqueue_mgmt.lock)
+        SDL_LockMutex(workqueue_mgmt.lock);
+}
+
+static void workqueue_unlock(void)
+{
+    if (workqueue_mgmt.lock)
+        SDL_UnlockMutex(workqueue_mgmt.lock);
+}
+
+static unsigned int workqueue_priority(const struct work_struct *work)
+{
+    return (work->priority < WORK_PRIORITY_COUNT) ? work->priority : WORK_PRIORITY_LOW;
+}
+
+/* Must be called with the lock held */
+static void workqueue_dequeue(struct work_struct *work)
+{
+    list_del_init(&work->list);
+    --workqueue_mgmt.pending[workqueue_priority(work)];
+}
+
+static void workqueue_fence_complete(struct work_fence *fence)
+{
+    struct work_struct *on_done = NULL;
+
+    workqueue_lock();
+    if (--fence->pending == 0) {
+        on_done = fence->on_done;
+        if (fence->done)
+            SDL_CondSignal(fence->done);
+    }
+    workqueue_unlock();
+
+    if (on_done)
+        queue_work(on_done);
+}
+
+static void workqueue_run(struct work_struct *work)
 {
+    /* work may be released by its handler */
+    struct work_fence *fence = work->fence;
+
+    work->func(work);
+
+    if (fence)
+        workqueue_fence_complete(fence);
+}
+
+/* Moves the delayed work which is due to the work queues, and returns the
+ * time until the next one is, 0 if there is none left.
+ * Must be called with the lock held */
+static unsigned int workqueue_promote_delayed(void)
+{
+    struct work_struct *work, *safe;
+    unsigned int now = SDL_GetTicks();
+    unsigned int next = 0;
+    int remaining;
+
+    list_for_each_entry_safe_t(work, safe, &workqueue_mgmt.delayed_queue, struct work_struct, list) {
+        remaining = (int)(work->deadline - now);
+        /* pending work is drained before the threads exit */
+        if (remaining <= 0 || workqueue_mgmt.shutdown) {
+            list_del(&work->list);
+            list_add_tail(&work->list, &workqueue_mgmt.work_queue[workqueue_priority(work)]);
+            ++workqueue_mgmt.pending[workqueue_priority(work)];
+        }
+        else if (next == 0 || (unsigned int)remaining < next) {
+            next = (unsigned int)remaining;
+        }
+    }
+
+    return next;
 }
 
 static struct work_struct *workqueue_get_work(struct workqueue_thread *thread)
 {
-    int found = 0;
-    struct work_struct *work;
+    size_t i;
+    unsigned int next_delayed;
+    struct work_struct *work = NULL;
 
+    SDL_LockMutex(workqueue_mgmt.lock);
     for (;;) {
-        SDL_LockMutex(workqueue_mgmt.lock);
         list_del_init(&thread->list);
-        if (!list_empty(&workqueue_mgmt.work_queue)) {
-            found = 1;
-            work = list_first_entry(&workqueue_mgmt.work_queue, struct work_struct, list);
-            list_del_init(&work->list);
-        } else {
-            list_add(&thread->list, &workqueue_mgmt.thread_queue);
-	        SDL_CondWait(thread->work_avail, workqueue_mgmt.lock);
+        next_delayed = workqueue_promote_delayed();
+        for (i = 0; i < WORK_PRIORITY_COUNT; i++) {
+            if (!list_empty(&workqueue_mgmt.work_queue[i])) {
+                work = list_first_entry(&workqueue_mgmt.work_queue[i], struct work_struct, list);
+                workqueue_dequeue(work);
+                break;
+            }
         }
-        SDL_UnlockMutex(workqueue_mgmt.lock);
 
-        if (found)
+        /* pending work is drained before the threads exit */
+        if (work || workqueue_mgmt.shutdown)
             break;
+
+        list_add(&thread->list, &workqueue_mgmt.thread_queue);
+        if (next_delayed > 0)
+            SDL_CondWaitTimeout(thread->work_avail, workqueue_mgmt.lock, next_delayed);
+        else
+            SDL_CondWait(thread->work_avail, workqueue_mgmt.lock);
     }
+    SDL_UnlockMutex(workqueue_mgmt.lock);
 
     return work;
 }
@@ -83,15 +177,8 @@ static int workqueue_thread_handler(void *data)
     struct workqueue_thread *thread = data;
     struct work_struct *work;
 
-    for (;;) {
-        work = workqueue_get_work(thread);
-        if (work->func == workqueue_dismiss) {
-            free(work);
-            break;
-        }
-
-        work->func(work);
-    }
+    while ((work = workqueue_get_work(thread)) != NULL)
+        workqueue_run(work);
 
     return 0;
 }
@@ -99,10 +186,13 @@ static int workqueue_thread_handler(void *data)
 int workqueue_init(void)
 {
     size_t i;
+    int cpu_count;
     struct workqueue_thread *thread;
 
     memset(&workqueue_mgmt, 0, sizeof(workqueue_mgmt));
-    INIT_LIST_HEAD(&workqueue_mgmt.work_queue);
+    for (i = 0; i < WORK_PRIORITY_COUNT; i++)
+        INIT_LIST_HEAD(&workqueue_mgmt.work_queue[i]);
+    INIT_LIST_HEAD(&workqueue_mgmt.delayed_queue);
     INIT_LIST_HEAD(&workqueue_mgmt.thread_queue);
     INIT_LIST_HEAD(&workqueue_mgmt.thread_list);
 
@@ -112,23 +202,28 @@ int workqueue_init(void)
         return -1;
     }
 
+    /* leave one core to the emulation thread */
+    cpu_count = SDL_GetCPUCount() - 1;
+    if (cpu_count < 1)
+        cpu_count = 1;
+    if (cpu_count > WORKQUEUE_MAX_THREADS)
+        cpu_count = WORKQUEUE_MAX_THREADS;
+
     SDL_LockMutex(workqueue_mgmt.lock);
-    for (i = 0; i < WORKQUEUE_THREADS; i++) {
+    for (i = 0; i < (size_t)cpu_count; i++) {
         thread = malloc(sizeof(*thread));
         if (!thread) {
             DebugMessage(M64MSG_ERROR, "Could not create workqueue thread management data");
-            SDL_UnlockMutex(workqueue_mgmt.lock);
-            return -1;
+            break;
         }
 
         memset(thread, 0, sizeof(*thread));
-        list_add(&thread->list_mgmt, &workqueue_mgmt.thread_list);
         INIT_LIST_HEAD(&thread->list);
         thread->work_avail = SDL_CreateCond();
         if (!thread->work_avail) {
             DebugMessage(M64MSG_ERROR, "Could not create workqueue thread work_avail condition");
-            SDL_UnlockMutex(workqueue_mgmt.lock);
-            return -1;
+            free(thread);
+            break;
         }
 
 #if SDL_VERSION_ATLEAST(2,0,0)
@@ -138,27 +233,34 @@ int workqueue_init(void)
 #endif
         if (!thread->thread) {
             DebugMessage(M64MSG_ERROR, "Could not create workqueue thread handler");
-            SDL_UnlockMutex(workqueue_mgmt.lock);
-            return -1;
+            SDL_DestroyCond(thread->work_avail);
+            free(thread);
+            break;
         }
+
+        list_add(&thread->list_mgmt, &workqueue_mgmt.thread_list);
+        workqueue_mgmt.thread_count++;
     }
     SDL_UnlockMutex(workqueue_mgmt.lock);
 
-    return 0;
+    /* without any thread, work is executed synchronously */
+    return (workqueue_mgmt.thread_count > 0) ? 0 : -1;
 }
 
 void workqueue_shutdown(void)
 {
-    size_t i;
     int status;
-    struct work_struct *work;
     struct workqueue_thread *thread, *safe;
 
-    for (i = 0; i < WORKQUEUE_THREADS; i++) {
-        work = malloc(sizeof(*work));
-        init_work(work, workqueue_dismiss);
-        queue_work(work);
+    if (!workqueue_mgmt.lock)
+        return;
+
+    SDL_LockMutex(workqueue_mgmt.lock);
+    workqueue_mgmt.shutdown = 1;
+    list_for_each_entry_t(thread, &workqueue_mgmt.thread_list, struct workqueue_thread, list_mgmt) {
+        SDL_CondSignal(thread->work_avail);
     }
+    SDL_UnlockMutex(workqueue_mgmt.lock);
 
     list_for_each_entry_safe_t(thread, safe, &workqueue_mgmt.thread_list, struct workqueue_thread, list_mgmt) {
         list_del(&thread->list_mgmt);
@@ -167,25 +269,167 @@ void workqueue_shutdown(void)
         free(thread);
     }
 
-    if (!list_empty(&workqueue_mgmt.work_queue))
-        DebugMessage(M64MSG_WARNING, "Stopped workqueue with work still pending");
-
     SDL_DestroyMutex(workqueue_mgmt.lock);
+    memset(&workqueue_mgmt, 0, sizeof(workqueue_mgmt));
+}
+
+size_t workqueue_thread_count(void)
+{
+    return workqueue_mgmt.thread_count;
 }
 
 int queue_work(struct work_struct *work)
 {
     struct workqueue_thread *thread;
+    unsigned int priority = workqueue_priority(work);
+
+    workqueue_lock();
+    /* run it ourselves if there's no one to do it, or as backpressure
+     * when the queue is full */
+    if (workqueue_mgmt.thread_count == 0 || workqueue_mgmt.shutdown ||
+        workqueue_mgmt.pending[priority] >= WORKQUEUE_MAX_PENDING) {
+        workqueue_unlock();
+        workqueue_run(work);
+        return 0;
+    }
 
-    SDL_LockMutex(workqueue_mgmt.lock);
-    list_add_tail(&work->list, &workqueue_mgmt.work_queue);
+    list_add_tail(&work->list, &workqueue_mgmt.work_queue[priority]);
+    ++workqueue_mgmt.pending[priority];
+    if (!list_empty(&workqueue_mgmt.thread_queue)) {
+        thread = list_first_entry(&workqueue_mgmt.thread_queue, struct workqueue_thread, list);
+        list_del_init(&thread->list);
+
+        SDL_CondSignal(thread->work_avail);
+    }
+    workqueue_unlock();
+
+    return 0;
+}
+
+int queue_delayed_work(struct work_struct *work, unsigned int delay_ms)
+{
+    struct workqueue_thread *thread;
+
+    workqueue_lock();
+    if (workqueue_mgmt.thread_count == 0 || workqueue_mgmt.shutdown) {
+        workqueue_unlock();
+        workqueue_run(work);
+        return 0;
+    }
+
+    work->deadline = SDL_GetTicks() + delay_ms;
+    list_add_tail(&work->list, &workqueue_mgmt.delayed_queue);
+
+    /* an idle thread picks the new deadline up */
     if (!list_empty(&workqueue_mgmt.thread_queue)) {
         thread = list_first_entry(&workqueue_mgmt.thread_queue, struct workqueue_thread, list);
         list_del_init(&thread->list);
 
         SDL_CondSignal(thread->work_avail);
     }
-    SDL_UnlockMutex(workqueue_mgmt.lock);
+
+    /* and so does someone already waiting on its fence */
+    if (work->fence && work->fence->done)
+        SDL_CondSignal(work->fence->done);
+    workqueue_unlock();
 
     return 0;
 }
+
+struct work_fence *work_fence_create(struct work_struct *on_done)
+{
+    struct work_fence *fence = malloc(sizeof(*fence));
+    if (!fence)
+        return NULL;
+
+    fence->pending = 0;
+    fence->on_done = on_done;
+    fence->done = SDL_CreateCond();
+    if (!fence->done) {
+        free(fence);
+        return NULL;
+    }
+
+    return fence;
+}
+
+void work_fence_destroy(struct work_fence *fence)
+{
+    if (!fence)
+        return;
+
+    SDL_DestroyCond(fence->done);
+    free(fence);
+}
+
+void work_fence_add(struct work_fence *fence, struct work_struct *work)
+{
+    workqueue_lock();
+    ++fence->pending;
+    work->fence = fence;
+    workqueue_unlock();
+}
+
+int work_fence_done(struct work_fence *fence)
+{
+    int done;
+
+    workqueue_lock();
+    done = (fence->pending == 0);
+    workqueue_unlock();
+
+    return done;
+}
+
+void work_fence_wait(struct work_fence *fence)
+{
+    size_t i;
+    struct work_struct *work, *found;
+
+    workqueue_lock();
+    while (fence->pending > 0) {
+        /* help with the work still waiting in the queue */
+        found = NULL;
+        for (i = 0; i < WORK_PRIORITY_COUNT && !found; i++) {
+            list_for_each_entry_t(work, &workqueue_mgmt.work_queue[i], struct work_struct, list) {
+                if (work->fence == fence) {
+                    found = work;
+                    break;
+                }
+            }
+        }
+
+        /* delayed work is run without waiting for its deadline */
+        if (!found && workqueue_mgmt.lock) {
+            list_for_each_entry_t(work, &workqueue_mgmt.delayed_queue, struct work_struct, list) {
+                if (work->fence == fence) {
+                    found = work;
+                    break;
+                }
+            }
+
+            if (found) {
+                list_del_init(&found->list);
+                workqueue_unlock();
+                workqueue_run(found);
+                workqueue_lock();
+                continue;
+            }
+        }
+
+        if (found) {
+            workqueue_dequeue(found);
+            workqueue_unlock();
+            workqueue_run(found);
+            workqueue_lock();
+        }
+        else if (workqueue_mgmt.lock) {
+            SDL_CondWait(fence->done, workqueue_mgmt.lock);
+        }
+        else {
+            /* can't happen when everything runs synchronously */
+            break;
+        }
+    }
+    workqueue_unlock();
+}
@@ -22,46 +22,65 @@
 #ifndef __WORKQUEUE_H__
 #define __WORKQUEUE_H__
 
+#include <stddef.h>
+
 #include "list.h"
 #include "osal/preproc.h"
 
 struct work_struct;
+struct work_fence;
+
+enum work_priority {
+    WORK_PRIORITY_HIGH,     /* someone is waiting for the result */
+    WORK_PRIORITY_NORMAL,
+    WORK_PRIORITY_LOW,      /* background jobs */
+    WORK_PRIORITY_COUNT
+};
 
 typedef void (*work_func_t)(struct work_struct *work);
 struct work_struct {
     work_func_t func;
     struct list_head list;
+    unsigned int priority;
+    struct work_fence *fence;
+    unsigned int deadline;  /* SDL ticks, for delayed work */
 };
 
 static osal_inline void init_work(struct work_struct *work, work_func_t func)
 {
     INIT_LIST_HEAD(&work->list);
     work->func = func;
+    work->priority = WORK_PRIORITY_NORMAL;
+    work->fence = NULL;
 }
 
-#ifdef M64P_PARALLEL
-
 int workqueue_init(void);
 void workqueue_shutdown(void);
-int queue_work(struct work_struct *work);
 
-#else
+/* Returns the number of worker threads, 0 if work is executed synchronously */
+size_t workqueue_thread_count(void);
 
-static osal_inline int workqueue_init(void)
-{
-    return 0;
-}
+/* Queues work for execution on the worker threads.
+ * When the workqueue isn't running, or when too much work of the same
+ * priority is already pending, the work is executed by the caller instead. */
+int queue_work(struct work_struct *work);
 
-static osal_inline void workqueue_shutdown(void)
-{
-}
+/* Queues work for execution once delay_ms have passed, without holding a
+ * worker thread meanwhile. Fences waited on run their delayed work right
+ * away, and so does a workqueue without threads or shutting down. */
+int queue_delayed_work(struct work_struct *work, unsigned int delay_ms);
 
-static osal_inline int queue_work(struct work_struct *work)
-{
-    work->func(work);
-    return 0;
-}
+/* Fences track completion of a group of work items.
+ * Work must be added to a fence before being queued, and the fence must
+ * outlive the work. If on_done is not NULL, it is queued each time the
+ * last pending work of the fence completes. */
+struct work_fence *work_fence_create(struct work_struct *on_done);
+void work_fence_destroy(struct work_fence *fence);
+void work_fence_add(struct work_fence *fence, struct work_struct *work);
+int work_fence_done(struct work_fence *fence);
 
-#endif
+/* Waits for all the work of the fence to complete, executing the still
+ * queued ones on the calling thread. A fence supports a single waiter. */
+void work_fence_wait(struct work_fence *fence);
 
 #endif
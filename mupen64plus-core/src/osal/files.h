@@ -26,6 +26,7 @@
 #if !defined (OSAL_FILES_H)
 #define OSAL_FILES_H
 
+#include <stdint.h>
 #include <zlib.h>
 
 /* some file-related preprocessor definitions */
@@ -65,6 +66,19 @@ extern const char * osal_get_user_datapath(void);
 extern const char * osal_get_user_cachepath(void);
 
 extern FILE * osal_file_open (const char *filename, const char *mode);
+
+/* Renames a file, replacing newpath if it already exists.
+ * Returns zero on success, nonzero on failure.
+ */
+extern int osal_rename_file(const char *oldpath, const char *newpath);
+
+/* Deletes a file. Returns zero on success, nonzero on failure. */
+extern int osal_delete_file(const char *filename);
+
+/* Gets the size of a file and its modification time in nanoseconds, at the
+ * resolution the host has. Returns zero on success, nonzero on failure.
+ */
+extern int osal_file_info(const char *filename, uint64_t *size, int64_t *mtime_ns);
 extern gzFile osal_gzopen(const char *filename, const char *mode);
 
 #endif /* OSAL_FILES_H */
@@ -237,6 +237,32 @@ FILE * osal_file_open(const char *filename, const char *mode)
     return fopen (filename, mode);
 }
 
+int osal_rename_file(const char *oldpath, const char *newpath)
+{
+    return rename(oldpath, newpath);
+}
+
+int osal_delete_file(const char *filename)
+{
+    return unlink(filename);
+}
+
+int osal_file_info(const char *filename, uint64_t *size, int64_t *mtime_ns)
+{
+    struct stat st;
+
+    if (stat(filename, &st) != 0)
+        return -1;
+
+    *size = (uint64_t) st.st_size;
+#if defined(__linux__)
+    *mtime_ns = (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#else
+    *mtime_ns = (int64_t) st.st_mtime * 1000000000;
+#endif
+    return 0;
+}
+
 gzFile osal_gzopen(const char *filename, const char *mode)
 {
     return gzopen(filename, mode);
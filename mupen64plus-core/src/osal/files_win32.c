@@ -24,6 +24,7 @@
  */
 
 #include <direct.h>
+#include <io.h>
 #include <shlobj.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -214,6 +215,37 @@ FILE * osal_file_open ( const char * filename, const char * mode )
     return _wfopen (wstr_filename, wstr_mode);
 }
 
+int osal_rename_file(const char *oldpath, const char *newpath)
+{
+    wchar_t wstr_oldpath[PATH_MAX];
+    wchar_t wstr_newpath[PATH_MAX];
+    MultiByteToWideChar(CP_UTF8, 0, oldpath, -1, wstr_oldpath, PATH_MAX);
+    MultiByteToWideChar(CP_UTF8, 0, newpath, -1, wstr_newpath, PATH_MAX);
+    return MoveFileExW(wstr_oldpath, wstr_newpath, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+}
+
+int osal_delete_file(const char *filename)
+{
+    wchar_t wstr_filename[PATH_MAX];
+    if (MultiByteToWideChar(CP_UTF8, 0, filename, -1, wstr_filename, PATH_MAX) == 0)
+        return -1;
+    return _wunlink(wstr_filename);
+}
+
+int osal_file_info(const char *filename, uint64_t *size, int64_t *mtime_ns)
+{
+    wchar_t wstr_filename[PATH_MAX];
+    struct _stat64 st;
+
+    if (MultiByteToWideChar(CP_UTF8, 0, filename, -1, wstr_filename, PATH_MAX) == 0
+     || _wstat64(wstr_filename, &st) != 0)
+        return -1;
+
+    *size = (uint64_t) st.st_size;
+    *mtime_ns = (int64_t) st.st_mtime * 1000000000;
+    return 0;
+}
+
 gzFile osal_gzopen(const char *filename, const char *mode)
 {
     wchar_t wstr_filename[PATH_MAX];
@@ -75,6 +75,9 @@
 #define SE16(a) ((int64_t) ((int16_t) (a)))
 #define SE32(a) ((int64_t) ((int32_t) (a)))
 
+/* marks a parameter an interface requires but the implementation ignores */
+#define UNUSED(x) (void)(x)
+
 #if !defined(M64P_BIG_ENDIAN)
   #if defined(__GNUC__) && (__GNUC__ > 4  || (__GNUC__ == 4 && __GNUC_MINOR__ >= 3))
     #define tohl(x) __builtin_bswap32((x))
@@ -59,3 +59,7 @@ void dummyrsp_RomClosed(void)
 {
 }
 
+void dummyrsp_SyncRspTasks(void)
+{
+}
+
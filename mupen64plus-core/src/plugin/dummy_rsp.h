@@ -30,6 +30,7 @@ extern m64p_error dummyrsp_PluginGetVersion(m64p_plugin_type *PluginType, int *P
 extern unsigned int dummyrsp_DoRspCycles(unsigned int Cycles);
 extern void dummyrsp_InitiateRSP(RSP_INFO Rsp_Info, unsigned int *CycleCount);
 extern void dummyrsp_RomClosed(void);
+extern void dummyrsp_SyncRspTasks(void);
 
 #endif /* DUMMY_RSP_H */
 
@@ -108,7 +108,8 @@ static const rsp_plugin_functions dummy_rsp = {
     dummyrsp_PluginGetVersion,
     dummyrsp_DoRspCycles,
     dummyrsp_InitiateRSP,
-    dummyrsp_RomClosed
+    dummyrsp_RomClosed,
+    dummyrsp_SyncRspTasks
 };
 
 static GFX_INFO gfx_info;
@@ -481,6 +482,11 @@ static m64p_error plugin_connect_rsp(m64p_dynlib_handle plugin_handle)
             return M64ERR_INCOMPATIBLE;
         }
 
+        /* set function pointers for optional functions */
+        rsp.syncRspTasks = (ptr_SyncRspTasks)osal_dynlib_getproc(plugin_handle, "SyncRspTasks");
+        if (rsp.syncRspTasks == NULL)
+            rsp.syncRspTasks = dummyrsp_SyncRspTasks;
+
         l_RspAttached = 1;
     }
     else
@@ -117,6 +117,7 @@ typedef struct _rsp_plugin_functions
 	ptr_DoRspCycles         doRspCycles;
 	ptr_InitiateRSP         initiateRSP;
 	ptr_RomClosed           romClosed;
+	ptr_SyncRspTasks        syncRspTasks;
 } rsp_plugin_functions;
 
 extern rsp_plugin_functions rsp;
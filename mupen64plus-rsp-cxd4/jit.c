@@ -0,0 +1,774 @@
+/******************************************************************************\
+* Project:  Dynamic Recompiler for Scalar Unit Microcode Images                *
+* Release:  2026.10.19                                                         *
+* License:  CC0 Public Domain Dedication                                       *
+*                                                                              *
+* To the extent possible under law, the author(s) have dedicated all copyright *
+* and related and neighboring rights to this software to the public domain     *
+* worldwide. This software is distributed without any warranty.                *
+*                                                                              *
+* You should have received a copy of the CC0 Public Domain Dedication along    *
+* with this software.                                                          *
+* If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.             *
+\******************************************************************************/
+
+#include "jit.h"
+
+#ifdef SU_JIT
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS   MAP_ANON
+#endif
+#endif
+
+#include "module.h"
+
+#define IMEM_WORDS          (4096 / 4)
+
+/*
+ * Translations are cached per IMEM image, so that the handful of microcode
+ * images a game keeps switching between (graphics, audio, overlays) are only
+ * ever translated once.  An image has to be seen twice before it is
+ * translated; one-shot boot code and half-loaded overlays stay interpreted.
+ */
+#define JIT_SLOTS           16
+#define JIT_SLOT_SIZE       (256 * 1024)
+#define JIT_SIGHTINGS       32
+#define JIT_HOT_SIGHTINGS   2
+
+/*
+ * Worst case emitted for a single instruction word, including a branch with
+ * the copy of its delay slot.  Translation gives up past this margin.
+ */
+#define JIT_MAX_INST_BYTES  256
+
+/*
+ * Translated code returns the 12-bit IMEM address to continue at, with the
+ * reason for leaving in the upper half:  the su_step() status bits, or the
+ * request to finish the task with the interpreter.
+ */
+#define JIT_EXIT_FALLBACK   0x00000004
+
+typedef u32 (*jit_code)(u32 PC);
+
+struct jit_image {
+    u64 hash;
+    u32 last_used;
+    int valid;
+    jit_code code;
+    u32 imem[IMEM_WORDS];
+};
+
+struct jit_sighting {
+    u64 hash;
+    int count; /* negative if the image can not be translated */
+};
+
+static struct jit_image images[JIT_SLOTS];
+static struct jit_sighting sightings[JIT_SIGHTINGS];
+static unsigned int next_sighting;
+static u32 use_clock;
+
+static u8* code_memory;
+static int code_memory_failed;
+
+/*** x86-64 code emitter ***/
+
+enum {
+    EAX = 0, ECX = 1, EDX = 2
+};
+
+enum {
+    OP_ADD = 0x03, OP_OR = 0x0B, OP_AND = 0x23, OP_SUB = 0x2B,
+    OP_XOR = 0x33, OP_CMP = 0x3B, OP_STORE = 0x89, OP_LOAD = 0x8B
+};
+
+enum {
+    CC_B = 0x2, CC_E = 0x4, CC_NE = 0x5, CC_S = 0x8, CC_NS = 0x9,
+    CC_L = 0xC, CC_LE = 0xE, CC_G = 0xF
+};
+
+enum {
+    SHIFT_LEFT = 4, SHIFT_RIGHT = 5, SHIFT_ARITHMETIC = 7
+};
+
+/*
+ * register assignments inside translated code:
+ *     rbx = SR, rbp = DMEM, r12d = delayed jump target, r13 = entry table
+ */
+#ifdef _WIN32
+#define JIT_FRAME_SIZE      40 /* shadow space for callees, plus alignment */
+#define MOV_ARG_IMM32       0xB9 /* mov ecx, imm32 */
+#define MOV_EAX_ARG         0xC8 /* mov eax, ecx */
+#else
+#define JIT_FRAME_SIZE      8
+#define MOV_ARG_IMM32       0xBF /* mov edi, imm32 */
+#define MOV_EAX_ARG         0xF8 /* mov eax, edi */
+#endif
+
+static u8* out;
+static u8* out_end;
+static u8* exit_stub;
+static u8** entries;
+
+static struct {
+    u8* at;
+    unsigned int index;
+} fixups[2*IMEM_WORDS + 1];
+static unsigned int fixup_count;
+
+static void emit8(unsigned int byte)
+{
+    *out++ = (u8)byte;
+}
+static void emit32(u32 word)
+{
+    memcpy(out, &word, sizeof(word));
+    out += sizeof(word);
+}
+static void emit64(u64 word)
+{
+    memcpy(out, &word, sizeof(word));
+    out += sizeof(word);
+}
+
+/* op reg, dword [rbx + 4*gpr] (or the reverse, for OP_STORE) */
+static void emit_sr(unsigned int op, unsigned int reg, unsigned int gpr)
+{
+    emit8(op);
+    emit8(0x43 | reg << 3);
+    emit8(4 * gpr);
+}
+static void emit_sr_imm(unsigned int gpr, u32 imm)
+{
+    emit8(0xC7);
+    emit8(0x43);
+    emit8(4 * gpr);
+    emit32(imm);
+}
+
+/* op eax, imm32 */
+static void emit_eax_imm(unsigned int op, u32 imm)
+{
+    emit8(op + 0x02);
+    emit32(imm);
+}
+static void emit_shift(unsigned int kind, unsigned int amount)
+{
+    emit8(0xC1);
+    emit8(0xC0 | kind << 3);
+    emit8(amount);
+}
+static void emit_set_edx(unsigned int cc)
+{
+    emit8(0x0F);
+    emit8(0x90 | cc);
+    emit8(0xC2);
+}
+
+/* [rbp + rax], after whatever opcode bytes name the access */
+static void emit_dmem(unsigned int reg)
+{
+    emit8(0x44 | reg << 3);
+    emit8(0x05);
+    emit8(0x00);
+}
+
+static u8* emit_jcc8(unsigned int cc)
+{
+    emit8(0x70 | cc);
+    emit8(0x00);
+    return (out);
+}
+static u8* emit_jmp8(void)
+{
+    emit8(0xEB);
+    emit8(0x00);
+    return (out);
+}
+static void patch8(u8* after)
+{
+    after[-1] = (u8)(out - after);
+}
+static u8* emit_jcc32(unsigned int cc)
+{
+    emit8(0x0F);
+    emit8(0x80 | cc);
+    emit32(0x00000000);
+    return (out);
+}
+static u8* emit_jmp32(void)
+{
+    emit8(0xE9);
+    emit32(0x00000000);
+    return (out);
+}
+static void patch32(u8* after, const u8* target)
+{
+    const i32 relative = (i32)(target - after);
+
+    memcpy(after - 4, &relative, sizeof(relative));
+}
+static void emit_jmp_entry(unsigned int PC)
+{
+    fixups[fixup_count].at = emit_jmp32();
+    fixups[fixup_count].index = FIT_IMEM(PC) / 4;
+    ++fixup_count;
+}
+
+/* jmp [r13 + rax*8] */
+static void emit_dispatch(void)
+{
+    emit8(0x41);
+    emit8(0xFF);
+    emit8(0x64);
+    emit8(0xC5);
+    emit8(0x00);
+}
+
+static void emit_exit(u32 reason, int exit_in_r12, u32 exit_PC)
+{
+    if (reason != 0) {
+        emit8(0xB8);
+        emit32(reason);
+    }
+    if (exit_in_r12) {
+        emit8(0x44); /* mov ecx, r12d */
+        emit8(0x89);
+        emit8(0xE1);
+    } else {
+        emit8(0xB9);
+        emit32(FIT_IMEM(exit_PC));
+    }
+    patch32(emit_jmp32(), exit_stub);
+}
+
+static void emit_call_step(u32 inst)
+{
+    emit8(MOV_ARG_IMM32);
+    emit32(inst);
+    emit8(0x48); /* mov rax, imm64 */
+    emit8(0xB8);
+    emit64((u64)(size_t)su_step);
+    emit8(0xFF); /* call rax */
+    emit8(0xD0);
+}
+
+/* eax = SR[base] + (s16)offset */
+static void emit_address(unsigned int base, u32 inst)
+{
+    emit_sr(OP_LOAD, EAX, base);
+    if ((inst & 0x0000FFFFu) != 0)
+        emit_eax_imm(OP_ADD, (u32)(s16)inst);
+}
+
+/*
+ * Everything but the branches and jumps.  When the instruction word is in a
+ * taken branch's delay slot, an exit from it resumes at the branch target
+ * rather than at the following word.
+ */
+static void emit_scalar(u32 inst, int exit_in_r12, u32 exit_PC)
+{
+    u8* slow;
+    u8* done;
+    const unsigned int rs = (inst >> 21) % (1 << 5);
+    const unsigned int rt = (inst >> 16) % (1 << 5);
+    const unsigned int rd = IW_RD(inst);
+    const unsigned int sa = (inst >>  6) % (1 << 5);
+    const u32 immediate = inst & 0x0000FFFFu;
+
+    switch (inst >> 26) {
+    case 000: /* SPECIAL */
+        switch (inst % 64) {
+        case 000: /* SLL */
+        case 002: /* SRL */
+        case 003: /* SRA */
+            if (rd == zero)
+                return;
+            emit_sr(OP_LOAD, EAX, rt);
+            if (sa != 0)
+                emit_shift(
+                    (inst % 64 == 000) ? SHIFT_LEFT :
+                    (inst % 64 == 002) ? SHIFT_RIGHT : SHIFT_ARITHMETIC, sa
+                );
+            emit_sr(OP_STORE, EAX, rd);
+            return;
+        case 004: /* SLLV */
+        case 006: /* SRLV */
+        case 007: /* SRAV */
+            if (rd == zero)
+                return;
+            emit_sr(OP_LOAD, ECX, rs);
+            emit_sr(OP_LOAD, EAX, rt);
+            emit8(0xD3);
+            emit8(0xC0 | (
+                (inst % 64 == 004) ? SHIFT_LEFT :
+                (inst % 64 == 006) ? SHIFT_RIGHT : SHIFT_ARITHMETIC) << 3
+            );
+            emit_sr(OP_STORE, EAX, rd);
+            return;
+        case 040: /* ADD */
+        case 041: /* ADDU */
+        case 042: /* SUB */
+        case 043: /* SUBU */
+        case 044: /* AND */
+        case 045: /* OR */
+        case 046: /* XOR */
+        case 047: /* NOR */
+            if (rd == zero)
+                return;
+            emit_sr(OP_LOAD, EAX, rs);
+            switch (inst % 64) {
+            case 040:
+            case 041:
+                emit_sr(OP_ADD, EAX, rt);
+                break;
+            case 042:
+            case 043:
+                emit_sr(OP_SUB, EAX, rt);
+                break;
+            case 044:
+                emit_sr(OP_AND, EAX, rt);
+                break;
+            case 045:
+                emit_sr(OP_OR, EAX, rt);
+                break;
+            case 046:
+                emit_sr(OP_XOR, EAX, rt);
+                break;
+            default:
+                emit_sr(OP_OR, EAX, rt);
+                emit8(0xF7); /* not eax */
+                emit8(0xD0);
+            }
+            emit_sr(OP_STORE, EAX, rd);
+            return;
+        case 052: /* SLT */
+        case 053: /* SLTU */
+            if (rd == zero)
+                return;
+            emit_sr(OP_LOAD, EAX, rs);
+            emit8(0x31); /* xor edx, edx */
+            emit8(0xD2);
+            emit_sr(OP_CMP, EAX, rt);
+            emit_set_edx((inst % 64 == 052) ? CC_L : CC_B);
+            emit_sr(OP_STORE, EDX, rd);
+            return;
+        }
+        break; /* BREAK and the reserved function codes */
+    case 010: /* ADDI */
+    case 011: /* ADDIU */
+        if (rt == zero)
+            return;
+        if (rs == zero) {
+            emit_sr_imm(rt, (u32)(s16)immediate);
+            return;
+        }
+        emit_sr(OP_LOAD, EAX, rs);
+        emit_eax_imm(OP_ADD, (u32)(s16)immediate);
+        emit_sr(OP_STORE, EAX, rt);
+        return;
+    case 012: /* SLTI */
+    case 013: /* SLTIU */
+        if (rt == zero)
+            return;
+        emit_sr(OP_LOAD, EAX, rs);
+        emit8(0x31); /* xor edx, edx */
+        emit8(0xD2);
+        emit_eax_imm(OP_CMP, (u32)(s16)immediate);
+        emit_set_edx((inst >> 26 == 012) ? CC_L : CC_B);
+        emit_sr(OP_STORE, EDX, rt);
+        return;
+    case 014: /* ANDI */
+    case 015: /* ORI */
+    case 016: /* XORI */
+        if (rt == zero)
+            return;
+        if (rs == zero) {
+            emit_sr_imm(rt, (inst >> 26 == 014) ? 0x00000000 : immediate);
+            return;
+        }
+        emit_sr(OP_LOAD, EAX, rs);
+        emit_eax_imm(
+            (inst >> 26 == 014) ? OP_AND :
+            (inst >> 26 == 015) ? OP_OR : OP_XOR, immediate
+        );
+        emit_sr(OP_STORE, EAX, rt);
+        return;
+    case 017: /* LUI */
+        if (rt == zero)
+            return;
+        emit_sr_imm(rt, immediate << 16);
+        return;
+    case 040: /* LB */
+    case 044: /* LBU */
+        if (rt == zero)
+            return;
+        emit_address(rs, inst);
+        emit_eax_imm(OP_XOR, ENDIAN_SWAP_BYTE);
+        emit_eax_imm(OP_AND, 0x00000FFFu);
+        emit8(0x0F);
+        emit8((inst >> 26 == 040) ? 0xBE : 0xB6);
+        emit_dmem(EAX);
+        emit_sr(OP_STORE, EAX, rt);
+        return;
+    case 041: /* LH */
+    case 045: /* LHU */
+    case 043: /* LW */
+        if (rt == zero)
+            return;
+        emit_address(rs, inst);
+        emit8(0xA8); /* test al, imm8:  misaligned accesses go the slow way */
+        emit8((inst >> 26 == 043) ? 3 : 1);
+        slow = emit_jcc8(CC_NE);
+        if (inst >> 26 != 043)
+            emit_eax_imm(OP_XOR, ENDIAN_SWAP_HALF);
+        emit_eax_imm(OP_AND, 0x00000FFFu);
+        if (inst >> 26 == 043) {
+            emit8(OP_LOAD);
+        } else {
+            emit8(0x0F);
+            emit8((inst >> 26 == 041) ? 0xBF : 0xB7);
+        }
+        emit_dmem(EAX);
+        emit_sr(OP_STORE, EAX, rt);
+        done = emit_jmp8();
+        patch8(slow);
+        emit_call_step(inst);
+        patch8(done);
+        return;
+    case 050: /* SB */
+        emit_address(rs, inst);
+        emit_sr(OP_LOAD, EDX, rt);
+        emit_eax_imm(OP_XOR, ENDIAN_SWAP_BYTE);
+        emit_eax_imm(OP_AND, 0x00000FFFu);
+        emit8(0x88);
+        emit_dmem(EDX);
+        return;
+    case 051: /* SH */
+    case 053: /* SW */
+        emit_address(rs, inst);
+        emit8(0xA8);
+        emit8((inst >> 26 == 053) ? 3 : 1);
+        slow = emit_jcc8(CC_NE);
+        emit_sr(OP_LOAD, EDX, rt);
+        if (inst >> 26 == 051) {
+            emit_eax_imm(OP_XOR, ENDIAN_SWAP_HALF);
+            emit_eax_imm(OP_AND, 0x00000FFFu);
+            emit8(0x66);
+        } else {
+            emit_eax_imm(OP_AND, 0x00000FFFu);
+        }
+        emit8(OP_STORE);
+        emit_dmem(EDX);
+        done = emit_jmp8();
+        patch8(slow);
+        emit_call_step(inst);
+        patch8(done);
+        return;
+    }
+
+    emit_call_step(inst);
+    if (inst >> 26 == 000 || inst >> 26 == 020) { /* BREAK, or MTC0 */
+        emit8(0x85); /* test eax, eax */
+        emit8(0xC0);
+        done = emit_jcc8(CC_E);
+        emit_exit(0, exit_in_r12, exit_PC);
+        patch8(done);
+    }
+}
+
+static int is_control(u32 inst)
+{
+    switch (inst >> 26) {
+    case 000:
+        return (inst % 64 == 010 || inst % 64 == 011);
+    case 001:
+    case 002:
+    case 003:
+    case 004:
+    case 005:
+    case 006:
+    case 007:
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * The branch at IMEM address `PC', with `slot' in its delay slot.  The
+ * not-taken path falls into the translation of the delay slot word itself,
+ * while the taken path executes its own copy of it before jumping.
+ */
+static void emit_branch(u32 inst, u32 PC, u32 slot)
+{
+    u8* not_taken;
+    const unsigned int rs = (inst >> 21) % (1 << 5);
+    const unsigned int rt = (inst >> 16) % (1 << 5);
+    const u32 link = FIT_IMEM(PC + 8);
+    const u32 target = FIT_IMEM(PC + 4 + 4*(s16)inst);
+
+    switch (inst >> 26) {
+    case 000: /* JR and JALR */
+        if (inst % 64 == 011 && IW_RD(inst) != zero)
+            emit_sr_imm(IW_RD(inst), link);
+        emit_sr(OP_LOAD, EAX, rs);
+        emit_eax_imm(OP_AND, 0x00000FFCu);
+        emit8(0x41); /* mov r12d, eax */
+        emit8(0x89);
+        emit8(0xC4);
+        emit_scalar(slot, 1, 0);
+        emit8(0x44); /* mov eax, r12d */
+        emit8(0x89);
+        emit8(0xE0);
+        emit_shift(SHIFT_RIGHT, 2);
+        emit_dispatch();
+        return;
+    case 001: /* REGIMM */
+        if ((rt & ~020u) > 001) {
+            emit_exit(JIT_EXIT_FALLBACK, 0, PC);
+            return;
+        }
+        if (rt & 020) /* BLTZAL and BGEZAL link before the test. */
+            emit_sr_imm(ra, link);
+        emit_sr(OP_LOAD, EAX, rs);
+        emit8(0x85);
+        emit8(0xC0);
+        not_taken = emit_jcc32((rt & 001) ? CC_S : CC_NS);
+        break;
+    case 002: /* J */
+    case 003: /* JAL */
+        if (inst >> 26 == 003)
+            emit_sr_imm(ra, link);
+        emit_scalar(slot, 0, 4 * inst);
+        emit_jmp_entry(4 * inst);
+        return;
+    case 004: /* BEQ */
+    case 005: /* BNE */
+        if (rs == rt) {
+            if (inst >> 26 == 005)
+                return; /* never taken */
+            emit_scalar(slot, 0, target);
+            emit_jmp_entry(target);
+            return;
+        }
+        emit_sr(OP_LOAD, EAX, rs);
+        emit_sr(OP_CMP, EAX, rt);
+        not_taken = emit_jcc32((inst >> 26 == 004) ? CC_NE : CC_E);
+        break;
+    default: /* BLEZ and BGTZ */
+        emit_sr(OP_LOAD, EAX, rs);
+        emit8(0x85);
+        emit8(0xC0);
+        not_taken = emit_jcc32((inst >> 26 == 006) ? CC_G : CC_LE);
+        break;
+    }
+    emit_scalar(slot, 0, target);
+    emit_jmp_entry(target);
+    patch32(not_taken, out);
+}
+
+static int jit_translate(struct jit_image* image, u8* slot)
+{
+    u8* code;
+    register unsigned int i;
+
+    entries = (u8 **)slot;
+    out = slot + IMEM_WORDS*sizeof(u8 *);
+    out_end = slot + JIT_SLOT_SIZE;
+    fixup_count = 0;
+
+    code = out;
+    emit8(0x53); /* push rbx */
+    emit8(0x55); /* push rbp */
+    emit8(0x41); /* push r12 */
+    emit8(0x54);
+    emit8(0x41); /* push r13 */
+    emit8(0x55);
+    emit8(0x48); /* sub rsp, imm8 */
+    emit8(0x83);
+    emit8(0xEC);
+    emit8(JIT_FRAME_SIZE);
+    emit8(0x48); /* mov rbx, imm64 */
+    emit8(0xBB);
+    emit64((u64)(size_t)SR);
+    emit8(0x48); /* mov rax, imm64 */
+    emit8(0xB8);
+    emit64((u64)(size_t)&DMEM);
+    emit8(0x48); /* mov rbp, [rax] */
+    emit8(0x8B);
+    emit8(0x28);
+    emit8(0x49); /* mov r13, imm64 */
+    emit8(0xBD);
+    emit64((u64)(size_t)entries);
+    emit8(0x89);
+    emit8(MOV_EAX_ARG);
+    emit_eax_imm(OP_AND, 0x00000FFCu);
+    emit_shift(SHIFT_RIGHT, 2);
+    emit_dispatch();
+
+    exit_stub = out; /* eax = reason, ecx = PC */
+    emit_shift(SHIFT_LEFT, 16);
+    emit8(0x09); /* or eax, ecx */
+    emit8(0xC8);
+    emit8(0x48); /* add rsp, imm8 */
+    emit8(0x83);
+    emit8(0xC4);
+    emit8(JIT_FRAME_SIZE);
+    emit8(0x41); /* pop r13 */
+    emit8(0x5D);
+    emit8(0x41); /* pop r12 */
+    emit8(0x5C);
+    emit8(0x5D); /* pop rbp */
+    emit8(0x5B); /* pop rbx */
+    emit8(0xC3); /* ret */
+
+    for (i = 0; i < IMEM_WORDS; i++) {
+        const u32 inst = image->imem[i];
+        const u32 slot_inst = image->imem[(i + 1) % IMEM_WORDS];
+
+        if (out_end - out < JIT_MAX_INST_BYTES)
+            return 0;
+        entries[i] = out;
+        if (!is_control(inst))
+            emit_scalar(inst, 0, 4*i + 4);
+        else if (is_control(slot_inst)) /* left to the interpreter */
+            emit_exit(JIT_EXIT_FALLBACK, 0, 4*i);
+        else
+            emit_branch(inst, 4*i, slot_inst);
+    }
+    emit_jmp_entry(0x000); /* falling off the end of IMEM wraps around */
+
+    for (i = 0; i < fixup_count; i++)
+        patch32(fixups[i].at, entries[fixups[i].index]);
+    memcpy(&image->code, &code, sizeof(image->code));
+    return 1;
+}
+
+/*** translation cache ***/
+
+static int jit_reserve(void)
+{
+    void* memory;
+
+    if (code_memory != NULL)
+        return 1;
+    if (code_memory_failed)
+        return 0;
+#ifdef _WIN32
+    memory = VirtualAlloc(
+        NULL, JIT_SLOTS * JIT_SLOT_SIZE,
+        MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE
+    );
+#else
+    memory = mmap(
+        NULL, JIT_SLOTS * JIT_SLOT_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+#ifdef MAP_JIT
+        MAP_JIT |
+#endif
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+    if (memory == MAP_FAILED)
+        memory = NULL;
+#endif
+    if (memory == NULL) {
+        code_memory_failed = 1;
+        message("Failed to allocate the RSP recompiler cache.");
+        return 0;
+    }
+    code_memory = (u8 *)memory;
+    return 1;
+}
+
+void jit_release(void)
+{
+    if (code_memory != NULL) {
+#ifdef _WIN32
+        VirtualFree(code_memory, 0, MEM_RELEASE);
+#else
+        munmap(code_memory, JIT_SLOTS * JIT_SLOT_SIZE);
+#endif
+    }
+    code_memory = NULL;
+    code_memory_failed = 0;
+    memset(images, 0, sizeof(images));
+    memset(sightings, 0, sizeof(sightings));
+}
+
+static struct jit_image* jit_lookup(void)
+{
+    struct jit_image* victim;
+    struct jit_sighting* seen;
+    const u64 hash = hash_IMEM();
+    register unsigned int i;
+
+    victim = &images[0];
+    for (i = 0; i < JIT_SLOTS; i++) {
+        struct jit_image* image = &images[i];
+
+        if (image->valid && image->hash == hash
+         && memcmp(image->imem, IMEM, sizeof(image->imem)) == 0) {
+            image->last_used = ++use_clock;
+            return (image);
+        }
+        if (!victim->valid)
+            continue;
+        if (!image->valid || image->last_used < victim->last_used)
+            victim = image;
+    }
+
+    seen = NULL;
+    for (i = 0; i < JIT_SIGHTINGS; i++)
+        if (sightings[i].count != 0 && sightings[i].hash == hash)
+            seen = &sightings[i];
+    if (seen == NULL) {
+        seen = &sightings[next_sighting++ % JIT_SIGHTINGS];
+        seen->hash = hash;
+        seen->count = 0;
+    }
+    if (seen->count < 0 || ++(seen->count) < JIT_HOT_SIGHTINGS)
+        return NULL;
+
+    memcpy(victim->imem, IMEM, sizeof(victim->imem));
+    victim->hash = hash;
+    victim->valid = jit_translate(
+        victim, code_memory + JIT_SLOT_SIZE*(victim - &images[0])
+    );
+    if (!victim->valid) {
+        seen->count = -1;
+        return NULL;
+    }
+    victim->last_used = ++use_clock;
+    return (victim);
+}
+
+int jit_run_task(void)
+{
+    struct jit_image* image;
+    u32 PC, status;
+
+    PC = FIT_IMEM(GET_RCP_REG(SP_PC_REG));
+    if (!jit_reserve())
+        return 0;
+    while ((image = jit_lookup()) != NULL) {
+        status = image->code(PC);
+        PC = FIT_IMEM(status);
+        if (status & (SU_STEP_HALTED << 16)) {
+            GET_RCP_REG(SP_PC_REG) = 0x04001000 | PC;
+            return 1;
+        }
+        if (status & (JIT_EXIT_FALLBACK << 16))
+            break;
+     /* Otherwise, IMEM was overwritten under the running image. */
+    }
+    GET_RCP_REG(SP_PC_REG) = 0x04001000 | PC;
+    return 0;
+}
+
+#endif
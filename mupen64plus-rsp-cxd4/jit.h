@@ -0,0 +1,52 @@
+/******************************************************************************\
+* Project:  Dynamic Recompiler for Scalar Unit Microcode Images                *
+* Release:  2026.10.19                                                         *
+* License:  CC0 Public Domain Dedication                                       *
+*                                                                              *
+* To the extent possible under law, the author(s) have dedicated all copyright *
+* and related and neighboring rights to this software to the public domain     *
+* worldwide. This software is distributed without any warranty.                *
+*                                                                              *
+* You should have received a copy of the CC0 Public Domain Dedication along    *
+* with this software.                                                          *
+* If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.             *
+\******************************************************************************/
+
+#ifndef _JIT_H_
+#define _JIT_H_
+
+#include "su.h"
+
+/*
+ * IMEM is only 4 KiB, so rather than discovering blocks as they execute, the
+ * whole image is translated at once to x86-64 code with one entry point per
+ * instruction word.  Scalar ALU operations, branches and the common aligned
+ * scalar loads and stores are emitted inline against SR[] and DMEM; the rest
+ * (COP0, vector unit operations and LWC2/SWC2) are calls to su_step().
+ *
+ * The recompiler depends on the static-PC model of run_task() for its delay
+ * slot handling, and on a little-endian host for its DMEM addressing.
+ */
+#if defined(EMULATE_STATIC_PC) && !defined(SP_EXECUTE_LOG)
+#if defined(__x86_64__) || defined(_M_X64)
+#define SU_JIT
+#endif
+#endif
+
+#ifdef SU_JIT
+/*
+ * Run the current task from SP_PC_REG with translated code.
+ *
+ * Returns nonzero once the RSP has halted.  Returns zero if the task could
+ * not be run to completion natively, in which case SP_PC_REG holds the
+ * address from which the interpreter has to resume.
+ */
+extern int jit_run_task(void);
+
+/*
+ * Release the translation cache and its executable memory.
+ */
+extern void jit_release(void);
+#endif
+
+#endif
@@ -26,6 +26,7 @@
 
 #include "module.c"
 #include "su.c"
+#include "jit.c"
 
 #include "vu/vu.c"
 
@@ -7,6 +7,7 @@ obj="$src/obj"
 OBJ_LIST="\
     $obj/module.o \
     $obj/su.o \
+    $obj/jit.o \
     $obj/vu/vu.o \
     $obj/vu/multiply.o \
     $obj/vu/add.o \
@@ -49,6 +50,7 @@ C_FLAGS=$FLAGS_x86 # default since Intel SIMD was the most tested
 echo Compiling C source code...
 cc -S -Os $C_FLAGS -o $obj/module.s  $src/module.c
 cc -S -O3 $C_FLAGS -o $obj/su.s      $src/su.c
+cc -S -O2 $C_FLAGS -o $obj/jit.s     $src/jit.c
 cc -S -O3 $C_FLAGS -o $obj/vu/vu.s       $src/vu/vu.c
 cc -S -O3 $C_FLAGS -o $obj/vu/multiply.s $src/vu/multiply.c
 cc -S -O3 $C_FLAGS -o $obj/vu/add.s      $src/vu/add.c
@@ -59,6 +61,7 @@ cc -S -O2 $C_FLAGS -o $obj/vu/divide.s   $src/vu/divide.c
 echo Assembling compiled sources...
 as -o $obj/module.o $obj/module.s
 as -o $obj/su.o     $obj/su.s
+as -o $obj/jit.o    $obj/jit.s
 as -o $obj/vu/vu.o  $obj/vu/vu.s
 as -o $obj/vu/multiply.o $obj/vu/multiply.s
 as -o $obj/vu/add.o      $obj/vu/add.s
@@ -24,6 +24,7 @@ set obj=%rsp%\obj
 set OBJ_LIST=^
  "%obj%\module.o"^
  "%obj%\su.o"^
+ "%obj%\jit.o"^
  "%obj%\vu\vu.o"^
  "%obj%\vu\multiply.o"^
  "%obj%\vu\add.o"^
@@ -54,6 +55,7 @@ ECHO Compiling C source code...
 @ECHO ON
 gcc -S -Os %C_FLAGS% -o "%obj%\module.asm"      "%rsp%\module.c"
 gcc -S -O3 %C_FLAGS% -o "%obj%\su.asm"          "%rsp%\su.c"
+gcc -S -O2 %C_FLAGS% -o "%obj%\jit.asm"         "%rsp%\jit.c"
 gcc -S -O3 %C_FLAGS% -o "%obj%\vu\vu.asm"       "%rsp%\vu\vu.c"
 gcc -S -O3 %C_FLAGS% -o "%obj%\vu\multiply.asm" "%rsp%\vu\multiply.c"
 gcc -S -O3 %C_FLAGS% -o "%obj%\vu\add.asm"      "%rsp%\vu\add.c"
@@ -66,6 +68,7 @@ ECHO.
 ECHO Assembling compiled sources...
 as -o "%obj%\module.o"            "%obj%\module.asm"
 as -o "%obj%\su.o"                "%obj%\su.asm"
+as -o "%obj%\jit.o"               "%obj%\jit.asm"
 as -o "%obj%\vu\vu.o"             "%obj%\vu\vu.asm"
 as -o "%obj%\vu\multiply.o"       "%obj%\vu\multiply.asm"
 as -o "%obj%\vu\add.o"            "%obj%\vu\add.asm"
@@ -30,6 +30,7 @@
 
 #include "module.h"
 #include "su.h"
+#include "jit.h"
 
 #include "m64p_common.h"
 
@@ -92,6 +93,7 @@ NOINLINE void update_conf(const char* source)
     CFG_HLE_AUD = ConfigGetParamBool(l_ConfigRsp, "AudioListToAudioPlugin");
     CFG_WAIT_FOR_CPU_HOST = ConfigGetParamBool(l_ConfigRsp, "WaitForCPUHost");
     CFG_MEND_SEMAPHORE_LOCK = ConfigGetParamBool(l_ConfigRsp, "SupportCPUSemaphoreLock");
+    CFG_DYNAREC = ConfigGetParamBool(l_ConfigRsp, "DynamicRecompiler");
 }
 
 static void DebugMessage(int level, const char *message, ...) ATTR_FMT(2, 3);
@@ -196,6 +198,7 @@ EXPORT m64p_error CALL PluginStartup(m64p_dynlib_handle CoreLibHandle, void *Con
     ConfigSetDefaultBool(l_ConfigRsp, "AudioListToAudioPlugin", 0, "Send audio lists to the audio plugin");
     ConfigSetDefaultBool(l_ConfigRsp, "WaitForCPUHost", 0, "Force CPU-RSP signals synchronization");
     ConfigSetDefaultBool(l_ConfigRsp, "SupportCPUSemaphoreLock", 0, "Support CPU-RSP semaphore lock");
+    ConfigSetDefaultBool(l_ConfigRsp, "DynamicRecompiler", 1, "Translate recurring microcode to native code where supported");
 
     l_PluginInit = 1;
     return M64ERR_SUCCESS;
@@ -206,6 +209,9 @@ EXPORT m64p_error CALL PluginShutdown(void)
     if (!l_PluginInit)
         return M64ERR_NOT_INIT;
 
+#ifdef SU_JIT
+    jit_release();
+#endif
     l_PluginInit = 0;
     return M64ERR_SUCCESS;
 }
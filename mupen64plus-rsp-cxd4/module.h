@@ -66,6 +66,12 @@ typedef enum {
 #define CFG_MEND_SEMAPHORE_LOCK     (*(pi32)(conf + 0x14))
 #define CFG_TRACE_RSP_REGISTERS     (*(pi32)(conf + 0x18))
 
+/*
+ * Translate recurring microcode images to native code instead of
+ * interpreting them (only where jit.h defines SU_JIT).
+ */
+#define CFG_DYNAREC                 (*(pi32)(conf + 0x1C))
+
 /*
  * Update RSP configuration memory from local file resource.
  */
@@ -20,6 +20,7 @@
  * Some of the parallel timing features require perfect timing or configs.
  */
 #include "module.h"
+#include "jit.h"
 
 /* memcpy() and memset() in SP DMA */
 #include <string.h>
@@ -34,6 +35,12 @@ pu8 DMEM;
 pu8 IMEM;
 unsigned long su_max_address = 0x007FFFFFul;
 
+/*
+ * Set whenever an SP DMA read lands in IMEM, so that the dynamic recompiler
+ * knows its translation of the current microcode image has gone stale.
+ */
+static int imem_written;
+
 static int temp_PC;
 
 NOINLINE void res_S(void)
@@ -215,6 +222,7 @@ MT_CMD_CLOCK       ,MT_READ_ONLY       ,MT_READ_ONLY       ,MT_READ_ONLY
 void SP_DMA_READ(void)
 {
     unsigned int offC, offD; /* SP cache and dynamic DMA pointers */
+    unsigned int touched;
     register unsigned int length;
     register unsigned int count;
     register unsigned int skip;
@@ -228,6 +236,7 @@ void SP_DMA_READ(void)
     ++length;
     ++count;
     skip += length;
+    touched = 0x00000000;
     do {
         register unsigned int i;
 
@@ -236,6 +245,7 @@ void SP_DMA_READ(void)
         do {
             offC = (count*length + *CR[0x0] + i) & 0x00001FF8ul;
             offD = (count*skip + *CR[0x1] + i) & 0x00FFFFF8ul;
+            touched |= offC;
             i += 0x008;
             if (offD > su_max_address) {
                 memset(DMEM + offC, 0x00, 8);
@@ -245,6 +255,8 @@ void SP_DMA_READ(void)
         } while (i < length);
     } while (count);
 
+    if (touched & 0x1000)
+        imem_written = 1;
     if ((*CR[0x0] ^ offC) & 0x1000)
         message("DMA over the DMEM-to-IMEM gap.");
     GET_RCP_REG(SP_DMA_BUSY_REG)  =  0x00000000;
@@ -1954,6 +1966,540 @@ PROFILE_MODE void COP2(u32 inst)
     }
 }
 
+/*
+ * Execute one instruction word that does not change the flow of control.
+ * The dynamic recompiler calls this for everything it does not emit inline.
+ */
+int su_step(u32 inst)
+{
+    int status;
+
+    status = 0;
+    imem_written = 0;
+    inst_word = inst; /* Some vector divides re-decode from this. */
+    switch (inst >> 26) {
+    case 000: /* SPECIAL:  BREAK, or one of the reserved function codes */
+        if (SPECIAL(inst, 0x000) < 0)
+            status |= SU_STEP_HALTED;
+        break;
+    case 010:
+    case 011:
+        ADDIU(inst);
+        break;
+    case 012:
+        SLTI(inst);
+        break;
+    case 013:
+        SLTIU(inst);
+        break;
+    case 014:
+        ANDI(inst);
+        break;
+    case 015:
+        ORI(inst);
+        break;
+    case 016:
+        XORI(inst);
+        break;
+    case 017:
+        LUI(inst);
+        break;
+    case 020:
+        COP0(inst);
+        if (GET_RCP_REG(SP_STATUS_REG) & SP_STATUS_HALT)
+            status |= SU_STEP_HALTED;
+        break;
+    case 022:
+        COP2(inst);
+        break;
+    case 040:
+        LB(inst);
+        break;
+    case 041:
+        LH(inst);
+        break;
+    case 043:
+        LW(inst);
+        break;
+    case 044:
+        LBU(inst);
+        break;
+    case 045:
+        LHU(inst);
+        break;
+    case 050:
+        SB(inst);
+        break;
+    case 051:
+        SH(inst);
+        break;
+    case 053:
+        SW(inst);
+        break;
+    case 062: /* LWC2 */
+        MWC2_load(inst);
+        break;
+    case 072: /* SWC2 */
+        MWC2_store(inst);
+        break;
+    default:
+        res_S();
+    }
+    if (imem_written)
+        status |= SU_STEP_IMEM_WRITTEN;
+    return (status);
+}
+
+u64 hash_IMEM(void)
+{
+    u64 hash;
+    register unsigned int i;
+
+    hash = 0xCBF29CE484222325ull;
+    for (i = 0; i < 4096; i += 4) {
+        hash ^= *(pi32)(IMEM + i);
+        hash *= 0x00000100000001B3ull;
+    }
+    return (hash);
+}
+
+#ifdef PREDECODE_IMEM
+/*
+ * pre-decoded microcode images
+ *
+ * Every instruction word in IMEM is decoded once into the handler to run for
+ * it and its register and immediate operands.  Handlers return what the task
+ * loop has to do next; branches still get their delayed target from set_PC().
+ */
+enum {
+    OP_NEXT,
+    OP_JUMP, /* Execute the delay slot, then continue at temp_PC. */
+    OP_HALT,
+    OP_RELOAD /* IMEM was overwritten by DMA. */
+};
+
+typedef struct su_op su_op;
+typedef int (*su_handler)(const su_op* op, u32 PC);
+struct su_op {
+    su_handler handler;
+    u32 inst;
+    u32 imm; /* extended immediate, shift amount or branch offset */
+    u8 rd, rs, rt;
+};
+
+#define DECODED_IMAGES      8
+
+static struct {
+    u64 hash;
+    u32 last_used;
+    int valid;
+    u32 imem[4096 / 4];
+    su_op ops[4096 / 4];
+} decoded[DECODED_IMAGES];
+static u32 decode_clock;
+
+static int op_NOP(const su_op* op, u32 PC)
+{
+    return OP_NEXT;
+}
+static int op_reserved(const su_op* op, u32 PC)
+{
+    res_S();
+    return OP_NEXT;
+}
+
+static int op_SLL(const su_op* op, u32 PC)
+{
+    SR[op->rd] = SR[op->rt] << op->imm;
+    return OP_NEXT;
+}
+static int op_SRL(const su_op* op, u32 PC)
+{
+    SR[op->rd] = (u32)(SR[op->rt]) >> op->imm;
+    return OP_NEXT;
+}
+static int op_SRA(const su_op* op, u32 PC)
+{
+    SR[op->rd] = (s32)(SR[op->rt]) >> op->imm;
+    return OP_NEXT;
+}
+static int op_SLLV(const su_op* op, u32 PC)
+{
+    SR[op->rd] = SR[op->rt] << MASK_SA(SR[op->rs]);
+    return OP_NEXT;
+}
+static int op_SRLV(const su_op* op, u32 PC)
+{
+    SR[op->rd] = (u32)(SR[op->rt]) >> MASK_SA(SR[op->rs]);
+    return OP_NEXT;
+}
+static int op_SRAV(const su_op* op, u32 PC)
+{
+    SR[op->rd] = (s32)(SR[op->rt]) >> MASK_SA(SR[op->rs]);
+    return OP_NEXT;
+}
+static int op_JR(const su_op* op, u32 PC)
+{
+    set_PC(SR[op->rs]);
+    return OP_JUMP;
+}
+static int op_JALR(const su_op* op, u32 PC)
+{
+    SR[op->rd] = FIT_IMEM(PC + LINK_OFF);
+    SR[zero] = 0x00000000;
+    set_PC(SR[op->rs]);
+    return OP_JUMP;
+}
+static int op_SPECIAL(const su_op* op, u32 PC)
+{ /* BREAK, or one of the reserved function codes */
+    return (SPECIAL(op->inst, PC) < 0) ? OP_HALT : OP_NEXT;
+}
+static int op_ADDU(const su_op* op, u32 PC)
+{
+    SR[op->rd] = SR[op->rs] + SR[op->rt];
+    return OP_NEXT;
+}
+static int op_SUBU(const su_op* op, u32 PC)
+{
+    SR[op->rd] = SR[op->rs] - SR[op->rt];
+    return OP_NEXT;
+}
+static int op_AND(const su_op* op, u32 PC)
+{
+    SR[op->rd] = SR[op->rs] & SR[op->rt];
+    return OP_NEXT;
+}
+static int op_OR(const su_op* op, u32 PC)
+{
+    SR[op->rd] = SR[op->rs] | SR[op->rt];
+    return OP_NEXT;
+}
+static int op_XOR(const su_op* op, u32 PC)
+{
+    SR[op->rd] = SR[op->rs] ^ SR[op->rt];
+    return OP_NEXT;
+}
+static int op_NOR(const su_op* op, u32 PC)
+{
+    SR[op->rd] = ~(SR[op->rs] | SR[op->rt]);
+    return OP_NEXT;
+}
+static int op_SLT(const su_op* op, u32 PC)
+{
+    SR[op->rd] = ((s32)(SR[op->rs]) < (s32)(SR[op->rt]));
+    return OP_NEXT;
+}
+static int op_SLTU(const su_op* op, u32 PC)
+{
+    SR[op->rd] = ((u32)(SR[op->rs]) < (u32)(SR[op->rt]));
+    return OP_NEXT;
+}
+
+static int op_REGIMM(const su_op* op, u32 PC)
+{
+    return (REGIMM(op->inst, PC) != 0) ? OP_JUMP : OP_NEXT;
+}
+static int op_J(const su_op* op, u32 PC)
+{
+    set_PC(op->imm);
+    return OP_JUMP;
+}
+static int op_JAL(const su_op* op, u32 PC)
+{
+    SR[ra] = FIT_IMEM(PC + LINK_OFF);
+    set_PC(op->imm);
+    return OP_JUMP;
+}
+static int op_BEQ(const su_op* op, u32 PC)
+{
+    if (!(SR[op->rs] == SR[op->rt]))
+        return OP_NEXT;
+    set_PC(PC + op->imm);
+    return OP_JUMP;
+}
+static int op_BNE(const su_op* op, u32 PC)
+{
+    if (!(SR[op->rs] != SR[op->rt]))
+        return OP_NEXT;
+    set_PC(PC + op->imm);
+    return OP_JUMP;
+}
+static int op_BLEZ(const su_op* op, u32 PC)
+{
+    if (!((s32)SR[op->rs] <= 0))
+        return OP_NEXT;
+    set_PC(PC + op->imm);
+    return OP_JUMP;
+}
+static int op_BGTZ(const su_op* op, u32 PC)
+{
+    if (!((s32)SR[op->rs] > 0))
+        return OP_NEXT;
+    set_PC(PC + op->imm);
+    return OP_JUMP;
+}
+
+static int op_ADDIU(const su_op* op, u32 PC)
+{
+    SR[op->rt] = SR[op->rs] + op->imm;
+    return OP_NEXT;
+}
+static int op_SLTI(const su_op* op, u32 PC)
+{
+    SR[op->rt] = ((s32)(SR[op->rs]) < (s32)(op->imm)) ? 1 : 0;
+    return OP_NEXT;
+}
+static int op_SLTIU(const su_op* op, u32 PC)
+{
+    SR[op->rt] = ((u32)(SR[op->rs]) < (u32)(op->imm)) ? 1 : 0;
+    return OP_NEXT;
+}
+static int op_ANDI(const su_op* op, u32 PC)
+{
+    SR[op->rt] = SR[op->rs] & op->imm;
+    return OP_NEXT;
+}
+static int op_ORI(const su_op* op, u32 PC)
+{
+    SR[op->rt] = SR[op->rs] | op->imm;
+    return OP_NEXT;
+}
+static int op_XORI(const su_op* op, u32 PC)
+{
+    SR[op->rt] = SR[op->rs] ^ op->imm;
+    return OP_NEXT;
+}
+static int op_LUI(const su_op* op, u32 PC)
+{
+    SR[op->rt] = op->imm;
+    return OP_NEXT;
+}
+
+static int op_COP0(const su_op* op, u32 PC)
+{
+    imem_written = 0;
+    COP0(op->inst);
+    if (GET_RCP_REG(SP_STATUS_REG) & SP_STATUS_HALT)
+        return OP_HALT;
+    return (imem_written) ? OP_RELOAD : OP_NEXT;
+}
+static int op_COP2(const su_op* op, u32 PC)
+{
+    inst_word = op->inst; /* Some vector divides re-decode from this. */
+    COP2(op->inst);
+    return OP_NEXT;
+}
+
+static int op_LB(const su_op* op, u32 PC)
+{
+    LB(op->inst);
+    return OP_NEXT;
+}
+static int op_LH(const su_op* op, u32 PC)
+{
+    LH(op->inst);
+    return OP_NEXT;
+}
+static int op_LW(const su_op* op, u32 PC)
+{
+    LW(op->inst);
+    return OP_NEXT;
+}
+static int op_LBU(const su_op* op, u32 PC)
+{
+    LBU(op->inst);
+    return OP_NEXT;
+}
+static int op_LHU(const su_op* op, u32 PC)
+{
+    LHU(op->inst);
+    return OP_NEXT;
+}
+static int op_SB(const su_op* op, u32 PC)
+{
+    SB(op->inst);
+    return OP_NEXT;
+}
+static int op_SH(const su_op* op, u32 PC)
+{
+    SH(op->inst);
+    return OP_NEXT;
+}
+static int op_SW(const su_op* op, u32 PC)
+{
+    SW(op->inst);
+    return OP_NEXT;
+}
+static int op_LWC2(const su_op* op, u32 PC)
+{
+    MWC2_load(op->inst);
+    return OP_NEXT;
+}
+static int op_SWC2(const su_op* op, u32 PC)
+{
+    MWC2_store(op->inst);
+    return OP_NEXT;
+}
+
+static const su_handler special_handlers[64] = {
+    op_SLL     ,op_SPECIAL ,op_SRL     ,op_SRA     ,
+    op_SLLV    ,op_SPECIAL ,op_SRLV    ,op_SRAV    ,
+    op_JR      ,op_JALR    ,op_SPECIAL ,op_SPECIAL ,
+    op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,
+    op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,
+    op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,
+    op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,
+    op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,
+    op_ADDU    ,op_ADDU    ,op_SUBU    ,op_SUBU    ,
+    op_AND     ,op_OR      ,op_XOR     ,op_NOR     ,
+    op_SPECIAL ,op_SPECIAL ,op_SLT     ,op_SLTU    ,
+    op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,
+    op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,
+    op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,
+    op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,
+    op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,op_SPECIAL ,
+};
+
+static const su_handler primary_handlers[64] = {
+    op_SPECIAL ,op_REGIMM  ,op_J       ,op_JAL     ,
+    op_BEQ     ,op_BNE     ,op_BLEZ    ,op_BGTZ    ,
+    op_ADDIU   ,op_ADDIU   ,op_SLTI    ,op_SLTIU   ,
+    op_ANDI    ,op_ORI     ,op_XORI    ,op_LUI     ,
+    op_COP0    ,op_reserved,op_COP2    ,op_reserved,
+    op_reserved,op_reserved,op_reserved,op_reserved,
+    op_reserved,op_reserved,op_reserved,op_reserved,
+    op_reserved,op_reserved,op_reserved,op_reserved,
+    op_LB      ,op_LH      ,op_reserved,op_LW      ,
+    op_LBU     ,op_LHU     ,op_reserved,op_reserved,
+    op_SB      ,op_SH      ,op_reserved,op_SW      ,
+    op_reserved,op_reserved,op_reserved,op_reserved,
+    op_reserved,op_reserved,op_LWC2    ,op_reserved,
+    op_reserved,op_reserved,op_reserved,op_reserved,
+    op_reserved,op_reserved,op_SWC2    ,op_reserved,
+    op_reserved,op_reserved,op_reserved,op_reserved,
+};
+
+static void decode_op(su_op* op, u32 inst)
+{
+    const unsigned int opcode = inst >> 26;
+
+    op->inst = inst;
+    op->rs = (inst >> 21) % (1 << 5);
+    op->rt = (inst >> 16) % (1 << 5);
+    op->rd = IW_RD(inst);
+    if (opcode == 000) {
+        op->handler = special_handlers[inst % 64];
+        op->imm = (inst >> 6) % (1 << 5);
+        if (op->rd == zero && op->handler != op_JR && op->handler != op_JALR
+         && op->handler != op_SPECIAL)
+            op->handler = op_NOP;
+        return;
+    }
+
+    op->handler = primary_handlers[opcode];
+    switch (opcode) {
+    case 002: /* J */
+    case 003: /* JAL */
+        op->imm = 4 * inst;
+        return;
+    case 004: /* BEQ */
+    case 005: /* BNE */
+    case 006: /* BLEZ */
+    case 007: /* BGTZ */
+        op->imm = 4*inst + SLOT_OFF;
+        return;
+    case 010:
+    case 011:
+    case 012:
+    case 013:
+        op->imm = (u32)SIGNED_IMM16(inst & 0x0000FFFFu);
+        break;
+    case 014:
+    case 015:
+    case 016:
+        op->imm = inst & 0x0000FFFFu;
+        break;
+    case 017:
+        op->imm = (inst & 0x0000FFFFu) << 16;
+        break;
+    case 040:
+    case 041:
+    case 043:
+    case 044:
+    case 045:
+        op->imm = 0;
+        break;
+    default:
+        op->imm = 0;
+        return;
+    }
+    if (op->rt == zero) /* ALU operations and loads with no effect */
+        op->handler = op_NOP;
+}
+
+/*
+ * Find or make the decoding of the image currently in IMEM.
+ */
+static const su_op* decoded_IMEM(void)
+{
+    register unsigned int i;
+    const u64 hash = hash_IMEM();
+    unsigned int victim;
+
+    victim = 0;
+    for (i = 0; i < DECODED_IMAGES; i++) {
+        if (decoded[i].valid && decoded[i].hash == hash
+         && memcmp(decoded[i].imem, IMEM, sizeof(decoded[i].imem)) == 0) {
+            decoded[i].last_used = ++decode_clock;
+            return (decoded[i].ops);
+        }
+        if (!decoded[victim].valid)
+            continue;
+        if (!decoded[i].valid || decoded[i].last_used < decoded[victim].last_used)
+            victim = i;
+    }
+
+    memcpy(decoded[victim].imem, IMEM, sizeof(decoded[victim].imem));
+    for (i = 0; i < 4096 / 4; i++)
+        decode_op(&decoded[victim].ops[i], decoded[victim].imem[i]);
+    decoded[victim].hash = hash;
+    decoded[victim].valid = 1;
+    decoded[victim].last_used = ++decode_clock;
+    return (decoded[victim].ops);
+}
+
+NOINLINE void run_task(void)
+{
+    const su_op* ops;
+    const su_op* op;
+    register u32 PC;
+
+#ifdef SU_JIT
+    if (CFG_DYNAREC != 0 && jit_run_task() != 0)
+        return;
+#endif
+    ops = decoded_IMEM();
+    PC = FIT_IMEM(GET_RCP_REG(SP_PC_REG));
+    for (;;) {
+        op = &ops[PC / 4];
+        PC = FIT_IMEM(PC + 0x004);
+EX:
+        switch (op->handler(op, PC)) {
+        case OP_NEXT:
+            continue;
+        case OP_JUMP:
+            op = &ops[PC / 4];
+            PC = FIT_IMEM(temp_PC);
+            goto EX;
+        case OP_RELOAD:
+            ops = decoded_IMEM();
+            continue;
+        }
+        break;
+    }
+    GET_RCP_REG(SP_PC_REG) = 0x04001000 | FIT_IMEM(PC);
+}
+#else
 NOINLINE void run_task(void)
 {
     register u32 PC;
@@ -2096,3 +2642,4 @@ RSP_halted_CPU_exit_point:
 
     return;
 }
+#endif
@@ -69,6 +69,15 @@ extern unsigned long su_max_address;
 #define EMULATE_STATIC_PC
 #endif
 
+/*
+ * Decode each microcode image found in IMEM only once, into an array of
+ * handler and operand entries cached by a hash of IMEM, rather than decoding
+ * every instruction word over again on every task.
+ */
+#if defined(EMULATE_STATIC_PC) && !defined(SP_EXECUTE_LOG)
+#define PREDECODE_IMEM
+#endif
+
 #if (0 != 0)
 #define PROFILE_MODE    static NOINLINE
 #else
@@ -388,6 +397,20 @@ extern void LTV(unsigned vt, unsigned element, signed offset, unsigned base);
 extern void SWV(unsigned vt, unsigned element, signed offset, unsigned base);
 extern void STV(unsigned vt, unsigned element, signed offset, unsigned base);
 
+/*
+ * su_step() status bits:  the RSP halted itself (BREAK or a write to the
+ * SP_STATUS halt bit), and/or an SP DMA read has overwritten part of IMEM.
+ */
+#define SU_STEP_HALTED          0x00000001
+#define SU_STEP_IMEM_WRITTEN    0x00000002
+
+extern int su_step(u32 inst);
+
+/*
+ * 64-bit FNV-1a hash of the instruction words in IMEM, for looking up cached
+ * decodings or translations of the current microcode image
+ */
+extern u64 hash_IMEM(void);
 NOINLINE extern void run_task(void);
 
 #endif
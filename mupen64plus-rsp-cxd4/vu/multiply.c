@@ -28,6 +28,85 @@
         _mm_xor_si128(src, _mm_setmin_epi16())  \
     )
 
+#ifdef ARCH_MIN_AVX2
+/*
+ * With AVX2, all eight accumulator elements' bits 47..16 fit in one register
+ * as 32-bit integers, so the multiply-accumulate operations add the whole
+ * product at once rather than chaining carries through VACC_M into VACC_H.
+ * Only VACC_L still needs the 16-bit carry out of it detected.
+ */
+static INLINE __m256i acc_load_upper(void)
+{
+    const v16 acc_md = *(v16 *)VACC_M;
+    const v16 acc_hi = *(v16 *)VACC_H;
+
+    return _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_unpacklo_epi16(acc_md, acc_hi)),
+        _mm_unpackhi_epi16(acc_md, acc_hi), 1
+    );
+}
+
+static INLINE v16 narrow_saturate(__m256i words)
+{ /* signed clamp of each 32-bit element to 16 bits */
+    words = _mm256_packs_epi32(words, words);
+    words = _mm256_permute4x64_epi64(words, 0x08);
+    return _mm256_castsi256_si128(words);
+}
+static INLINE v16 narrow_low(__m256i words)
+{ /* bits 15..0 of each 32-bit element */
+    words = _mm256_srai_epi32(_mm256_slli_epi32(words, 16), 16);
+    return narrow_saturate(words);
+}
+static INLINE v16 narrow_high(__m256i words)
+{ /* bits 31..16 of each 32-bit element */
+    return narrow_saturate(_mm256_srai_epi32(words, 16));
+}
+
+/*
+ * accumulator += (upper << 16) + (u16)lower
+ * Returns the new accumulator bits 47..16.
+ */
+static INLINE __m256i acc_add(__m256i upper, v16 lower)
+{
+    __m256i acc;
+    v16 acc_lo, carry;
+
+    acc_lo = _mm_add_epi16(*(v16 *)VACC_L, lower);
+    carry = _mm_cmplt_epu16(acc_lo, lower); /* ~0 (-1) if carry out */
+    *(v16 *)VACC_L = acc_lo;
+
+    acc = _mm256_add_epi32(acc_load_upper(), upper);
+    acc = _mm256_sub_epi32(acc, _mm256_cvtepi16_epi32(carry));
+    *(v16 *)VACC_M = narrow_low(acc);
+    *(v16 *)VACC_H = narrow_high(acc);
+    return (acc);
+}
+
+/*
+ * the VM?DL and VM?DN clamp:  acc 15..0 if acc 47..16 fits in 16 bits,
+ * otherwise the signed clamp of acc 47..16 with its sign bit flipped
+ */
+static INLINE v16 clamp_low(__m256i acc)
+{
+    v16 clamped, in_range;
+
+    clamped = narrow_saturate(acc);
+    in_range = _mm_cmpeq_epi16(*(v16 *)VACC_M, clamped);
+    clamped = _mm_andnot_si128(in_range, clamped);
+    clamped = _mm_or_si128(clamped, _mm_and_si128(in_range, *(v16 *)VACC_L));
+    in_range = _mm_xor_si128(in_range, _mm_allones_si128());
+    return _mm_xor_si128(clamped, _mm_slli_epi16(in_range, 15));
+}
+
+/* 32-bit products of (s16)vs * (s16)vt, without needing VPMULLD */
+static INLINE __m256i product_ss(v16 vs, v16 vt)
+{
+    return _mm256_madd_epi16(
+        _mm256_cvtepu16_epi32(vs), _mm256_cvtepi16_epi32(vt)
+    );
+}
+#endif
+
 #else
 
 static INLINE void SIGNED_CLAMP_AM(pi16 VD)
@@ -354,7 +433,17 @@ VECTOR_OPERATION VMUDH(v16 vs, v16 vt)
 
 VECTOR_OPERATION VMACF(v16 vs, v16 vt)
 {
-#ifdef ARCH_MIN_SSE2
+#if defined(ARCH_MIN_AVX2)
+    const __m256i product = product_ss(vs, vt);
+    __m256i acc;
+
+    /* fractional adjustment:  acc += product << 1 */
+    acc = acc_add(
+        _mm256_srai_epi32(product, 15),
+        narrow_low(_mm256_slli_epi32(product, 1))
+    );
+    return narrow_saturate(acc);
+#elif defined(ARCH_MIN_SSE2)
     v16 acc_hi, acc_md, acc_lo;
     v16 prod_hi, prod_lo;
     v16 overflow, overflow_new;
@@ -421,7 +510,20 @@ VECTOR_OPERATION VMACF(v16 vs, v16 vt)
 
 VECTOR_OPERATION VMACU(v16 vs, v16 vt)
 {
-#ifdef ARCH_MIN_SSE2
+#if defined(ARCH_MIN_AVX2)
+    const __m256i product = product_ss(vs, vt);
+    __m256i acc;
+    v16 overflow;
+
+    acc = acc_add(
+        _mm256_srai_epi32(product, 15),
+        narrow_low(_mm256_slli_epi32(product, 1))
+    );
+    vs = narrow_saturate(acc);
+    overflow = _mm_cmplt_epi16(*(v16 *)VACC_M, vs);
+    vs = _mm_andnot_si128(_mm_srai_epi16(vs, 15), vs);
+    return _mm_or_si128(vs, overflow);
+#elif defined(ARCH_MIN_SSE2)
     v16 acc_hi, acc_md, acc_lo;
     v16 prod_hi, prod_lo;
     v16 overflow, overflow_new;
@@ -491,7 +593,12 @@ VECTOR_OPERATION VMACU(v16 vs, v16 vt)
 
 VECTOR_OPERATION VMADL(v16 vs, v16 vt)
 {
-#ifdef ARCH_MIN_SSE2
+#if defined(ARCH_MIN_AVX2)
+    __m256i acc;
+
+    acc = acc_add(_mm256_setzero_si256(), _mm_mulhi_epu16(vs, vt));
+    return clamp_low(acc);
+#elif defined(ARCH_MIN_SSE2)
     v16 acc_hi, acc_md, acc_lo;
     v16 prod_hi;
     v16 overflow, overflow_new;
@@ -564,7 +671,15 @@ VECTOR_OPERATION VMADL(v16 vs, v16 vt)
 
 VECTOR_OPERATION VMADM(v16 vs, v16 vt)
 {
-#ifdef ARCH_MIN_SSE2
+#if defined(ARCH_MIN_AVX2)
+    const __m256i product = _mm256_mullo_epi32(
+        _mm256_cvtepi16_epi32(vs), _mm256_cvtepu16_epi32(vt)
+    );
+    __m256i acc;
+
+    acc = acc_add(_mm256_srai_epi32(product, 16), narrow_low(product));
+    return narrow_saturate(acc);
+#elif defined(ARCH_MIN_SSE2)
     v16 acc_hi, acc_md, acc_lo;
     v16 prod_hi, prod_lo;
     v16 overflow;
@@ -625,7 +740,15 @@ VECTOR_OPERATION VMADM(v16 vs, v16 vt)
 
 VECTOR_OPERATION VMADN(v16 vs, v16 vt)
 {
-#ifdef ARCH_MIN_SSE2
+#if defined(ARCH_MIN_AVX2)
+    const __m256i product = _mm256_mullo_epi32(
+        _mm256_cvtepu16_epi32(vs), _mm256_cvtepi16_epi32(vt)
+    );
+    __m256i acc;
+
+    acc = acc_add(_mm256_srai_epi32(product, 16), narrow_low(product));
+    return clamp_low(acc);
+#elif defined(ARCH_MIN_SSE2)
     v16 acc_hi, acc_md, acc_lo;
     v16 prod_hi, prod_lo;
     v16 overflow;
@@ -704,7 +827,15 @@ VECTOR_OPERATION VMADN(v16 vs, v16 vt)
 
 VECTOR_OPERATION VMADH(v16 vs, v16 vt)
 {
-#ifdef ARCH_MIN_SSE2
+#if defined(ARCH_MIN_AVX2)
+    __m256i acc;
+
+    /* The product lands on bits 47..16, so nothing carries out of VACC_L. */
+    acc = _mm256_add_epi32(acc_load_upper(), product_ss(vs, vt));
+    *(v16 *)VACC_M = narrow_low(acc);
+    *(v16 *)VACC_H = narrow_high(acc);
+    return narrow_saturate(acc);
+#elif defined(ARCH_MIN_SSE2)
     v16 acc_mid;
     v16 prod_high;
 
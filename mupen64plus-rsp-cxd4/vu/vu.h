@@ -19,6 +19,17 @@
 #include <emmintrin.h>
 #endif
 
+/*
+ * The AVX2 path only replaces the SSE2 code of some operations, so building
+ * with it means building with the SSE2 path too.
+ */
+#ifdef ARCH_MIN_AVX2
+#if !defined(ARCH_MIN_SSE2) || defined(SSE2NEON)
+#error ARCH_MIN_AVX2 requires ARCH_MIN_SSE2 on an x86 host.
+#endif
+#include <immintrin.h>
+#endif
+
 #include "../my_types.h"
 
 #define N       8
@@ -96,6 +96,63 @@ static int16_t ramp_step(struct ramp_t* ramp)
     return (int16_t)(ramp->value >> 16);
 }
 
+#ifdef ARITHMETICS_SSE2
+/* Vectors of 8 samples can only replace the sample by sample loops
+ * if dst doesn't lie less than 8 samples past src. */
+static bool can_vectorize(const int16_t* dst, const int16_t* src)
+{
+    return (dst <= src || dst >= src + 8);
+}
+
+static bool are_disjoint(const int16_t* a, const int16_t* b)
+{
+    return (a + 8 <= b || b + 8 <= a);
+}
+
+static bool alist_envmix_can_vectorize(size_t n, int16_t* const* dst, const int16_t* src)
+{
+    size_t i, j;
+
+    for(i = 0; i < n; ++i) {
+        if (!are_disjoint(dst[i], src))
+            return false;
+        for(j = 0; j < i; ++j) {
+            if (!are_disjoint(dst[i], dst[j]))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/* alist_envmix_mix on the 8 samples at offset pos, gains[i] being laid out
+ * like the samples */
+static void alist_envmix_mix8(size_t n, int16_t* const* dst, unsigned pos,
+                              int16_t gains[][8], const int16_t* src)
+{
+    const __m128i x = _mm_loadu_si128((const __m128i*)(src + pos));
+    size_t i;
+
+    for(i = 0; i < n; ++i) {
+        __m128i y = _mm_loadu_si128((const __m128i*)(dst[i] + pos));
+        __m128i g = _mm_loadu_si128((const __m128i*)gains[i]);
+        _mm_storeu_si128((__m128i*)(dst[i] + pos), mix_s16x8(y, x, g, 0));
+    }
+}
+
+static void alist_envmix_gains8(int16_t gains[][8], unsigned i, struct ramp_t* ramps,
+                                int16_t dry, int16_t wet)
+{
+    int16_t l_vol = ramp_step(&ramps[0]);
+    int16_t r_vol = ramp_step(&ramps[1]);
+
+    gains[0][i^S] = clamp_s16((l_vol * dry + 0x4000) >> 15);
+    gains[1][i^S] = clamp_s16((r_vol * dry + 0x4000) >> 15);
+    gains[2][i^S] = clamp_s16((l_vol * wet + 0x4000) >> 15);
+    gains[3][i^S] = clamp_s16((r_vol * wet + 0x4000) >> 15);
+}
+#endif
+
 /* global functions */
 void alist_process(struct hle_t* hle, const acmd_callback_t abi[], unsigned int abi_size)
 {
@@ -111,6 +168,9 @@ void alist_process(struct hle_t* hle, const acmd_callback_t abi[], unsigned int
 
         acmd = (w1 >> 24) & 0x7f;
 
+#ifdef HLE_BENCH
+        HleBenchCommand(hle->user_defined, acmd);
+#endif
         if (acmd < abi_size)
             (*abi[acmd])(hle, w1, w2);
         else
@@ -282,6 +342,11 @@ void alist_envmix_exp(
     int x, y;
     short save_buffer[40];
 
+#ifdef ARITHMETICS_SSE2
+    int16_t* const outputs[4] = { dl, dr, wl, wr };
+    const bool vectorize = alist_envmix_can_vectorize(n, outputs, in);
+#endif
+
     memcpy((uint8_t *)save_buffer, (hle->dram + address), sizeof(save_buffer));
     if (init) {
         ramps[0].value  = (vol[0] << 16);
@@ -323,6 +388,19 @@ void alist_envmix_exp(
             ramps[1].step = (exp_seq[1] - ramps[1].value) >> 3;
         }
 
+#ifdef ARITHMETICS_SSE2
+        if (vectorize) {
+            int16_t gains[4][8];
+
+            for (x = 0; x < 8; ++x)
+                alist_envmix_gains8(gains, x, ramps, dry, wet);
+
+            alist_envmix_mix8(n, outputs, ptr, gains, in);
+            ptr += 8;
+            continue;
+        }
+#endif
+
         for (x = 0; x < 8; ++x) {
             int16_t  gains[4];
             int16_t* buffers[4];
@@ -382,6 +460,10 @@ void alist_envmix_ge(
     struct ramp_t ramps[2];
     short save_buffer[40];
 
+#ifdef ARITHMETICS_SSE2
+    int16_t* const outputs[4] = { dl, dr, wl, wr };
+#endif
+
     memcpy((uint8_t *)save_buffer, (hle->dram + address), 80);
     if (init) {
         ramps[0].value  = (vol[0] << 16);
@@ -404,7 +486,23 @@ void alist_envmix_ge(
     }
 
     count >>= 1;
-    for (k = 0; k < count; ++k) {
+    k = 0;
+
+#ifdef ARITHMETICS_SSE2
+    if (alist_envmix_can_vectorize(n, outputs, in)) {
+        for (; count - k >= 8; k += 8) {
+            int16_t gains[4][8];
+            unsigned i;
+
+            for (i = 0; i < 8; ++i)
+                alist_envmix_gains8(gains, i, ramps, dry, wet);
+
+            alist_envmix_mix8(n, outputs, k, gains, in);
+        }
+    }
+#endif
+
+    for (; k < count; ++k) {
         int16_t  gains[4];
         int16_t* buffers[4];
         int16_t l_vol = ramp_step(&ramps[0]);
@@ -458,6 +556,10 @@ void alist_envmix_lin(
     int16_t* const wl = (int16_t*)(hle->alist_buffer + dmem_wl);
     int16_t* const wr = (int16_t*)(hle->alist_buffer + dmem_wr);
 
+#ifdef ARITHMETICS_SSE2
+    int16_t* const outputs[4] = { dl, dr, wl, wr };
+#endif
+
     memcpy((uint8_t *)save_buffer, hle->dram + address, 80);
     if (init) {
         ramps[0].step   = rate[0] / 8;
@@ -479,7 +581,23 @@ void alist_envmix_lin(
     }
 
     count >>= 1;
-    for(k = 0; k < count; ++k) {
+    k = 0;
+
+#ifdef ARITHMETICS_SSE2
+    if (alist_envmix_can_vectorize(4, outputs, in)) {
+        for (; count - k >= 8; k += 8) {
+            int16_t gains[4][8];
+            unsigned i;
+
+            for (i = 0; i < 8; ++i)
+                alist_envmix_gains8(gains, i, ramps, dry, wet);
+
+            alist_envmix_mix8(4, outputs, k, gains, in);
+        }
+    }
+#endif
+
+    for(; k < count; ++k) {
         int16_t  gains[4];
         int16_t* buffers[4];
         int16_t l_vol = ramp_step(&ramps[0]);
@@ -534,6 +652,49 @@ void alist_envmix_nead(
     if (swap_wet_LR)
         swap(&wl, &wr);
 
+#ifdef ARITHMETICS_SSE2
+    /* each output is read then written once per sample, which a vector of
+     * samples can only do in the same order if none of them overlap */
+    if (are_disjoint(dl, dr) && are_disjoint(dl, wl) && are_disjoint(dl, wr)
+     && are_disjoint(dr, wl) && are_disjoint(dr, wr) && are_disjoint(wl, wr)
+     && are_disjoint(in, dl) && are_disjoint(in, dr)
+     && are_disjoint(in, wl) && are_disjoint(in, wr)) {
+        const __m128i xor_l  = _mm_set1_epi16(xors[0]);
+        const __m128i xor_r  = _mm_set1_epi16(xors[1]);
+        const __m128i xor_l2 = _mm_set1_epi16(xors[2]);
+        const __m128i xor_r2 = _mm_set1_epi16(xors[3]);
+
+        for (; count != 0; count -= 8) {
+            const __m128i x = _mm_loadu_si128((const __m128i*)in);
+            const __m128i env2 = _mm_set1_epi16(env_values[2]);
+            __m128i l  = mulhi_s16_u16(x, _mm_set1_epi16(env_values[0]));
+            __m128i r  = mulhi_s16_u16(x, _mm_set1_epi16(env_values[1]));
+            __m128i l2, r2;
+
+            l  = _mm_xor_si128(l, xor_l);
+            r  = _mm_xor_si128(r, xor_r);
+            l2 = _mm_xor_si128(mulhi_s16_u16(l, env2), xor_l2);
+            r2 = _mm_xor_si128(mulhi_s16_u16(r, env2), xor_r2);
+
+            _mm_storeu_si128((__m128i*)dl, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)dl), l));
+            _mm_storeu_si128((__m128i*)dr, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)dr), r));
+            _mm_storeu_si128((__m128i*)wl, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)wl), l2));
+            _mm_storeu_si128((__m128i*)wr, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)wr), r2));
+
+            env_values[0] += env_steps[0];
+            env_values[1] += env_steps[1];
+            env_values[2] += env_steps[2];
+
+            dl += 8;
+            dr += 8;
+            wl += 8;
+            wr += 8;
+            in += 8;
+        }
+        return;
+    }
+#endif
+
     while (count != 0) {
         size_t i;
         for(i = 0; i < 8; ++i) {
@@ -569,6 +730,18 @@ void alist_mix(struct hle_t* hle, uint16_t dmemo, uint16_t dmemi, uint16_t count
 
     count >>= 1;
 
+#ifdef ARITHMETICS_SSE2
+    if (can_vectorize(dst, src)) {
+        const __m128i g = _mm_set1_epi16(gain);
+
+        for(; count >= 8; count -= 8, dst += 8, src += 8) {
+            __m128i y = _mm_loadu_si128((const __m128i*)dst);
+            __m128i x = _mm_loadu_si128((const __m128i*)src);
+            _mm_storeu_si128((__m128i*)dst, mix_s16x8(y, x, g, 0));
+        }
+    }
+#endif
+
     while(count != 0) {
         sample_mix(dst, *src, gain);
 
@@ -584,6 +757,20 @@ void alist_multQ44(struct hle_t* hle, uint16_t dmem, uint16_t count, int8_t gain
 
     count >>= 1;
 
+#ifdef ARITHMETICS_SSE2
+    {
+        const __m128i g = _mm_set1_epi16(gain);
+
+        for(; count >= 8; count -= 8, dst += 8) {
+            __m128i lo, hi;
+            mul_s16x8(_mm_loadu_si128((const __m128i*)dst), g, &lo, &hi);
+            lo = _mm_srai_epi32(lo, 4);
+            hi = _mm_srai_epi32(hi, 4);
+            _mm_storeu_si128((__m128i*)dst, _mm_packs_epi32(lo, hi));
+        }
+    }
+#endif
+
     while(count != 0) {
         *dst = clamp_s16(*dst * gain >> 4);
 
@@ -599,6 +786,16 @@ void alist_add(struct hle_t* hle, uint16_t dmemo, uint16_t dmemi, uint16_t count
 
     count >>= 1;
 
+#ifdef ARITHMETICS_SSE2
+    if (can_vectorize(dst, src)) {
+        for(; count >= 8; count -= 8, dst += 8, src += 8) {
+            __m128i y = _mm_loadu_si128((const __m128i*)dst);
+            __m128i x = _mm_loadu_si128((const __m128i*)src);
+            _mm_storeu_si128((__m128i*)dst, _mm_adds_epi16(y, x));
+        }
+    }
+#endif
+
     while(count != 0) {
         *dst = clamp_s16(*dst + *src);
 
@@ -791,6 +988,62 @@ void alist_adpcm(
 }
 
 
+#ifdef ARITHMETICS_SSE2
+/* swaps the halfwords of each word, turning 8 S16 swizzled samples into
+ * 8 samples in order and back */
+static inline __m128i swap_s16x8(__m128i x)
+{
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xb1), 0xb1);
+}
+
+/* samples k to k+7 of the 16 samples held by x and y */
+#define SAMPLES_AT(x, y, k) \
+    _mm_or_si128(_mm_srli_si128((x), 2 * (k)), _mm_slli_si128((y), 16 - 2 * (k)))
+
+/* alist_filter on one block of 8 samples: output sample i is the dot product
+ * of samples i+1 to i+8 of in1:in2 with the taps, rounded and truncated */
+static void alist_filter8(int16_t* out, const int16_t* in1, const int16_t* in2,
+                          const __m128i* taps)
+{
+    const __m128i x = swap_s16x8(_mm_loadu_si128((const __m128i*)in1));
+    const __m128i y = swap_s16x8(_mm_loadu_si128((const __m128i*)in2));
+    const __m128i round = _mm_set1_epi32(0x4000);
+    const __m128i s1 = SAMPLES_AT(x, y, 1);
+    const __m128i s2 = SAMPLES_AT(x, y, 2);
+    const __m128i s3 = SAMPLES_AT(x, y, 3);
+    const __m128i s4 = SAMPLES_AT(x, y, 4);
+    const __m128i s5 = SAMPLES_AT(x, y, 5);
+    const __m128i s6 = SAMPLES_AT(x, y, 6);
+    const __m128i s7 = SAMPLES_AT(x, y, 7);
+    __m128i lo, hi;
+
+    lo =                   _mm_madd_epi16(_mm_unpacklo_epi16(s1, s2), taps[0]);
+    lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(s3, s4), taps[1]));
+    lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(s5, s6), taps[2]));
+    lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(s7, y ), taps[3]));
+
+    hi =                   _mm_madd_epi16(_mm_unpackhi_epi16(s1, s2), taps[0]);
+    hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(s3, s4), taps[1]));
+    hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(s5, s6), taps[2]));
+    hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(s7, y ), taps[3]));
+
+    /* (v + 0x4000) >> 15, truncated to 16 bits rather than clamped */
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, round), 15);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, round), 15);
+    lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+    hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+
+    _mm_storeu_si128((__m128i*)out, swap_s16x8(_mm_packs_epi32(lo, hi)));
+}
+
+#undef SAMPLES_AT
+
+static inline __m128i pair_taps(int16_t a, int16_t b)
+{
+    return _mm_set1_epi32((int32_t)((uint32_t)(uint16_t)a | ((uint32_t)(uint16_t)b << 16)));
+}
+#endif
+
 void alist_filter(
         struct hle_t* hle,
         uint16_t dmem,
@@ -814,6 +1067,24 @@ void alist_filter(
         lutt5[x] = lutt6[x] = v;
     }
 
+#ifdef ARITHMETICS_SSE2
+    {
+        /* taps in sample order: the lut is S16 swizzled and reversed */
+        const __m128i taps[4] = {
+            pair_taps(lutt6[6], lutt6[7]),
+            pair_taps(lutt6[4], lutt6[5]),
+            pair_taps(lutt6[2], lutt6[3]),
+            pair_taps(lutt6[0], lutt6[1])
+        };
+
+        for (x = 0; x < count; x += 16) {
+            alist_filter8(outp, in1, in2, taps);
+            in1 = in2;
+            in2 += 8;
+            outp += 8;
+        }
+    }
+#else
     for (x = 0; x < count; x += 16) {
         int32_t v[8];
 
@@ -901,6 +1172,7 @@ void alist_filter(
         in2 += 8;
         outp += 8;
     }
+#endif
 
     memcpy(hle->dram + address, in2 - 8, 16);
     memcpy(hle->alist_buffer + dmem, outbuff, count);
@@ -948,11 +1220,42 @@ void alist_polef(
         for(i = 0; i < 8; ++i, dmemi += 2)
             frame[i] = *alist_s16(hle, dmemi);
 
+#ifdef ARITHMETICS_SSE2
+        {
+            const __m128i f = _mm_loadu_si128((const __m128i*)frame);
+            const __m128i g = _mm_set1_epi16(gain);
+            const __m128i fglo = _mm_mullo_epi16(f, g);
+            const __m128i fghi = mulhi_s16_u16(f, g);
+            __m128i lo, hi, plo, phi;
+            int16_t out[8];
+
+            rdot8(h2, f, &lo, &hi);
+
+            lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(fglo, fghi));
+            hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(fglo, fghi));
+
+            mul_s16x8(_mm_loadu_si128((const __m128i*)h1), _mm_set1_epi16(l1), &plo, &phi);
+            lo = _mm_add_epi32(lo, plo);
+            hi = _mm_add_epi32(hi, phi);
+
+            mul_s16x8(_mm_loadu_si128((const __m128i*)h2_before), _mm_set1_epi16(l2), &plo, &phi);
+            lo = _mm_add_epi32(lo, plo);
+            hi = _mm_add_epi32(hi, phi);
+
+            lo = _mm_srai_epi32(lo, 14);
+            hi = _mm_srai_epi32(hi, 14);
+            _mm_storeu_si128((__m128i*)out, _mm_packs_epi32(lo, hi));
+
+            for(i = 0; i < 8; ++i)
+                dst[i^S] = out[i];
+        }
+#else
         for(i = 0; i < 8; ++i) {
             int32_t accu = frame[i] * gain;
             accu += h1[i]*l1 + h2_before[i]*l2 + rdot(i, h2, frame);
             dst[i^S] = clamp_s16(accu >> 14);
         }
+#endif
 
         l1 = dst[6^S];
         l2 = dst[7^S];
@@ -39,5 +39,45 @@ static inline int32_t vmulf(int16_t x, int16_t y)
     return (((int32_t)(x))*((int32_t)(y))+0x4000)>>15;
 }
 
+/* NO_SIMD forces the scalar code paths, which the SIMD ones are checked against */
+#if !defined(NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define ARITHMETICS_SSE2
+#include <emmintrin.h>
+
+/* full 32-bit products of 8 pairs of signed 16-bit integers
+ * (elements 0-3 in *lo, elements 4-7 in *hi) */
+static inline void mul_s16x8(__m128i x, __m128i y, __m128i* lo, __m128i* hi)
+{
+    const __m128i plo = _mm_mullo_epi16(x, y);
+    const __m128i phi = _mm_mulhi_epi16(x, y);
+
+    *lo = _mm_unpacklo_epi16(plo, phi);
+    *hi = _mm_unpackhi_epi16(plo, phi);
+}
+
+/* high 16 bits of the products of signed x by unsigned y */
+static inline __m128i mulhi_s16_u16(__m128i x, __m128i y)
+{
+    const __m128i phi = _mm_mulhi_epu16(x, y);
+
+    return _mm_sub_epi16(phi, _mm_and_si128(_mm_srai_epi16(x, 15), y));
+}
+
+/* clamp_s16(y + ((x * gain [+ round]) >> 15)) on 8 samples */
+static inline __m128i mix_s16x8(__m128i y, __m128i x, __m128i gain, int32_t round)
+{
+    const __m128i r = _mm_set1_epi32(round);
+    __m128i lo, hi;
+
+    mul_s16x8(x, gain, &lo, &hi);
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, r), 15);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, r), 15);
+    lo = _mm_add_epi32(lo, _mm_srai_epi32(_mm_unpacklo_epi16(y, y), 16));
+    hi = _mm_add_epi32(hi, _mm_srai_epi32(_mm_unpackhi_epi16(y, y), 16));
+
+    return _mm_packs_epi32(lo, hi);
+}
+#endif
+
 #endif
 
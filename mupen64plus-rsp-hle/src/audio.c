@@ -106,6 +106,31 @@ int32_t rdot(size_t n, const int16_t *x, const int16_t *y)
     return accu;
 }
 
+#ifdef ARITHMETICS_SSE2
+void rdot8(const int16_t *x, __m128i y, __m128i *lo, __m128i *hi)
+{
+    __m128i plo, phi;
+
+    *lo = _mm_setzero_si128();
+    *hi = _mm_setzero_si128();
+
+    /* x[k] weighs y[i - 1 - k], the elements of y moved up by k + 1 */
+#define RDOT8_TERM(k) \
+    mul_s16x8(_mm_set1_epi16(x[k]), _mm_slli_si128(y, 2 * ((k) + 1)), &plo, &phi); \
+    *lo = _mm_add_epi32(*lo, plo); \
+    *hi = _mm_add_epi32(*hi, phi);
+
+    RDOT8_TERM(0)
+    RDOT8_TERM(1)
+    RDOT8_TERM(2)
+    RDOT8_TERM(3)
+    RDOT8_TERM(4)
+    RDOT8_TERM(5)
+    RDOT8_TERM(6)
+#undef RDOT8_TERM
+}
+#endif
+
 void adpcm_compute_residuals(int16_t* dst, const int16_t* src,
         const int16_t* cb_entry, const int16_t* last_samples, size_t count)
 {
@@ -119,6 +144,31 @@ void adpcm_compute_residuals(int16_t* dst, const int16_t* src,
 
     assert(count <= 8);
 
+#ifdef ARITHMETICS_SSE2
+    if (count == 8) {
+        const __m128i s = _mm_loadu_si128((const __m128i*)src);
+        __m128i lo, hi, plo, phi;
+
+        rdot8(book2, s, &lo, &hi);
+
+        lo = _mm_add_epi32(lo, _mm_slli_epi32(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16), 11));
+        hi = _mm_add_epi32(hi, _mm_slli_epi32(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16), 11));
+
+        mul_s16x8(_mm_loadu_si128((const __m128i*)book1), _mm_set1_epi16(l1), &plo, &phi);
+        lo = _mm_add_epi32(lo, plo);
+        hi = _mm_add_epi32(hi, phi);
+
+        mul_s16x8(_mm_loadu_si128((const __m128i*)book2), _mm_set1_epi16(l2), &plo, &phi);
+        lo = _mm_add_epi32(lo, plo);
+        hi = _mm_add_epi32(hi, phi);
+
+        lo = _mm_srai_epi32(lo, 11);
+        hi = _mm_srai_epi32(hi, 11);
+        _mm_storeu_si128((__m128i*)dst, _mm_packs_epi32(lo, hi));
+        return;
+    }
+#endif
+
     for(i = 0; i < count; ++i) {
         int32_t accu = (int32_t)src[i] << 11;
         accu += book1[i]*l1 + book2[i]*l2 + rdot(i, book2, src);
@@ -25,12 +25,18 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "arithmetics.h"
 #include "common.h"
 
 extern const int16_t RESAMPLE_LUT[64 * 4];
 
 int32_t rdot(size_t n, const int16_t *x, const int16_t *y);
 
+#ifdef ARITHMETICS_SSE2
+/* rdot(i, x, y) for i = 0..7, as 32-bit elements 0-3 in *lo and 4-7 in *hi */
+void rdot8(const int16_t *x, __m128i y, __m128i *lo, __m128i *hi);
+#endif
+
 static inline int16_t adpcm_predict_sample(uint8_t byte, uint8_t mask,
         unsigned lshift, unsigned rshift)
 {
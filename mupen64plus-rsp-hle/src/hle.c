@@ -22,22 +22,37 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
-#ifdef ENABLE_TASK_DUMP
+#if defined(ENABLE_TASK_DUMP) || defined(ENABLE_TASK_CAPTURE)
 #include <stdio.h>
 #endif
 
+#include "hle.h"
 #include "hle_external.h"
 #include "hle_internal.h"
 #include "memory.h"
 #include "ucodes.h"
+#ifdef ENABLE_TASK_CAPTURE
+#include "task_capture.h"
+#endif
 
 #define min(a,b) (((a) < (b)) ? (a) : (b))
 
 /* some rdp status flags */
 #define DP_STATUS_FREEZE            0x2
 
+/* ucodes which are identified by their content, and can be remembered
+ * across sessions by name */
+struct known_ucode_t
+{
+    ucode_func_t uc_pfunc;
+    const char* name;
+    bool audio;
+};
+
 
 
 /* helper functions prototypes */
@@ -48,6 +63,17 @@ static ucode_func_t try_audio_task_detection(struct hle_t* hle);
 static ucode_func_t try_normal_task_detection(struct hle_t* hle);
 static ucode_func_t non_task_detection(struct hle_t* hle);
 static ucode_func_t task_detection(struct hle_t* hle);
+static void task_done(struct hle_t* hle);
+static const struct known_ucode_t* find_known_ucode(ucode_func_t uc_pfunc);
+static uint32_t ucode_fingerprint(struct hle_t* hle);
+static unsigned int ucode_slot(uint32_t uc_start, uint32_t uc_dstart, uint16_t uc_dsize, uint32_t uc_fingerprint);
+static struct ucode_info_t* find_ucode(struct cached_ucodes_t* cached_ucodes,
+    uint32_t uc_start, uint32_t uc_dstart, uint16_t uc_dsize, uint32_t uc_fingerprint);
+static bool is_lle_ucode(struct hle_t* hle, const struct known_ucode_t* known);
+static struct ucode_info_t* insert_ucode(struct hle_t* hle,
+    uint32_t uc_start, uint32_t uc_dstart, uint16_t uc_dsize, uint32_t uc_fingerprint,
+    ucode_func_t uc_pfunc);
+static void remove_ucode(struct cached_ucodes_t* cached_ucodes, unsigned int slot);
 
 #ifdef ENABLE_TASK_DUMP
 static void dump_binary(struct hle_t* hle, const char *const filename,
@@ -57,6 +83,53 @@ static void dump_unknown_task(struct hle_t* hle, unsigned int uc_start);
 static void dump_unknown_non_task(struct hle_t* hle, unsigned int uc_start);
 #endif
 
+#ifdef ENABLE_TASK_CAPTURE
+static void capture_task(struct hle_t* hle, ucode_func_t uc_pfunc,
+                         unsigned int uc_start, unsigned int uc_dstart);
+#endif
+
+#define KNOWN_UCODE(func, audio) { &func, #func, audio }
+
+static const struct known_ucode_t known_ucodes[] = {
+    KNOWN_UCODE(cicx105_ucode, false),
+    KNOWN_UCODE(task_done, false),
+    KNOWN_UCODE(jpeg_decode_PS0, false),
+    KNOWN_UCODE(jpeg_decode_PS, false),
+    KNOWN_UCODE(jpeg_decode_OB, false),
+    KNOWN_UCODE(resize_bilinear_task, false),
+    KNOWN_UCODE(decode_video_frame_task, false),
+    KNOWN_UCODE(fill_video_double_buffer_task, false),
+    KNOWN_UCODE(hvqm2_decode_sp1_task, false),
+    KNOWN_UCODE(hvqm2_decode_sp2_task, false),
+    /* audio ucodes only read their task header from DMEM, keep their state
+     * in struct hle_t and RDRAM, and never forward the task to the RSP
+     * fallback, so they can run on another thread than the one which
+     * emulates the CPU */
+    KNOWN_UCODE(alist_process_audio, true),
+    KNOWN_UCODE(alist_process_audio_ge, true),
+    KNOWN_UCODE(alist_process_audio_bc, true),
+    KNOWN_UCODE(alist_process_nead_mk, true),
+    KNOWN_UCODE(alist_process_nead_sfj, true),
+    KNOWN_UCODE(alist_process_nead_wrjb, true),
+    KNOWN_UCODE(alist_process_nead_sf, true),
+    KNOWN_UCODE(alist_process_nead_fz, true),
+    KNOWN_UCODE(alist_process_nead_ys, true),
+    KNOWN_UCODE(alist_process_nead_1080, true),
+    KNOWN_UCODE(alist_process_nead_oot, true),
+    KNOWN_UCODE(alist_process_nead_mm, true),
+    KNOWN_UCODE(alist_process_nead_mmb, true),
+    KNOWN_UCODE(alist_process_nead_ac, true),
+    KNOWN_UCODE(alist_process_nead_mats, true),
+    KNOWN_UCODE(alist_process_nead_efz, true),
+    KNOWN_UCODE(alist_process_naudio, true),
+    KNOWN_UCODE(alist_process_naudio_bk, true),
+    KNOWN_UCODE(alist_process_naudio_dk, true),
+    KNOWN_UCODE(alist_process_naudio_mp3, true),
+    KNOWN_UCODE(alist_process_naudio_cbfd, true),
+    KNOWN_UCODE(musyx_v1_task, true),
+    KNOWN_UCODE(musyx_v2_task, true)
+};
+
 /* Global functions */
 void hle_init(struct hle_t* hle,
     unsigned char* dram,
@@ -110,39 +183,276 @@ void hle_execute(struct hle_t* hle)
 {
     uint32_t uc_start = *dmem_u32(hle, TASK_UCODE);
     uint32_t uc_dstart = *dmem_u32(hle, TASK_UCODE_DATA);
-    uint32_t uc_dsize = *dmem_u32(hle, TASK_UCODE_DATA_SIZE);
+    uint16_t uc_dsize = *dmem_u32(hle, TASK_UCODE_DATA_SIZE);
+    uint32_t uc_fingerprint = ucode_fingerprint(hle);
 
-    bool match = false;
     struct cached_ucodes_t * cached_ucodes = &hle->cached_ucodes;
-    struct ucode_info_t *info = NULL;
-    if (cached_ucodes->count > 0)
-        info = &cached_ucodes->infos[cached_ucodes->count-1];
-    for (int i = 0; i < cached_ucodes->count; i++)
+    struct ucode_info_t *info = find_ucode(cached_ucodes, uc_start, uc_dstart, uc_dsize, uc_fingerprint);
+
+    if (info == NULL)
     {
-        if (info->uc_start == uc_start && info->uc_dstart == uc_dstart && info->uc_dsize == uc_dsize)
-        {
-            match = true;
-            break;
-        }
-        info--;
+        ucode_func_t uc_pfunc = task_detection(hle);
+        assert(uc_pfunc != NULL);
+
+        info = insert_ucode(hle, uc_start, uc_dstart, uc_dsize, uc_fingerprint, uc_pfunc);
+#ifdef ENABLE_TASK_CAPTURE
+        capture_task(hle, info->uc_pfunc, uc_start, uc_dstart);
+#endif
     }
 
-    if (!match)
-    {
-        info = &cached_ucodes->infos[cached_ucodes->count];
-        info->uc_start = uc_start;
-        info->uc_dstart = uc_dstart;
-        info->uc_dsize = uc_dsize;
-        info->uc_pfunc = task_detection(hle);
-        cached_ucodes->count++;
-        assert(cached_ucodes->count <= CACHED_UCODES_MAX_SIZE);
-        assert(info->uc_pfunc != NULL);
+    info->last_use = ++cached_ucodes->clock;
+
+    /* known ucodes can still be run on the RSP fallback when their HLE
+     * is not good enough for the current game */
+    if (info->uc_lle && HleForwardTask(hle->user_defined) == 0)
+        return;
+
+    if (info->uc_async && hle->async_aud
+     && HleQueueAudioTask(hle->user_defined, info->uc_pfunc) == 0) {
+        rsp_break(hle, SP_STATUS_TASKDONE);
+        return;
     }
 
     info->uc_pfunc(hle);
 }
 
+void hle_clear_ucodes(struct hle_t* hle)
+{
+    memset(&hle->cached_ucodes, 0, sizeof(hle->cached_ucodes));
+}
+
+void hle_list_ucodes(struct hle_t* hle, hle_ucode_callback_t callback, void* opaque)
+{
+    const struct ucode_info_t *sorted[CACHED_UCODES_SIZE];
+    const struct ucode_info_t *info;
+    const struct known_ucode_t *known;
+    int count = 0;
+    int i, j;
+
+    /* least recently used first, so that adding them back keeps their order */
+    for (i = 0; i < CACHED_UCODES_SIZE; ++i) {
+        info = &hle->cached_ucodes.infos[i];
+        if (info->uc_pfunc == NULL)
+            continue;
+
+        for (j = count++; j > 0 && sorted[j-1]->last_use > info->last_use; --j)
+            sorted[j] = sorted[j-1];
+        sorted[j] = info;
+    }
+
+    for (i = 0; i < count; ++i) {
+        known = find_known_ucode(sorted[i]->uc_pfunc);
+        if (known == NULL)
+            continue;
+
+        callback(opaque, sorted[i]->uc_start, sorted[i]->uc_dstart, sorted[i]->uc_dsize,
+                 sorted[i]->uc_fingerprint, known->name);
+    }
+}
+
+int hle_add_ucode(struct hle_t* hle,
+    uint32_t uc_start, uint32_t uc_dstart, uint16_t uc_dsize, uint32_t uc_fingerprint,
+    const char* uc_name)
+{
+    const struct known_ucode_t *known = NULL;
+    struct ucode_info_t *info;
+    size_t i;
+
+    for (i = 0; i < sizeof(known_ucodes) / sizeof(known_ucodes[0]); ++i) {
+        if (strcmp(known_ucodes[i].name, uc_name) == 0) {
+            known = &known_ucodes[i];
+            break;
+        }
+    }
+
+    /* audio lists may be sent to the audio plugin instead */
+    if (known == NULL || (known->audio && hle->hle_aud))
+        return -1;
+
+    info = find_ucode(&hle->cached_ucodes, uc_start, uc_dstart, uc_dsize, uc_fingerprint);
+    if (info == NULL)
+        info = insert_ucode(hle, uc_start, uc_dstart, uc_dsize, uc_fingerprint, known->uc_pfunc);
+
+    info->last_use = ++hle->cached_ucodes.clock;
+    return 0;
+}
+
 /* local functions */
+static const struct known_ucode_t* find_known_ucode(ucode_func_t uc_pfunc)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(known_ucodes) / sizeof(known_ucodes[0]); ++i) {
+        if (known_ucodes[i].uc_pfunc == uc_pfunc)
+            return &known_ucodes[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * Games may load different ucodes at the same address, so ucodes are told
+ * apart by a hash of everything task detection looks at: the task type,
+ * the ucode bytes summed by try_normal_task_detection and the ucode data
+ * words read by try_audio_task_detection for tasks, the start of IMEM
+ * otherwise.
+ **/
+static uint32_t fnv1a_words(uint32_t hash, const uint32_t* words, unsigned int count)
+{
+    unsigned int i;
+
+    for (i = 0; i < count; ++i)
+        hash = (hash ^ words[i]) * 0x01000193;
+
+    return hash;
+}
+
+static uint32_t ucode_fingerprint(struct hle_t* hle)
+{
+    static const uint32_t audio_data_offsets[] = { 0x00, 0x10, 0x28, 0x30 };
+    uint32_t hash = 0x811c9dc5;
+    unsigned int i;
+
+    if (is_task(hle)) {
+        const uint32_t type = *dmem_u32(hle, TASK_TYPE);
+        const uint32_t ucode = *dmem_u32(hle, TASK_UCODE);
+        const uint32_t ucode_data = *dmem_u32(hle, TASK_UCODE_DATA);
+        /* the ucode is summed over up to 0xf80 >> 1 bytes, then 256 and 1488 */
+        const uint32_t sum_size = min(*dmem_u32(hle, TASK_UCODE_SIZE), 0xf80) >> 1;
+        const uint32_t size = (sum_size > 1488) ? sum_size : 1488;
+
+        hash = fnv1a_words(hash, &type, 1);
+        hash = fnv1a_words(hash, &sum_size, 1);
+        hash = fnv1a_words(hash, dram_u32(hle, ucode & ~3), ((ucode & 3) + size + 3) >> 2);
+
+        if (type == 2) {
+            for (i = 0; i < sizeof(audio_data_offsets) / sizeof(audio_data_offsets[0]); ++i)
+                hash = fnv1a_words(hash, dram_u32(hle, ucode_data + audio_data_offsets[i]), 1);
+        }
+    } else {
+        /* non_task_detection sums the first 44 bytes of IMEM */
+        hash = fnv1a_words(hash, (const uint32_t*)hle->imem, 44 >> 2);
+    }
+
+    return hash;
+}
+
+static unsigned int ucode_slot(uint32_t uc_start, uint32_t uc_dstart, uint16_t uc_dsize, uint32_t uc_fingerprint)
+{
+    uint32_t hash = uc_fingerprint
+                  ^ (uc_start * 0x9e3779b1)
+                  ^ ((uc_dstart + uc_dsize) * 0x85ebca6b);
+
+    hash ^= hash >> 16;
+    return hash & (CACHED_UCODES_SIZE - 1);
+}
+
+static struct ucode_info_t* find_ucode(struct cached_ucodes_t* cached_ucodes,
+    uint32_t uc_start, uint32_t uc_dstart, uint16_t uc_dsize, uint32_t uc_fingerprint)
+{
+    unsigned int slot = ucode_slot(uc_start, uc_dstart, uc_dsize, uc_fingerprint);
+    struct ucode_info_t *info;
+
+    /* linear probing, there is always an empty slot to stop at */
+    for (;;) {
+        info = &cached_ucodes->infos[slot];
+        if (info->uc_pfunc == NULL)
+            return NULL;
+
+        if (info->uc_fingerprint == uc_fingerprint && info->uc_start == uc_start
+         && info->uc_dstart == uc_dstart && info->uc_dsize == uc_dsize)
+            return info;
+
+        slot = (slot + 1) & (CACHED_UCODES_SIZE - 1);
+    }
+}
+
+static bool is_lle_ucode(struct hle_t* hle, const struct known_ucode_t* known)
+{
+    static const char separators[] = " \t,;";
+    const char* list = hle->lle_ucodes;
+    size_t name_len, len;
+
+    if (list == NULL || known == NULL)
+        return false;
+
+    name_len = strlen(known->name);
+    while (*(list += strspn(list, separators)) != '\0') {
+        len = strcspn(list, separators);
+        if (len == name_len && strncmp(list, known->name, len) == 0)
+            return true;
+        list += len;
+    }
+
+    return false;
+}
+
+static struct ucode_info_t* insert_ucode(struct hle_t* hle,
+    uint32_t uc_start, uint32_t uc_dstart, uint16_t uc_dsize, uint32_t uc_fingerprint,
+    ucode_func_t uc_pfunc)
+{
+    struct cached_ucodes_t* cached_ucodes = &hle->cached_ucodes;
+    const struct known_ucode_t *known;
+    struct ucode_info_t *info;
+    unsigned int slot, lru;
+
+    if (cached_ucodes->count == CACHED_UCODES_MAX_SIZE) {
+        lru = CACHED_UCODES_SIZE;
+        for (slot = 0; slot < CACHED_UCODES_SIZE; ++slot) {
+            if (cached_ucodes->infos[slot].uc_pfunc != NULL
+             && (lru == CACHED_UCODES_SIZE || cached_ucodes->infos[slot].last_use < cached_ucodes->infos[lru].last_use))
+                lru = slot;
+        }
+        remove_ucode(cached_ucodes, lru);
+    }
+
+    slot = ucode_slot(uc_start, uc_dstart, uc_dsize, uc_fingerprint);
+    while (cached_ucodes->infos[slot].uc_pfunc != NULL)
+        slot = (slot + 1) & (CACHED_UCODES_SIZE - 1);
+
+    known = find_known_ucode(uc_pfunc);
+
+    info = &cached_ucodes->infos[slot];
+    info->uc_start = uc_start;
+    info->uc_dstart = uc_dstart;
+    info->uc_dsize = uc_dsize;
+    info->uc_fingerprint = uc_fingerprint;
+    info->last_use = 0;
+    info->uc_pfunc = uc_pfunc;
+    info->uc_async = (known != NULL && known->audio);
+    info->uc_lle = is_lle_ucode(hle, known);
+    cached_ucodes->count++;
+
+    return info;
+}
+
+static void remove_ucode(struct cached_ucodes_t* cached_ucodes, unsigned int slot)
+{
+    struct ucode_info_t *infos = cached_ucodes->infos;
+    unsigned int next = slot;
+    unsigned int home;
+
+    /* move back the entries which probed past the freed slot */
+    for (;;) {
+        next = (next + 1) & (CACHED_UCODES_SIZE - 1);
+        if (infos[next].uc_pfunc == NULL)
+            break;
+
+        home = ucode_slot(infos[next].uc_start, infos[next].uc_dstart,
+                          infos[next].uc_dsize, infos[next].uc_fingerprint);
+
+        /* skip entries whose home slot lies cyclically in (slot, next] */
+        if ((slot <= next) ? (slot < home && home <= next) : (slot < home || home <= next))
+            continue;
+
+        infos[slot] = infos[next];
+        slot = next;
+    }
+
+    infos[slot].uc_pfunc = NULL;
+    cached_ucodes->count--;
+}
+
 static unsigned int sum_bytes(const unsigned char *bytes, unsigned int size)
 {
     unsigned int sum = 0;
@@ -522,3 +832,59 @@ static void dump_task(struct hle_t* hle, const char *const filename)
         fclose(f);
 }
 #endif
+
+#ifdef ENABLE_TASK_CAPTURE
+/**
+ * Record the first task of each ucode before it runs, so that it can be
+ * replayed by rsp-hle-bench. Tasks which are sent to the gfx or audio
+ * plugins are not emulated here, so they are not worth a capture.
+ **/
+static void capture_task(struct hle_t* hle, ucode_func_t uc_pfunc,
+                         unsigned int uc_start, unsigned int uc_dstart)
+{
+    char filename[256];
+    struct task_capture_header header;
+    uint32_t dram_size = TASK_CAPTURE_DRAM_SIZE;
+    FILE *f;
+
+    if (!is_task(hle)
+     || uc_pfunc == &send_dlist_to_gfx_plugin
+     || uc_pfunc == &send_alist_to_audio_plugin)
+        return;
+
+    sprintf(&filename[0], "capture_%x_%x.bin", uc_start, uc_dstart);
+
+    /* if file already exists, do nothing */
+    f = fopen(filename, "r");
+    if (f != NULL) {
+        fclose(f);
+        return;
+    }
+
+    /* the end of RDRAM is usually unused, only store up to its last non zero word */
+    while (dram_size != 0 && *(uint32_t*)(hle->dram + dram_size - 4) == 0)
+        dram_size -= 4;
+
+    memcpy(header.magic, TASK_CAPTURE_MAGIC, sizeof(header.magic));
+    header.sp_pc = *hle->sp_pc;
+    header.sp_status = *hle->sp_status;
+    header.dram_size = dram_size;
+    header.reserved = 0;
+
+    f = fopen(filename, "wb");
+    if (f == NULL) {
+        HleErrorMessage(hle->user_defined, "Couldn't open %s for writing !", filename);
+        return;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, f) != 1
+     || fwrite(hle->dmem, 1, 0x1000, f) != 0x1000
+     || fwrite(hle->imem, 1, 0x1000, f) != 0x1000
+     || fwrite(hle->dram, 1, dram_size, f) != dram_size)
+        HleErrorMessage(hle->user_defined, "Writing error on %s", filename);
+    else
+        HleInfoMessage(hle->user_defined, "Task captured in %s", filename);
+
+    fclose(f);
+}
+#endif
@@ -50,5 +50,22 @@ void hle_init(struct hle_t* hle,
 
 void hle_execute(struct hle_t* hle);
 
+/* The ucodes found by task detection can be saved, so that a later session
+ * does not have to detect them again. uc_name identifies the ucode emulation
+ * function, only ucodes which are identified by their content are listed. */
+typedef void (*hle_ucode_callback_t)(void* opaque,
+    uint32_t uc_start, uint32_t uc_dstart, uint16_t uc_dsize, uint32_t uc_fingerprint,
+    const char* uc_name);
+
+/* hle_t.lle_ucodes is looked up when a ucode is added, so the cache has to
+ * be cleared after changing it */
+void hle_clear_ucodes(struct hle_t* hle);
+void hle_list_ucodes(struct hle_t* hle, hle_ucode_callback_t callback, void* opaque);
+
+/* returns 0 on success, -1 if uc_name is not a known ucode */
+int hle_add_ucode(struct hle_t* hle,
+    uint32_t uc_start, uint32_t uc_dstart, uint16_t uc_dsize, uint32_t uc_fingerprint,
+    const char* uc_name);
+
 #endif
 
@@ -0,0 +1,902 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus-rsp-hle - hle_bench.c                                     *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* rsp-hle-bench replays task captures (see task_capture.h) through the hle
+ * core. Each capture is run once from a fresh hle state to get the hash of
+ * the resulting RDRAM, which can be checked against golden hashes and against
+ * the output of an LLE RSP plugin, then it is run repeatedly to measure the
+ * time spent per task and per audio list command.
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#include <time.h>
+#endif
+
+#include "common.h"
+#include "hle.h"
+#include "hle_external.h"
+#include "hle_internal.h"
+#include "memory.h"
+#include "task_capture.h"
+
+#include "m64p_common.h"
+#include "m64p_config.h"
+#include "m64p_frontend.h"
+#include "m64p_plugin.h"
+#include "m64p_types.h"
+
+#include "osal_dynamiclib.h"
+
+#define CONFIG_API_VERSION       0x020100
+#define RSP_API_VERSION          0x20000
+
+#define BENCH_DEFAULT_RUNS       1000
+#define BENCH_ACMD_COUNT         0x80
+#define BENCH_CONFIG_MAX_PARAMS  64
+#define BENCH_LLE_MAX_CALLS      64
+
+/* Handy macro to avoid code bloat when loading symbols */
+#define GET_FUNC(type, field, name) \
+    ((field = (type)osal_dynlib_getproc(handle, name)) != NULL)
+
+struct bench_t
+{
+    int profile;
+    int last_acmd;
+    uint64_t mark;
+    uint64_t acmd_ns[BENCH_ACMD_COUNT];
+    uint64_t acmd_calls[BENCH_ACMD_COUNT];
+};
+
+struct rsp_regs_t
+{
+    unsigned int mi_intr;
+    unsigned int sp_mem_addr;
+    unsigned int sp_dram_addr;
+    unsigned int sp_rd_length;
+    unsigned int sp_wr_length;
+    unsigned int sp_status;
+    unsigned int sp_dma_full;
+    unsigned int sp_dma_busy;
+    unsigned int sp_pc;
+    unsigned int sp_semaphore;
+    unsigned int dpc_start;
+    unsigned int dpc_end;
+    unsigned int dpc_current;
+    unsigned int dpc_status;
+    unsigned int dpc_clock;
+    unsigned int dpc_bufbusy;
+    unsigned int dpc_pipebusy;
+    unsigned int dpc_tmem;
+};
+
+struct golden_t
+{
+    uint64_t hash;
+    char name[256];
+};
+
+struct config_param_t
+{
+    char name[64];
+    m64p_type type;
+    int ival;
+    float fval;
+};
+
+/* local variables */
+static int l_Verbose = 0;
+static int l_Quiet = 0;
+
+static struct bench_t l_Bench;
+static struct hle_t l_Hle;
+static struct hle_t l_FreshHle;
+static struct rsp_regs_t l_Regs;
+
+static struct task_capture_header l_Capture;
+static unsigned char l_CaptureDmem[0x1000];
+static unsigned char l_CaptureImem[0x1000];
+static unsigned char* l_CaptureDram = NULL;
+
+static unsigned char l_Dmem[0x1000];
+static unsigned char l_Imem[0x1000];
+static unsigned char* l_Dram = NULL;
+static unsigned char* l_ResultDram = NULL;
+
+static struct golden_t* l_Golden = NULL;
+static size_t l_GoldenCount = 0;
+
+static struct config_param_t l_ConfigParams[BENCH_CONFIG_MAX_PARAMS];
+static int l_ConfigParamCount = 0;
+
+static m64p_dynlib_handle l_LleHandle = NULL;
+static ptr_InitiateRSP l_InitiateRSP = NULL;
+static ptr_DoRspCycles l_DoRspCycles = NULL;
+static ptr_PluginShutdown l_PluginShutdown = NULL;
+
+/* local functions */
+static uint64_t bench_time(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+
+    return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000u
+         + (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000u / freq.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* 64-bit FNV-1a */
+static uint64_t hash_bytes(const unsigned char* bytes, size_t size)
+{
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    size_t i;
+
+    for (i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= UINT64_C(0x100000001b3);
+    }
+
+    return hash;
+}
+
+static const char* base_name(const char* path)
+{
+    const char* name = path;
+
+    for (; *path != '\0'; ++path) {
+        if (*path == '/' || *path == '\\')
+            name = path + 1;
+    }
+
+    return name;
+}
+
+static void print_message(const char* level, const char* message, va_list args)
+{
+    fprintf(stderr, "%s: ", level);
+    vfprintf(stderr, message, args);
+    fputc('\n', stderr);
+}
+
+static int load_capture(const char* filename)
+{
+    FILE* f = fopen(filename, "rb");
+
+    if (f == NULL) {
+        fprintf(stderr, "Couldn't open %s\n", filename);
+        return -1;
+    }
+
+    if (fread(&l_Capture, sizeof(l_Capture), 1, f) != 1
+     || memcmp(l_Capture.magic, TASK_CAPTURE_MAGIC, sizeof(l_Capture.magic)) != 0
+     || l_Capture.dram_size > TASK_CAPTURE_DRAM_SIZE
+     || (l_Capture.dram_size & 3) != 0) {
+        fprintf(stderr, "%s is not a task capture\n", filename);
+        fclose(f);
+        return -1;
+    }
+
+    if (fread(l_CaptureDmem, 1, 0x1000, f) != 0x1000
+     || fread(l_CaptureImem, 1, 0x1000, f) != 0x1000
+     || fread(l_CaptureDram, 1, l_Capture.dram_size, f) != l_Capture.dram_size) {
+        fprintf(stderr, "Reading error on %s\n", filename);
+        fclose(f);
+        return -1;
+    }
+
+    memset(l_CaptureDram + l_Capture.dram_size, 0, TASK_CAPTURE_DRAM_SIZE - l_Capture.dram_size);
+    fclose(f);
+    return 0;
+}
+
+static void restore_capture(void)
+{
+    memcpy(l_Dmem, l_CaptureDmem, 0x1000);
+    memcpy(l_Imem, l_CaptureImem, 0x1000);
+    memcpy(l_Dram, l_CaptureDram, TASK_CAPTURE_DRAM_SIZE);
+
+    memset(&l_Regs, 0, sizeof(l_Regs));
+    l_Regs.sp_status = l_Capture.sp_status;
+    l_Regs.sp_pc = l_Capture.sp_pc;
+}
+
+static void init_hle(struct hle_t* hle)
+{
+    memset(hle, 0, sizeof(*hle));
+
+    hle_init(hle,
+             l_Dram,
+             l_Dmem,
+             l_Imem,
+             &l_Regs.mi_intr,
+             &l_Regs.sp_mem_addr,
+             &l_Regs.sp_dram_addr,
+             &l_Regs.sp_rd_length,
+             &l_Regs.sp_wr_length,
+             &l_Regs.sp_status,
+             &l_Regs.sp_dma_full,
+             &l_Regs.sp_dma_busy,
+             &l_Regs.sp_pc,
+             &l_Regs.sp_semaphore,
+             &l_Regs.dpc_start,
+             &l_Regs.dpc_end,
+             &l_Regs.dpc_current,
+             &l_Regs.dpc_status,
+             &l_Regs.dpc_clock,
+             &l_Regs.dpc_bufbusy,
+             &l_Regs.dpc_pipebusy,
+             &l_Regs.dpc_tmem,
+             &l_Bench);
+}
+
+static int load_golden(const char* filename)
+{
+    char line[512];
+    unsigned long long hash;
+    struct golden_t* golden;
+    FILE* f = fopen(filename, "r");
+
+    if (f == NULL) {
+        fprintf(stderr, "Couldn't open %s\n", filename);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        golden = realloc(l_Golden, (l_GoldenCount + 1) * sizeof(*l_Golden));
+        if (golden == NULL) {
+            fclose(f);
+            return -1;
+        }
+        l_Golden = golden;
+        golden += l_GoldenCount;
+
+        if (sscanf(line, "%16llx %255s", &hash, golden->name) == 2) {
+            golden->hash = hash;
+            ++l_GoldenCount;
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static const struct golden_t* find_golden(const char* name)
+{
+    size_t i;
+
+    for (i = 0; i < l_GoldenCount; ++i) {
+        if (strcmp(l_Golden[i].name, name) == 0)
+            return &l_Golden[i];
+    }
+
+    return NULL;
+}
+
+static void lle_debug_callback(void* UNUSED(context), int level, const char* message)
+{
+    if (l_Verbose || level <= M64MSG_WARNING)
+        fprintf(stderr, "lle: %s\n", message);
+}
+
+static void lle_dummy(void)
+{
+}
+
+static int load_lle(const char* filename)
+{
+    m64p_dynlib_handle handle = NULL;
+    m64p_dynlib_handle core_handle;
+    ptr_PluginGetVersion PluginGetVersion;
+    ptr_PluginStartup PluginStartup;
+    m64p_plugin_type plugin_type = (m64p_plugin_type)0;
+    int plugin_version = 0;
+    int api_version = 0;
+    const char* plugin_name = NULL;
+
+    if (osal_dynlib_open(&handle, filename) != M64ERR_SUCCESS) {
+        fprintf(stderr, "Can't load library: %s\n", filename);
+        return -1;
+    }
+
+    if (!GET_FUNC(ptr_PluginGetVersion, PluginGetVersion, "PluginGetVersion")) {
+        fprintf(stderr, "library '%s' is not a Mupen64Plus library.\n", filename);
+        goto close_handle;
+    }
+
+    (*PluginGetVersion)(&plugin_type, &plugin_version, &api_version, &plugin_name, NULL);
+
+    if (plugin_type != M64PLUGIN_RSP
+     || (api_version & 0xffff0000) != (RSP_API_VERSION & 0xffff0000)) {
+        fprintf(stderr, "library '%s' is not a compatible RSP plugin.\n", filename);
+        goto close_handle;
+    }
+
+    if (!GET_FUNC(ptr_PluginStartup, PluginStartup, "PluginStartup") ||
+        !GET_FUNC(ptr_PluginShutdown, l_PluginShutdown, "PluginShutdown") ||
+        !GET_FUNC(ptr_DoRspCycles, l_DoRspCycles, "DoRspCycles") ||
+        !GET_FUNC(ptr_InitiateRSP, l_InitiateRSP, "InitiateRSP")) {
+        fprintf(stderr, "broken RSP plugin; function(s) not found.\n");
+        goto close_handle;
+    }
+
+    /* the plugin gets its Config functions from this executable */
+#ifdef _WIN32
+    core_handle = GetModuleHandle(NULL);
+#else
+    core_handle = dlopen(NULL, RTLD_NOW);
+#endif
+
+    if ((*PluginStartup)(core_handle, NULL, lle_debug_callback) != M64ERR_SUCCESS) {
+        fprintf(stderr, "%s plugin library '%s' failed to start.\n", plugin_name, filename);
+        goto close_handle;
+    }
+
+    l_LleHandle = handle;
+    return 0;
+
+close_handle:
+    l_PluginShutdown = NULL;
+    l_DoRspCycles = NULL;
+    l_InitiateRSP = NULL;
+    osal_dynlib_close(handle);
+    return -1;
+}
+
+static uint64_t run_lle(void)
+{
+    RSP_INFO info;
+    unsigned int cycles = 0;
+    unsigned int i;
+    uint64_t start;
+
+    restore_capture();
+
+    info.RDRAM = l_Dram;
+    info.DMEM = l_Dmem;
+    info.IMEM = l_Imem;
+    info.MI_INTR_REG = &l_Regs.mi_intr;
+    info.SP_MEM_ADDR_REG = &l_Regs.sp_mem_addr;
+    info.SP_DRAM_ADDR_REG = &l_Regs.sp_dram_addr;
+    info.SP_RD_LEN_REG = &l_Regs.sp_rd_length;
+    info.SP_WR_LEN_REG = &l_Regs.sp_wr_length;
+    info.SP_STATUS_REG = &l_Regs.sp_status;
+    info.SP_DMA_FULL_REG = &l_Regs.sp_dma_full;
+    info.SP_DMA_BUSY_REG = &l_Regs.sp_dma_busy;
+    info.SP_PC_REG = &l_Regs.sp_pc;
+    info.SP_SEMAPHORE_REG = &l_Regs.sp_semaphore;
+    info.DPC_START_REG = &l_Regs.dpc_start;
+    info.DPC_END_REG = &l_Regs.dpc_end;
+    info.DPC_CURRENT_REG = &l_Regs.dpc_current;
+    info.DPC_STATUS_REG = &l_Regs.dpc_status;
+    info.DPC_CLOCK_REG = &l_Regs.dpc_clock;
+    info.DPC_BUFBUSY_REG = &l_Regs.dpc_bufbusy;
+    info.DPC_PIPEBUSY_REG = &l_Regs.dpc_pipebusy;
+    info.DPC_TMEM_REG = &l_Regs.dpc_tmem;
+    info.CheckInterrupts = lle_dummy;
+    info.ProcessDlistList = lle_dummy;
+    info.ProcessAlistList = lle_dummy;
+    info.ProcessRdpList = lle_dummy;
+    info.ShowCFB = lle_dummy;
+
+    (*l_InitiateRSP)(info, &cycles);
+
+    /* InitiateRSP resets the RSP registers, restart the task as the CPU did */
+    memset(&l_Regs, 0, sizeof(l_Regs));
+    l_Regs.sp_status = l_Capture.sp_status & ~(SP_STATUS_HALT | SP_STATUS_BROKE);
+    l_Regs.sp_pc = l_Capture.sp_pc;
+
+    start = bench_time();
+    for (i = 0; i < BENCH_LLE_MAX_CALLS && !(l_Regs.sp_status & SP_STATUS_HALT); ++i)
+        (*l_DoRspCycles)(0xffffffff);
+
+    return bench_time() - start;
+}
+
+static uint64_t run_hle_once(void)
+{
+    uint64_t start, end;
+
+    restore_capture();
+    l_Hle = l_FreshHle;
+    l_Bench.last_acmd = -1;
+
+    start = bench_time();
+    l_Bench.mark = start;
+    hle_execute(&l_Hle);
+    end = bench_time();
+
+    /* the time left after the last command is attributed to it */
+    if (l_Bench.profile && l_Bench.last_acmd >= 0)
+        l_Bench.acmd_ns[l_Bench.last_acmd] += end - l_Bench.mark;
+
+    return end - start;
+}
+
+static int run_capture(const char* filename, unsigned int runs, FILE* write_golden)
+{
+    const char* name = base_name(filename);
+    const struct golden_t* golden;
+    uint64_t hash, total, lle_ns;
+    unsigned int i, acmd;
+    size_t diffs, first_diff;
+    int failed = 0;
+
+    if (load_capture(filename) != 0)
+        return 1;
+
+    /* reference run, from a fresh hle state */
+    init_hle(&l_FreshHle);
+    memset(&l_Bench, 0, sizeof(l_Bench));
+    l_Quiet = 0;
+    run_hle_once();
+
+    memcpy(l_ResultDram, l_Dram, TASK_CAPTURE_DRAM_SIZE);
+    hash = hash_bytes(l_ResultDram, TASK_CAPTURE_DRAM_SIZE);
+
+    /* keep ucode detection out of the measurements */
+    l_FreshHle.cached_ucodes = l_Hle.cached_ucodes;
+    l_Quiet = !l_Verbose;
+
+    total = 0;
+    for (i = 0; i < runs; ++i)
+        total += run_hle_once();
+
+    if (runs != 0 && hash_bytes(l_Dram, TASK_CAPTURE_DRAM_SIZE) != hash) {
+        printf("%s: replays do not give the same RDRAM\n", name);
+        failed = 1;
+    }
+
+    /* second pass with command timing, which adds some overhead */
+    l_Bench.profile = 1;
+    for (i = 0; i < runs; ++i)
+        run_hle_once();
+    l_Bench.profile = 0;
+    l_Quiet = 0;
+
+    printf("%s: type %u, ucode %08x, %u runs, %.0f ns/task, hash %016llx\n",
+           name,
+           *(uint32_t*)(l_CaptureDmem + TASK_TYPE),
+           *(uint32_t*)(l_CaptureDmem + TASK_UCODE),
+           runs,
+           (runs != 0) ? (double)total / runs : 0.0,
+           (unsigned long long)hash);
+
+    for (acmd = 0; acmd < BENCH_ACMD_COUNT && runs != 0; ++acmd) {
+        if (l_Bench.acmd_calls[acmd] == 0)
+            continue;
+
+        printf("    acmd %02x: %7.1f calls/task %10.0f ns/task %8.1f ns/call\n",
+               acmd,
+               (double)l_Bench.acmd_calls[acmd] / runs,
+               (double)l_Bench.acmd_ns[acmd] / runs,
+               (double)l_Bench.acmd_ns[acmd] / l_Bench.acmd_calls[acmd]);
+    }
+
+    if (write_golden != NULL)
+        fprintf(write_golden, "%016llx %s\n", (unsigned long long)hash, name);
+
+    if (l_Golden != NULL) {
+        golden = find_golden(name);
+        if (golden == NULL) {
+            printf("    golden: missing\n");
+            failed = 1;
+        } else if (golden->hash != hash) {
+            printf("    golden: MISMATCH (expected %016llx)\n", (unsigned long long)golden->hash);
+            failed = 1;
+        } else
+            printf("    golden: ok\n");
+    }
+
+    if (l_LleHandle != NULL) {
+        lle_ns = run_lle();
+
+        diffs = 0;
+        first_diff = 0;
+        for (i = 0; i < TASK_CAPTURE_DRAM_SIZE; ++i) {
+            if (l_Dram[i] != l_ResultDram[i] && diffs++ == 0)
+                first_diff = i;
+        }
+
+        if (!(l_Regs.sp_status & SP_STATUS_HALT)) {
+            printf("    lle: task did not halt\n");
+            failed = 1;
+        } else if (diffs != 0) {
+            printf("    lle: %.0f ns/task, %u RDRAM bytes differ (first at %06x)\n",
+                   (double)lle_ns, (unsigned int)diffs, (unsigned int)first_diff);
+            failed = 1;
+        } else
+            printf("    lle: %.0f ns/task, same RDRAM\n", (double)lle_ns);
+    }
+
+    return failed;
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options] capture.bin...\n"
+            "  -n N                 number of timed runs per capture (default: %u)\n"
+            "  --golden FILE        compare RDRAM hashes with the ones in FILE\n"
+            "  --write-golden FILE  write RDRAM hashes to FILE\n"
+            "  --lle PLUGIN         compare RDRAM with the one given by an LLE RSP plugin\n"
+            "  -v                   show hle core messages for every run\n",
+            program, BENCH_DEFAULT_RUNS);
+}
+
+/* Global functions needed by HLE core */
+void HleVerboseMessage(void* UNUSED(user_defined), const char *msg, ...)
+{
+    va_list args;
+
+    if (!l_Verbose)
+        return;
+
+    va_start(args, msg);
+    print_message("verbose", msg, args);
+    va_end(args);
+}
+
+void HleInfoMessage(void* UNUSED(user_defined), const char *msg, ...)
+{
+    va_list args;
+
+    if (!l_Verbose)
+        return;
+
+    va_start(args, msg);
+    print_message("info", msg, args);
+    va_end(args);
+}
+
+void HleErrorMessage(void* UNUSED(user_defined), const char *msg, ...)
+{
+    va_list args;
+
+    if (l_Quiet)
+        return;
+
+    va_start(args, msg);
+    print_message("error", msg, args);
+    va_end(args);
+}
+
+void HleWarnMessage(void* UNUSED(user_defined), const char *msg, ...)
+{
+    va_list args;
+
+    if (l_Quiet)
+        return;
+
+    va_start(args, msg);
+    print_message("warning", msg, args);
+    va_end(args);
+}
+
+void HleCheckInterrupts(void* UNUSED(user_defined))
+{
+}
+
+void HleProcessDlistList(void* UNUSED(user_defined))
+{
+}
+
+void HleProcessAlistList(void* UNUSED(user_defined))
+{
+}
+
+void HleProcessRdpList(void* UNUSED(user_defined))
+{
+}
+
+void HleShowCFB(void* UNUSED(user_defined))
+{
+}
+
+int HleForwardTask(void* UNUSED(user_defined))
+{
+    /* the LLE plugin, if any, only runs the capture for comparison */
+    return -1;
+}
+
+int HleQueueAudioTask(void* UNUSED(user_defined), void (*task)(struct hle_t* hle))
+{
+    return -1;
+}
+
+void HleBenchCommand(void* user_defined, unsigned int acmd)
+{
+    struct bench_t* bench = (struct bench_t*)user_defined;
+    uint64_t now;
+
+    if (!bench->profile)
+        return;
+
+    now = bench_time();
+    if (bench->last_acmd >= 0)
+        bench->acmd_ns[bench->last_acmd] += now - bench->mark;
+
+    ++bench->acmd_calls[acmd];
+    bench->last_acmd = acmd;
+    bench->mark = now;
+}
+
+/* Core functions needed by the LLE plugin. Parameters are only kept in
+ * memory, so the plugin always runs with its default configuration. */
+static struct config_param_t* find_config_param(const char* name, int create)
+{
+    int i;
+
+    for (i = 0; i < l_ConfigParamCount; ++i) {
+        if (strcmp(l_ConfigParams[i].name, name) == 0)
+            return &l_ConfigParams[i];
+    }
+
+    if (!create || l_ConfigParamCount == BENCH_CONFIG_MAX_PARAMS)
+        return NULL;
+
+    i = l_ConfigParamCount++;
+    memset(&l_ConfigParams[i], 0, sizeof(l_ConfigParams[i]));
+    strncpy(l_ConfigParams[i].name, name, sizeof(l_ConfigParams[i].name) - 1);
+    return &l_ConfigParams[i];
+}
+
+static m64p_error set_config_param(const char* name, m64p_type type, int ival, float fval)
+{
+    struct config_param_t* param = find_config_param(name, 1);
+
+    if (param == NULL)
+        return M64ERR_NO_MEMORY;
+
+    param->type = type;
+    param->ival = ival;
+    param->fval = fval;
+    return M64ERR_SUCCESS;
+}
+
+EXPORT m64p_error CALL CoreGetAPIVersions(int* ConfigVersion, int* DebugVersion, int* VidextVersion, int* ExtraVersion)
+{
+    if (ConfigVersion != NULL)
+        *ConfigVersion = CONFIG_API_VERSION;
+    if (DebugVersion != NULL)
+        *DebugVersion = 0;
+    if (VidextVersion != NULL)
+        *VidextVersion = 0;
+    if (ExtraVersion != NULL)
+        *ExtraVersion = 0;
+
+    return M64ERR_SUCCESS;
+}
+
+EXPORT m64p_error CALL CoreDoCommand(m64p_command Command, int ParamInt, void* ParamPtr)
+{
+    /* there is no ROM, plugins asking for its header get a blank one */
+    if (Command == M64CMD_ROM_GET_HEADER && ParamPtr != NULL && ParamInt > 0) {
+        memset(ParamPtr, 0, ParamInt);
+        return M64ERR_SUCCESS;
+    }
+
+    return M64ERR_UNSUPPORTED;
+}
+
+EXPORT m64p_error CALL ConfigOpenSection(const char* UNUSED(SectionName), m64p_handle* ConfigSectionHandle)
+{
+    *ConfigSectionHandle = l_ConfigParams;
+    return M64ERR_SUCCESS;
+}
+
+EXPORT m64p_error CALL ConfigDeleteSection(const char* UNUSED(SectionName))
+{
+    l_ConfigParamCount = 0;
+    return M64ERR_SUCCESS;
+}
+
+EXPORT m64p_error CALL ConfigSaveSection(const char* UNUSED(SectionName))
+{
+    return M64ERR_SUCCESS;
+}
+
+EXPORT m64p_error CALL ConfigSetParameter(m64p_handle UNUSED(ConfigSectionHandle), const char* ParamName, m64p_type ParamType, const void* ParamValue)
+{
+    switch (ParamType) {
+    case M64TYPE_INT:
+    case M64TYPE_BOOL:
+        return set_config_param(ParamName, ParamType, *(const int*)ParamValue, 0.0f);
+    case M64TYPE_FLOAT:
+        return set_config_param(ParamName, ParamType, 0, *(const float*)ParamValue);
+    default:
+        return M64ERR_INPUT_INVALID;
+    }
+}
+
+EXPORT m64p_error CALL ConfigGetParameter(m64p_handle UNUSED(ConfigSectionHandle), const char* ParamName, m64p_type ParamType, void* ParamValue, int MaxSize)
+{
+    const struct config_param_t* param = find_config_param(ParamName, 0);
+
+    if (param == NULL)
+        return M64ERR_INPUT_NOT_FOUND;
+
+    switch (ParamType) {
+    case M64TYPE_INT:
+    case M64TYPE_BOOL:
+        if (MaxSize < (int)sizeof(int))
+            return M64ERR_INPUT_INVALID;
+        *(int*)ParamValue = (param->type == M64TYPE_FLOAT) ? (int)param->fval : param->ival;
+        return M64ERR_SUCCESS;
+    case M64TYPE_FLOAT:
+        if (MaxSize < (int)sizeof(float))
+            return M64ERR_INPUT_INVALID;
+        *(float*)ParamValue = (param->type == M64TYPE_FLOAT) ? param->fval : (float)param->ival;
+        return M64ERR_SUCCESS;
+    default:
+        return M64ERR_INPUT_INVALID;
+    }
+}
+
+EXPORT m64p_error CALL ConfigSetDefaultInt(m64p_handle UNUSED(ConfigSectionHandle), const char* ParamName, int ParamValue, const char* UNUSED(ParamHelp))
+{
+    if (find_config_param(ParamName, 0) != NULL)
+        return M64ERR_SUCCESS;
+
+    return set_config_param(ParamName, M64TYPE_INT, ParamValue, 0.0f);
+}
+
+EXPORT m64p_error CALL ConfigSetDefaultFloat(m64p_handle UNUSED(ConfigSectionHandle), const char* ParamName, float ParamValue, const char* UNUSED(ParamHelp))
+{
+    if (find_config_param(ParamName, 0) != NULL)
+        return M64ERR_SUCCESS;
+
+    return set_config_param(ParamName, M64TYPE_FLOAT, 0, ParamValue);
+}
+
+EXPORT m64p_error CALL ConfigSetDefaultBool(m64p_handle UNUSED(ConfigSectionHandle), const char* ParamName, int ParamValue, const char* UNUSED(ParamHelp))
+{
+    if (find_config_param(ParamName, 0) != NULL)
+        return M64ERR_SUCCESS;
+
+    return set_config_param(ParamName, M64TYPE_BOOL, ParamValue, 0.0f);
+}
+
+EXPORT m64p_error CALL ConfigSetDefaultString(m64p_handle UNUSED(ConfigSectionHandle), const char* UNUSED(ParamName), const char* UNUSED(ParamValue), const char* UNUSED(ParamHelp))
+{
+    return M64ERR_SUCCESS;
+}
+
+EXPORT int CALL ConfigGetParamInt(m64p_handle UNUSED(ConfigSectionHandle), const char* ParamName)
+{
+    const struct config_param_t* param = find_config_param(ParamName, 0);
+
+    return (param != NULL) ? param->ival : 0;
+}
+
+EXPORT float CALL ConfigGetParamFloat(m64p_handle UNUSED(ConfigSectionHandle), const char* ParamName)
+{
+    const struct config_param_t* param = find_config_param(ParamName, 0);
+
+    return (param != NULL) ? param->fval : 0.0f;
+}
+
+EXPORT int CALL ConfigGetParamBool(m64p_handle UNUSED(ConfigSectionHandle), const char* ParamName)
+{
+    const struct config_param_t* param = find_config_param(ParamName, 0);
+
+    return (param != NULL) ? (param->ival != 0) : 0;
+}
+
+EXPORT const char* CALL ConfigGetParamString(m64p_handle UNUSED(ConfigSectionHandle), const char* UNUSED(ParamName))
+{
+    return "";
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int runs = BENCH_DEFAULT_RUNS;
+    const char* golden_filename = NULL;
+    const char* write_golden_filename = NULL;
+    const char* lle_filename = NULL;
+    FILE* write_golden = NULL;
+    int captures = 0;
+    int failed = 0;
+    int i;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            runs = (unsigned int)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+            golden_filename = argv[++i];
+        else if (strcmp(argv[i], "--write-golden") == 0 && i + 1 < argc)
+            write_golden_filename = argv[++i];
+        else if (strcmp(argv[i], "--lle") == 0 && i + 1 < argc)
+            lle_filename = argv[++i];
+        else if (strcmp(argv[i], "-v") == 0)
+            l_Verbose = 1;
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (i == argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    l_CaptureDram = malloc(TASK_CAPTURE_DRAM_SIZE);
+    l_Dram = malloc(TASK_CAPTURE_DRAM_SIZE);
+    l_ResultDram = malloc(TASK_CAPTURE_DRAM_SIZE);
+    if (l_CaptureDram == NULL || l_Dram == NULL || l_ResultDram == NULL) {
+        fprintf(stderr, "Can't allocate RDRAM\n");
+        return 2;
+    }
+
+    if (golden_filename != NULL && load_golden(golden_filename) != 0)
+        return 2;
+
+    if (write_golden_filename != NULL) {
+        write_golden = fopen(write_golden_filename, "w");
+        if (write_golden == NULL) {
+            fprintf(stderr, "Couldn't open %s for writing\n", write_golden_filename);
+            return 2;
+        }
+    }
+
+    if (lle_filename != NULL && load_lle(lle_filename) != 0)
+        return 2;
+
+    for (; i < argc; ++i) {
+        failed |= run_capture(argv[i], runs, write_golden);
+        ++captures;
+    }
+
+    if (l_LleHandle != NULL) {
+        (*l_PluginShutdown)();
+        osal_dynlib_close(l_LleHandle);
+    }
+
+    if (write_golden != NULL)
+        fclose(write_golden);
+
+    free(l_Golden);
+    free(l_ResultDram);
+    free(l_Dram);
+    free(l_CaptureDram);
+
+    printf("%d capture(s), %s\n", captures, failed ? "FAILED" : "ok");
+    return failed;
+}
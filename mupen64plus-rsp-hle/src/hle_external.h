@@ -28,6 +28,8 @@
 #define ATTR_FMT(fmtpos, attrpos)
 #endif
 
+struct hle_t;
+
 /* users of the hle core are expected to define these functions */
 
 void HleVerboseMessage(void* user_defined, const char *message, ...) ATTR_FMT(2, 3);
@@ -42,5 +44,17 @@ void HleProcessRdpList(void* user_defined);
 void HleShowCFB(void* user_defined);
 int HleForwardTask(void* user_defined);
 
+/* Start an audio task on another thread, against a copy of the current DMEM.
+ * Return 0 if the task was queued, in which case the hle core signals its
+ * completion right away; RDRAM is only complete once the user waited for it,
+ * which SyncRspTasks does before the core lets the game see the completion.
+ */
+int HleQueueAudioTask(void* user_defined, void (*task)(struct hle_t* hle));
+
+#ifdef HLE_BENCH
+/* Only in rsp-hle-bench builds: called before each audio list command. */
+void HleBenchCommand(void* user_defined, unsigned int acmd);
+#endif
+
 #endif
 
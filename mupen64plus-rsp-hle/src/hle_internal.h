@@ -59,6 +59,11 @@ struct hle_t
 
     int hle_gfx;
     int hle_aud;
+    int async_aud;
+
+    /* names of the known ucodes to forward to the RSP fallback instead of
+     * emulating them, separated by spaces, commas or semicolons (may be NULL) */
+    const char* lle_ucodes;
 
     /* alist.c */
     uint8_t alist_buffer[0x1000];
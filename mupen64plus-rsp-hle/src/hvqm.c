@@ -199,9 +199,16 @@ static struct RGBA YCbCr_to_RGBA(int16_t Y, int16_t Cb, int16_t Cr, uint8_t alph
     struct RGBA color;
 
     //Format S10.6
-    int r = (int)(((double)Y + 0.5) + (1.765625 * (double)(Cr - 128)));
-    int g = (int)(((double)Y + 0.5) - (0.34375 * (double)(Cr - 128)) - (0.71875 * (double)(Cb - 128)));
-    int b = (int)(((double)Y + 0.5) + (1.40625 * (double)(Cb - 128)));
+    /* The coefficients are exact in S10.6, so are all the intermediate
+     * results of the double precision formula. Integer arithmetic gives the
+     * same results, the division truncating towards zero like the cast:
+     * r = (int)((Y + 0.5) + 1.765625 * (Cr - 128))
+     * g = (int)((Y + 0.5) - 0.34375 * (Cr - 128) - 0.71875 * (Cb - 128))
+     * b = (int)((Y + 0.5) + 1.40625 * (Cb - 128)) */
+    const int y = Y * 64 + 32;
+    int r = (y + 113 * (Cr - 128)) / 64;
+    int g = (y - 22 * (Cr - 128) - 46 * (Cb - 128)) / 64;
+    int b = (y + 90 * (Cb - 128)) / 64;
 
     color.r = SATURATE8(r);
     color.g = SATURATE8(g);
@@ -211,21 +218,30 @@ static struct RGBA YCbCr_to_RGBA(int16_t Y, int16_t Cb, int16_t Cr, uint8_t alph
     return color;
 }
 
-void store_rgba5551(struct hle_t* hle, struct RGBA color, uint32_t * addr)
+/* a line of a macro block is 8 pixels wide */
+#define HVQM2_LINE_WIDTH 8
+
+void store_rgba5551(struct hle_t* hle, const struct RGBA* colors, uint32_t addr)
 {
-    uint16_t pixel = ((color.b >> 3) << 11) | ((color.g >> 3) << 6) | ((color.r >> 3) << 1) | (color.a & 1);
-    dram_store_u16(hle, &pixel, *addr, 1);
-    *addr += 2;
+    uint16_t pixels[HVQM2_LINE_WIDTH];
+
+    for (int i = 0; i < HVQM2_LINE_WIDTH; i++)
+        pixels[i] = ((colors[i].b >> 3) << 11) | ((colors[i].g >> 3) << 6) | ((colors[i].r >> 3) << 1) | (colors[i].a & 1);
+
+    dram_store_u16(hle, pixels, addr, HVQM2_LINE_WIDTH);
 }
 
-void store_rgba8888(struct hle_t* hle, struct RGBA color, uint32_t * addr)
+void store_rgba8888(struct hle_t* hle, const struct RGBA* colors, uint32_t addr)
 {
-    uint32_t pixel = (color.b << 24) | (color.g << 16) | (color.r << 8) | color.a;
-    dram_store_u32(hle, &pixel, *addr, 1);
-    *addr += 4;
+    uint32_t pixels[HVQM2_LINE_WIDTH];
+
+    for (int i = 0; i < HVQM2_LINE_WIDTH; i++)
+        pixels[i] = (colors[i].b << 24) | (colors[i].g << 16) | (colors[i].r << 8) | colors[i].a;
+
+    dram_store_u32(hle, pixels, addr, HVQM2_LINE_WIDTH);
 }
 
-typedef void(*store_pixel_t)(struct hle_t* hle, struct RGBA color, uint32_t * addr);
+typedef void(*store_line_t)(struct hle_t* hle, const struct RGBA* colors, uint32_t addr);
 
 static void hvqm2_decode(struct hle_t* hle, int is32)
 {
@@ -257,21 +273,21 @@ static void hvqm2_decode(struct hle_t* hle, int is32)
     assert((*hle->sp_status & 0x80) == 0);  //SP_STATUS_YIELD
 
     int length, skip;
-    store_pixel_t store_pixel;
+    store_line_t store_line;
 
     if (is32)
     {
         length = 0x20;
         skip = arg.buf_width << 2;
         arg.buf_width <<= 4;
-        store_pixel = &store_rgba8888;
+        store_line = &store_rgba8888;
     }
     else
     {
         length = 0x10;
         skip = arg.buf_width << 1;
         arg.buf_width <<= 3;
-        store_pixel = &store_rgba5551;
+        store_line = &store_rgba5551;
     }
 
     if (arg.chroma_step_v == 2)
@@ -319,17 +335,12 @@ static void hvqm2_decode(struct hle_t* hle, int is32)
             {
                 for (int m = 0; m < arg.chroma_step_v; m++)
                 {
-                    uint32_t addr = out_buf;
+                    struct RGBA colors[HVQM2_LINE_WIDTH];
                     for (int l = 0; l < 4; l++)
-                    {
-                        struct RGBA color = YCbCr_to_RGBA(pY1[l], pCb[l >> 1], pCr[l >> 1], arg.alpha);
-                        store_pixel(hle, color, &addr);
-                    }
+                        colors[l] = YCbCr_to_RGBA(pY1[l], pCb[l >> 1], pCr[l >> 1], arg.alpha);
                     for (int l = 0; l < 4; l++)
-                    {
-                        struct RGBA color = YCbCr_to_RGBA(pY2[l], pCb[(l + 4) >> 1], pCr[(l + 4) >> 1], arg.alpha);
-                        store_pixel(hle, color, &addr);
-                    }
+                        colors[l + 4] = YCbCr_to_RGBA(pY2[l], pCb[(l + 4) >> 1], pCr[(l + 4) >> 1], arg.alpha);
+                    store_line(hle, colors, out_buf);
                     out_buf += skip;
                     pY1 += 4;
                     pY2 += 4;
@@ -45,11 +45,17 @@ static void jpeg_decode_std(struct hle_t* hle,
 /* helper functions */
 static uint8_t clamp_u8(int16_t x);
 static int16_t clamp_s12(int16_t x);
+#ifndef ARITHMETICS_SSE2
 static uint16_t clamp_RGBA_component(int16_t x);
+#endif
 
 /* pixel conversion & formatting */
 static uint32_t GetUYVY(int16_t y1, int16_t y2, int16_t u, int16_t v);
+#ifdef ARITHMETICS_SSE2
+static __m128i GetRGBA8(const int16_t *y, const int16_t *u, const int16_t *v);
+#else
 static uint16_t GetRGBA(int16_t y, int16_t u, int16_t v);
+#endif
 
 /* tile line emitters */
 static void EmitYUVTileLine(struct hle_t* hle, const int16_t *y, const int16_t *u, uint32_t address);
@@ -72,7 +78,11 @@ static void ReorderSubBlock(int16_t *dst, const int16_t *src, const unsigned int
 static void MultSubBlocks(int16_t *dst, const int16_t *src1, const int16_t *src2, unsigned int shift);
 static void ScaleSubBlock(int16_t *dst, const int16_t *src, int16_t scale);
 static void RShiftSubBlock(int16_t *dst, const int16_t *src, unsigned int shift);
+#ifdef ARITHMETICS_SSE2
+static void InverseDCT1D4(const __m128 *x, __m128 *dst);
+#else
 static void InverseDCT1D(const float *const x, float *dst, unsigned int stride);
+#endif
 static void InverseDCTSubBlock(int16_t *dst, const int16_t *src);
 static void RescaleYSubBlock(int16_t *dst, const int16_t *src);
 static void RescaleUVSubBlock(int16_t *dst, const int16_t *src);
@@ -282,6 +292,7 @@ static int16_t clamp_s12(int16_t x)
     return x;
 }
 
+#ifndef ARITHMETICS_SSE2
 static uint16_t clamp_RGBA_component(int16_t x)
 {
     if (x > 0xff0)
@@ -290,6 +301,7 @@ static uint16_t clamp_RGBA_component(int16_t x)
         x = 0;
     return (x & 0xf80);
 }
+#endif
 
 static uint32_t GetUYVY(int16_t y1, int16_t y2, int16_t u, int16_t v)
 {
@@ -299,6 +311,44 @@ static uint32_t GetUYVY(int16_t y1, int16_t y2, int16_t u, int16_t v)
            (uint32_t)clamp_u8(y2);
 }
 
+#ifdef ARITHMETICS_SSE2
+/* GetRGBA on 8 pixels, each pair of pixels sharing the same u and v */
+static __m128i GetRGBA8(const int16_t *y, const int16_t *u, const int16_t *v)
+{
+    int32_t rgb[3][8];
+    __m128i c[3];
+    unsigned int i;
+
+    for (i = 0; i < 4; ++i) {
+        const __m128d fY = _mm_setr_pd((float)y[2 * i] + 2048.0f, (float)y[2 * i + 1] + 2048.0f);
+        const __m128d fU = _mm_set1_pd((float)u[i]);
+        const __m128d fV = _mm_set1_pd((float)v[i]);
+
+        const __m128d r = _mm_add_pd(fY, _mm_mul_pd(_mm_set1_pd(1.4025), fV));
+        const __m128d g = _mm_sub_pd(_mm_sub_pd(fY, _mm_mul_pd(_mm_set1_pd(0.3443), fU)),
+                                     _mm_mul_pd(_mm_set1_pd(0.7144), fV));
+        const __m128d b = _mm_add_pd(fY, _mm_mul_pd(_mm_set1_pd(1.7729), fU));
+
+        _mm_storel_epi64((__m128i *)&rgb[0][2 * i], _mm_cvttpd_epi32(r));
+        _mm_storel_epi64((__m128i *)&rgb[1][2 * i], _mm_cvttpd_epi32(g));
+        _mm_storel_epi64((__m128i *)&rgb[2][2 * i], _mm_cvttpd_epi32(b));
+    }
+
+    /* (int16_t) conversion followed by clamp_RGBA_component */
+    for (i = 0; i < 3; ++i) {
+        const __m128i lo = _mm_loadu_si128((const __m128i *)&rgb[i][0]);
+        const __m128i hi = _mm_loadu_si128((const __m128i *)&rgb[i][4]);
+
+        c[i] = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(lo, 16), 16),
+                               _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16));
+        c[i] = _mm_max_epi16(_mm_min_epi16(c[i], _mm_set1_epi16(0xff0)), _mm_setzero_si128());
+        c[i] = _mm_and_si128(c[i], _mm_set1_epi16(0xf80));
+    }
+
+    return _mm_or_si128(_mm_or_si128(_mm_slli_epi16(c[0], 4), _mm_srli_epi16(c[1], 1)),
+                        _mm_or_si128(_mm_srli_epi16(c[2], 6), _mm_set1_epi16(1)));
+}
+#else
 static uint16_t GetRGBA(int16_t y, int16_t u, int16_t v)
 {
     const float fY = (float)y + 2048.0f;
@@ -311,6 +361,7 @@ static uint16_t GetRGBA(int16_t y, int16_t u, int16_t v)
 
     return (r << 4) | (g >> 1) | (b >> 6) | 1;
 }
+#endif
 
 static void EmitYUVTileLine(struct hle_t* hle, const int16_t *y, const int16_t *u, uint32_t address)
 {
@@ -338,6 +389,10 @@ static void EmitRGBATileLine(struct hle_t* hle, const int16_t *y, const int16_t
     const int16_t *const v  = u + SUBBLOCK_SIZE;
     const int16_t *const y2 = y + SUBBLOCK_SIZE;
 
+#ifdef ARITHMETICS_SSE2
+    _mm_storeu_si128((__m128i *)&rgba[0], GetRGBA8(y,  u,     v));
+    _mm_storeu_si128((__m128i *)&rgba[8], GetRGBA8(y2, u + 4, v + 4));
+#else
     rgba[0]  = GetRGBA(y[0],  u[0], v[0]);
     rgba[1]  = GetRGBA(y[1],  u[0], v[0]);
     rgba[2]  = GetRGBA(y[2],  u[1], v[1]);
@@ -354,6 +409,7 @@ static void EmitRGBATileLine(struct hle_t* hle, const int16_t *y, const int16_t
     rgba[13] = GetRGBA(y2[5], u[6], v[6]);
     rgba[14] = GetRGBA(y2[6], u[7], v[7]);
     rgba[15] = GetRGBA(y2[7], u[7], v[7]);
+#endif
 
     dram_store_u16(hle, rgba, address, 16);
 }
@@ -515,6 +571,114 @@ static void RShiftSubBlock(int16_t *dst, const int16_t *src, unsigned int shift)
  * Implementation based on Wikipedia :
  * http://fr.wikipedia.org/wiki/Transform%C3%A9e_en_cosinus_discr%C3%A8te
  **************************************************************************/
+#ifdef ARITHMETICS_SSE2
+/* InverseDCT1D on 4 vectors at once, the same operations in the same order
+ * keeping the results identical */
+static void InverseDCT1D4(const __m128 *x, __m128 *dst)
+{
+    __m128 e[4];
+    __m128 f[4];
+    __m128 x26, x1357, x15, x37, x17, x35;
+
+    x15   = _mm_mul_ps(_mm_set1_ps(IDCT_K[2]), _mm_add_ps(x[1], x[5]));
+    x37   = _mm_mul_ps(_mm_set1_ps(IDCT_K[3]), _mm_add_ps(x[3], x[7]));
+    x17   = _mm_mul_ps(_mm_set1_ps(IDCT_K[8]), _mm_add_ps(x[1], x[7]));
+    x35   = _mm_mul_ps(_mm_set1_ps(IDCT_K[9]), _mm_add_ps(x[3], x[5]));
+    x1357 = _mm_mul_ps(_mm_set1_ps(IDCT_C3),
+                       _mm_add_ps(_mm_add_ps(_mm_add_ps(x[1], x[3]), x[5]), x[7]));
+    x26   = _mm_mul_ps(_mm_set1_ps(IDCT_C6), _mm_add_ps(x[2], x[6]));
+
+    f[0] = _mm_add_ps(x[0], x[4]);
+    f[1] = _mm_sub_ps(x[0], x[4]);
+    f[2] = _mm_add_ps(x26, _mm_mul_ps(_mm_set1_ps(IDCT_K[0]), x[2]));
+    f[3] = _mm_add_ps(x26, _mm_mul_ps(_mm_set1_ps(IDCT_K[1]), x[6]));
+
+    e[0] = _mm_add_ps(_mm_add_ps(_mm_add_ps(x1357, x15), _mm_mul_ps(_mm_set1_ps(IDCT_K[4]), x[1])), x17);
+    e[1] = _mm_add_ps(_mm_add_ps(_mm_add_ps(x1357, x37), _mm_mul_ps(_mm_set1_ps(IDCT_K[6]), x[3])), x35);
+    e[2] = _mm_add_ps(_mm_add_ps(_mm_add_ps(x1357, x15), _mm_mul_ps(_mm_set1_ps(IDCT_K[5]), x[5])), x35);
+    e[3] = _mm_add_ps(_mm_add_ps(_mm_add_ps(x1357, x37), _mm_mul_ps(_mm_set1_ps(IDCT_K[7]), x[7])), x17);
+
+    dst[0] = _mm_add_ps(_mm_add_ps(f[0], f[2]), e[0]);
+    dst[1] = _mm_add_ps(_mm_add_ps(f[1], f[3]), e[1]);
+    dst[2] = _mm_add_ps(_mm_sub_ps(f[1], f[3]), e[2]);
+    dst[3] = _mm_add_ps(_mm_sub_ps(f[0], f[2]), e[3]);
+    dst[4] = _mm_sub_ps(_mm_sub_ps(f[0], f[2]), e[3]);
+    dst[5] = _mm_sub_ps(_mm_sub_ps(f[1], f[3]), e[2]);
+    dst[6] = _mm_sub_ps(_mm_add_ps(f[1], f[3]), e[1]);
+    dst[7] = _mm_sub_ps(_mm_add_ps(f[0], f[2]), e[0]);
+}
+
+static void InverseDCTSubBlock(int16_t *dst, const int16_t *src)
+{
+    __m128i a[8], b[8], col[8], out[2][8];
+    __m128 block[2][8];
+    unsigned int i, h;
+
+    /* transpose src so that col[j] holds the j-th element of each row */
+    for (i = 0; i < 8; ++i)
+        a[i] = _mm_loadu_si128((const __m128i *)(src + i * 8));
+
+    for (i = 0; i < 8; i += 2) {
+        b[i]     = _mm_unpacklo_epi16(a[i], a[i + 1]);
+        b[i + 1] = _mm_unpackhi_epi16(a[i], a[i + 1]);
+    }
+
+    for (i = 0; i < 8; i += 4) {
+        a[i]     = _mm_unpacklo_epi32(b[i],     b[i + 2]);
+        a[i + 1] = _mm_unpackhi_epi32(b[i],     b[i + 2]);
+        a[i + 2] = _mm_unpacklo_epi32(b[i + 1], b[i + 3]);
+        a[i + 3] = _mm_unpackhi_epi32(b[i + 1], b[i + 3]);
+    }
+
+    for (i = 0; i < 4; ++i) {
+        col[2 * i]     = _mm_unpacklo_epi64(a[i], a[i + 4]);
+        col[2 * i + 1] = _mm_unpackhi_epi64(a[i], a[i + 4]);
+    }
+
+    /* idct 1d on rows 0-3 and 4-7: block[h][k] holds the k-th output
+     * of rows 4h to 4h+3 */
+    for (h = 0; h < 2; ++h) {
+        __m128 x[8];
+
+        for (i = 0; i < 8; ++i) {
+            const __m128i c = (h == 0)
+                ? _mm_unpacklo_epi16(col[i], col[i])
+                : _mm_unpackhi_epi16(col[i], col[i]);
+            x[i] = _mm_cvtepi32_ps(_mm_srai_epi32(c, 16));
+        }
+
+        InverseDCT1D4(x, block[h]);
+    }
+
+    /* idct 1d on columns, for the columns 4h to 4h+3 */
+    for (h = 0; h < 2; ++h) {
+        __m128 x[8], y[8];
+
+        for (i = 0; i < 2; ++i) {
+            __m128 r0 = block[i][4 * h];
+            __m128 r1 = block[i][4 * h + 1];
+            __m128 r2 = block[i][4 * h + 2];
+            __m128 r3 = block[i][4 * h + 3];
+
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+            x[4 * i]     = r0;
+            x[4 * i + 1] = r1;
+            x[4 * i + 2] = r2;
+            x[4 * i + 3] = r3;
+        }
+
+        InverseDCT1D4(x, y);
+
+        /* (int16_t) conversion followed by C4 = 1 normalization */
+        for (i = 0; i < 8; ++i)
+            out[h][i] = _mm_srai_epi32(_mm_slli_epi32(_mm_cvttps_epi32(y[i]), 16), 19);
+    }
+
+    for (i = 0; i < 8; ++i)
+        _mm_storeu_si128((__m128i *)(dst + i * 8), _mm_packs_epi32(out[0][i], out[1][i]));
+}
+#else
 static void InverseDCT1D(const float *const x, float *dst, unsigned int stride)
 {
     float e[4];
@@ -578,6 +742,7 @@ static void InverseDCTSubBlock(int16_t *dst, const int16_t *src)
             dst[i + j * 8] = (int16_t)x[j] >> 3;
     }
 }
+#endif
 
 static void RescaleYSubBlock(int16_t *dst, const int16_t *src)
 {
@@ -23,9 +23,70 @@
 
 #include "memory.h"
 
+/* Within a 32-bit word, the S8 and S16 swizzles reverse the order of the
+ * bytes and halfwords respectively. So 16 bytes starting on a word boundary
+ * can be swizzled by a single shuffle, in either direction. */
+#if defined(M64P_BIG_ENDIAN) || defined(NO_SIMD)
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SWIZZLE_BLOCKS
+
+#include <emmintrin.h>
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+static inline void swizzle_u8x16(void* dst, const void* src)
+{
+    __m128i x = _mm_loadu_si128((const __m128i*)src);
+#ifdef __SSSE3__
+    x = _mm_shuffle_epi8(x, _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                                          11, 10, 9, 8, 15, 14, 13, 12));
+#else
+    x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xb1), 0xb1);
+    x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+#endif
+    _mm_storeu_si128((__m128i*)dst, x);
+}
+
+static inline void swizzle_u16x8(void* dst, const void* src)
+{
+    __m128i x = _mm_loadu_si128((const __m128i*)src);
+    x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xb1), 0xb1);
+    _mm_storeu_si128((__m128i*)dst, x);
+}
+#elif defined(__ARM_NEON)
+#define SWIZZLE_BLOCKS
+
+#include <arm_neon.h>
+
+static inline void swizzle_u8x16(void* dst, const void* src)
+{
+    vst1q_u8((uint8_t*)dst, vrev32q_u8(vld1q_u8((const uint8_t*)src)));
+}
+
+static inline void swizzle_u16x8(void* dst, const void* src)
+{
+    vst1q_u16((uint16_t*)dst, vrev32q_u16(vld1q_u16((const uint16_t*)src)));
+}
+#endif
+
 /* Global functions */
 void load_u8(uint8_t* dst, const unsigned char* buffer, unsigned address, size_t count)
 {
+#ifdef SWIZZLE_BLOCKS
+    while (count != 0 && (address & 3) != 0) {
+        *(dst++) = *u8(buffer, address);
+        address += 1;
+        --count;
+    }
+
+    for (; count >= 16; count -= 16) {
+        swizzle_u8x16(dst, buffer + address);
+        dst += 16;
+        address += 16;
+    }
+#endif
+
     while (count != 0) {
         *(dst++) = *u8(buffer, address);
         address += 1;
@@ -35,6 +96,23 @@ void load_u8(uint8_t* dst, const unsigned char* buffer, unsigned address, size_t
 
 void load_u16(uint16_t* dst, const unsigned char* buffer, unsigned address, size_t count)
 {
+#ifdef SWIZZLE_BLOCKS
+    /* odd addresses don't map onto the halfword swizzle, leave them to the scalar loop */
+    if ((address & 1) == 0) {
+        if (count != 0 && (address & 3) != 0) {
+            *(dst++) = *u16(buffer, address);
+            address += 2;
+            --count;
+        }
+
+        for (; count >= 8; count -= 8) {
+            swizzle_u16x8(dst, buffer + address);
+            dst += 8;
+            address += 16;
+        }
+    }
+#endif
+
     while (count != 0) {
         *(dst++) = *u16(buffer, address);
         address += 2;
@@ -50,6 +128,20 @@ void load_u32(uint32_t* dst, const unsigned char* buffer, unsigned address, size
 
 void store_u8(unsigned char* buffer, unsigned address, const uint8_t* src, size_t count)
 {
+#ifdef SWIZZLE_BLOCKS
+    while (count != 0 && (address & 3) != 0) {
+        *u8(buffer, address) = *(src++);
+        address += 1;
+        --count;
+    }
+
+    for (; count >= 16; count -= 16) {
+        swizzle_u8x16(buffer + address, src);
+        src += 16;
+        address += 16;
+    }
+#endif
+
     while (count != 0) {
         *u8(buffer, address) = *(src++);
         address += 1;
@@ -59,6 +151,23 @@ void store_u8(unsigned char* buffer, unsigned address, const uint8_t* src, size_
 
 void store_u16(unsigned char* buffer, unsigned address, const uint16_t* src, size_t count)
 {
+#ifdef SWIZZLE_BLOCKS
+    /* odd addresses don't map onto the halfword swizzle, leave them to the scalar loop */
+    if ((address & 1) == 0) {
+        if (count != 0 && (address & 3) != 0) {
+            *u16(buffer, address) = *(src++);
+            address += 2;
+            --count;
+        }
+
+        for (; count >= 8; count -= 8) {
+            swizzle_u16x8(buffer + address, src);
+            src += 8;
+            address += 16;
+        }
+    }
+#endif
+
     while (count != 0) {
         *u16(buffer, address) = *(src++);
         address += 2;
@@ -71,4 +180,3 @@ void store_u32(unsigned char* buffer, unsigned address, const uint32_t* src, siz
     /* Optimization for uint32_t */
     memcpy(u32(buffer, address), src, count * sizeof(uint32_t));
 }
-
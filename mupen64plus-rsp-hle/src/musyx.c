@@ -719,6 +719,55 @@ static void mix_voice_samples(struct hle_t* hle, musyx_t *musyx,
                       v4_env[0],      v4_env[1],      v4_env[2],      v4_env[3],
                       v4_env_step[0], v4_env_step[1], v4_env_step[2], v4_env_step[3]);
 
+#ifdef ARITHMETICS_SSE2
+    {
+        int16_t v[SUBFRAME_SIZE];
+
+        for (i = 0; i < SUBFRAME_SIZE; ++i) {
+            /* update sample and lut pointers and then pitch_accu */
+            const int16_t *lut = (RESAMPLE_LUT + ((pitch_accu & 0xfc00) >> 8));
+            int dist;
+
+            sample += (pitch_accu >> 16);
+            pitch_accu &= 0xffff;
+            pitch_accu += pitch_step;
+
+            /* handle end/restart points */
+            dist = sample - sample_end;
+            if (dist >= 0)
+                sample = sample_restart + dist;
+
+            /* apply resample filter */
+            v[i] = clamp_s16(dot4(sample, lut));
+        }
+
+        /* envmix, one destination at a time */
+        for (k = 0; k < 4; ++k) {
+            const uint32_t env = v4_env[k];
+            const uint32_t env_step = v4_env_step[k];
+            const __m128i env_step8 = _mm_set1_epi32((int32_t)(env_step << 3));
+            __m128i env_lo = _mm_setr_epi32(env, env + env_step,
+                                            env + 2 * env_step, env + 3 * env_step);
+            __m128i env_hi = _mm_add_epi32(env_lo, _mm_set1_epi32((int32_t)(env_step << 2)));
+            int32_t last_env;
+
+            for (i = 0; i < SUBFRAME_SIZE; i += 8) {
+                const __m128i gain = _mm_packs_epi32(_mm_srai_epi32(env_lo, 16),
+                                                     _mm_srai_epi32(env_hi, 16));
+                __m128i y = _mm_loadu_si128((const __m128i *)(v4_dst[k] + i));
+                __m128i x = _mm_loadu_si128((const __m128i *)(v + i));
+
+                _mm_storeu_si128((__m128i *)(v4_dst[k] + i), mix_s16x8(y, x, gain, 0));
+
+                env_lo = _mm_add_epi32(env_lo, env_step8);
+                env_hi = _mm_add_epi32(env_hi, env_step8);
+            }
+
+            last_env = (int32_t)(env + (SUBFRAME_SIZE - 1) * env_step);
+            v4[k] = clamp_s16((v[SUBFRAME_SIZE - 1] * (last_env >> 16)) >> 15);
+        }
+    }
+#else
     for (i = 0; i < SUBFRAME_SIZE; ++i) {
         /* update sample and lut pointers and then pitch_accu */
         const int16_t *lut = (RESAMPLE_LUT + ((pitch_accu & 0xfc00) >> 8));
@@ -748,6 +797,7 @@ static void mix_voice_samples(struct hle_t* hle, musyx_t *musyx,
             v4_env[k] += v4_env_step[k];
         }
     }
+#endif
 
     /* save last resampled sample */
     dram_store_u16(hle, (uint16_t *)v4, last_sample_ptr, 4);
@@ -856,11 +906,22 @@ static void mix_sfx_with_main_subframes_v1(musyx_t *musyx, const int16_t *subfra
 {
     unsigned i;
 
+#ifdef ARITHMETICS_SSE2
+    for (i = 0; i < SUBFRAME_SIZE; i += 8) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(subframe + i));
+        __m128i *left  = (__m128i *)(musyx->left + i);
+        __m128i *right = (__m128i *)(musyx->right + i);
+
+        _mm_storeu_si128(left,  _mm_adds_epi16(_mm_loadu_si128(left),  v));
+        _mm_storeu_si128(right, _mm_adds_epi16(_mm_loadu_si128(right), v));
+    }
+#else
     for (i = 0; i < SUBFRAME_SIZE; ++i) {
         int16_t v = subframe[i];
         musyx->left[i]  = clamp_s16(musyx->left[i]  + v);
         musyx->right[i] = clamp_s16(musyx->right[i] + v);
     }
+#endif
 }
 
 static void mix_sfx_with_main_subframes_v2(musyx_t *musyx, const int16_t *subframe,
@@ -868,6 +929,23 @@ static void mix_sfx_with_main_subframes_v2(musyx_t *musyx, const int16_t *subfra
 {
     unsigned i;
 
+#ifdef ARITHMETICS_SSE2
+    const __m128i g1 = _mm_set1_epi16(gains[0]);
+    const __m128i g2 = _mm_set1_epi16(gains[1]);
+
+    for (i = 0; i < SUBFRAME_SIZE; i += 8) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(subframe + i));
+        const __m128i v1 = mulhi_s16_u16(v, g1);
+        const __m128i v2 = mulhi_s16_u16(v, g2);
+        __m128i *left  = (__m128i *)(musyx->left + i);
+        __m128i *right = (__m128i *)(musyx->right + i);
+        __m128i *cc0   = (__m128i *)(musyx->cc0 + i);
+
+        _mm_storeu_si128(left,  _mm_adds_epi16(_mm_loadu_si128(left),  v1));
+        _mm_storeu_si128(right, _mm_adds_epi16(_mm_loadu_si128(right), v1));
+        _mm_storeu_si128(cc0,   _mm_adds_epi16(_mm_loadu_si128(cc0),   v2));
+    }
+#else
     for (i = 0; i < SUBFRAME_SIZE; ++i) {
         int16_t v = subframe[i];
         int16_t v1 = (int32_t)(v * gains[0]) >> 16;
@@ -877,6 +955,7 @@ static void mix_sfx_with_main_subframes_v2(musyx_t *musyx, const int16_t *subfra
         musyx->right[i] = clamp_s16(musyx->right[i] + v1);
         musyx->cc0[i]   = clamp_s16(musyx->cc0[i]   + v2);
     }
+#endif
 }
 
 static void mix_samples(int16_t *y, int16_t x, int16_t hgain)
@@ -888,8 +967,18 @@ static void mix_subframes(int16_t *y, const int16_t *x, int16_t hgain)
 {
     unsigned int i;
 
+#ifdef ARITHMETICS_SSE2
+    const __m128i g = _mm_set1_epi16(hgain);
+
+    for (i = 0; i < SUBFRAME_SIZE; i += 8) {
+        __m128i yv = _mm_loadu_si128((const __m128i *)(y + i));
+        __m128i xv = _mm_loadu_si128((const __m128i *)(x + i));
+        _mm_storeu_si128((__m128i *)(y + i), mix_s16x8(yv, xv, g, 0x4000));
+    }
+#else
     for (i = 0; i < SUBFRAME_SIZE; ++i)
         mix_samples(&y[i], x[i], hgain);
+#endif
 }
 
 static void mix_fir4(int16_t *y, const int16_t *x, int16_t hgain, const int16_t *hcoeffs)
@@ -902,6 +991,33 @@ static void mix_fir4(int16_t *y, const int16_t *x, int16_t hgain, const int16_t
     h[2] = (hgain * hcoeffs[2]) >> 15;
     h[3] = (hgain * hcoeffs[3]) >> 15;
 
+#ifdef ARITHMETICS_SSE2
+    /* (-0x8000 * -0x8000) >> 15 is the only tap which doesn't fit in 16 bits */
+    if (h[0] <= INT16_MAX && h[1] <= INT16_MAX && h[2] <= INT16_MAX && h[3] <= INT16_MAX) {
+        const __m128i h01 = _mm_set1_epi32((int32_t)((uint32_t)h[1] << 16 | (uint16_t)h[0]));
+        const __m128i h23 = _mm_set1_epi32((int32_t)((uint32_t)h[3] << 16 | (uint16_t)h[2]));
+
+        for (i = 0; i < SUBFRAME_SIZE; i += 8) {
+            const __m128i x0 = _mm_loadu_si128((const __m128i *)(x + i));
+            const __m128i x1 = _mm_loadu_si128((const __m128i *)(x + i + 1));
+            const __m128i x2 = _mm_loadu_si128((const __m128i *)(x + i + 2));
+            const __m128i x3 = _mm_loadu_si128((const __m128i *)(x + i + 3));
+            const __m128i yv = _mm_loadu_si128((const __m128i *)(y + i));
+            __m128i lo, hi;
+
+            lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(x0, x1), h01),
+                               _mm_madd_epi16(_mm_unpacklo_epi16(x2, x3), h23));
+            hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(x0, x1), h01),
+                               _mm_madd_epi16(_mm_unpackhi_epi16(x2, x3), h23));
+
+            lo = _mm_add_epi32(_mm_srai_epi32(lo, 15), _mm_srai_epi32(_mm_unpacklo_epi16(yv, yv), 16));
+            hi = _mm_add_epi32(_mm_srai_epi32(hi, 15), _mm_srai_epi32(_mm_unpackhi_epi16(yv, yv), 16));
+            _mm_storeu_si128((__m128i *)(y + i), _mm_packs_epi32(lo, hi));
+        }
+        return;
+    }
+#endif
+
     for (i = 0; i < SUBFRAME_SIZE; ++i) {
         int32_t v = (h[0] * x[i] + h[1] * x[i + 1] + h[2] * x[i + 2] + h[3] * x[i + 3]) >> 15;
         y[i] = clamp_s16(y[i] + v);
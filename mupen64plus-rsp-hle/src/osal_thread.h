@@ -0,0 +1,47 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus-rsp-hle - osal_thread.h                                   *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#if !defined(OSAL_THREAD_H)
+#define OSAL_THREAD_H
+
+typedef struct osal_thread osal_thread;
+
+/* a mutex together with a condition variable waiting on it */
+typedef struct osal_cond osal_cond;
+
+osal_thread* osal_thread_create(void (*entry)(void*), void* arg);
+
+void         osal_thread_join(osal_thread* thread);
+
+osal_cond*   osal_cond_create(void);
+
+void         osal_cond_destroy(osal_cond* cond);
+
+void         osal_cond_lock(osal_cond* cond);
+
+void         osal_cond_unlock(osal_cond* cond);
+
+/* must be called with the lock held, which is released while waiting */
+void         osal_cond_wait(osal_cond* cond);
+
+void         osal_cond_broadcast(osal_cond* cond);
+
+#endif /* #define OSAL_THREAD_H */
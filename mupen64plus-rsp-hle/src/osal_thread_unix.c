@@ -0,0 +1,121 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus-rsp-hle - osal_thread_unix.c                              *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "osal_thread.h"
+
+struct osal_thread
+{
+    pthread_t handle;
+    void (*entry)(void*);
+    void* arg;
+};
+
+struct osal_cond
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+};
+
+static void* thread_entry(void* opaque)
+{
+    osal_thread* thread = (osal_thread*)opaque;
+
+    thread->entry(thread->arg);
+    return NULL;
+}
+
+osal_thread* osal_thread_create(void (*entry)(void*), void* arg)
+{
+    osal_thread* thread = malloc(sizeof(*thread));
+
+    if (thread == NULL)
+        return NULL;
+
+    thread->entry = entry;
+    thread->arg = arg;
+
+    if (pthread_create(&thread->handle, NULL, thread_entry, thread) != 0)
+    {
+        free(thread);
+        return NULL;
+    }
+
+    return thread;
+}
+
+void osal_thread_join(osal_thread* thread)
+{
+    pthread_join(thread->handle, NULL);
+    free(thread);
+}
+
+osal_cond* osal_cond_create(void)
+{
+    osal_cond* cond = malloc(sizeof(*cond));
+
+    if (cond == NULL)
+        return NULL;
+
+    if (pthread_mutex_init(&cond->mutex, NULL) != 0)
+    {
+        free(cond);
+        return NULL;
+    }
+
+    if (pthread_cond_init(&cond->cond, NULL) != 0)
+    {
+        pthread_mutex_destroy(&cond->mutex);
+        free(cond);
+        return NULL;
+    }
+
+    return cond;
+}
+
+void osal_cond_destroy(osal_cond* cond)
+{
+    pthread_cond_destroy(&cond->cond);
+    pthread_mutex_destroy(&cond->mutex);
+    free(cond);
+}
+
+void osal_cond_lock(osal_cond* cond)
+{
+    pthread_mutex_lock(&cond->mutex);
+}
+
+void osal_cond_unlock(osal_cond* cond)
+{
+    pthread_mutex_unlock(&cond->mutex);
+}
+
+void osal_cond_wait(osal_cond* cond)
+{
+    pthread_cond_wait(&cond->cond, &cond->mutex);
+}
+
+void osal_cond_broadcast(osal_cond* cond)
+{
+    pthread_cond_broadcast(&cond->cond);
+}
@@ -0,0 +1,112 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus-rsp-hle - osal_thread_win32.c                             *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <stdlib.h>
+#include <windows.h>
+#include <process.h>
+
+#include "osal_thread.h"
+
+struct osal_thread
+{
+    HANDLE handle;
+    void (*entry)(void*);
+    void* arg;
+};
+
+struct osal_cond
+{
+    CRITICAL_SECTION mutex;
+    CONDITION_VARIABLE cond;
+};
+
+static unsigned __stdcall thread_entry(void* opaque)
+{
+    osal_thread* thread = (osal_thread*)opaque;
+
+    thread->entry(thread->arg);
+    return 0;
+}
+
+osal_thread* osal_thread_create(void (*entry)(void*), void* arg)
+{
+    osal_thread* thread = malloc(sizeof(*thread));
+
+    if (thread == NULL)
+        return NULL;
+
+    thread->entry = entry;
+    thread->arg = arg;
+    thread->handle = (HANDLE)_beginthreadex(NULL, 0, thread_entry, thread, 0, NULL);
+
+    if (thread->handle == NULL)
+    {
+        free(thread);
+        return NULL;
+    }
+
+    return thread;
+}
+
+void osal_thread_join(osal_thread* thread)
+{
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    free(thread);
+}
+
+osal_cond* osal_cond_create(void)
+{
+    osal_cond* cond = malloc(sizeof(*cond));
+
+    if (cond == NULL)
+        return NULL;
+
+    InitializeCriticalSection(&cond->mutex);
+    InitializeConditionVariable(&cond->cond);
+    return cond;
+}
+
+void osal_cond_destroy(osal_cond* cond)
+{
+    DeleteCriticalSection(&cond->mutex);
+    free(cond);
+}
+
+void osal_cond_lock(osal_cond* cond)
+{
+    EnterCriticalSection(&cond->mutex);
+}
+
+void osal_cond_unlock(osal_cond* cond)
+{
+    LeaveCriticalSection(&cond->mutex);
+}
+
+void osal_cond_wait(osal_cond* cond)
+{
+    SleepConditionVariableCS(&cond->cond, &cond->mutex, INFINITE);
+}
+
+void osal_cond_broadcast(osal_cond* cond)
+{
+    WakeAllConditionVariable(&cond->cond);
+}
@@ -25,6 +25,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
 #include "common.h"
 #include "hle.h"
 #include "hle_internal.h"
@@ -38,6 +42,7 @@
 #include "m64p_types.h"
 
 #include "osal_dynamiclib.h"
+#include "osal_thread.h"
 
 #define CONFIG_API_VERSION       0x020100
 #define CONFIG_PARAM_VERSION     1.00
@@ -51,6 +56,12 @@
 #define RSP_HLE_CONFIG_FALLBACK "RspFallback"
 #define RSP_HLE_CONFIG_HLE_GFX  "DisplayListToGraphicsPlugin"
 #define RSP_HLE_CONFIG_HLE_AUD  "AudioListToAudioPlugin"
+#define RSP_HLE_CONFIG_ASYNC_AUD "AsyncAudio"
+#define RSP_HLE_CONFIG_UCODE_CACHE "UcodeCache"
+#define RSP_HLE_CONFIG_LLE_UCODES "LleUcodes"
+
+#define RSP_HLE_UCODE_CACHE_FILE "rsp-hle-ucodes.txt"
+#define RSP_HLE_UCODE_CACHE_MAX  256
 
 
 #define VERSION_PRINTF_SPLIT(x) (((x) >> 16) & 0xffff), (((x) >> 8) & 0xff), ((x) & 0xff)
@@ -59,8 +70,19 @@
 #define GET_FUNC(type, field, name) \
     ((field = (type)osal_dynlib_getproc(handle, name)) != NULL)
 
+/* ucodes of the cache file, least recently used first */
+struct ucode_cache_t
+{
+    unsigned int count;
+    struct {
+        unsigned int uc_start, uc_dstart, uc_dsize, uc_fingerprint;
+        char name[64];
+    } entries[RSP_HLE_UCODE_CACHE_MAX];
+};
+
 /* local variables */
 static struct hle_t g_hle;
+static struct ucode_cache_t l_UcodeCache;
 static void (*l_CheckInterrupts)(void) = NULL;
 static void (*l_ProcessDlistList)(void) = NULL;
 static void (*l_ProcessAlistList)(void) = NULL;
@@ -77,6 +99,17 @@ static ptr_InitiateRSP l_InitiateRSP = NULL;
 static ptr_DoRspCycles l_DoRspCycles = NULL;
 static ptr_RomClosed l_RomClosed = NULL;
 static ptr_PluginShutdown l_PluginShutdown = NULL;
+static char l_LleUcodes[512];
+
+/* asynchronous audio tasks */
+static struct hle_t g_hle_audio;
+static unsigned char l_AudioDmem[0x1000];
+static unsigned int l_AudioMiIntr;
+static unsigned int l_AudioSpStatus;
+static osal_thread* l_AudioThread = NULL;
+static osal_cond* l_AudioCond = NULL;
+static void (*l_AudioTask)(struct hle_t*) = NULL;
+static int l_AudioQuit = 0;
 
 /* definitions of pointers to Core functions */
 static ptr_ConfigOpenSection      ConfigOpenSection = NULL;
@@ -91,6 +124,7 @@ static ptr_ConfigGetParamInt      ConfigGetParamInt = NULL;
 static ptr_ConfigGetParamFloat    ConfigGetParamFloat = NULL;
 static ptr_ConfigGetParamBool     ConfigGetParamBool = NULL;
 static ptr_ConfigGetParamString   ConfigGetParamString = NULL;
+static ptr_ConfigGetUserCachePath ConfigGetUserCachePath = NULL;
 static ptr_CoreDoCommand          CoreDoCommand = NULL;
 
 /* local function */
@@ -187,6 +221,248 @@ close_handle:
     osal_dynlib_close(handle);
 }
 
+static void audio_thread(void* UNUSED(arg))
+{
+    void (*task)(struct hle_t*);
+
+    osal_cond_lock(l_AudioCond);
+    for (;;) {
+        while (l_AudioTask == NULL && !l_AudioQuit)
+            osal_cond_wait(l_AudioCond);
+
+        /* a queued task is still run when asked to quit */
+        task = l_AudioTask;
+        if (task == NULL)
+            break;
+
+        osal_cond_unlock(l_AudioCond);
+        task(&g_hle_audio);
+        osal_cond_lock(l_AudioCond);
+
+        l_AudioTask = NULL;
+        osal_cond_broadcast(l_AudioCond);
+    }
+    osal_cond_unlock(l_AudioCond);
+}
+
+static void wait_audio_task(void)
+{
+    if (l_AudioThread == NULL)
+        return;
+
+    osal_cond_lock(l_AudioCond);
+    while (l_AudioTask != NULL)
+        osal_cond_wait(l_AudioCond);
+    osal_cond_unlock(l_AudioCond);
+}
+
+static void stop_audio_thread(void)
+{
+    if (l_AudioThread == NULL)
+        return;
+
+    osal_cond_lock(l_AudioCond);
+    l_AudioQuit = 1;
+    osal_cond_broadcast(l_AudioCond);
+    osal_cond_unlock(l_AudioCond);
+
+    osal_thread_join(l_AudioThread);
+    osal_cond_destroy(l_AudioCond);
+    l_AudioThread = NULL;
+    l_AudioCond = NULL;
+    l_AudioQuit = 0;
+}
+
+static void start_audio_thread(void)
+{
+    stop_audio_thread();
+
+    /* audio tasks get their own hle state, DMEM and status registers,
+     * so that they never race with the tasks which follow them */
+    g_hle_audio = g_hle;
+    g_hle_audio.dmem = l_AudioDmem;
+    g_hle_audio.mi_intr = &l_AudioMiIntr;
+    g_hle_audio.sp_status = &l_AudioSpStatus;
+
+    l_AudioCond = osal_cond_create();
+    if (l_AudioCond == NULL) {
+        HleErrorMessage(NULL, "Can't create audio task condition variable");
+        return;
+    }
+
+    l_AudioThread = osal_thread_create(audio_thread, NULL);
+    if (l_AudioThread == NULL) {
+        HleErrorMessage(NULL, "Can't create audio task thread");
+        osal_cond_destroy(l_AudioCond);
+        l_AudioCond = NULL;
+    }
+}
+
+/* Ucodes listed in the config and in the RspLle property of the ROM
+ * database are run on the fallback plugin, the others stay emulated */
+static void setup_lle_ucodes(void)
+{
+    m64p_rom_settings rom_settings;
+    const char* config_ucodes;
+
+    config_ucodes = ConfigGetParamString(l_ConfigRspHle, RSP_HLE_CONFIG_LLE_UCODES);
+
+    /* older cores don't fill rsplle, leaving it empty */
+    memset(&rom_settings, 0, sizeof(rom_settings));
+    CoreDoCommand(M64CMD_ROM_GET_SETTINGS, sizeof(rom_settings), &rom_settings);
+    rom_settings.rsplle[sizeof(rom_settings.rsplle) - 1] = '\0';
+
+    snprintf(l_LleUcodes, sizeof(l_LleUcodes), "%s %s",
+             config_ucodes != NULL ? config_ucodes : "", rom_settings.rsplle);
+
+    if (l_DoRspCycles == NULL) {
+        if (strspn(l_LleUcodes, " \t,;") != strlen(l_LleUcodes))
+            HleWarnMessage(NULL, "No RSP fallback plugin, ucodes will be emulated: %s", l_LleUcodes);
+        g_hle.lle_ucodes = NULL;
+    }
+    else {
+        g_hle.lle_ucodes = l_LleUcodes;
+    }
+}
+
+static int get_ucode_cache_path(char* path, size_t size)
+{
+    const char* cache_dir;
+    size_t len;
+
+    if (ConfigGetUserCachePath == NULL || !ConfigGetParamBool(l_ConfigRspHle, RSP_HLE_CONFIG_UCODE_CACHE))
+        return 0;
+
+    cache_dir = ConfigGetUserCachePath();
+    if (cache_dir == NULL)
+        return 0;
+
+    len = strlen(cache_dir);
+    if (len != 0 && cache_dir[len-1] != '/' && cache_dir[len-1] != '\\')
+        snprintf(path, size, "%s/%s", cache_dir, RSP_HLE_UCODE_CACHE_FILE);
+    else
+        snprintf(path, size, "%s%s", cache_dir, RSP_HLE_UCODE_CACHE_FILE);
+
+    return 1;
+}
+
+/* adds a ucode as the most recently used one, replacing the same ucode
+ * and dropping the least recently used one when the cache is full */
+static void add_cached_ucode(void* opaque,
+    uint32_t uc_start, uint32_t uc_dstart, uint16_t uc_dsize, uint32_t uc_fingerprint,
+    const char* uc_name)
+{
+    struct ucode_cache_t* cache = (struct ucode_cache_t*)opaque;
+    unsigned int i;
+
+    for (i = 0; i < cache->count; ++i) {
+        if (cache->entries[i].uc_start == uc_start && cache->entries[i].uc_dstart == uc_dstart
+         && cache->entries[i].uc_dsize == uc_dsize && cache->entries[i].uc_fingerprint == uc_fingerprint)
+            break;
+    }
+
+    if (i == RSP_HLE_UCODE_CACHE_MAX)
+        i = 0;
+    if (i < cache->count) {
+        memmove(&cache->entries[i], &cache->entries[i+1], (cache->count - i - 1) * sizeof(cache->entries[0]));
+        cache->count--;
+    }
+
+    i = cache->count++;
+    cache->entries[i].uc_start = uc_start;
+    cache->entries[i].uc_dstart = uc_dstart;
+    cache->entries[i].uc_dsize = uc_dsize;
+    cache->entries[i].uc_fingerprint = uc_fingerprint;
+    snprintf(cache->entries[i].name, sizeof(cache->entries[i].name), "%s", uc_name);
+}
+
+static void read_ucode_cache(const char* path, struct ucode_cache_t* cache)
+{
+    char line[256];
+    char name[64];
+    unsigned int uc_start, uc_dstart, uc_dsize, uc_fingerprint;
+    FILE* f;
+
+    cache->count = 0;
+
+    f = fopen(path, "r");
+    if (f == NULL)
+        return;
+
+    /* one "uc_start uc_dstart uc_dsize fingerprint name" line per ucode */
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "%x %x %x %x %63s", &uc_start, &uc_dstart, &uc_dsize, &uc_fingerprint, name) != 5)
+            continue;
+
+        add_cached_ucode(cache, uc_start, uc_dstart, uc_dsize, uc_fingerprint, name);
+    }
+
+    fclose(f);
+}
+
+static int replace_file(const char* src, const char* dst)
+{
+#ifdef _WIN32
+    return MoveFileExA(src, dst, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(src, dst);
+#endif
+}
+
+static void load_ucode_cache(void)
+{
+    char path[4096];
+    unsigned int i;
+
+    if (!get_ucode_cache_path(path, sizeof(path)))
+        return;
+
+    read_ucode_cache(path, &l_UcodeCache);
+
+    for (i = 0; i < l_UcodeCache.count; ++i) {
+        if (hle_add_ucode(&g_hle, l_UcodeCache.entries[i].uc_start, l_UcodeCache.entries[i].uc_dstart,
+                          l_UcodeCache.entries[i].uc_dsize, l_UcodeCache.entries[i].uc_fingerprint,
+                          l_UcodeCache.entries[i].name) != 0)
+            HleVerboseMessage(NULL, "Ignoring cached ucode %s", l_UcodeCache.entries[i].name);
+    }
+}
+
+/* The cache file is shared by all games and emulator instances, so the
+ * ucodes of this session are merged with the ones currently in the file,
+ * and the file is replaced at once so that it is never seen half written. */
+static void save_ucode_cache(void)
+{
+    char path[4096];
+    char tmp_path[4096 + 4];
+    unsigned int i;
+    FILE* f;
+
+    if (!get_ucode_cache_path(path, sizeof(path)))
+        return;
+
+    read_ucode_cache(path, &l_UcodeCache);
+    hle_list_ucodes(&g_hle, add_cached_ucode, &l_UcodeCache);
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    f = fopen(tmp_path, "w");
+    if (f == NULL) {
+        HleWarnMessage(NULL, "Couldn't open %s for writing", tmp_path);
+        return;
+    }
+
+    for (i = 0; i < l_UcodeCache.count; ++i) {
+        fprintf(f, "%08x %08x %04x %08x %s\n",
+                l_UcodeCache.entries[i].uc_start, l_UcodeCache.entries[i].uc_dstart,
+                l_UcodeCache.entries[i].uc_dsize, l_UcodeCache.entries[i].uc_fingerprint,
+                l_UcodeCache.entries[i].name);
+    }
+
+    if (fclose(f) != 0 || replace_file(tmp_path, path) != 0) {
+        HleWarnMessage(NULL, "Couldn't write %s", path);
+        remove(tmp_path);
+    }
+}
+
 static void DebugMessage(int level, const char *message, va_list args)
 {
     char msgbuf[1024];
@@ -283,6 +559,25 @@ int HleForwardTask(void* user_defined)
 }
 
 
+int HleQueueAudioTask(void* UNUSED(user_defined), void (*task)(struct hle_t* hle))
+{
+    if (l_AudioThread == NULL)
+        return -1;
+
+    wait_audio_task();
+
+    memcpy(l_AudioDmem, g_hle.dmem, sizeof(l_AudioDmem));
+    l_AudioMiIntr = 0;
+    l_AudioSpStatus = 0;
+
+    osal_cond_lock(l_AudioCond);
+    l_AudioTask = task;
+    osal_cond_broadcast(l_AudioCond);
+    osal_cond_unlock(l_AudioCond);
+    return 0;
+}
+
+
 /* DLL-exported functions */
 EXPORT m64p_error CALL PluginStartup(m64p_dynlib_handle CoreLibHandle, void *Context,
                                      void (*DebugCallback)(void *, int, const char *))
@@ -333,6 +628,9 @@ EXPORT m64p_error CALL PluginStartup(m64p_dynlib_handle CoreLibHandle, void *Con
         !ConfigGetParamInt   || !ConfigGetParamFloat   || !ConfigGetParamBool   || !ConfigGetParamString)
         return M64ERR_INCOMPATIBLE;
 
+    /* optional, the ucode cache is disabled without it */
+    ConfigGetUserCachePath = (ptr_ConfigGetUserCachePath) osal_dynlib_getproc(CoreLibHandle, "ConfigGetUserCachePath");
+
     /* Get core DoCommand function */
     CoreDoCommand = (ptr_CoreDoCommand) osal_dynlib_getproc(CoreLibHandle, "CoreDoCommand");
     if (!CoreDoCommand) {
@@ -377,6 +675,13 @@ EXPORT m64p_error CALL PluginStartup(m64p_dynlib_handle CoreLibHandle, void *Con
         "Send display lists to the graphics plugin");
     ConfigSetDefaultBool(l_ConfigRspHle, RSP_HLE_CONFIG_HLE_AUD, 0,
         "Send audio lists to the audio plugin");
+    ConfigSetDefaultBool(l_ConfigRspHle, RSP_HLE_CONFIG_ASYNC_AUD, 0,
+        "Process audio lists on a separate thread, finishing them before the game is told they are done");
+    ConfigSetDefaultBool(l_ConfigRspHle, RSP_HLE_CONFIG_UCODE_CACHE, 0,
+        "Remember the ucodes detected in previous sessions, in the user cache directory");
+    ConfigSetDefaultString(l_ConfigRspHle, RSP_HLE_CONFIG_LLE_UCODES, "",
+        "Names of known ucodes (e.g. \"alist_process_naudio_mp3 musyx_v2_task\") to run on the RSP fallback "
+        "instead of emulating them, in addition to the RspLle property of the ROM database");
 
     l_CoreHandle = CoreLibHandle;
 
@@ -394,6 +699,7 @@ EXPORT m64p_error CALL PluginShutdown(void)
     l_DebugCallContext = NULL;
     l_CoreHandle = NULL;
 
+    stop_audio_thread();
     teardown_rsp_fallback();
 
     l_PluginInit = 0;
@@ -423,10 +729,18 @@ EXPORT m64p_error CALL PluginGetVersion(m64p_plugin_type *PluginType, int *Plugi
 
 EXPORT unsigned int CALL DoRspCycles(unsigned int Cycles)
 {
+    /* the RSP runs one task at a time */
+    wait_audio_task();
+
     hle_execute(&g_hle);
     return Cycles;
 }
 
+EXPORT void CALL SyncRspTasks(void)
+{
+    wait_audio_task();
+}
+
 EXPORT void CALL InitiateRSP(RSP_INFO Rsp_Info, unsigned int* CycleCount)
 {
     hle_init(&g_hle,
@@ -463,6 +777,15 @@ EXPORT void CALL InitiateRSP(RSP_INFO Rsp_Info, unsigned int* CycleCount)
 
     g_hle.hle_gfx = ConfigGetParamBool(l_ConfigRspHle, RSP_HLE_CONFIG_HLE_GFX);
     g_hle.hle_aud = ConfigGetParamBool(l_ConfigRspHle, RSP_HLE_CONFIG_HLE_AUD);
+    g_hle.async_aud = ConfigGetParamBool(l_ConfigRspHle, RSP_HLE_CONFIG_ASYNC_AUD);
+    setup_lle_ucodes();
+
+    hle_clear_ucodes(&g_hle);
+    load_ucode_cache();
+
+    if (g_hle.async_aud) {
+        start_audio_thread();
+    }
 
     /* notify fallback plugin */
     if (l_InitiateRSP) {
@@ -472,7 +795,10 @@ EXPORT void CALL InitiateRSP(RSP_INFO Rsp_Info, unsigned int* CycleCount)
 
 EXPORT void CALL RomClosed(void)
 {
-    g_hle.cached_ucodes.count = 0;
+    stop_audio_thread();
+
+    save_ucode_cache();
+    hle_clear_ucodes(&g_hle);
 
     /* notify fallback plugin */
     if (l_RomClosed) {
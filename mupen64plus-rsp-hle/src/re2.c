@@ -23,12 +23,16 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "arithmetics.h"
 #include "hle_external.h"
 #include "hle_internal.h"
 #include "memory.h"
 
 #define SATURATE8(x) ((unsigned int) x <= 255 ? x : (x < 0 ? 0: 255))
 
+/* number of pixels of a line converted at once by decode_video_frame_task */
+#define VIDEO_FRAME_BATCH 64
+
 /**************************************************************************
  * Resident evil 2 ucodes
  **************************************************************************/
@@ -100,6 +104,41 @@ void resize_bilinear_task(struct hle_t* hle)
     rsp_break(hle, SP_STATUS_TASKDONE);
 }
 
+#ifdef ARITHMETICS_SSE2
+/* YCbCr_to_RGBA on the 2x2 pixels sharing Cb and Cr */
+static void YCbCr_to_RGBA_2x2(uint32_t *dst1, uint32_t *dst2,
+                              const uint8_t *Y1, const uint8_t *Y2, uint8_t Cb, uint8_t Cr)
+{
+    const __m128d k = _mm_set1_pd(0.582199097);
+    const __m128d fY1 = _mm_mul_pd(_mm_setr_pd(Y1[0], Y1[1]), k);
+    const __m128d fY2 = _mm_mul_pd(_mm_setr_pd(Y2[0], Y2[1]), k);
+    const __m128d fCb = _mm_set1_pd(Cb - 128);
+    const __m128d fCr = _mm_set1_pd(Cr - 128);
+
+    const __m128d kr  = _mm_mul_pd(_mm_set1_pd(0.701004028), fCr);
+    const __m128d kgr = _mm_mul_pd(_mm_set1_pd(0.357070923), fCr);
+    const __m128d kgb = _mm_mul_pd(_mm_set1_pd(0.172073364), fCb);
+    const __m128d kb  = _mm_mul_pd(_mm_set1_pd(0.886001587), fCb);
+
+    const __m128i r = _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_add_pd(fY1, kr)),
+                                         _mm_cvttpd_epi32(_mm_add_pd(fY2, kr)));
+    const __m128i g = _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_sub_pd(_mm_sub_pd(fY1, kgr), kgb)),
+                                         _mm_cvttpd_epi32(_mm_sub_pd(_mm_sub_pd(fY2, kgr), kgb)));
+    const __m128i b = _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_add_pd(fY1, kb)),
+                                         _mm_cvttpd_epi32(_mm_add_pd(fY2, kb)));
+
+    /* SATURATE8, giving r0-r3 g0-g3 b0-b3 bytes */
+    const __m128i rgb = _mm_packus_epi16(_mm_packs_epi32(r, g),
+                                         _mm_packs_epi32(b, _mm_setzero_si128()));
+
+    const __m128i gr = _mm_unpacklo_epi8(_mm_srli_si128(rgb, 4), rgb);
+    const __m128i b0 = _mm_unpacklo_epi8(_mm_setzero_si128(), _mm_srli_si128(rgb, 8));
+    const __m128i pixels = _mm_unpacklo_epi16(b0, gr);
+
+    _mm_storel_epi64((__m128i *)dst1, pixels);
+    _mm_storel_epi64((__m128i *)dst2, _mm_srli_si128(pixels, 8));
+}
+#else
 static uint32_t YCbCr_to_RGBA(uint8_t Y, uint8_t Cb, uint8_t Cr)
 {
     int r, g, b;
@@ -115,6 +154,17 @@ static uint32_t YCbCr_to_RGBA(uint8_t Y, uint8_t Cb, uint8_t Cr)
     return (r << 24) | (g << 16) | (b << 8) | 0;
 }
 
+/* YCbCr_to_RGBA on the 2x2 pixels sharing Cb and Cr */
+static void YCbCr_to_RGBA_2x2(uint32_t *dst1, uint32_t *dst2,
+                              const uint8_t *Y1, const uint8_t *Y2, uint8_t Cb, uint8_t Cr)
+{
+    dst1[0] = YCbCr_to_RGBA(Y1[0], Cb, Cr);
+    dst1[1] = YCbCr_to_RGBA(Y1[1], Cb, Cr);
+    dst2[0] = YCbCr_to_RGBA(Y2[0], Cb, Cr);
+    dst2[1] = YCbCr_to_RGBA(Y2[1], Cb, Cr);
+}
+#endif
+
 void decode_video_frame_task(struct hle_t* hle)
 {
     int data_ptr = *dmem_u32(hle, TASK_UCODE_DATA);
@@ -132,9 +182,10 @@ void decode_video_frame_task(struct hle_t* hle)
 #endif
     int nScreenDMAIncrement = *dram_u32(hle, data_ptr + 36);
 
-    int i, j;
-    uint8_t Y, Cb, Cr;
-    uint32_t pixel;
+    int i, j, k, n;
+    uint8_t Y1[VIDEO_FRAME_BATCH], Y2[VIDEO_FRAME_BATCH];
+    uint8_t Cb[VIDEO_FRAME_BATCH / 2], Cr[VIDEO_FRAME_BATCH / 2];
+    uint32_t pixels1[VIDEO_FRAME_BATCH], pixels2[VIDEO_FRAME_BATCH];
     int pY_1st_row, pY_2nd_row, pDest_1st_row, pDest_2nd_row;
 
     for (i = 0; i < nMovieHeight; i += 2)
@@ -144,32 +195,32 @@ void decode_video_frame_task(struct hle_t* hle)
         pDest_1st_row = pDestination;
         pDest_2nd_row = pDestination + (nScreenDMAIncrement >> 1);
 
-        for (j = 0; j < nMovieWidth; j += 2)
+        /* each Cb, Cr sample covers 2x2 pixels */
+        for (j = 0; j < nMovieWidth; j += n)
         {
-            dram_load_u8(hle, (uint8_t*)&Cb, pCb++, 1);
-            dram_load_u8(hle, (uint8_t*)&Cr, pCr++, 1);
+            n = (nMovieWidth - j + 1) & ~1;
+            if (n > VIDEO_FRAME_BATCH)
+                n = VIDEO_FRAME_BATCH;
+
+            dram_load_u8(hle, Cb, pCb, n / 2);
+            dram_load_u8(hle, Cr, pCr, n / 2);
+            dram_load_u8(hle, Y1, pY_1st_row, n);
+            dram_load_u8(hle, Y2, pY_2nd_row, n);
+            pCb += n / 2;
+            pCr += n / 2;
+            pY_1st_row += n;
+            pY_2nd_row += n;
+
+            for (k = 0; k < n; k += 2)
+                YCbCr_to_RGBA_2x2(&pixels1[k], &pixels2[k], &Y1[k], &Y2[k], Cb[k / 2], Cr[k / 2]);
 
             /*1st row*/
-            dram_load_u8(hle, (uint8_t*)&Y, pY_1st_row++, 1);
-            pixel = YCbCr_to_RGBA(Y, Cb, Cr);
-            dram_store_u32(hle, &pixel, pDest_1st_row, 1);
-            pDest_1st_row += 4;
-
-            dram_load_u8(hle, (uint8_t*)&Y, pY_1st_row++, 1);
-            pixel = YCbCr_to_RGBA(Y, Cb, Cr);
-            dram_store_u32(hle, &pixel, pDest_1st_row, 1);
-            pDest_1st_row += 4;
+            dram_store_u32(hle, pixels1, pDest_1st_row, n);
+            pDest_1st_row += 4 * n;
 
             /*2nd row*/
-            dram_load_u8(hle, (uint8_t*)&Y, pY_2nd_row++, 1);
-            pixel = YCbCr_to_RGBA(Y, Cb, Cr);
-            dram_store_u32(hle, &pixel, pDest_2nd_row, 1);
-            pDest_2nd_row += 4;
-
-            dram_load_u8(hle, (uint8_t*)&Y, pY_2nd_row++, 1);
-            pixel = YCbCr_to_RGBA(Y, Cb, Cr);
-            dram_store_u32(hle, &pixel, pDest_2nd_row, 1);
-            pDest_2nd_row += 4;
+            dram_store_u32(hle, pixels2, pDest_2nd_row, n);
+            pDest_2nd_row += 4 * n;
         }
 
         pLuminance += (nMovieWidth << 1);
@@ -0,0 +1,51 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus-rsp-hle - task_capture.h                                  *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64Plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef TASK_CAPTURE_H
+#define TASK_CAPTURE_H
+
+#include <stdint.h>
+
+/* A task capture holds the RSP memories as they were when a task was
+ * started, so that it can be replayed outside of the emulator (see
+ * hle_bench.c).
+ *
+ * File layout, in host byte order (memories are stored as the hle core
+ * sees them, so captures are not portable across endianness):
+ *   struct task_capture_header
+ *   DMEM  (0x1000 bytes)
+ *   IMEM  (0x1000 bytes)
+ *   RDRAM (dram_size bytes, the rest of RDRAM being zero)
+ */
+
+#define TASK_CAPTURE_MAGIC      "HLETASK1"
+#define TASK_CAPTURE_DRAM_SIZE  0x800000
+
+struct task_capture_header
+{
+    char     magic[8];
+    uint32_t sp_pc;
+    uint32_t sp_status;
+    uint32_t dram_size;
+    uint32_t reserved;
+};
+
+#endif
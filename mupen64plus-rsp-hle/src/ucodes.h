@@ -24,7 +24,10 @@
 
 #include <stdint.h>
 
-#define CACHED_UCODES_MAX_SIZE 16
+/* open addressed table of the ucodes seen so far, the least recently used
+ * one being evicted when more than CACHED_UCODES_MAX_SIZE are in use */
+#define CACHED_UCODES_SIZE     64
+#define CACHED_UCODES_MAX_SIZE 48
 
 struct hle_t;
 
@@ -34,12 +37,17 @@ struct ucode_info_t {
     uint32_t     uc_start;
     uint32_t     uc_dstart;
     uint16_t     uc_dsize;
-    ucode_func_t uc_pfunc;
+    uint32_t     uc_fingerprint; /* hash of the ucode content, see ucode_fingerprint */
+    uint32_t     last_use;
+    ucode_func_t uc_pfunc;  /* NULL for empty slots */
+    int          uc_async;  /* can run on a private copy of DMEM */
+    int          uc_lle;    /* forwarded to the RSP fallback, see hle_t.lle_ucodes */
 };
 
 struct cached_ucodes_t {
-    struct ucode_info_t infos[CACHED_UCODES_MAX_SIZE];
+    struct ucode_info_t infos[CACHED_UCODES_SIZE];
     int count;
+    uint32_t clock;
 };
 
 /* cic_x105 ucode */